@@ -0,0 +1,516 @@
+// Microbenchmarks for the Temple of Secrets engine
+// full_game.c gets included with its main() left out, so every benchmark calls the real game code
+// (static functions too). The results are tab separated, one line per benchmark:
+//   benchmark <tab> ns per call <tab> calls timed
+// lines starting with '#' are comments. Save them per commit and compare later:
+//   ./temple_bench > before.tsv
+//   ... change something, rebuild ...
+//   ./temple_bench --compare before.tsv --max-regression 10
+//
+//   make temple_bench   (or: gcc -O2 bench.c -o temple_bench)
+
+#define TEMPLE_NO_MAIN
+#include "full_game.c"
+
+#define BENCH_ROUNDS 5
+#define MAX_BENCHES 32
+
+typedef struct
+{
+    const char *name;
+    void (*run)(long calls);
+} Bench;
+
+typedef struct
+{
+    char name[64];
+    double ns;
+} OldResult;
+
+// everything the benchmarks play with, set up once in main
+static World *world;
+static Session session;
+static FILE *results;   // the real stdout, the game's own output goes to /dev/null
+static FILE *nullFile;  // what WriteToLog writes to
+static char pagePath[64] = "";
+static const char *names[64];
+static char typed[64][COMPLETION_LINE];
+static int nameCount;
+static char transcript[128][100]; // transcripts/walkthrough.txt, one command per line
+static int transcriptLines;       // 0 = not there, the transcript benchmarks get skipped
+static volatile int sink; // so the compiler can't throw the work away
+
+static int ItemId(const char *name)
+{
+    int id = FindItemId(world, name);
+    if (id < 0)
+    {
+        fprintf(stderr, "The world has no %s, can't run the benchmarks\n", name);
+        exit(EXIT_FAILURE);
+    }
+    return id;
+}
+
+// ----- the benchmarks, each one does its thing `calls` times -----
+
+// every typed name against every name in the world, like the lookups do
+static void BenchCompareNames(long calls)
+{
+    for (long i = 0; i < calls; i++)
+        sink += string_compare(typed[i % nameCount], names[(i / nameCount) % nameCount]);
+}
+
+static void BenchCompareLong(long calls)
+{
+    const char *text = "A heavily rusted metal cog. Looks like it could fit into some machinery if it wasn't so rusty.";
+    char lower[128];
+    LowercaseAscii(lower, text, strlen(text) + 1);
+    for (long i = 0; i < calls; i++)
+        sink += string_compare(lower, text);
+}
+
+// pick the note up and put it down again (Entrance Hall)
+static void BenchTakeDrop(long calls)
+{
+    for (long i = 0; i < calls; i++)
+    {
+        GetItem(world, &session, "note");
+        ThrowItem(world, &session, "note");
+    }
+}
+
+// both key parts go in the bag, get combined, and the golden key gets thrown away again
+static void BenchMerge(long calls)
+{
+    int part1 = ItemId("Key Part 1");
+    int part2 = ItemId("Key Part 2");
+    for (long i = 0; i < calls; i++)
+    {
+        AddToBag(&session, part1);
+        AddToBag(&session, part2);
+        sink += MergeItems(world, &session, "key part 1", "key part 2");
+        DeleteItemFromBag(world, &session, "combined key parts");
+    }
+}
+
+// using something on the wrong target goes through every puzzle check, that's the common case
+static void BenchUseNothing(long calls)
+{
+    AddToBag(&session, ItemId("Note"));
+    for (long i = 0; i < calls; i++)
+        DoUseItem(world, &session, "note", "crate");
+    ThrowItem(world, &session, "note");
+}
+
+// the whole look command: room text, exits, items and interactables
+static void BenchLook(long calls)
+{
+    bool running = true, won = false;
+    char command[16];
+    for (long i = 0; i < calls; i++)
+    {
+        strcpy(command, "look");
+        DoCommand(command, world, &session, &running, &won, NULL);
+    }
+}
+
+// take the note back out of the bag and pick it up again, through the undo history
+static void BenchUndoRedo(long calls)
+{
+    StartUndoStep(&session, "take note");
+    GetItem(world, &session, "note");
+    EndUndoStep(&session);
+    for (long i = 0; i < calls; i++)
+    {
+        Undo(world, &session);
+        Redo(world, &session);
+    }
+    Undo(world, &session);
+}
+
+static void BenchLog(long calls)
+{
+    for (long i = 0; i < calls; i++)
+        WriteToLog(nullFile, "take rusty cog", "Attempted to take rusty cog");
+}
+
+static void BenchComplete(long calls)
+{
+    char lines[MAX_SUGGESTIONS][COMPLETION_LINE];
+    char common[COMPLETION_LINE];
+    for (long i = 0; i < calls; i++)
+        sink += CompleteLine(&session.completer, "examine c", lines, MAX_SUGGESTIONS, common);
+}
+
+// a new game on the built-in world: tables, session, timers, completion
+static void BenchWorldTables(long calls)
+{
+    for (long i = 0; i < calls; i++)
+    {
+        World *w = OpenTableWorld(&builtinWorld);
+        Session s;
+        StartSession(&s, w);
+        EndSession(&s, w);
+        CloseWorld(w);
+    }
+}
+
+// same from a page file on disk (the catalog and string pool get read, rooms come in as needed)
+static void BenchWorldPages(long calls)
+{
+    for (long i = 0; i < calls; i++)
+    {
+        World *w = OpenWorld(pagePath, DEFAULT_ROOM_CACHE);
+        if (!w)
+            exit(EXIT_FAILURE);
+        Session s;
+        StartSession(&s, w);
+        EndSession(&s, w);
+        CloseWorld(w);
+    }
+}
+
+// the whole validator on the built-in world (one thread, it's tiny)
+static void BenchValidate(long calls)
+{
+    for (long i = 0; i < calls; i++)
+        sink += ValidateWorld(world, 1, NULL);
+}
+
+// a whole game through the library: create, intro, destroy
+static void BenchGameCreate(long calls)
+{
+    char out[2048];
+    for (long i = 0; i < calls; i++)
+    {
+        TempleGame *game = game_create(NULL);
+        sink += game_intro(game, out, sizeof(out));
+        game_destroy(game);
+    }
+}
+
+// one command through the library, output into a buffer
+static void BenchGameStep(long calls)
+{
+    char out[2048];
+    TempleGame *game = game_create(NULL);
+    for (long i = 0; i < calls; i++)
+        sink += game_step(game, "look", out, sizeof(out));
+    game_destroy(game);
+}
+
+// same on a game that follows a host, so every line starts by checking for a new version of the world
+static void BenchHostStep(long calls)
+{
+    char out[2048];
+    TempleHost *host = host_create(pagePath);
+    TempleGame *game = host ? game_create_on(host) : NULL;
+    if (!game)
+        exit(EXIT_FAILURE);
+    for (long i = 0; i < calls; i++)
+        sink += game_step(game, "look", out, sizeof(out));
+    game_destroy(game);
+    host_destroy(host);
+}
+
+// same on a game in a shared world (alone in there), so every line takes its room's turn and hears the room's notes
+static void BenchSharedStep(long calls)
+{
+    char out[2048];
+    TempleShared *shared = shared_create(NULL);
+    TempleGame *game = shared ? game_join(shared, NULL) : NULL;
+    if (!game)
+        exit(EXIT_FAILURE);
+    for (long i = 0; i < calls; i++)
+        sink += game_step(game, "look", out, sizeof(out));
+    game_destroy(game);
+    shared_destroy(shared);
+}
+
+// a new version of the world: load the page file whole, validate it, put it out, one game goes over to it
+// and the old version gets freed
+static void BenchHostReload(long calls)
+{
+    char out[2048];
+    TempleHost *host = host_create(pagePath);
+    TempleGame *game = host ? game_create_on(host) : NULL;
+    if (!game)
+        exit(EXIT_FAILURE);
+    for (long i = 0; i < calls; i++)
+    {
+        sink += host_reload(host, NULL);
+        sink += game_step(game, "look", out, sizeof(out));
+        sink += host_collect(host);
+    }
+    game_destroy(game);
+    host_destroy(host);
+}
+
+// what moving a game to another process costs on both ends without the socket: save it, load it into a new game
+static void BenchSaveLoad(long calls)
+{
+    unsigned char saved[512];
+    TempleGame *game = game_create(NULL);
+    game_step(game, "take note; east; push crate; take rucksack", NULL, 0);
+    size_t size = game_save(game, saved, sizeof(saved));
+    for (long i = 0; i < calls; i++)
+    {
+        TempleGame *copy = game_load(NULL, saved, size);
+        sink += (int)game_save(copy, saved, sizeof(saved));
+        game_destroy(copy);
+    }
+    game_destroy(game);
+}
+
+// the walkthrough from the first room to the Gold Room on a new session, as text (stdout, like playing it)
+// or as JSON records (--json). same commands, same game, the difference is what the output costs
+static void PlayTranscript(long calls, bool json)
+{
+    MachineState machine;
+    char text[MACHINE_TEXT];
+    Output out;
+    char command[100];
+    for (long i = 0; i < calls; i++)
+    {
+        Session s;
+        StartSession(&s, world);
+        if (json)
+        {
+            memset(&machine, 0, sizeof(machine));
+            out.text = text;
+            out.size = sizeof(text);
+            out.length = 0;
+            text[0] = '\0';
+            s.machine = &machine;
+            s.out = &out;
+            WriteMachineIntro(nullFile, world, &s, false);
+        }
+        else
+        {
+            SayWelcome(world, &s, false);
+        }
+        bool running = true, won = false;
+        for (int line = 0; line < transcriptLines && running; line++)
+        {
+            strcpy(command, transcript[line]);
+            RunCommand(command, world, &s, &running, &won, NULL);
+            if (json)
+                WriteMachineRecord(nullFile, world, &s, running, won);
+        }
+        EndSession(&s, world);
+    }
+}
+
+static void BenchTranscriptText(long calls)
+{
+    PlayTranscript(calls, false);
+}
+
+static void BenchTranscriptJson(long calls)
+{
+    PlayTranscript(calls, true);
+}
+
+static const Bench benches[] = {
+    {"string_compare/names", BenchCompareNames},
+    {"string_compare/94_bytes", BenchCompareLong},
+    {"GetItem+ThrowItem", BenchTakeDrop},
+    {"MergeItems", BenchMerge},
+    {"DoUseItem/no_effect", BenchUseNothing},
+    {"look", BenchLook},
+    {"undo+redo", BenchUndoRedo},
+    {"WriteToLog", BenchLog},
+    {"CompleteLine", BenchComplete},
+    {"world/tables", BenchWorldTables},
+    {"world/page_file", BenchWorldPages},
+    {"ValidateWorld", BenchValidate},
+    {"game_create+destroy", BenchGameCreate},
+    {"game_step/look", BenchGameStep},
+    {"host/game_step/look", BenchHostStep},
+    {"host/reload", BenchHostReload},
+    {"shared/game_step/look", BenchSharedStep},
+    {"game_save+game_load", BenchSaveLoad},
+    {"transcript/text", BenchTranscriptText},
+    {"transcript/json", BenchTranscriptJson},
+};
+
+// ----- running and reporting -----
+
+// grow the number of calls until one round takes about roundMs, then keep the best of a few rounds
+static double TimeBench(const Bench *b, long roundMs, long *timedCalls)
+{
+    long calls = 1;
+    for (;;)
+    {
+        long long start = NowNs();
+        b->run(calls);
+        long long took = NowNs() - start;
+        if (took >= roundMs * 1000000LL / 10 || calls >= (1L << 40))
+        {
+            // scale up to a full round from here
+            calls = (long)((double)calls * roundMs * 1e6 / (took > 0 ? took : 1));
+            if (calls < 1)
+                calls = 1;
+            break;
+        }
+        calls *= 4;
+    }
+    double best = 0;
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        long long start = NowNs();
+        b->run(calls);
+        double ns = (double)(NowNs() - start) / calls;
+        if (r == 0 || ns < best)
+            best = ns;
+    }
+    *timedCalls = calls;
+    return best;
+}
+
+// read an earlier run, returns how many results it had (0 if the file isn't there)
+static int ReadResults(const char *path, OldResult *old, int max)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror("Can't read the results to compare with");
+        return 0;
+    }
+    char line[256];
+    int count = 0;
+    while (count < max && fgets(line, sizeof(line), file))
+    {
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%63[^\t]\t%lf", old[count].name, &old[count].ns) == 2)
+            count++;
+    }
+    fclose(file);
+    return count;
+}
+
+static void SetUp(void)
+{
+    world = OpenTableWorld(&builtinWorld);
+    if (!world || !StartSession(&session, world))
+    {
+        fprintf(stderr, "Can't start the world\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < world->itemCount && nameCount < 64; i++)
+        names[nameCount++] = Text(world, world->items[i].name);
+    for (int i = 0; i < nameCount; i++)
+    {
+        snprintf(typed[i], sizeof(typed[i]), "%s", names[i]);
+        LowercaseAscii(typed[i], typed[i], strlen(typed[i]));
+    }
+
+    // the page file and host benchmarks need a page file
+    strcpy(pagePath, "/tmp/temple_bench_XXXXXX");
+    int fd = mkstemp(pagePath);
+    if (fd < 0 || !SaveWorld(pagePath, world, false))
+    {
+        perror("Can't write a page file for the benchmarks");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    // the transcript benchmarks play the walkthrough (make bench runs in the game directory)
+    FILE *file = fopen("transcripts/walkthrough.txt", "r");
+    if (file)
+    {
+        char line[256];
+        while (transcriptLines < 128 && fgets(line, sizeof(line), file))
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (strlen(line) < sizeof(transcript[0]))
+                strcpy(transcript[transcriptLines++], line);
+        }
+        fclose(file);
+    }
+
+    nullFile = fopen("/dev/null", "w");
+    // results go to the real stdout, everything the game says goes nowhere
+    results = fdopen(dup(fileno(stdout)), "w");
+    if (!nullFile || !results || !freopen("/dev/null", "w", stdout))
+    {
+        perror("Can't set up the output");
+        exit(EXIT_FAILURE);
+    }
+    MakeBiggerInventory(&session, 9); // room for the key parts
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filter = NULL;
+    const char *comparePath = NULL;
+    double maxRegression = -1; // percent, -1 = don't fail
+    long roundMs = 50;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc)
+            comparePath = argv[++i];
+        else if (strcmp(argv[i], "--max-regression") == 0 && i + 1 < argc)
+            maxRegression = atof(argv[++i]);
+        else if (strcmp(argv[i], "--round-ms") == 0 && i + 1 < argc)
+        {
+            roundMs = atol(argv[++i]);
+            if (roundMs < 1)
+                roundMs = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--filter text] [--compare old.tsv [--max-regression percent]] [--round-ms ms]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    OldResult old[MAX_BENCHES];
+    int oldCount = comparePath ? ReadResults(comparePath, old, MAX_BENCHES) : 0;
+
+    SetUp();
+    fprintf(results, "# temple_bench, case folding: %s, best of %d rounds of ~%ld ms\n", CaseKernelName(), BENCH_ROUNDS,
+            roundMs);
+    fprintf(results, comparePath ? "# benchmark\tns_per_call\tcalls\told_ns_per_call\tchange_percent\n"
+                                 : "# benchmark\tns_per_call\tcalls\n");
+    int regressions = 0;
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+    {
+        const Bench *b = &benches[i];
+        if (filter && !strstr(b->name, filter))
+            continue;
+        if (transcriptLines == 0 && (b->run == BenchTranscriptText || b->run == BenchTranscriptJson))
+        {
+            fprintf(results, "# %s skipped, no transcripts/walkthrough.txt here\n", b->name);
+            continue;
+        }
+        long calls;
+        double ns = TimeBench(b, roundMs, &calls);
+        fprintf(results, "%s\t%.2f\t%ld", b->name, ns, calls);
+        for (int k = 0; k < oldCount; k++)
+        {
+            if (strcmp(old[k].name, b->name) != 0 || old[k].ns <= 0)
+                continue;
+            double change = (ns - old[k].ns) / old[k].ns * 100;
+            fprintf(results, "\t%.2f\t%+.1f", old[k].ns, change);
+            if (maxRegression >= 0 && change > maxRegression)
+                regressions++;
+        }
+        fprintf(results, "\n");
+        fflush(results);
+    }
+
+    EndSession(&session, world);
+    CloseWorld(world);
+    remove(pagePath);
+    fclose(nullFile);
+    if (regressions > 0)
+    {
+        fprintf(stderr, "%d benchmark%s got more than %.1f%% slower\n", regressions, regressions == 1 ? "" : "s",
+                maxRegression);
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -9,1390 +9,10321 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <time.h>
-// #include <windows.h>
-
-// string comparison that ignores case
-// cuz the normal one is annoying with uppercase/lowercase
-int string_compare(const char *a, const char *b)
-{
-    for (;; a++, b++)
-    {
-        int d = tolower((unsigned char)*a) - tolower((unsigned char)*b);
-        if (d != 0 || !*a)
-            return d;
-    }
-}
-
-typedef struct Room Room;
-
-// stuff we need for items
-typedef struct
+#include <stdarg.h>
+#include <limits.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#ifdef _WIN32
+#include <io.h>
+#define fsync _commit
+#define ftruncate _chsize
+#define isatty _isatty
+#define read _read
+struct iovec
 {
-    char name[50];
-    int quantity;
-    char description[200];
-    bool canCombine;
-    char combineWith[50];
-    char resultItem[50];
-} Item;
+    void *iov_base;
+    size_t iov_len;
+};
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#endif
+// #include <windows.h>
+#include "temple.h"
 
-// backpack stuff
-typedef struct
-{
-    Item *items;
-    int capacity;
-    int count;
-} Inventory;
+// ASCII case folding (same as tolower in the C locale, the game never changes locale)
+// these run on every name lookup, so on x86-64 they do 16 (SSE2) or 32 (AVX2) bytes at a time
+// the AVX2 ones are only used if the CPU has it, everything else gets the plain loops
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CASE_SIMD 1
+#include <immintrin.h>
+#endif
 
-// interactive objects
-typedef struct
+static inline unsigned char LowerAscii(unsigned char c)
 {
-    char name[50];
-    char description[200];
-    bool interacted;
-    char riddle[200];
-    char answer[50];
-} Interactable;
+    return (unsigned char)(c + ((unsigned char)(c - 'A') < 26 ? 32 : 0));
+}
 
-// room structure(connections to other rooms and what's in it)
-typedef struct Room
+static void LowercaseScalar(char *dst, const char *src, size_t n)
 {
-    char name[50];
-    char description[200];
-    Item *items[10];
-    int itemCount;
-
-    Interactable *interactables[10];
-    int interactableCount;
-    bool isLocked;
-    char keyName[50];
-
-    Room *north;
-    Room *south;
-    Room *east;
-    Room *west;
-} Room;
-
-// all the functions we'll need
-void StartInventory(Inventory *inv);
-void MakeBiggerInventory(Inventory *inv, int more_space);
-void GetItem(Inventory *inv, Room *currentRoom, const char *itemName);
-void ThrowItem(Inventory *inv, Room *currentRoom, const char *itemName);
-void LookAtItem(const Inventory *inv, const char *itemName);
-void ShowInventory(const Inventory *inv);
-Item *MakeItem(const char *name, int quantity, const char *description, bool canCombine, const char *combineWith, const char *resultItem);
-Interactable *MakeInteractable(const char *name, const char *description, const char *riddle, const char *answer);
-void DoCommand(char *command, Inventory *inv, Room **currentRoom, bool *gameRunning, bool *hasWon, FILE *logFile);
-void WriteToLog(FILE *logFile, const char *action, const char *result);
-bool MergeItems(Inventory *inv, const char *item1, const char *item2);
-void DoInteract(Room *currentRoom, Inventory *inv, const char *objectName);
-void DoUseItem(Room *currentRoom, Inventory *inv, const char *itemName, const char *targetName);
-bool GotItem(const Inventory *inv, const char *itemName);
-void DeleteItemFromBag(Inventory *inv, const char *itemName);
-void PutItemInRoom(Room *room, Item *item);
+    for (size_t i = 0; i < n; i++)
+        dst[i] = (char)LowerAscii((unsigned char)src[i]);
+}
 
-// set up the inventory with 1 space at first
-void StartInventory(Inventory *inv)
+// compare the first n bytes, first difference like strcmp would give it
+static int CompareScalar(const char *a, const char *b, size_t n)
 {
-    inv->capacity = 1;
-    inv->count = 0;
-    inv->items = (Item *)malloc(sizeof(Item) * inv->capacity);
-    if (inv->items == NULL)
+    for (size_t i = 0; i < n; i++)
     {
-        fprintf(stderr, "Oh oh! Memory screwed up, can't make inventory\n");
-        exit(EXIT_FAILURE);
+        int d = LowerAscii((unsigned char)a[i]) - LowerAscii((unsigned char)b[i]);
+        if (d != 0)
+            return d;
     }
+    return 0;
 }
 
-// make the inventory bigger
-void MakeBiggerInventory(Inventory *inv, int more_space)
+#ifdef CASE_SIMD
+static inline __m128i Lower16(__m128i v)
 {
-    int new_capacity = inv->capacity + more_space;
-    Item *new_items = realloc(inv->items, sizeof(Item) * new_capacity);
-    if (!new_items)
-    {
-        perror("Dang it! Can't make inventory bigger, memory fail");
-        return;
-    }
-    inv->items = new_items;
-    inv->capacity = new_capacity;
-    printf("Sweet! Your inventory now has %d slots.\n", inv->capacity);
+    // signed compares, so bytes >= 0x80 are never "uppercase"
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
 }
 
-// pick up stuff from the room
-void GetItem(Inventory *inv, Room *currentRoom, const char *itemName)
+static void LowercaseSse2(char *dst, const char *src, size_t n)
 {
-    // find the item in the room
-    int itemIndex = -1;
-    for (int i = 0; i < currentRoom->itemCount; i++)
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm_storeu_si128((__m128i *)(dst + i), Lower16(_mm_loadu_si128((const __m128i *)(src + i))));
+    LowercaseScalar(dst + i, src + i, n - i);
+}
+
+static int CompareSse2(const char *a, const char *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
     {
-        if (string_compare(currentRoom->items[i]->name, itemName) == 0)
+        __m128i x = Lower16(_mm_loadu_si128((const __m128i *)(a + i)));
+        __m128i y = Lower16(_mm_loadu_si128((const __m128i *)(b + i)));
+        unsigned int same = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (same != 0xFFFF)
         {
-            itemIndex = i;
-            break;
+            size_t k = i + (size_t)__builtin_ctz(~same);
+            return LowerAscii((unsigned char)a[k]) - LowerAscii((unsigned char)b[k]);
         }
     }
+    return CompareScalar(a + i, b + i, n - i);
+}
 
-    if (itemIndex == -1)
-    {
-        printf("There's no %s here that you can grab.\n", itemName);
-        return;
-    }
-
-    // Special case for Rusty Cog without rucksack
-    if (string_compare(itemName, "Rusty Cog") == 0 && inv->capacity == 1)
-    {
-        printf("\n");
-        printf("  ██████╗  █████╗ ███╗   ███╗███████╗     ██████╗ ██╗   ██╗███████╗██████╗ \n");
-        printf(" ██╔════╝ ██╔══██╗████╗ ████║██╔════╝    ██╔═══██╗██║   ██║██╔════╝██╔══██╗\n");
-        printf(" ██║  ███╗███████║██╔████╔██║█████╗      ██║   ██║██║   ██║█████╗  ██████╔╝\n");
-        printf(" ██║   ██║██╔══██║██║╚██╔╝██║██╔══╝      ██║   ██║╚██╗ ██╔╝██╔══╝  ██╔══██╗\n");
-        printf(" ╚██████╔╝██║  ██║██║ ╚═╝ ██║███████╗    ╚██████╔╝ ╚████╔╝ ███████╗██║  ██║\n");
-        printf("  ╚═════╝ ╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝     ╚═════╝   ╚═══╝  ╚══════╝╚═╝  ╚═╝\n");
-        printf("\n");
-        printf("You tried to pick up the rusty cog but dropped it on your foot! Ouch! You clumsy explorer!\n");
-        // Sleep(5000); // waiting for 5 seconds
-        exit(0);
-    }
-
-    // Special case for Rucksack: expand inventory firs and allow pickup even if full
-    if (string_compare(itemName, "Rucksack") == 0)
-    {
-        MakeBiggerInventory(inv, 9);
-    }
-    else if (inv->count >= inv->capacity)
-    {
-        printf("Your pockets are full! Can't take %s.\n", itemName);
-        return;
-    }
-
-    // Add item to inventory
-    strcpy(inv->items[inv->count].name, currentRoom->items[itemIndex]->name);
-    strcpy(inv->items[inv->count].description, currentRoom->items[itemIndex]->description);
-    inv->items[inv->count].quantity = currentRoom->items[itemIndex]->quantity;
-    inv->items[inv->count].canCombine = currentRoom->items[itemIndex]->canCombine;
-    strcpy(inv->items[inv->count].combineWith, currentRoom->items[itemIndex]->combineWith);
-    strcpy(inv->items[inv->count].resultItem, currentRoom->items[itemIndex]->resultItem);
-    inv->count++;
-
-    if (string_compare(itemName, "Rucksack") == 0)
-    {
-        printf("Awesome! You got a rucksack! Now you can carry more junk.\n");
-        printf("You've got %d slots in your bag now.\n", inv->capacity);
-    }
-    else
-    {
-        printf("Got the %s!\n", itemName);
-    }
+__attribute__((target("avx2"))) static inline __m256i Lower32(__m256i v)
+{
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+    return _mm256_add_epi8(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
 
-    // remove item from room
-    free(currentRoom->items[itemIndex]);
-    for (int i = itemIndex; i < currentRoom->itemCount - 1; i++)
+// the tails stay in here on purpose: jumping into the plain SSE2 code with the upper halves of the ymm registers
+// dirty costs way more than the whole compare (gcc leaves out the vzeroupper on tail calls)
+__attribute__((target("avx2"))) static void LowercaseAvx2(char *dst, const char *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+        _mm256_storeu_si256((__m256i *)(dst + i), Lower32(_mm256_loadu_si256((const __m256i *)(src + i))));
+    if (i + 16 <= n)
     {
-        currentRoom->items[i] = currentRoom->items[i + 1];
+        _mm_storeu_si128((__m128i *)(dst + i), Lower16(_mm_loadu_si128((const __m128i *)(src + i))));
+        i += 16;
     }
-    currentRoom->itemCount--;
+    _mm256_zeroupper();
+    LowercaseScalar(dst + i, src + i, n - i);
 }
 
-// drop something from inventory
-void ThrowItem(Inventory *inv, Room *currentRoom, const char *itemName)
+__attribute__((target("avx2"))) static int CompareAvx2(const char *a, const char *b, size_t n)
 {
-    int itemIndex = -1;
-    for (int i = 0; i < inv->count; i++)
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
     {
-        if (string_compare(inv->items[i].name, itemName) == 0)
+        __m256i x = Lower32(_mm256_loadu_si256((const __m256i *)(a + i)));
+        __m256i y = Lower32(_mm256_loadu_si256((const __m256i *)(b + i)));
+        unsigned int same = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (same != 0xFFFFFFFFu)
         {
-            itemIndex = i;
-            break;
+            size_t k = i + (size_t)__builtin_ctz(~same);
+            return LowerAscii((unsigned char)a[k]) - LowerAscii((unsigned char)b[k]);
         }
     }
-    if (itemIndex == -1)
-    {
-        printf("You don't have a %s to drop.\n", itemName);
-        return;
-    }
-    // Don't allow dropping the rucksack
-    if (string_compare(itemName, "Rucksack") == 0)
+    if (i + 16 <= n)
     {
-        printf("No way! The rucksack is too useful to just toss away!\n");
-        printf("Seems like someone might be sabotaging himself...\n");
-        return;
-    }
-    // Add item to room
-    if (currentRoom->itemCount < 10)
-    {
-        Item *droppedItem = MakeItem(
-            inv->items[itemIndex].name,
-            inv->items[itemIndex].quantity,
-            inv->items[itemIndex].description,
-            inv->items[itemIndex].canCombine,
-            inv->items[itemIndex].combineWith,
-            inv->items[itemIndex].resultItem);
-        currentRoom->items[currentRoom->itemCount] = droppedItem;
-        currentRoom->itemCount++;
-        // Remove from inventory
-        for (int i = itemIndex; i < inv->count - 1; i++)
+        __m128i x = Lower16(_mm_loadu_si128((const __m128i *)(a + i)));
+        __m128i y = Lower16(_mm_loadu_si128((const __m128i *)(b + i)));
+        unsigned int same = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (same != 0xFFFF)
         {
-            inv->items[i] = inv->items[i + 1];
+            size_t k = i + (size_t)__builtin_ctz(~same);
+            return LowerAscii((unsigned char)a[k]) - LowerAscii((unsigned char)b[k]);
         }
-        inv->count--;
-        printf("Dropped the %s on the floor.\n", itemName);
-    }
-    else
-    {
-        printf("Dang it! This room is too messy already, can't drop anything else here.\n");
+        i += 16;
     }
+    _mm256_zeroupper();
+    return CompareScalar(a + i, b + i, n - i);
 }
+#endif
 
-// look at an item closer
-void LookAtItem(const Inventory *inv, const char *itemName)
+// the kernels we ended up with, picked once (games on other threads fold case too, see CaseKernels)
+static void (*lowercaseKernel)(char *dst, const char *src, size_t n);
+static int (*compareKernel)(const char *a, const char *b, size_t n);
+static atomic_int caseKernelsState; // 0 = not picked, 1 = somebody's picking, 2 = picked
+
+static void PickCaseKernels(void)
 {
-    for (int i = 0; i < inv->count; i++)
+    lowercaseKernel = LowercaseScalar;
+    compareKernel = CompareScalar;
+#ifdef CASE_SIMD
+    lowercaseKernel = LowercaseSse2; // every x86-64 has SSE2
+    compareKernel = CompareSse2;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
     {
-        if (string_compare(inv->items[i].name, itemName) == 0)
-        {
-            printf("%s: %s\n", inv->items[i].name, inv->items[i].description);
-            return;
-        }
+        lowercaseKernel = LowercaseAvx2;
+        compareKernel = CompareAvx2;
     }
-    printf("You don't have a %s to look at.\n", itemName);
+#endif
 }
 
-// show what's in your inventory
-void ShowInventory(const Inventory *inv)
+// pick the kernels the first time, whoever comes later waits until they're there
+static void CaseKernels(void)
 {
-    if (inv->count == 0)
-    {
-        printf("You're not carrying anything.\n");
+    if (atomic_load_explicit(&caseKernelsState, memory_order_acquire) == 2)
         return;
-    }
-    printf("Your stuff (%d/%d slots):\n", inv->count, inv->capacity);
-    for (int i = 0; i < inv->count; i++)
+    int notPicked = 0;
+    if (atomic_compare_exchange_strong_explicit(&caseKernelsState, &notPicked, 1, memory_order_acquire,
+                                                memory_order_relaxed))
     {
-        printf("- %s (%d)\n", inv->items[i].name, inv->items[i].quantity);
+        PickCaseKernels();
+        atomic_store_explicit(&caseKernelsState, 2, memory_order_release);
+        return;
     }
+    while (atomic_load_explicit(&caseKernelsState, memory_order_acquire) != 2)
+        ;
 }
 
-// create a new item
-Item *MakeItem(const char *name, int quantity, const char *description, bool canCombine, const char *combineWith, const char *resultItem)
+// which kernels are in use, for benchmarks
+const char *CaseKernelName(void)
 {
-    Item *newItem = (Item *)malloc(sizeof(Item));
-    if (!newItem)
-    {
-        perror("Memory fail - couldn't make new item");
-        return NULL;
-    }
-    strcpy(newItem->name, name);
-    newItem->quantity = quantity;
-    strcpy(newItem->description, description);
-    newItem->canCombine = canCombine;
-    strcpy(newItem->combineWith, combineWith);
-    strcpy(newItem->resultItem, resultItem);
-    return newItem;
+    CaseKernels();
+#ifdef CASE_SIMD
+    if (lowercaseKernel == LowercaseAvx2)
+        return "avx2";
+    if (lowercaseKernel == LowercaseSse2)
+        return "sse2";
+#endif
+    return "scalar";
 }
 
-// make something you can interact with
-Interactable *MakeInteractable(const char *name, const char *description, const char *riddle, const char *answer)
+// lowercase n bytes of src into dst (can be the same buffer)
+void LowercaseAscii(char *dst, const char *src, size_t n)
 {
-    Interactable *newInteractable = (Interactable *)malloc(sizeof(Interactable));
-    if (!newInteractable)
-    {
-        perror("Memory screwed up - can't make interactable");
-        return NULL;
-    }
-    strcpy(newInteractable->name, name);
-    strcpy(newInteractable->description, description);
-    strcpy(newInteractable->riddle, riddle);
-    strcpy(newInteractable->answer, answer);
-    newInteractable->interacted = false;
-    return newInteractable;
+    CaseKernels();
+    lowercaseKernel(dst, src, n);
 }
 
-// check if you have an item
-bool GotItem(const Inventory *inv, const char *itemName)
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+// the rest of a compare after 16 equal bytes, rare enough to stay out of line wherever string_compare gets inlined
+static NOINLINE int CompareRest(const char *a, const char *b)
 {
-    for (int i = 0; i < inv->count; i++)
-    {
-        if (string_compare(inv->items[i].name, itemName) == 0)
-        {
-            return true;
-        }
-    }
-    return false;
+    CaseKernels();
+    size_t la = strlen(a);
+    size_t lb = strlen(b);
+    // the shorter one's '\0' is part of the comparison, that's what makes "Crate" < "Crates"
+    return compareKernel(a, b, (la < lb ? la : lb) + 1);
 }
 
-// remove an item from inventory
-void DeleteItemFromBag(Inventory *inv, const char *itemName)
+// string comparison that ignores case
+// cuz the normal one is annoying with uppercase/lowercase
+int string_compare(const char *a, const char *b)
 {
-    int itemIndex = -1;
-    for (int i = 0; i < inv->count; i++)
-    {
-        if (string_compare(inv->items[i].name, itemName) == 0)
-        {
-            itemIndex = i;
-            break;
-        }
-    }
-    if (itemIndex == -1)
-    {
-        return;
-    }
-    for (int i = itemIndex; i < inv->count - 1; i++)
+    // names are short and mostly differ in the first letter or two, the plain loop wins there
+    // only a common prefix longer than 16 bytes is worth measuring and handing to the kernel
+    for (int i = 0; i < 16; i++)
     {
-        inv->items[i] = inv->items[i + 1];
+        int d = LowerAscii((unsigned char)a[i]) - LowerAscii((unsigned char)b[i]);
+        if (d != 0 || !a[i])
+            return d;
     }
-    inv->count--;
+    return CompareRest(a + 16, b + 16);
 }
 
-// add an item to a room
-void PutItemInRoom(Room *room, Item *item)
+// does text start with prefix (ignoring case)?
+bool StartsWithNoCase(const char *text, const char *prefix)
 {
-    if (room->itemCount < 10)
-    {
-        room->items[room->itemCount] = item;
-        room->itemCount++;
-    }
+    CaseKernels();
+    size_t n = strlen(prefix);
+    return strnlen(text, n) == n && compareKernel(text, prefix, n) == 0;
 }
 
-// combine two items in inventory
-bool MergeItems(Inventory *inv, const char *item1, const char *item2)
+typedef struct Room Room;
+
+// all the text of a world (names, descriptions, riddles) sits once in the world's string pool,
+// structs only keep where it starts. 0 is always the empty string.
+// with COLD_TEXT set it's in a compressed block instead (see Text())
+typedef unsigned int TextRef;
+
+// stuff we need for items
+// the world keeps exactly one of these per item and every player shares it
+typedef struct
 {
-    int index1 = -1, index2 = -1;
-    for (int i = 0; i < inv->count; i++)
-    {
-        if (string_compare(inv->items[i].name, item1) == 0)
-        {
-            index1 = i;
-        }
-        if (string_compare(inv->items[i].name, item2) == 0)
-        {
-            index2 = i;
-        }
-    }
-    if (index1 == -1 || index2 == -1)
-    {
-        printf("You don't have both those things to combine.\n");
-        return false;
-    }
-    // check if items can be combined
-    if (inv->items[index1].canCombine &&
-        (string_compare(inv->items[index1].combineWith, inv->items[index2].name) == 0))
-    {
-        strcpy(inv->items[inv->count].name, inv->items[index1].resultItem);
-        if (strcmp(inv->items[index1].resultItem, "Clean Cog") == 0)
-            strcpy(inv->items[inv->count].description, "A shiny, rust-free cog that looks like it'll work in machinery now.");
-        else if (strcmp(inv->items[index1].resultItem, "Combined Key Parts") == 0)
-            strcpy(inv->items[inv->count].description, "Two key parts stuck together. Hmm, looks like there might be a third piece?");
-        else if (strcmp(inv->items[index1].resultItem, "Golden Key") == 0)
-            strcpy(inv->items[inv->count].description, "A super fancy golden key. Bet this opens something important!");
-        else
-            strcpy(inv->items[inv->count].description, "Combined item");
-        inv->items[inv->count].quantity = 1;
-        inv->items[inv->count].canCombine = false;
-        inv->count++;
-        DeleteItemFromBag(inv, item1);
-        DeleteItemFromBag(inv, item2);
-        printf("Sweet! Combined %s and %s to make a %s!\n", item1, item2, inv->items[inv->count - 1].name);
-        return true;
-    }
-    else if (inv->items[index2].canCombine &&
-             (string_compare(inv->items[index2].combineWith, inv->items[index1].name) == 0))
-    {
-        strcpy(inv->items[inv->count].name, inv->items[index2].resultItem);
-        strcpy(inv->items[inv->count].description, "Combined item");
-        inv->items[inv->count].quantity = 1;
-        inv->items[inv->count].canCombine = false;
-        inv->count++;
-        DeleteItemFromBag(inv, item1);
-        DeleteItemFromBag(inv, item2);
-        printf("Nice! Combined %s and %s to make a %s!\n", item1, item2, inv->items[inv->count - 1].name);
-        return true;
-    }
-    else
-    {
-        printf("Nope, those things don't work together.\n");
-        return false;
-    }
-}
+    TextRef name;
+    TextRef description;
+    int quantity;
+    bool canCombine;
+    int combineWith; // item id it combines with
+    int resultItem;  // item id you get
+    int homeRoom; // room the item starts in, NO_ROOM if it only shows up later (rewards, combined stuff)
+    unsigned int nameHash; // NameHash(name), so lookups skip most strcmps
+} Item;
 
-void DoInteract(Room *currentRoom, Inventory *inv, const char *objectName)
+// backpack stuff (item ids, the items themselves live in the world)
+typedef struct
 {
-    for (int i = 0; i < currentRoom->interactableCount; i++)
-    {
-        if (string_compare(currentRoom->interactables[i]->name, objectName) == 0)
-        {
-            printf("You check out the %s.\n", objectName);
+    int *items;
+    int capacity;
+    int count;
+} Inventory;
 
-            // Jaguar logic
-            if (string_compare(objectName, "Jaguar") == 0 && !currentRoom->interactables[i]->interacted)
-            {
-                printf("The jaguar stares at you with ancient eyes and speaks:\n");
-                printf("\"%s\"\n", currentRoom->interactables[i]->riddle);
-
-                char answer[50];
-                printf("What's your answer? ");
-                scanf("%49s", answer);
-                int c;
-                while ((c = getchar()) != '\n' && c != EOF)
-                {
-                }
+// interactive objects, what they do comes from their components (see below)
+typedef struct
+{
+    TextRef name;
+    TextRef description;
+    unsigned int nameHash;
+} Interactable;
 
-                char correctAnswer[50];
-                strcpy(correctAnswer, currentRoom->interactables[i]->answer);
-                for (int j = 0; correctAnswer[j]; j++)
-                {
-                    correctAnswer[j] = tolower(correctAnswer[j]);
-                }
-                for (int j = 0; answer[j]; j++)
-                {
-                    answer[j] = tolower(answer[j]);
-                }
+// room structure(connections to other rooms and what's in it)
+// rooms are a read-only template shared by everyone, what a player changes goes into their WorldDelta
+typedef struct Room
+{
+    TextRef name;
+    TextRef description;
+    int items[10]; // item ids
+    int itemCount;
 
-                if (strcmp(answer, correctAnswer) == 0)
-                {
-                    printf("The jaguar nods. \"You have wisdom, traveler.\"\n");
-                    printf("The jaguar moves aside, and you see a gleaming key part in the chest!\n");
-                    for (int j = 0; j < currentRoom->interactableCount; j++)
-                    {
-                        if (strcmp(currentRoom->interactables[j]->name, "Chest") == 0)
-                        {
-                            strcpy(currentRoom->interactables[j]->description,
-                                   "A chest with the first part of a golden key inside.");
-                            break;
-                        }
-                    }
-                    currentRoom->interactables[i]->interacted = true;
-                }
-                else
-                {
-                    printf("The jaguar growls. \"Wrong! Try again or leave.\"\n");
-                }
-                return;
-            }
-            // CHEST LOGIC
-            else if (string_compare(objectName, "Chest") == 0) // პრობლემა იყო შედარებისას რადგან პატარა ასოს არ იღებდა. გამოვასწორე!
-            {
-                // Check if jaguar has been satisfied
-                bool jaguarSatisfied = false;
-                for (int j = 0; j < currentRoom->interactableCount; j++)
-                {
-                    if (strcmp(currentRoom->interactables[j]->name, "Jaguar") == 0)
-                    {
-                        jaguarSatisfied = currentRoom->interactables[j]->interacted;
-                        break;
-                    }
-                }
+    const Interactable *interactables; // this room's slice of the world's interactables
+    int interactableCount;
+    bool isLocked;
+    int keyItem; // item id that opens it, -1 if it isn't locked
 
-                // Use static flag for this function only
-                static bool keyPartTaken = false;
+    // exits are room ids (NO_ROOM if there's nothing that way)
+    // pointers don't work anymore since rooms can get kicked out of memory
+    int id;
+    int north;
+    int south;
+    int east;
+    int west;
+} Room;
 
-                if (jaguarSatisfied)
-                {
-                    if (!keyPartTaken)
-                    {
+// Components
+// What an interactable does isn't in the interactable and isn't in the code
+// either, it's in components: one dense array per kind for the whole world,
+// sorted by room and slot, and a thing only has the ones it needs. Every
+// component starts with the thing it belongs to (room id and slot), so
+// FindPart can binary search any of the arrays, and whatever has to go over
+// all of one kind (riddles that nag, containers a riddle guards) just walks
+// its array. A text that's 0 isn't there (the game says the usual line or
+// nothing). Doors belong to the room behind them and have slot -1.
 
-                        printf("You open the chest and find a piece of golden key!\n");
-
-                        // Check if there's space in inventory
-                        if (inv->count < inv->capacity)
-                        {
-                            // Add key part directly to inventory
-                            strcpy(inv->items[inv->count].name, "Key Part 1");
-                            strcpy(inv->items[inv->count].description, "First piece of a three-part golden key.");
-                            inv->items[inv->count].quantity = 1;
-                            inv->items[inv->count].canCombine = true;
-                            strcpy(inv->items[inv->count].combineWith, "Key Part 2");
-                            strcpy(inv->items[inv->count].resultItem, "Combined Key Parts");
-                            inv->count++;
-
-                            printf("You grab the key part!\n");
-
-                            strcpy(currentRoom->interactables[i]->description,
-                                   "An empty chest. Nothing left in here.");
-
-                            keyPartTaken = true;
-                        }
-                        else
-                        {
-                            printf("Your inventory is full! Can't take the key part.\n");
-                            // Create the key part and add it to the room instead
-                            Item *keyPart = MakeItem("Key Part 1", 1,
-                                                     "First piece of a three-part golden key.",
-                                                     true, "Key Part 2", "Combined Key Parts");
-                            PutItemInRoom(currentRoom, keyPart);
-                        }
-                    }
-                    else
-                    {
-                        printf("Chest is empty. You already took the key part.\n");
-                    }
-                }
-                else
-                {
-                    printf("The jaguar is guarding this chest. Deal with it first.\n");
-                }
-                return;
-            }
-            // TREE LOGIC
-            else if (string_compare(objectName, "Tree") == 0)
-            {
-                // Check if jaguar has been satisfied first
-                bool jaguarSatisfied = false;
-                for (int j = 0; j < currentRoom->interactableCount; j++)
-                {
-                    if (strcmp(currentRoom->interactables[j]->name, "Jaguar") == 0)
-                    {
-                        jaguarSatisfied = currentRoom->interactables[j]->interacted;
-                        break;
-                    }
-                }
+typedef struct
+{
+    int room;
+    int slot; // interactable in the room, -1 = the room itself
+} ThingId;
+
+// asks a riddle when you interact with it, until it gets the answer
+typedef struct
+{
+    ThingId of;
+    TextRef riddle;
+    TextRef answer;
+    TextRef ask;   // said instead of the description before the riddle
+    TextRef right; // 0 = "Something clicks inside ..."
+    TextRef wrong; // 0 = "Nothing happens ..."
+    TextRef nag;   // said every nagSeconds while you're in the room and it has no answer yet
+    int nagSeconds;
+} Riddle;
+
+// opens once and hands out what's in it, maybe only after the riddle of another thing is solved
+typedef struct
+{
+    ThingId of;
+    int guard;       // slot of the thing whose riddle has to be solved first, -1 = none
+    TextRef guarded; // said while it is
+    TextRef open;
+    TextRef empty;   // said every time after it's open
+    int dropItem;    // falls out into the room, -1 = none
+    int bagItem;     // goes into the bag (or into the room if the bag is full), -1 = none
+    TextRef grab;
+    TextRef full;
+} Container;
+
+// something happens when you use the right item on it
+typedef struct
+{
+    ThingId of;
+    int key;
+    int otherKey; // another item that works too, -1 = none
+    bool usesUp;  // the item is gone afterwards
+    TextRef use;
+    TextRef done; // said when it's used again, 0 = it works every time
+    int reveals;  // item that shows up in the room, -1 = none
+    int laterSeconds;
+    TextRef later; // said that long after it worked, if you're still in the room
+} Lockable;
+
+// pushing it around shows something the first time
+typedef struct
+{
+    ThingId of;
+    int reveals; // -1 = none
+    TextRef push;
+    TextRef again;
+} Pushable;
+
+// what a thing looks like after something happened to it, 0 = it keeps looking the same
+typedef struct
+{
+    ThingId of;
+    TextRef ready; // the riddle guarding it got its answer
+    TextRef used;  // it got opened, used or pushed
+    TextRef later; // its Lockable's later text came
+} Description;
+
+// the door of a locked room when it has a name ("use Golden Key golden door") and its own line
+typedef struct
+{
+    ThingId of; // slot -1
+    TextRef name;
+    TextRef opens;
+} Door;
+
+typedef struct
+{
+    const Riddle *riddles;
+    int riddleCount;
+    const Container *containers;
+    int containerCount;
+    const Lockable *lockables;
+    int lockableCount;
+    const Pushable *pushables;
+    int pushableCount;
+    const Description *descriptions;
+    int descriptionCount;
+    const Door *doors;
+    int doorCount;
+} Components;
+
+#define PART_KINDS 6
+
+#define NO_ROOM -1
+#define MIN_ROOM_CACHE 4
+#define DEFAULT_ROOM_CACHE 64
+#define MAX_WORLD_ROOMS (1 << 24)
+#define MAX_WORLD_ITEMS (1 << 24)
+#define WORLD_MAGIC 0x53525754 // "TWRS"
+#define WORLD_VERSION 5
+
+// cold text (descriptions, riddles) can be stored compressed in blocks of up to COLD_BLOCK_SIZE bytes
+// a cold TextRef is COLD_TEXT | block << COLD_BLOCK_BITS | offset in the block
+#define COLD_TEXT 0x80000000u
+#define COLD_BLOCK_BITS 12
+#define COLD_BLOCK_SIZE (1 << COLD_BLOCK_BITS)
+#define MAX_COLD_BLOCKS (1 << (31 - COLD_BLOCK_BITS))
+
+// a whole world as const tables (generated by worldc, see world_tables.h)
+typedef struct
+{
+    const char *text; // string pool, everything's TextRefs point in here
+    unsigned int textSize;
+    const Room *rooms; // indexed by room id
+    int roomCount;
+    int startRoom;
+    const Item *items; // indexed by item id
+    int itemCount;
+    Components parts;
+} WorldTables;
+
+// the built-in temple, compiled from temple.world
+#include "world_tables.h"
+
+// one slot of the room cache
+typedef struct
+{
+    Room *room; // NULL if the slot is free
+    int pins;   // pinned rooms (like the one the player stands in) never get evicted
+    int prev;   // LRU list, towards most recently used
+    int next;   // LRU list, towards least recently used
+} CacheSlot;
+
+typedef struct HintTable HintTable; // see Hints
+
+// a world is either the built-in const tables or a page file on disk where we only keep a few rooms around
+// file layout: header | string pool | cold text blocks | item catalog | components | offset table (one long long per room) | room records
+// the item catalog is the Item structs as they are in memory, so it can be used right out of the mapped file
+typedef struct
+{
+    const char *text; // string pool
+    unsigned int textSize;
+    const unsigned char *coldData; // compressed text blocks back to back (page files only)
+    unsigned int *coldOffsets;     // block i is coldData[coldOffsets[i]] up to coldOffsets[i + 1]
+    int coldBlockCount;
+    char **coldCache;              // blocks we had to show already, decompressed (NULL = not yet)
+
+    const Room *tableRooms; // set for table worlds, everything below about files and caches is unused then
+    int roomCount;
+    int startRoom;
+    const Item *items; // every item in the world, indexed by item id
+    int itemCount;
+    Components parts; // loaded whole like the items, they're small
+
+    FILE *file;
+    char path[256]; // of the page file, so the validator's threads can open their own
+    long tableOffset;
+    const char *mapped; // the page file mapped read-only, the text and the item catalog are read straight from it
+    size_t mappedSize;
+    void *loadedItems;    // our copy of the catalog when the file isn't mapped (items points here)
+    void *loadedText;     // our copy of the string pool when the file isn't mapped (Windows, whole worlds)
+    void *loadedColdData; // same for the cold blocks
+    Room *loadedRooms; // a page file loaded whole (LoadWholeWorld), tableRooms points here
+    Interactable *loadedInteractables;
+    void *loadedParts[PART_KINDS]; // our copy of the components for page files
+
+    CacheSlot *slots;
+    int capacity;
+    int *lookup; // open addressing hash: room id -> slot index (-1 = empty)
+    int lookupSize;
+    int lruHead; // most recently used
+    int lruTail; // least recently used, first to go
+    int used;
+
+    long loads;
+    long evictions;
+
+    HintTable *hints; // NULL = nobody made hints for this world
+} World;
+
+// where an item can be besides a room (room ids are >= 0)
+#define IN_INVENTORY -2
+#define USED_UP -3
+
+// kinds of changes a player can make to the world
+enum
+{
+    CHANGE_ITEM_MOVED,  // target = item id, value = room id, IN_INVENTORY or USED_UP
+    CHANGE_UNLOCKED,    // target = room id
+    CHANGE_INTERACTED,  // target = room id, slot = interactable, its riddle got the answer
+    CHANGE_DESCRIPTION, // target = room id, slot = interactable, value = LOOK_...
+    CHANGE_USED         // target = room id, slot = interactable, it got opened, used (the once only kind) or pushed
+};
+
+// kind in the top 4 bits, interactable slot in the next 4, room or item id in the rest
+#define CHANGE_KEY(kind, target, slot) (((unsigned int)(kind) << 28) | ((unsigned int)(slot) << 24) | (unsigned int)(target))
+#define CHANGE_KIND(key) ((int)((key) >> 28))
+#define CHANGE_TARGET(key) ((int)((key) & 0xFFFFFF))
+#define CHANGE_SLOT(key) ((int)(((key) >> 24) & 0xF))
+
+// one thing a player changed
+typedef struct
+{
+    unsigned int key;
+    int value;
+} Change;
+
+// texts of a thing that the state and the timers point at, the thing's components have them (see ThingText)
+// 0 is the thing's own description
+enum
+{
+    LOOK_READY = 1, // Description.ready
+    LOOK_USED,      // Description.used
+    LOOK_LATER,     // Description.later
+    SAY_LATER,      // Lockable.later
+    SAY_NAG,        // Riddle.nag
+    THING_TEXTS
+};
+
+// everything one player changed compared to the world template
+// lookups check here first and fall back to the template
+typedef struct
+{
+    Change *changes; // in the order they happened
+    int count;
+    int capacity;
+    unsigned long long hash; // Zobrist hash of the changes, kept up to date by every change
+} WorldDelta;
+
+// things that can happen on a timer
+enum
+{
+    EVENT_MESSAGE,      // say SAY_... (value) of thing (room, slot) to the player wherever they are
+    EVENT_ROOM_MESSAGE, // same, but only if the player is in room
+    EVENT_DESCRIPTION,  // interactable (room, slot) switches to LOOK_... (value)
+    EVENT_NAG           // the riddle of (room, slot) says its nag text while you're in the room, until it gets the answer
+};
+
+typedef struct
+{
+    int kind;   // EVENT_...
+    int room;   // room it's about, NO_ROOM if none
+    int slot;   // interactable in that room
+    int value;  // depends on kind
+    int period; // ticks until it goes off again, 0 = only once
+} TimerEvent;
+
+// a scheduled event, lives in its wheel slot's list until it goes off or gets cancelled
+typedef struct
+{
+    long long expires; // tick it goes off at
+    long long seq;     // order it was scheduled in, timers on the same tick go off in this order
+    TimerEvent event;
+    int prev; // list of the wheel slot (next is also the free list), -1 = end
+    int next;
+    int wheelSlot;           // level * WHEEL_SLOTS + slot, -1 if the timer is free
+    unsigned int generation; // bumped every time the timer is reused so old handles stop working
+} Timer;
+
+typedef struct
+{
+    int index;
+    unsigned int generation;
+} TimerHandle;
+
+// hierarchical timing wheel: level 0 has one slot per tick, every level above is 64 times coarser
+// timers sit in the level that fits how far away they are and move down as their time gets close
+#define TICK_MS 10
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+typedef struct
+{
+    long long now; // ticks since the session started
+    long long nextSeq;
+    int *wheel; // WHEEL_LEVELS * WHEEL_SLOTS list heads (-1 = empty), NULL until the first timer
+    Timer *timers;
+    int capacity;
+    int freeList;
+    int active;
+} Scheduler;
+
+// write-ahead journal of everything a player typed, so a crash doesn't throw their game away
+// records are text lines:
+//   L <line>   a line the player typed (commands and riddle answers)
+//   E          the game asked for a line and there wasn't one (end of input)
+//   T <tick>   the clock moved to <tick> (timers went off)
+//   K ...      checkpoint, the whole session state (see WriteCheckpoint)
+// a line is written before the game acts on it, and a checkpoint rewrites the file so replay stays short
+typedef struct
+{
+    char path[256];
+    FILE *file;
+    int syncEvery;       // group commit: fsync once this many records piled up (or before waiting on a terminal)
+    int pending;         // records written since the last fsync
+    int checkpointEvery; // commands between checkpoints
+    int sinceCheckpoint;
+    char *replayText; // lines left over from the last run, fed back in before we read stdin
+    char **replayLines;
+    int replayCount;
+    int replayNext;
+    bool recovered; // true if there was a game to pick up
+} Journal;
+
+// the output of a session, for spectators (see the Spectators section)
+#define BROADCAST_CHUNK 4096
+#define MAX_SPECTATOR_LAG (1 << 20) // bytes a spectator can fall behind before we drop them
+typedef struct BroadcastChunk
+{
+    struct BroadcastChunk *next; // NULL for the newest one
+    int refs;                    // spectators in it + whatever points at it
+    int used;
+    char data[BROADCAST_CHUNK];
+} BroadcastChunk;
+
+typedef struct
+{
+    int fd;                // socket it goes to, -1 = nobody (benchmarks)
+    BroadcastChunk *chunk; // how far it got
+    int offset;
+    long long position; // same thing counted in bytes since the broadcast started
+} Spectator;
+
+typedef struct
+{
+    BroadcastChunk *tail; // new output goes here
+    long long written;
+    Spectator *spectators;
+    int count;
+    int capacity;
+    int listenFd; // -1 if nobody can join
+    char path[108];
+    long dropped; // spectators we gave up on because they fell too far behind
+} Broadcast;
+
+#define COMPLETION_LINE 100 // same as the longest command
+#define MAX_SUGGESTIONS 32
+
+// radix trie for tab completion: every edge holds a whole run of letters, so "rusty cog" and
+// "rucksack" share one "ru" edge and the rest of each is one node
+typedef struct TrieNode
+{
+    struct TrieNode *child;   // first child, siblings are sorted by first letter
+    struct TrieNode *sibling;
+    int refs;   // how many times the word ending here was added (0 = just a fork)
+    int words;  // different words in this subtree
+    int length; // letters in label
+    char label[]; // lowercase, '\0' terminated
+} TrieNode;
+
+// the words tab completion and suggest know about
+typedef struct
+{
+    const World *world; // NULL if there's no completion (out of memory)
+    TrieNode *verbs;
+    TrieNode *names; // items and interactables in the room plus everything in the bag
+} Completer;
+
+// where a game's output goes when it isn't stdout (games made through temple.h)
+typedef struct
+{
+    char *text;    // NULL with size 0 = just count
+    size_t size;   // room in text, '\0' included
+    size_t length; // everything that got said, can be more than fit
+} Output;
+
+// undo history (see the Undo section): every change a command makes to the player
+// is written down as a small step that can be taken back and done again
+#define DEFAULT_UNDO_DEPTH 20
+#define UNDO_OPS_PER_STEP 4 // room in the ring per command of history, on average (a move is 1, taking something 2-3)
+enum
+{
+    UNDO_CHANGE_ADD,    // change (key, to) went in at index
+    UNDO_CHANGE_REMOVE, // change (key, from) at index went out
+    UNDO_CHANGE_SET,    // change at index went from -> to
+    UNDO_ROOM,          // the player walked from -> to
+    UNDO_BAG_ADD,       // item (key) went into the bag at index
+    UNDO_BAG_REMOVE,    // item (key) at index came out of the bag
+    UNDO_CAPACITY,      // the bag went from -> to slots
+    UNDO_TIMER          // a timer got scheduled
+};
+
+typedef struct
+{
+    int kind; // UNDO_...
+    union
+    {
+        struct
+        {
+            unsigned int key;
+            int index;
+            int from;
+            int to;
+        } change;
+        struct
+        {
+            TimerEvent event;
+            TimerHandle handle;
+            int delay; // ticks it had left when it got taken back, -1 = it had gone off already
+        } timer;
+    } u;
+} UndoOp;
+
+// one command's worth of ops
+typedef struct
+{
+    long long firstOp;
+    char command[32]; // what was typed, for "Took back ..."
+} UndoStep;
+
+// two rings, positions count up forever and wrap around with % (so a position never gets reused)
+// steps [firstStep, doneSteps) can be taken back, [doneSteps, lastStep) were taken back and can be done again
+typedef struct
+{
+    UndoOp *ops;     // size * UNDO_OPS_PER_STEP, NULL until the first command that changes something
+    UndoStep *steps; // size
+    int size;        // commands the rings have room for right now, they double up to depth when they fill up
+    int depth;       // commands that can be taken back, 0 = no undo
+    long long firstStep, doneSteps, lastStep;
+    long long firstOp, doneOps, lastOp;
+    char command[32]; // the command that's running, it becomes a step once it changes something
+    bool recording;   // a command is running (timers that go off between commands aren't anyone's step)
+    bool stepOpen;    // the running command has a step already
+    bool applying;    // undo or redo is at work, that doesn't get written down again
+} UndoHistory;
+
+// machine mode (--json): what one command did to the player, so its record can say it
+#define MAX_TRACKED_MOVES 16
+typedef struct
+{
+    long long seq;        // records written so far
+    int startRoom;        // where the player was when the command started
+    bool unknownCommand;  // the command wasn't one we know
+    const char *failure;  // NULL, or the status of a command that was understood but didn't happen (NoteFailure)
+    int moveCount;        // more than MAX_TRACKED_MOVES = lost track, the record lists everything instead
+    struct
+    {
+        int item;
+        int from; // where it was before this command touched it
+    } moves[MAX_TRACKED_MOVES];
+} MachineState;
+
+// a player in a world they share with others (game_join, see the Library section)
+typedef struct
+{
+    struct TempleShared *world;
+    int id;          // 1, 2, ... in the order they joined
+    char name[32];   // what the others hear about ("Ana picks up the Note.")
+    long long heard; // the notes of their room up to this one got said already
+} SharedSeat;
+
+// one player: where they are, what they carry and what they changed
+typedef struct
+{
+    int room;
+    Inventory inv;
+    WorldDelta delta;
+    Scheduler timers;
+    Journal *journal; // NULL if we're not journaling
+    bool quiet;       // while replaying the journal nobody needs to see the output again
+    bool atPrompt;    // sitting at "> " waiting for input, timers that talk need a fresh line
+    Broadcast *broadcast; // NULL if nobody's watching
+    Completer completer; // what's in reach, kept up to date as things move
+    int riddleSlot;      // interactable in this room whose riddle waits for an answer, -1 = none
+    Output *out;         // NULL = stdout
+    MachineState *machine; // NULL unless a program is playing (--json), also means no ASCII art
+    UndoHistory history;
+    const World *world;    // the one it plays in, timers look their texts up there
+    SharedSeat *seat;      // NULL = the world is theirs alone, otherwise the changes live in the shared rooms
+} Session;
+
+// one room of a shared world. turn is held while a player's command runs in the room, so two commands
+// in one room go one after the other and commands in different rooms never meet. lock guards the rest
+// and is only ever held for a moment, never while waiting for anything else: that's how a command
+// reaches into other rooms (the door it unlocks, a timer that goes off in a room the player left)
+#define ROOM_NOTES 16 // what happened lately, a player who falls further behind misses the oldest
+typedef struct
+{
+    long long seq;
+    int player;
+    char text[80];
+} RoomNote;
+
+typedef struct
+{
+#ifndef _WIN32
+    pthread_mutex_t turn;
+#else
+    atomic_flag turn;
+#endif
+    atomic_flag lock;
+    WorldDelta delta; // unlocked, solved, used and new looks of the room and its things (no item moves)
+    int *items;       // items that came here after the start, in the order they came
+    int itemCount;
+    int itemCapacity;
+    long long notes; // notes so far, the last ROOM_NOTES of them are in note
+    RoomNote *note;  // NULL until the first one
+    atomic_long waits; // commands that found the room busy
+} SharedRoom;
+
+struct TempleShared
+{
+    World *world;
+    SharedRoom *rooms;
+    atomic_int *itemAt;   // where every item is right now (what ItemLocation says)
+    unsigned char *moved; // items that left their home room once, behind the home room's lock
+    atomic_int players;   // joined so far
+};
+typedef struct TempleShared SharedWorld;
+
+// what the engine's memory gets used for (see the Memory section)
+enum
+{
+    MEM_WORLD,
+    MEM_ROOMS,
+    MEM_ITEMS,
+    MEM_INTERACTABLES,
+    MEM_TEXT,
+    MEM_INVENTORY,
+    MEM_CHANGES,
+    MEM_TIMERS,
+    MEM_JOURNAL,
+    MEM_SPECTATORS,
+    MEM_LOGGING,
+    MEM_COMPLETION,
+    MEM_UNDO,
+    MEM_TAGS
+};
+#define MemAlloc(tag, size) TrackedAlloc(tag, size, false, __FILE__, __LINE__)
+#define MemCalloc(tag, count, size) TrackedAlloc(tag, (size_t)(count) * (size), true, __FILE__, __LINE__)
+#define MemRealloc(tag, block, size) TrackedRealloc(tag, block, size, __FILE__, __LINE__)
+
+// all the functions we'll need
+void *TrackedAlloc(int tag, size_t size, bool zero, const char *file, int line);
+void *TrackedRealloc(int tag, void *block, size_t size, const char *file, int line);
+void MemFree(void *block);
+void MemDebug(bool on);
+long long SessionMemory(const Session *s);
+void ReportLeaks(void);
+void Say(const Session *s, const char *format, ...);
+bool ReadLine(Session *s, char *line, int size);
+bool Interactive(void);
+bool StartInventory(Inventory *inv);
+void MakeBiggerInventory(Session *s, int more_space);
+bool StartSession(Session *s, World *world);
+void EndSession(Session *s, World *world);
+void SetRoom(World *world, Session *s, int roomId);
+unsigned long long StateHash(const Session *s);
+unsigned long long ComputeStateHash(const Session *s);
+bool GetItem(World *world, Session *s, const char *itemName);
+void ThrowItem(World *world, Session *s, const char *itemName);
+void LookAtItem(const World *world, const Session *s, const char *itemName);
+void ShowInventory(const World *world, const Session *s);
+unsigned int NameHash(const char *name);
+const char *Text(const World *world, TextRef ref);
+void DoCommand(char *command, World *world, Session *s, bool *gameRunning, bool *hasWon, FILE *logFile);
+void WriteToLog(FILE *logFile, const char *action, const char *result);
+bool MergeItems(World *world, Session *s, const char *item1, const char *item2);
+void DoInteract(World *world, Session *s, const char *objectName);
+void AnswerRiddle(World *world, Session *s, const char *line);
+void DoUseItem(World *world, Session *s, const char *itemName, const char *targetName);
+bool GotItem(const World *world, const Inventory *inv, const char *itemName);
+void DeleteItemFromBag(const World *world, Session *s, const char *itemName);
+void PutItemInRoom(const World *world, Session *s, const Room *room, int itemId);
+int FindItemId(const World *world, const char *name);
+int ItemLocation(const World *world, const Session *s, int itemId);
+void MoveItem(Session *s, int itemId, int location);
+void RememberChange(Session *s, int kind, unsigned int key, int index, int from, int to);
+void RememberTimer(Session *s, TimerEvent event, TimerHandle handle);
+void StartUndoStep(Session *s, const char *command);
+void EndUndoStep(Session *s);
+void ForgetHistory(UndoHistory *h);
+bool Undo(World *world, Session *s);
+bool Redo(World *world, Session *s);
+void NoteMove(MachineState *m, int itemId, int from);
+void NoteFailure(const Session *s, bool blocked);
+int RoomItems(const World *world, const Session *s, const Room *room, int items[10]);
+bool RoomLocked(const Session *s, const Room *room);
+void UnlockRoom(Session *s, int roomId);
+bool HasInteracted(const Session *s, int roomId, int slot);
+void SetInteracted(Session *s, int roomId, int slot);
+bool HasUsed(const Session *s, int roomId, int slot);
+void SetUsed(Session *s, int roomId, int slot);
+const Riddle *RiddleOf(const World *world, int roomId, int slot);
+const Container *ContainerOf(const World *world, int roomId, int slot);
+const Lockable *LockableOf(const World *world, int roomId, int slot);
+const Pushable *PushableOf(const World *world, int roomId, int slot);
+const Description *DescriptionOf(const World *world, int roomId, int slot);
+const Door *DoorOf(const World *world, int roomId);
+TextRef ThingText(const World *world, int roomId, int slot, int which);
+const char *InteractableDescription(const World *world, const Session *s, const Room *room, int slot);
+void SetDescription(Session *s, int roomId, int slot, int textId);
+void FreeRoom(Room *room);
+bool SaveWorld(const char *path, World *world, bool compress);
+World *OpenWorld(const char *path, int cacheSize);
+World *OpenTableWorld(const WorldTables *tables);
+World *LoadWholeWorld(const char *path);
+const Room *GetRoom(World *world, int id);
+void PinRoom(World *world, int id);
+void UnpinRoom(World *world, int id);
+void CloseWorld(World *world);
+void PrintMemoryReport(World *world);
+int ValidateWorld(World *world, int threads, FILE *report);
+void FreeHints(HintTable *hints);
+bool SaveHints(const char *path, World *world);
+bool AttachHints(World *world, const char *path, bool quiet);
+void GiveHint(World *world, Session *s);
+void BenchCaseFolding(World *world);
+void GoThroughExit(World *world, Session *s, int exitId, const char *direction, char *result);
+TimerHandle ScheduleTimer(Session *s, long long delay, TimerEvent event);
+bool CancelTimer(Session *s, TimerHandle handle);
+long long NextTimerTick(const Scheduler *sched);
+int AdvanceTimers(Session *s, long long tick);
+int AdvanceClock(Session *s, long long tick);
+void FreeTimers(Scheduler *sched);
+void SayWinArt(const Session *s);
+void SayGameOverArt(const Session *s);
+void SayWelcome(World *world, const Session *s, bool recovered);
+void WriteMachineIntro(FILE *f, World *world, Session *s, bool recovered);
+void WriteMachineRecord(FILE *f, World *world, Session *s, bool running, bool won);
+void RunCommand(char *command, World *world, Session *s, bool *gameRunning, bool *hasWon, FILE *logFile);
+bool JournalReplaying(const Journal *journal);
+void ReplayClock(Session *s);
+void FinishReplay(Journal *journal);
+Journal *OpenJournal(const char *path, World *world, Session *s, int syncEvery, int checkpointEvery);
+void SyncJournal(Journal *journal);
+void WriteCheckpoint(Journal *journal, World *world, Session *s);
+void CloseJournal(Journal *journal, bool gameOver);
+void PrintMemStats(const Session *s);
+Broadcast *OpenBroadcast(void);
+void BroadcastWrite(Broadcast *b, const char *text, int length);
+bool AddSpectator(Broadcast *b, int fd);
+bool ListenForSpectators(Broadcast *b, const char *path);
+void PumpSpectators(Broadcast *b);
+void CloseBroadcast(Broadcast *b);
+void BenchSpectators(int spectators);
+void BenchMigrate(int games);
+void BenchShared(const char *worldPath, int players);
+void BenchFair(int people);
+void StartCompletion(World *world, Session *s);
+void FillScope(World *world, Session *s);
+void ScopeRoom(World *world, Session *s, int roomId, bool entering);
+void ScopeItemMoved(Session *s, int itemId, int from, int to);
+void EndCompletion(Completer *c);
+int CompleteLine(const Completer *c, const char *typed, char lines[][COMPLETION_LINE], int max, char *common);
+void ListSuggestions(const Session *s, const char *typed);
+bool EnableTabCompletion(const Completer *c);
+
+// ---------------------------------------------------------------------------
+// Memory
+// Everything the engine allocates goes through MemAlloc & co. with a tag for
+// the part of the game it belongs to, so `memstats` can show who is using
+// how much. Every block carries a small header with its size, tag and the
+// place it was allocated; with --mem-debug the blocks are also kept in a list
+// so anything still alive at shutdown gets reported as a leak.
+// ---------------------------------------------------------------------------
+
+static const char *const memTagNames[MEM_TAGS] = {
+    "world", "rooms", "items", "interactables", "text", "inventory",
+    "changes", "timers", "journal", "spectators", "logging", "completion", "undo",
+};
+
+typedef union MemHeader
+{
+    struct
+    {
+        size_t size;
+        const char *file; // where it was allocated
+        int line;
+        int tag;
+        union MemHeader *prev; // leak list, only with --mem-debug
+        union MemHeader *next;
+    } info;
+    max_align_t align; // keeps the block after the header aligned for anything
+} MemHeader;
+
+// games on other threads (shared worlds, the library) allocate at the same time, so the counters are atomic
+// (relaxed, they're only numbers) and the leak list has a lock
+typedef struct
+{
+    _Atomic long long live; // bytes allocated right now
+    _Atomic long long peak;
+    _Atomic long allocs;
+    _Atomic long frees;
+} MemCounter;
+
+static MemCounter memCounters[MEM_TAGS];
+static _Atomic long long memLive;
+static _Atomic long long memPeak;
+static bool memDebug;
+static MemHeader *memBlocks; // every live block, newest first (--mem-debug only)
+static atomic_flag memBlocksLock = ATOMIC_FLAG_INIT;
+
+// turn on leak tracking, has to happen before anything gets allocated
+void MemDebug(bool on)
+{
+    memDebug = on;
+}
+
+static void RaisePeak(_Atomic long long *peak, long long now)
+{
+    long long seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (now > seen && !atomic_compare_exchange_weak_explicit(peak, &seen, now, memory_order_relaxed,
+                                                                memory_order_relaxed))
+        ;
+}
+
+static void MemCount(int tag, long long bytes)
+{
+    MemCounter *c = &memCounters[tag];
+    RaisePeak(&c->peak, atomic_fetch_add_explicit(&c->live, bytes, memory_order_relaxed) + bytes);
+    RaisePeak(&memPeak, atomic_fetch_add_explicit(&memLive, bytes, memory_order_relaxed) + bytes);
+}
+
+// MemLink and MemUnlink only with the list locked, it's held for a few pointer writes (or one realloc)
+static void LockMemBlocks(void)
+{
+    while (atomic_flag_test_and_set_explicit(&memBlocksLock, memory_order_acquire))
+        ;
+}
+
+static void UnlockMemBlocks(void)
+{
+    atomic_flag_clear_explicit(&memBlocksLock, memory_order_release);
+}
+
+static void MemLink(MemHeader *h)
+{
+    h->info.prev = NULL;
+    h->info.next = memBlocks;
+    if (memBlocks)
+        memBlocks->info.prev = h;
+    memBlocks = h;
+}
+
+static void MemUnlink(MemHeader *h)
+{
+    if (h->info.prev)
+        h->info.prev->info.next = h->info.next;
+    else
+        memBlocks = h->info.next;
+    if (h->info.next)
+        h->info.next->info.prev = h->info.prev;
+}
+
+void *TrackedAlloc(int tag, size_t size, bool zero, const char *file, int line)
+{
+    MemHeader *h = zero ? calloc(1, sizeof(MemHeader) + size) : malloc(sizeof(MemHeader) + size);
+    if (!h)
+        return NULL;
+    h->info.size = size;
+    h->info.file = file;
+    h->info.line = line;
+    h->info.tag = tag;
+    if (memDebug)
+    {
+        LockMemBlocks();
+        MemLink(h);
+        UnlockMemBlocks();
+    }
+    MemCount(tag, (long long)size);
+    atomic_fetch_add_explicit(&memCounters[tag].allocs, 1, memory_order_relaxed);
+    return h + 1;
+}
+
+// like realloc, the block keeps its tag. NULL = nothing changed
+void *TrackedRealloc(int tag, void *block, size_t size, const char *file, int line)
+{
+    if (!block)
+        return TrackedAlloc(tag, size, false, file, line);
+    MemHeader *h = (MemHeader *)block - 1;
+    size_t old = h->info.size;
+    // the block is out of the list while realloc moves it, nobody else may walk the list then
+    if (memDebug)
+    {
+        LockMemBlocks();
+        MemUnlink(h);
+    }
+    MemHeader *moved = realloc(h, sizeof(MemHeader) + size);
+    if (memDebug)
+    {
+        MemLink(moved ? moved : h);
+        UnlockMemBlocks();
+    }
+    if (!moved)
+        return NULL;
+    moved->info.size = size;
+    MemCount(moved->info.tag, (long long)size - (long long)old);
+    return moved + 1;
+}
+
+void MemFree(void *block)
+{
+    if (!block)
+        return;
+    MemHeader *h = (MemHeader *)block - 1;
+    if (memDebug)
+    {
+        LockMemBlocks();
+        MemUnlink(h);
+        UnlockMemBlocks();
+    }
+    MemCount(h->info.tag, -(long long)h->info.size);
+    atomic_fetch_add_explicit(&memCounters[h->info.tag].frees, 1, memory_order_relaxed);
+    free(h);
+}
+
+// bytes one player's state takes (their bag, their changes, their timers)
+// counted off the session itself, the tag counters add up every game in the process
+long long SessionMemory(const Session *s)
+{
+    long long bytes = (long long)sizeof(int) * s->inv.capacity + (long long)sizeof(Change) * s->delta.capacity +
+                      (long long)sizeof(Timer) * s->timers.capacity;
+    if (s->history.ops)
+        bytes += ((long long)sizeof(UndoOp) * UNDO_OPS_PER_STEP + (long long)sizeof(UndoStep)) * s->history.size;
+    if (s->timers.wheel)
+        bytes += (long long)sizeof(int) * WHEEL_LEVELS * WHEEL_SLOTS;
+    return bytes;
+}
+
+// the memstats command
+void PrintMemStats(const Session *s)
+{
+    Say(s, "%-14s %10s %10s %8s %8s\n", "", "live", "peak", "allocs", "frees");
+    for (int i = 0; i < MEM_TAGS; i++)
+    {
+        MemCounter *c = &memCounters[i];
+        Say(s, "%-14s %10lld %10lld %8ld %8ld\n", memTagNames[i], atomic_load_explicit(&c->live, memory_order_relaxed),
+            atomic_load_explicit(&c->peak, memory_order_relaxed), atomic_load_explicit(&c->allocs, memory_order_relaxed),
+            atomic_load_explicit(&c->frees, memory_order_relaxed));
+    }
+    Say(s, "%-14s %10lld %10lld\n", "total", atomic_load_explicit(&memLive, memory_order_relaxed),
+        atomic_load_explicit(&memPeak, memory_order_relaxed));
+    Say(s, "This session: %lld bytes\n", SessionMemory(s));
+}
+
+// at shutdown with --mem-debug: everything that's still allocated is a leak
+void ReportLeaks(void)
+{
+    if (!memDebug)
+        return;
+    long count = 0;
+    long long bytes = 0;
+    LockMemBlocks();
+    for (MemHeader *h = memBlocks; h; h = h->info.next)
+    {
+        fprintf(stderr, "Leaked %zu bytes (%s) allocated at %s:%d\n", h->info.size, memTagNames[h->info.tag], h->info.file,
+                h->info.line);
+        count++;
+        bytes += (long long)h->info.size;
+    }
+    UnlockMemBlocks();
+    if (count == 0)
+        fprintf(stderr, "No leaks, peak was %lld bytes\n", atomic_load_explicit(&memPeak, memory_order_relaxed));
+    else
+        fprintf(stderr, "%ld leaks, %lld bytes\n", count, bytes);
+}
+
+// everything the game tells the player goes through here
+void Say(const Session *s, const char *format, ...)
+{
+    if (s->quiet)
+        return;
+    va_list args;
+    va_start(args, format);
+    if (s->out)
+    {
+        // like snprintf: count all of it, keep what fits
+        Output *out = s->out;
+        bool room = out->length + 1 < out->size;
+        int length = vsnprintf(room ? out->text + out->length : NULL, room ? out->size - out->length : 0, format, args);
+        va_end(args);
+        if (length > 0)
+            out->length += (size_t)length;
+        return;
+    }
+    if (!s->broadcast)
+    {
+        vprintf(format, args);
+        va_end(args);
+        return;
+    }
+
+    // spectators get the exact same bytes
+    char buffer[1024];
+    va_list again;
+    va_copy(again, args);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    char *text = buffer;
+    if (length >= (int)sizeof(buffer))
+    {
+        text = MemAlloc(MEM_LOGGING, length + 1);
+        if (text)
+            vsnprintf(text, length + 1, format, again);
+        else
+        {
+            text = buffer;
+            length = sizeof(buffer) - 1;
+        }
+    }
+    va_end(again);
+    va_end(args);
+    if (length > 0)
+    {
+        fwrite(text, 1, length, stdout);
+        BroadcastWrite(s->broadcast, text, length);
+    }
+    if (text != buffer)
+        MemFree(text);
+}
+
+// set up the inventory with 1 space at first
+bool StartInventory(Inventory *inv)
+{
+    inv->capacity = 1;
+    inv->count = 0;
+    inv->items = (int *)MemAlloc(MEM_INVENTORY, sizeof(int) * inv->capacity);
+    if (inv->items == NULL)
+    {
+        fprintf(stderr, "Oh oh! Memory screwed up, can't make inventory\n");
+        inv->capacity = 0;
+        return false;
+    }
+    return true;
+}
+
+// make the inventory bigger
+void MakeBiggerInventory(Session *s, int more_space)
+{
+    Inventory *inv = &s->inv;
+    int new_capacity = inv->capacity + more_space;
+    int *new_items = MemRealloc(MEM_INVENTORY, inv->items, sizeof(int) * new_capacity);
+    if (!new_items)
+    {
+        perror("Dang it! Can't make inventory bigger, memory fail");
+        return;
+    }
+    RememberChange(s, UNDO_CAPACITY, 0, 0, inv->capacity, new_capacity);
+    inv->items = new_items;
+    inv->capacity = new_capacity;
+    Say(s, "Sweet! Your inventory now has %d slots.\n", inv->capacity);
+}
+
+// ---------------------------------------------------------------------------
+// Per-player changes
+// The world template never changes while playing. Everything a player does
+// (taking stuff, unlocking doors, solving puzzles) is written down here as a
+// small change record, so a player costs a few bytes instead of a full copy
+// of every room.
+// ---------------------------------------------------------------------------
+
+// Every fact about a player (one change record, the room they're
+// in, how big their bag is) has its own random 64 bit Zobrist key and the
+// state hash is all of them xor'd together, so changing one fact costs one xor
+// out and one xor in. Keys come from mixing the fact itself instead of a
+// random table: they're the same in every build (so two builds can compare
+// hashes) and ids have no upper limit.
+enum
+{
+    ZOBRIST_CHANGE,
+    ZOBRIST_ROOM,
+    ZOBRIST_CAPACITY
+};
+
+// splitmix64 finalizer over (kind, a, b)
+static unsigned long long ZobristKey(int kind, unsigned int a, int b)
+{
+    unsigned long long x = ((unsigned long long)a << 32) | (unsigned int)b;
+    x += (unsigned long long)(kind + 1) * 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// look for a change in the delta, -1 if the player never touched that thing
+static int FindChange(const WorldDelta *delta, unsigned int key)
+{
+    for (int i = 0; i < delta->count; i++)
+    {
+        if (delta->changes[i].key == key)
+            return i;
+    }
+    return -1;
+}
+
+static void AppendChange(WorldDelta *delta, unsigned int key, int value)
+{
+    if (delta->count == delta->capacity)
+    {
+        int new_capacity = delta->capacity ? delta->capacity * 2 : 4;
+        Change *new_changes = MemRealloc(MEM_CHANGES, delta->changes, sizeof(Change) * new_capacity);
+        if (!new_changes)
+        {
+            perror("Memory fail - couldn't remember what you changed");
+            return;
+        }
+        delta->changes = new_changes;
+        delta->capacity = new_capacity;
+    }
+    delta->changes[delta->count].key = key;
+    delta->changes[delta->count].value = value;
+    delta->count++;
+    delta->hash ^= ZobristKey(ZOBRIST_CHANGE, key, value);
+}
+
+// put a change back where it was (undo), everything after it moves up one
+static void InsertChange(WorldDelta *delta, int index, unsigned int key, int value)
+{
+    AppendChange(delta, key, value);
+    if (delta->changes[delta->count - 1].key != key || index >= delta->count - 1)
+        return; // didn't fit, or it goes at the end anyway
+    memmove(&delta->changes[index + 1], &delta->changes[index], sizeof(Change) * (delta->count - 1 - index));
+    delta->changes[index].key = key;
+    delta->changes[index].value = value;
+}
+
+static void RemoveChange(WorldDelta *delta, int index)
+{
+    delta->hash ^= ZobristKey(ZOBRIST_CHANGE, delta->changes[index].key, delta->changes[index].value);
+    memmove(&delta->changes[index], &delta->changes[index + 1], sizeof(Change) * (delta->count - index - 1));
+    delta->count--;
+}
+
+static void SetChangeAt(WorldDelta *delta, int index, int value)
+{
+    unsigned int key = delta->changes[index].key;
+    delta->hash ^= ZobristKey(ZOBRIST_CHANGE, key, delta->changes[index].value) ^ ZobristKey(ZOBRIST_CHANGE, key, value);
+    delta->changes[index].value = value;
+}
+
+// ----- shared worlds -----
+// When players share a world (game_join) their changes aren't theirs, they belong to the rooms: every
+// room has its own delta, the items that came into it and notes about what happened in it, and where
+// an item is is one atomic int. The accessors below go there instead of the session's delta when the
+// session has a seat. The caller holds the turn of the player's room (see RunSharedCommand), so a
+// check and the change after it can't be split by someone else in that room.
+
+static void LockRoomState(SharedRoom *room)
+{
+    while (atomic_flag_test_and_set_explicit(&room->lock, memory_order_acquire))
+        ;
+}
+
+static void UnlockRoomState(SharedRoom *room)
+{
+    atomic_flag_clear_explicit(&room->lock, memory_order_release);
+}
+
+// tell the other players in a room what this one did (they hear it before their next line)
+static void NoteRoom(const Session *s, int roomId, const char *format, ...)
+{
+    char text[sizeof(((RoomNote *)0)->text)];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    SharedRoom *room = &s->seat->world->rooms[roomId];
+    LockRoomState(room);
+    if (!room->note)
+        room->note = MemCalloc(MEM_CHANGES, ROOM_NOTES, sizeof(RoomNote));
+    if (room->note)
+    {
+        RoomNote *note = &room->note[room->notes % ROOM_NOTES];
+        note->seq = ++room->notes;
+        note->player = s->seat->id;
+        memcpy(note->text, text, sizeof(text));
+    }
+    UnlockRoomState(room);
+}
+
+// the value of a change to a shared room, -1 if nobody made it
+static int SharedChange(const Session *s, unsigned int key)
+{
+    SharedRoom *room = &s->seat->world->rooms[CHANGE_TARGET(key)];
+    LockRoomState(room);
+    int i = FindChange(&room->delta, key);
+    int value = i != -1 ? room->delta.changes[i].value : -1;
+    UnlockRoomState(room);
+    return value;
+}
+
+// false if it was like that already (someone else got there first)
+static bool SetSharedChange(Session *s, unsigned int key, int value)
+{
+    SharedRoom *room = &s->seat->world->rooms[CHANGE_TARGET(key)];
+    LockRoomState(room);
+    int i = FindChange(&room->delta, key);
+    bool changed = i == -1 || room->delta.changes[i].value != value;
+    if (i == -1)
+        AppendChange(&room->delta, key, value);
+    else if (changed)
+        SetChangeAt(&room->delta, i, value);
+    UnlockRoomState(room);
+    if (!changed)
+        return false;
+    // what the others in the player's room get to hear about it
+    World *world = s->seat->world->world;
+    const Room *target = GetRoom(world, CHANGE_TARGET(key));
+    int slot = CHANGE_SLOT(key);
+    const char *who = s->seat->name;
+    const char *thing = slot < target->interactableCount ? Text(world, target->interactables[slot].name) : "";
+    switch (CHANGE_KIND(key))
+    {
+    case CHANGE_UNLOCKED:
+        NoteRoom(s, s->room, "%s opens the door to %s.", who, Text(world, target->name));
+        break;
+    case CHANGE_INTERACTED:
+        NoteRoom(s, s->room, "%s solves the riddle of the %s.", who, thing);
+        break;
+    case CHANGE_USED:
+        if (PushableOf(world, target->id, slot))
+            NoteRoom(s, s->room, "%s pushes the %s.", who, thing);
+        else if (ContainerOf(world, target->id, slot))
+            NoteRoom(s, s->room, "%s opens the %s.", who, thing);
+        else
+            NoteRoom(s, s->room, "%s uses something on the %s.", who, thing);
+        break;
+    }
+    return true;
+}
+
+// an item goes somewhere else in a shared world, the rooms it leaves and comes to hear about it
+static void MoveSharedItem(Session *s, int itemId, int from, int location)
+{
+    SharedWorld *shared = s->seat->world;
+    const char *who = s->seat->name;
+    const char *name = Text(shared->world, shared->world->items[itemId].name);
+    if (from >= 0)
+    {
+        SharedRoom *room = &shared->rooms[from];
+        LockRoomState(room);
+        int i = 0;
+        while (i < room->itemCount && room->items[i] != itemId)
+            i++;
+        if (i < room->itemCount)
+        {
+            memmove(&room->items[i], &room->items[i + 1], sizeof(int) * (room->itemCount - i - 1));
+            room->itemCount--;
+        }
+        if (from == shared->world->items[itemId].homeRoom)
+            shared->moved[itemId] = 1;
+        UnlockRoomState(room);
+        if (location == IN_INVENTORY)
+            NoteRoom(s, from, "%s picks up the %s.", who, name);
+    }
+    atomic_store(&shared->itemAt[itemId], location);
+    if (location >= 0)
+    {
+        SharedRoom *room = &shared->rooms[location];
+        LockRoomState(room);
+        if (room->itemCount == room->itemCapacity)
+        {
+            int newCapacity = room->itemCapacity ? room->itemCapacity * 2 : 4;
+            int *grown = MemRealloc(MEM_CHANGES, room->items, sizeof(int) * newCapacity);
+            if (grown)
+            {
+                room->items = grown;
+                room->itemCapacity = newCapacity;
+            }
+        }
+        if (room->itemCount < room->itemCapacity)
+            room->items[room->itemCount++] = itemId;
+        else
+            perror("Memory fail - the item fell through the floor");
+        UnlockRoomState(room);
+        NoteRoom(s, location, from == IN_INVENTORY ? "%s drops the %s." : "%s finds the %s.", who, name);
+    }
+}
+
+// a player walked from one room to another (from is NO_ROOM when they just joined)
+static void MoveSharedPlayer(Session *s, int from, int to)
+{
+    if (from >= 0)
+        NoteRoom(s, from, "%s leaves.", s->seat->name);
+    NoteRoom(s, to, from >= 0 ? "%s comes in." : "%s shows up.", s->seat->name);
+    // what happened in there before doesn't matter anymore
+    SharedRoom *room = &s->seat->world->rooms[to];
+    LockRoomState(room);
+    s->seat->heard = room->notes;
+    UnlockRoomState(room);
+}
+
+// overwrite a change if it's already there, otherwise add it
+static void SetChange(Session *s, unsigned int key, int value)
+{
+    if (s->seat)
+    {
+        SetSharedChange(s, key, value);
+        return;
+    }
+    WorldDelta *delta = &s->delta;
+    int i = FindChange(delta, key);
+    if (i != -1)
+    {
+        if (delta->changes[i].value == value)
+            return;
+        RememberChange(s, UNDO_CHANGE_SET, key, i, delta->changes[i].value, value);
+        SetChangeAt(delta, i, value);
+    }
+    else
+    {
+        RememberChange(s, UNDO_CHANGE_ADD, key, delta->count, 0, value);
+        AppendChange(delta, key, value);
+    }
+}
+
+// where is an item right now? (room id, IN_INVENTORY, USED_UP or NO_ROOM)
+int ItemLocation(const World *world, const Session *s, int itemId)
+{
+    if (s->seat)
+        return atomic_load(&s->seat->world->itemAt[itemId]);
+    int i = FindChange(&s->delta, CHANGE_KEY(CHANGE_ITEM_MOVED, itemId, 0));
+    if (i != -1)
+        return s->delta.changes[i].value;
+    return world->items[itemId].homeRoom;
+}
+
+// moved items go to the end of the list so rooms show them in the order they got dropped
+void MoveItem(Session *s, int itemId, int location)
+{
+    int from = ItemLocation(s->world, s, itemId);
+    if (s->seat)
+    {
+        MoveSharedItem(s, itemId, from, location);
+    }
+    else
+    {
+        unsigned int key = CHANGE_KEY(CHANGE_ITEM_MOVED, itemId, 0);
+        int i = FindChange(&s->delta, key);
+        if (i != -1)
+        {
+            RememberChange(s, UNDO_CHANGE_REMOVE, key, i, s->delta.changes[i].value, 0);
+            RemoveChange(&s->delta, i);
+        }
+        RememberChange(s, UNDO_CHANGE_ADD, key, s->delta.count, 0, location);
+        AppendChange(&s->delta, key, location);
+    }
+    ScopeItemMoved(s, itemId, from, location);
+    if (s->machine)
+        NoteMove(s->machine, itemId, from);
+}
+
+// what's lying around in a room for this player, returns how many
+int RoomItems(const World *world, const Session *s, const Room *room, int items[10])
+{
+    int count = 0;
+    if (s->seat)
+    {
+        SharedWorld *shared = s->seat->world;
+        SharedRoom *here = &shared->rooms[room->id];
+        LockRoomState(here);
+        for (int i = 0; i < room->itemCount; i++)
+        {
+            if (!shared->moved[room->items[i]])
+                items[count++] = room->items[i];
+        }
+        for (int i = 0; i < here->itemCount && count < 10; i++)
+            items[count++] = here->items[i];
+        UnlockRoomState(here);
+        return count;
+    }
+    (void)world;
+    // stuff that started here and nobody touched
+    for (int i = 0; i < room->itemCount; i++)
+    {
+        if (FindChange(&s->delta, CHANGE_KEY(CHANGE_ITEM_MOVED, room->items[i], 0)) == -1)
+            items[count++] = room->items[i];
+    }
+    // plus stuff that got dropped or showed up here
+    for (int i = 0; i < s->delta.count && count < 10; i++)
+    {
+        const Change *c = &s->delta.changes[i];
+        if (CHANGE_KIND(c->key) == CHANGE_ITEM_MOVED && c->value == room->id)
+            items[count++] = CHANGE_TARGET(c->key);
+    }
+    return count;
+}
+
+bool RoomLocked(const Session *s, const Room *room)
+{
+    if (!room->isLocked)
+        return false;
+    unsigned int key = CHANGE_KEY(CHANGE_UNLOCKED, room->id, 0);
+    return s->seat ? SharedChange(s, key) == -1 : FindChange(&s->delta, key) == -1;
+}
+
+void UnlockRoom(Session *s, int roomId)
+{
+    SetChange(s, CHANGE_KEY(CHANGE_UNLOCKED, roomId, 0), 1);
+}
+
+// first part in a component array that isn't before (room, slot), parts are sorted by room then slot
+static int PartBound(const void *parts, int count, size_t size, int roomId, int slot)
+{
+    int low = 0;
+    int high = count;
+    while (low < high)
+    {
+        int middle = low + (high - low) / 2;
+        const ThingId *of = (const ThingId *)((const char *)parts + (size_t)middle * size);
+        if (of->room < roomId || (of->room == roomId && of->slot < slot))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+// the part of thing (room, slot) in a component array, NULL if it doesn't have one
+static const void *FindPart(const void *parts, int count, size_t size, int roomId, int slot)
+{
+    int i = PartBound(parts, count, size, roomId, slot);
+    if (i == count)
+        return NULL;
+    const ThingId *of = (const ThingId *)((const char *)parts + (size_t)i * size);
+    return of->room == roomId && of->slot == slot ? of : NULL;
+}
+
+const Riddle *RiddleOf(const World *world, int roomId, int slot)
+{
+    return FindPart(world->parts.riddles, world->parts.riddleCount, sizeof(Riddle), roomId, slot);
+}
+
+const Container *ContainerOf(const World *world, int roomId, int slot)
+{
+    return FindPart(world->parts.containers, world->parts.containerCount, sizeof(Container), roomId, slot);
+}
+
+const Lockable *LockableOf(const World *world, int roomId, int slot)
+{
+    return FindPart(world->parts.lockables, world->parts.lockableCount, sizeof(Lockable), roomId, slot);
+}
+
+const Pushable *PushableOf(const World *world, int roomId, int slot)
+{
+    return FindPart(world->parts.pushables, world->parts.pushableCount, sizeof(Pushable), roomId, slot);
+}
+
+const Description *DescriptionOf(const World *world, int roomId, int slot)
+{
+    return FindPart(world->parts.descriptions, world->parts.descriptionCount, sizeof(Description), roomId, slot);
+}
+
+const Door *DoorOf(const World *world, int roomId)
+{
+    return FindPart(world->parts.doors, world->parts.doorCount, sizeof(Door), roomId, -1);
+}
+
+// LOOK_... or SAY_... of a thing, 0 if it doesn't have that text
+TextRef ThingText(const World *world, int roomId, int slot, int which)
+{
+    if (which == SAY_LATER)
+    {
+        const Lockable *lock = LockableOf(world, roomId, slot);
+        return lock ? lock->later : 0;
+    }
+    if (which == SAY_NAG)
+    {
+        const Riddle *riddle = RiddleOf(world, roomId, slot);
+        return riddle ? riddle->nag : 0;
+    }
+    const Description *looks = DescriptionOf(world, roomId, slot);
+    if (!looks)
+        return 0;
+    return which == LOOK_READY ? looks->ready : which == LOOK_USED ? looks->used : which == LOOK_LATER ? looks->later : 0;
+}
+
+bool HasInteracted(const Session *s, int roomId, int slot)
+{
+    unsigned int key = CHANGE_KEY(CHANGE_INTERACTED, roomId, slot);
+    return s->seat ? SharedChange(s, key) != -1 : FindChange(&s->delta, key) != -1;
+}
+
+void SetInteracted(Session *s, int roomId, int slot)
+{
+    SetChange(s, CHANGE_KEY(CHANGE_INTERACTED, roomId, slot), 1);
+}
+
+bool HasUsed(const Session *s, int roomId, int slot)
+{
+    unsigned int key = CHANGE_KEY(CHANGE_USED, roomId, slot);
+    return s->seat ? SharedChange(s, key) != -1 : FindChange(&s->delta, key) != -1;
+}
+
+void SetUsed(Session *s, int roomId, int slot)
+{
+    SetChange(s, CHANGE_KEY(CHANGE_USED, roomId, slot), 1);
+}
+
+const char *InteractableDescription(const World *world, const Session *s, const Room *room, int slot)
+{
+    unsigned int key = CHANGE_KEY(CHANGE_DESCRIPTION, room->id, slot);
+    int i = s->seat ? -1 : FindChange(&s->delta, key);
+    int value = s->seat ? SharedChange(s, key) : i != -1 ? s->delta.changes[i].value : -1;
+    TextRef look = value != -1 ? ThingText(world, room->id, slot, value) : 0;
+    return Text(world, look ? look : room->interactables[slot].description);
+}
+
+void SetDescription(Session *s, int roomId, int slot, int textId)
+{
+    SetChange(s, CHANGE_KEY(CHANGE_DESCRIPTION, roomId, slot), textId);
+}
+
+// walk into another room, the one we're standing in stays pinned in the cache
+void SetRoom(World *world, Session *s, int roomId)
+{
+    RememberChange(s, UNDO_ROOM, 0, 0, s->room, roomId);
+    ScopeRoom(world, s, s->room, false);
+    UnpinRoom(world, s->room);
+    PinRoom(world, roomId);
+    int from = s->room;
+    s->room = roomId;
+    if (s->seat)
+        MoveSharedPlayer(s, from, roomId);
+    ScopeRoom(world, s, roomId, true);
+}
+
+// the whole player state as one 64 bit number, same state = same hash (in any build)
+// good enough as a key for dedup in caches and searches too. O(1), the delta keeps its part up to date
+unsigned long long StateHash(const Session *s)
+{
+    return s->delta.hash ^ ZobristKey(ZOBRIST_ROOM, (unsigned int)s->room, 0) ^
+           ZobristKey(ZOBRIST_CAPACITY, (unsigned int)s->inv.capacity, 0);
+}
+
+// the delta's part of the hash from scratch
+static unsigned long long DeltaHash(const WorldDelta *delta)
+{
+    unsigned long long hash = 0;
+    for (int i = 0; i < delta->count; i++)
+        hash ^= ZobristKey(ZOBRIST_CHANGE, delta->changes[i].key, delta->changes[i].value);
+    return hash;
+}
+
+// StateHash the slow way, to check nothing changed the state behind the hash's back
+unsigned long long ComputeStateHash(const Session *s)
+{
+    return DeltaHash(&s->delta) ^ ZobristKey(ZOBRIST_ROOM, (unsigned int)s->room, 0) ^
+           ZobristKey(ZOBRIST_CAPACITY, (unsigned int)s->inv.capacity, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Text
+// Names and descriptions live once in the world's string pool and structs
+// only keep offsets. Page files can store the cold text (descriptions and
+// riddles, most of which nobody ever reads) compressed in small blocks; a
+// block gets unpacked the first time something in it has to be shown.
+// ---------------------------------------------------------------------------
+
+// tiny LZ77: a byte < 0x80 means that many + 1 plain bytes follow,
+// otherwise copy (byte & 0x7F) + LZ_MIN_MATCH bytes from 1..LZ_WINDOW bytes back (2 byte distance follows)
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (0x7F + LZ_MIN_MATCH)
+#define LZ_MAX_LITERALS 0x80
+#define LZ_WINDOW COLD_BLOCK_SIZE
+
+// returns how many bytes came out, -1 if the data is broken
+static int Decompress(const unsigned char *in, int inSize, char *out, int outSize)
+{
+    int i = 0;
+    int o = 0;
+    while (i < inSize)
+    {
+        int c = in[i++];
+        if (c < 0x80)
+        {
+            int n = c + 1;
+            if (i + n > inSize || o + n > outSize)
+                return -1;
+            memcpy(out + o, in + i, n);
+            i += n;
+            o += n;
+        }
+        else
+        {
+            int n = (c & 0x7F) + LZ_MIN_MATCH;
+            if (i + 2 > inSize)
+                return -1;
+            int back = in[i] | (in[i + 1] << 8);
+            i += 2;
+            if (back < 1 || back > o || o + n > outSize)
+                return -1;
+            // byte by byte on purpose, a match can overlap what it's writing
+            for (int k = 0; k < n; k++, o++)
+                out[o] = out[o - back];
+        }
+    }
+    return o;
+}
+
+static unsigned int HashThree(const char *p)
+{
+    return (((unsigned char)p[0] << 8) ^ ((unsigned char)p[1] << 4) ^ (unsigned char)p[2]) & 0xFFF;
+}
+
+static void FlushLiterals(const char *in, int from, int to, unsigned char *out, int *o)
+{
+    while (from < to)
+    {
+        int n = to - from < LZ_MAX_LITERALS ? to - from : LZ_MAX_LITERALS;
+        out[(*o)++] = (unsigned char)(n - 1);
+        memcpy(out + *o, in + from, n);
+        *o += n;
+        from += n;
+    }
+}
+
+// greedy, one candidate per hash. out needs space for inSize + inSize / LZ_MAX_LITERALS + 1 bytes
+static int Compress(const char *in, int inSize, unsigned char *out)
+{
+    int last[4096]; // where we last saw each 3 byte hash
+    for (int i = 0; i < 4096; i++)
+        last[i] = -1;
+    int i = 0;
+    int o = 0;
+    int literalStart = 0;
+    while (i < inSize)
+    {
+        int length = 0;
+        int back = 0;
+        if (i + LZ_MIN_MATCH <= inSize)
+        {
+            unsigned int h = HashThree(in + i);
+            int candidate = last[h];
+            last[h] = i;
+            if (candidate >= 0 && i - candidate <= LZ_WINDOW)
+            {
+                while (length < LZ_MAX_MATCH && i + length < inSize && in[candidate + length] == in[i + length])
+                    length++;
+                back = i - candidate;
+            }
+        }
+        if (length < LZ_MIN_MATCH)
+        {
+            i++;
+            continue;
+        }
+        FlushLiterals(in, literalStart, i, out, &o);
+        out[o++] = (unsigned char)(0x80 | (length - LZ_MIN_MATCH));
+        out[o++] = (unsigned char)(back & 0xFF);
+        out[o++] = (unsigned char)(back >> 8);
+        for (int k = 1; k < length && i + k + LZ_MIN_MATCH <= inSize; k++)
+            last[HashThree(in + i + k)] = i + k;
+        i += length;
+        literalStart = i;
+    }
+    FlushLiterals(in, literalStart, inSize, out, &o);
+    return o;
+}
+
+// the actual text behind a TextRef
+const char *Text(const World *world, TextRef ref)
+{
+    if (!(ref & COLD_TEXT))
+        return ref < world->textSize ? world->text + ref : "";
+    int block = (int)((ref & ~COLD_TEXT) >> COLD_BLOCK_BITS);
+    if (block >= world->coldBlockCount)
+        return "";
+    if (!world->coldCache[block])
+    {
+        // first time anyone looks at this block. the rest stays zero so any offset still ends in a '\0'
+        char *raw = MemCalloc(MEM_TEXT, 1, COLD_BLOCK_SIZE + 1);
+        if (!raw)
+        {
+            perror("Memory fail - can't unpack text");
+            return "";
+        }
+        unsigned int start = world->coldOffsets[block];
+        if (Decompress(world->coldData + start, (int)(world->coldOffsets[block + 1] - start), raw, COLD_BLOCK_SIZE) < 0)
+        {
+            fprintf(stderr, "Text block %d of the world is broken\n", block);
+            MemFree(raw);
+            return "";
+        }
+        world->coldCache[block] = raw;
+    }
+    return world->coldCache[block] + (ref & (COLD_BLOCK_SIZE - 1));
+}
+
+// ---------------------------------------------------------------------------
+// Timers
+// Stuff that happens on its own after a while (a guardian staring at you,
+// machines winding down). Each session has a hierarchical timing wheel:
+// scheduling and cancelling are O(1), and nothing runs while nothing is due,
+// the main loop sleeps until NextTimerTick(). The clock is in ticks of
+// TICK_MS and only moves when AdvanceClock() says so, which is either the
+// real time or a virtual clock that moves a fixed step per command.
+// ---------------------------------------------------------------------------
+
+static void UnlinkTimer(Scheduler *sched, int index)
+{
+    Timer *t = &sched->timers[index];
+    if (t->prev != -1)
+        sched->timers[t->prev].next = t->next;
+    else
+        sched->wheel[t->wheelSlot] = t->next;
+    if (t->next != -1)
+        sched->timers[t->next].prev = t->prev;
+    t->wheelSlot = -1;
+}
+
+// put a timer in the slot for how far away it is
+static void InsertTimer(Scheduler *sched, int index)
+{
+    Timer *t = &sched->timers[index];
+    long long delta = t->expires - sched->now;
+    int level = 0;
+    long long slot;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1LL << (WHEEL_BITS * (level + 1))))
+        level++;
+    if (delta >= (1LL << (WHEEL_BITS * WHEEL_LEVELS)))
+        slot = (sched->now >> (WHEEL_BITS * level)) + WHEEL_SLOTS - 1; // too far out, park it in the last slot, it gets sorted again on the way down
+    else
+        slot = t->expires >> (WHEEL_BITS * level);
+    t->wheelSlot = level * WHEEL_SLOTS + (int)(slot & (WHEEL_SLOTS - 1));
+    t->prev = -1;
+    t->next = sched->wheel[t->wheelSlot];
+    if (t->next != -1)
+        sched->timers[t->next].prev = index;
+    sched->wheel[t->wheelSlot] = index;
+}
+
+static TimerHandle AddTimer(Session *s, long long expires, long long seq, TimerEvent event)
+{
+    Scheduler *sched = &s->timers;
+    TimerHandle handle = {-1, 0};
+    if (!sched->wheel)
+    {
+        sched->wheel = MemAlloc(MEM_TIMERS, sizeof(int) * WHEEL_LEVELS * WHEEL_SLOTS);
+        if (!sched->wheel)
+        {
+            perror("Memory fail - no timers");
+            return handle;
+        }
+        for (int i = 0; i < WHEEL_LEVELS * WHEEL_SLOTS; i++)
+            sched->wheel[i] = -1;
+    }
+    if (sched->freeList == -1)
+    {
+        int new_capacity = sched->capacity ? sched->capacity * 2 : 8;
+        Timer *new_timers = MemRealloc(MEM_TIMERS, sched->timers, sizeof(Timer) * new_capacity);
+        if (!new_timers)
+        {
+            perror("Memory fail - no timers");
+            return handle;
+        }
+        for (int i = sched->capacity; i < new_capacity; i++)
+        {
+            new_timers[i].next = i + 1 < new_capacity ? i + 1 : -1;
+            new_timers[i].wheelSlot = -1;
+            new_timers[i].generation = 0;
+        }
+        sched->freeList = sched->capacity;
+        sched->timers = new_timers;
+        sched->capacity = new_capacity;
+    }
+    int index = sched->freeList;
+    Timer *t = &sched->timers[index];
+    sched->freeList = t->next;
+    t->expires = expires > sched->now ? expires : sched->now + 1;
+    t->seq = seq;
+    t->event = event;
+    t->generation++;
+    InsertTimer(sched, index);
+    sched->active++;
+    handle.index = index;
+    handle.generation = t->generation;
+    return handle;
+}
+
+static void ReleaseTimer(Scheduler *sched, int index)
+{
+    sched->timers[index].next = sched->freeList;
+    sched->freeList = index;
+    sched->active--;
+}
+
+// something happens in `delay` ticks
+TimerHandle ScheduleTimer(Session *s, long long delay, TimerEvent event)
+{
+    TimerHandle handle = AddTimer(s, s->timers.now + delay, s->timers.nextSeq++, event);
+    RememberTimer(s, event, handle);
+    return handle;
+}
+
+// false if the timer already went off (or was cancelled before)
+bool CancelTimer(Session *s, TimerHandle handle)
+{
+    Scheduler *sched = &s->timers;
+    if (handle.index < 0 || handle.index >= sched->capacity)
+        return false;
+    Timer *t = &sched->timers[handle.index];
+    if (t->generation != handle.generation || t->wheelSlot == -1)
+        return false;
+    UnlinkTimer(sched, handle.index);
+    ReleaseTimer(sched, handle.index);
+    return true;
+}
+
+// first tick after now where the wheel has something to do (fire or move timers down), LLONG_MAX if never
+long long NextTimerTick(const Scheduler *sched)
+{
+    if (sched->active == 0)
+        return LLONG_MAX;
+    long long next = LLONG_MAX;
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+    {
+        int shift = WHEEL_BITS * level;
+        for (long long slot = (sched->now >> shift) + 1; slot <= (sched->now >> shift) + WHEEL_SLOTS; slot++)
+        {
+            if (sched->wheel[level * WHEEL_SLOTS + (slot & (WHEEL_SLOTS - 1))] != -1)
+            {
+                if ((slot << shift) < next)
+                    next = slot << shift;
+                break;
+            }
+        }
+    }
+    return next;
+}
+
+static int CompareTimers(const void *a, const void *b)
+{
+    const Timer *x = a;
+    const Timer *y = b;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+// what a timer does when it goes off, false if it shouldn't come back (for repeating ones)
+static bool FireTimer(Session *s, const TimerEvent *e)
+{
+    switch (e->kind)
+    {
+    case EVENT_ROOM_MESSAGE:
+        if (s->room != e->room)
+            return true;
+        // fall through
+    case EVENT_MESSAGE:
+        if (s->atPrompt)
+        {
+            Say(s, "\n");
+            s->atPrompt = false;
+        }
+        Say(s, "%s\n", Text(s->world, ThingText(s->world, e->room, e->slot, e->value)));
+        return true;
+    case EVENT_DESCRIPTION:
+        SetDescription(s, e->room, e->slot, e->value);
+        return true;
+    case EVENT_NAG:
+        if (HasInteracted(s, e->room, e->slot))
+            return false; // riddle solved, it leaves you alone now
+        if (s->room == e->room)
+        {
+            TimerEvent message = {EVENT_MESSAGE, e->room, e->slot, SAY_NAG, 0};
+            FireTimer(s, &message);
+        }
+        return true;
+    }
+    return false;
+}
+
+// move timers of a higher level slot down now that their time is close
+static void CascadeTimers(Scheduler *sched, int level)
+{
+    int wheelSlot = level * WHEEL_SLOTS + (int)((sched->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+    int index = sched->wheel[wheelSlot];
+    sched->wheel[wheelSlot] = -1;
+    while (index != -1)
+    {
+        int next = sched->timers[index].next;
+        InsertTimer(sched, index);
+        index = next;
+    }
+}
+
+// run the wheel up to `tick`, returns how many timers went off
+int AdvanceTimers(Session *s, long long tick)
+{
+    Scheduler *sched = &s->timers;
+    int fired = 0;
+    while (sched->now < tick)
+    {
+        long long next = NextTimerTick(sched);
+        if (next > tick)
+        {
+            sched->now = tick;
+            break;
+        }
+        sched->now = next;
+        for (int level = 1; level < WHEEL_LEVELS; level++)
+        {
+            if (sched->now & ((1LL << (WHEEL_BITS * level)) - 1))
+                break;
+            CascadeTimers(sched, level);
+        }
+
+        // take everything due out of the wheel first, so events can schedule new timers
+        int wheelSlot = (int)(sched->now & (WHEEL_SLOTS - 1));
+        int count = 0;
+        for (int i = sched->wheel[wheelSlot]; i != -1; i = sched->timers[i].next)
+            count++;
+        if (count == 0)
+            continue;
+        Timer *due = MemAlloc(MEM_TIMERS, sizeof(Timer) * count);
+        if (!due)
+        {
+            perror("Memory fail - timers lost");
+            return fired;
+        }
+        count = 0;
+        for (int i = sched->wheel[wheelSlot]; i != -1;)
+        {
+            int next = sched->timers[i].next;
+            due[count++] = sched->timers[i];
+            sched->timers[i].wheelSlot = -1;
+            ReleaseTimer(sched, i);
+            i = next;
+        }
+        sched->wheel[wheelSlot] = -1;
+        qsort(due, count, sizeof(Timer), CompareTimers);
+        for (int i = 0; i < count; i++)
+        {
+            if (FireTimer(s, &due[i].event) && due[i].event.period > 0)
+                AddTimer(s, due[i].expires + due[i].event.period, due[i].seq, due[i].event);
+            fired++;
+        }
+        MemFree(due);
+    }
+    return fired;
+}
+
+void FreeTimers(Scheduler *sched)
+{
+    MemFree(sched->wheel);
+    MemFree(sched->timers);
+    sched->wheel = NULL;
+    sched->timers = NULL;
+    sched->capacity = 0;
+    sched->freeList = -1;
+    sched->active = 0;
+}
+
+// timed stuff the world has from the start: riddles that nag
+static void StartWorldEvents(World *world, Session *s)
+{
+    for (int i = 0; i < world->parts.riddleCount; i++)
+    {
+        const Riddle *riddle = &world->parts.riddles[i];
+        if (!riddle->nag || riddle->nagSeconds <= 0)
+            continue;
+        TimerEvent watch = {EVENT_NAG, riddle->of.room, riddle->of.slot, 0, riddle->nagSeconds * (1000 / TICK_MS)};
+        ScheduleTimer(s, watch.period, watch);
+    }
+}
+
+// new player at the start of the world, the room they're in stays pinned in the cache
+bool StartSession(Session *s, World *world)
+{
+    if (!GetRoom(world, world->startRoom))
+        return false;
+    if (!StartInventory(&s->inv))
+        return false;
+    s->room = world->startRoom;
+    PinRoom(world, s->room);
+    s->delta.changes = NULL;
+    s->delta.count = 0;
+    s->delta.capacity = 0;
+    s->delta.hash = 0;
+    s->journal = NULL;
+    s->quiet = false;
+    s->atPrompt = false;
+    s->broadcast = NULL;
+    s->riddleSlot = -1;
+    s->out = NULL;
+    s->machine = NULL;
+    s->world = world;
+    s->seat = NULL;
+    memset(&s->history, 0, sizeof(s->history));
+    s->history.depth = DEFAULT_UNDO_DEPTH;
+    memset(&s->timers, 0, sizeof(s->timers));
+    s->timers.freeList = -1;
+    StartWorldEvents(world, s);
+    StartCompletion(world, s);
+    return true;
+}
+
+void EndSession(Session *s, World *world)
+{
+    UnpinRoom(world, s->room);
+    MemFree(s->inv.items);
+    MemFree(s->delta.changes);
+    s->inv.items = NULL;
+    s->delta.changes = NULL;
+    FreeTimers(&s->timers);
+    EndCompletion(&s->completer);
+    MemFree(s->history.ops);
+    MemFree(s->history.steps);
+    s->history.ops = NULL;
+    s->history.steps = NULL;
+    s->history.size = 0;
+}
+
+// FNV-1a over the lowercase name, worldc puts the same hash in the tables
+// (has to stay the same as NameHash in worldc.c)
+unsigned int NameHash(const char *name)
+{
+    unsigned int h = 2166136261u;
+    for (; *name; name++)
+    {
+        h ^= LowerAscii((unsigned char)*name);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// find an item in the world catalog by name, -1 if there's no such thing
+int FindItemId(const World *world, const char *name)
+{
+    unsigned int hash = NameHash(name);
+    for (int i = 0; i < world->itemCount; i++)
+    {
+        if (world->items[i].nameHash == hash && string_compare(Text(world, world->items[i].name), name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// find an interactable in a room by name, -1 if it isn't there
+static int FindInteractable(const World *world, const Room *room, const char *name)
+{
+    unsigned int hash = NameHash(name);
+    for (int i = 0; i < room->interactableCount; i++)
+    {
+        if (room->interactables[i].nameHash == hash && string_compare(Text(world, room->interactables[i].name), name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// where an item sits in the bag, -1 if we don't have it
+static int FindInBag(const World *world, const Inventory *inv, const char *itemName)
+{
+    for (int i = 0; i < inv->count; i++)
+    {
+        if (string_compare(Text(world, world->items[inv->items[i]].name), itemName) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void RemoveFromBag(Session *s, int index)
+{
+    Inventory *inv = &s->inv;
+    RememberChange(s, UNDO_BAG_REMOVE, (unsigned int)inv->items[index], index, 0, 0);
+    for (int i = index; i < inv->count - 1; i++)
+    {
+        inv->items[i] = inv->items[i + 1];
+    }
+    inv->count--;
+}
+
+// put an item in the bag (caller checks there's space)
+static void AddToBag(Session *s, int itemId)
+{
+    if (itemId < 0)
+        return;
+    RememberChange(s, UNDO_BAG_ADD, (unsigned int)itemId, s->inv.count, 0, 0);
+    s->inv.items[s->inv.count++] = itemId;
+    MoveItem(s, itemId, IN_INVENTORY);
+}
+
+// pick up stuff from the room, returns false if that was the end of the game
+bool GetItem(World *world, Session *s, const char *itemName)
+{
+    const Room *currentRoom = GetRoom(world, s->room);
+    Inventory *inv = &s->inv;
+
+    // find the item in the room
+    int roomItems[10];
+    int roomItemCount = RoomItems(world, s, currentRoom, roomItems);
+    int itemId = -1;
+    for (int i = 0; i < roomItemCount; i++)
+    {
+        if (string_compare(Text(world, world->items[roomItems[i]].name), itemName) == 0)
+        {
+            itemId = roomItems[i];
+            break;
+        }
+    }
+
+    if (itemId == -1)
+    {
+        NoteFailure(s, false);
+        Say(s, "There's no %s here that you can grab.\n", itemName);
+        return true;
+    }
+
+    // Special case for Rusty Cog without rucksack
+    if (string_compare(itemName, "Rusty Cog") == 0 && inv->capacity == 1)
+    {
+        SayGameOverArt(s);
+        Say(s, "You tried to pick up the rusty cog but dropped it on your foot! Ouch! You clumsy explorer!\n");
+        // Sleep(5000); // waiting for 5 seconds
+        return false;
+    }
+
+    // Special case for Rucksack: expand inventory firs and allow pickup even if full
+    if (string_compare(itemName, "Rucksack") == 0)
+    {
+        MakeBiggerInventory(s, 9);
+    }
+    else if (inv->count >= inv->capacity)
+    {
+        NoteFailure(s, true);
+        Say(s, "Your pockets are full! Can't take %s.\n", itemName);
+        return true;
+    }
+
+    // Add item to inventory (this takes it out of the room too)
+    AddToBag(s, itemId);
+
+    if (string_compare(itemName, "Rucksack") == 0)
+    {
+        Say(s, "Awesome! You got a rucksack! Now you can carry more junk.\n");
+        Say(s, "You've got %d slots in your bag now.\n", inv->capacity);
+    }
+    else
+    {
+        Say(s, "Got the %s!\n", itemName);
+    }
+    return true;
+}
+
+// drop something from inventory
+void ThrowItem(World *world, Session *s, const char *itemName)
+{
+    Inventory *inv = &s->inv;
+    int itemIndex = FindInBag(world, inv, itemName);
+    if (itemIndex == -1)
+    {
+        NoteFailure(s, false);
+        Say(s, "You don't have a %s to drop.\n", itemName);
+        return;
+    }
+    // Don't allow dropping the rucksack
+    if (string_compare(itemName, "Rucksack") == 0)
+    {
+        NoteFailure(s, true);
+        Say(s, "No way! The rucksack is too useful to just toss away!\n");
+        Say(s, "Seems like someone might be sabotaging himself...\n");
+        return;
+    }
+    // Add item to room
+    const Room *currentRoom = GetRoom(world, s->room);
+    int roomItems[10];
+    if (RoomItems(world, s, currentRoom, roomItems) < 10)
+    {
+        MoveItem(s, inv->items[itemIndex], currentRoom->id);
+        // Remove from inventory
+        RemoveFromBag(s, itemIndex);
+        Say(s, "Dropped the %s on the floor.\n", itemName);
+    }
+    else
+    {
+        NoteFailure(s, true);
+        Say(s, "Dang it! This room is too messy already, can't drop anything else here.\n");
+    }
+}
+
+// look at an item closer
+void LookAtItem(const World *world, const Session *s, const char *itemName)
+{
+    const Inventory *inv = &s->inv;
+    int itemIndex = FindInBag(world, inv, itemName);
+    if (itemIndex != -1)
+    {
+        const Item *item = &world->items[inv->items[itemIndex]];
+        Say(s, "%s: %s\n", Text(world, item->name), Text(world, item->description));
+        return;
+    }
+    NoteFailure(s, false);
+    Say(s, "You don't have a %s to look at.\n", itemName);
+}
+
+// show what's in your inventory
+void ShowInventory(const World *world, const Session *s)
+{
+    const Inventory *inv = &s->inv;
+    if (inv->count == 0)
+    {
+        Say(s, "You're not carrying anything.\n");
+        return;
+    }
+    Say(s, "Your stuff (%d/%d slots):\n", inv->count, inv->capacity);
+    for (int i = 0; i < inv->count; i++)
+    {
+        const Item *item = &world->items[inv->items[i]];
+        Say(s, "- %s (%d)\n", Text(world, item->name), item->quantity);
+    }
+}
+
+// check if you have an item
+bool GotItem(const World *world, const Inventory *inv, const char *itemName)
+{
+    return FindInBag(world, inv, itemName) != -1;
+}
+
+// remove an item from inventory, it's used up after this
+void DeleteItemFromBag(const World *world, Session *s, const char *itemName)
+{
+    int itemIndex = FindInBag(world, &s->inv, itemName);
+    if (itemIndex == -1)
+    {
+        return;
+    }
+    MoveItem(s, s->inv.items[itemIndex], USED_UP);
+    RemoveFromBag(s, itemIndex);
+}
+
+// add an item to a room
+void PutItemInRoom(const World *world, Session *s, const Room *room, int itemId)
+{
+    int roomItems[10];
+    if (itemId >= 0 && RoomItems(world, s, room, roomItems) < 10)
+    {
+        MoveItem(s, itemId, room->id);
+    }
+}
+
+// free a room loaded from a page file and its interactables
+void FreeRoom(Room *room)
+{
+    if (!room)
+        return;
+    MemFree((void *)room->interactables);
+    MemFree(room);
+}
+
+// ---------------------------------------------------------------------------
+// World storage
+// Rooms are stored in a page file and loaded the first time somebody needs
+// them. Only `capacity` rooms stay in memory, the least recently used one
+// gets thrown out when we need space. The file is never written while
+// playing, player changes live in their WorldDelta.
+// The built-in temple doesn't need any of this, its rooms are const tables.
+// ---------------------------------------------------------------------------
+
+static void WriteInt(FILE *file, int value)
+{
+    fwrite(&value, sizeof(value), 1, file);
+}
+
+static bool ReadInt(FILE *file, int *value)
+{
+    return fread(value, sizeof(*value), 1, file) == 1;
+}
+
+static void WriteBool(FILE *file, bool value)
+{
+    unsigned char b = value ? 1 : 0;
+    fwrite(&b, 1, 1, file);
+}
+
+static bool ReadBool(FILE *file, bool *value)
+{
+    unsigned char b;
+    if (fread(&b, 1, 1, file) != 1)
+        return false;
+    *value = b != 0;
+    return true;
+}
+
+static void WriteRef(FILE *file, TextRef ref)
+{
+    fwrite(&ref, sizeof(ref), 1, file);
+}
+
+// text refs have to point into the world's string pool (or one of its cold blocks)
+static bool ReadRef(FILE *file, const World *world, TextRef *ref)
+{
+    if (fread(ref, sizeof(*ref), 1, file) != 1)
+        return false;
+    if (*ref & COLD_TEXT)
+        return (int)((*ref & ~COLD_TEXT) >> COLD_BLOCK_BITS) < world->coldBlockCount;
+    return *ref < world->textSize;
+}
+
+// an item id or -1
+static bool ReadItemId(FILE *file, const World *world, int *id)
+{
+    return ReadInt(file, id) && *id >= -1 && *id < world->itemCount;
+}
+
+// collects the text of a world we're writing, every different string goes in only once
+typedef struct
+{
+    char *hot; // the string pool
+    unsigned int hotSize;
+    unsigned int hotCapacity;
+    char *cold; // cold text before compression, block after block
+    unsigned int coldSize;
+    unsigned int coldCapacity;
+    unsigned int *blockStarts; // where each block starts in cold
+    int blockCount;
+    int blockCapacity;
+    bool compress; // false = cold text goes in the pool like everything else
+
+    TextRef *refs; // open addressing: what we already have (refs[i] = 0 means empty, "" is always there)
+    unsigned int *hashes;
+    int tableSize;
+    int used;
+} TextBuilder;
+
+static const char *BuiltText(const TextBuilder *b, TextRef ref)
+{
+    if (!(ref & COLD_TEXT))
+        return b->hot + ref;
+    int block = (int)((ref & ~COLD_TEXT) >> COLD_BLOCK_BITS);
+    return b->cold + b->blockStarts[block] + (ref & (COLD_BLOCK_SIZE - 1));
+}
+
+// make sure `extra` more bytes fit
+static bool GrowBuffer(char **buffer, unsigned int size, unsigned int *capacity, unsigned int extra)
+{
+    if (size + extra <= *capacity)
+        return true;
+    unsigned int new_capacity = *capacity ? *capacity : 4096;
+    while (new_capacity < size + extra)
+        new_capacity *= 2;
+    char *new_buffer = MemRealloc(MEM_TEXT, *buffer, new_capacity);
+    if (!new_buffer)
+        return false;
+    *buffer = new_buffer;
+    *capacity = new_capacity;
+    return true;
+}
+
+static bool GrowTextTable(TextBuilder *b)
+{
+    int new_size = b->tableSize ? b->tableSize * 2 : 1024;
+    TextRef *refs = MemCalloc(MEM_TEXT, new_size, sizeof(TextRef));
+    unsigned int *hashes = MemAlloc(MEM_TEXT, sizeof(unsigned int) * new_size);
+    if (!refs || !hashes)
+    {
+        MemFree(refs);
+        MemFree(hashes);
+        return false;
+    }
+    for (int i = 0; i < b->tableSize; i++)
+    {
+        if (!b->refs[i])
+            continue;
+        int j = (int)(b->hashes[i] & (unsigned int)(new_size - 1));
+        while (refs[j])
+            j = (j + 1) & (new_size - 1);
+        refs[j] = b->refs[i];
+        hashes[j] = b->hashes[i];
+    }
+    MemFree(b->refs);
+    MemFree(b->hashes);
+    b->refs = refs;
+    b->hashes = hashes;
+    b->tableSize = new_size;
+    return true;
+}
+
+// the ref a string gets in the world we're writing (adds it the first time), 0 if we ran out of memory
+static TextRef AddText(TextBuilder *b, const char *text, bool cold)
+{
+    if (!text[0])
+        return 0;
+    if (b->hotSize == 0)
+    {
+        // offset 0 is the empty string
+        if (!GrowBuffer(&b->hot, 0, &b->hotCapacity, 1))
+            return 0;
+        b->hot[b->hotSize++] = '\0';
+    }
+    unsigned int size = (unsigned int)strlen(text) + 1;
+    cold = cold && b->compress && size <= COLD_BLOCK_SIZE;
+    unsigned int hash = 2166136261u ^ (cold ? 1u : 0u);
+    for (const char *p = text; *p; p++)
+    {
+        hash ^= (unsigned char)*p;
+        hash *= 16777619u;
+    }
+    if (b->used * 2 >= b->tableSize && !GrowTextTable(b))
+        return 0;
+    int i = (int)(hash & (unsigned int)(b->tableSize - 1));
+    for (; b->refs[i]; i = (i + 1) & (b->tableSize - 1))
+    {
+        if (b->hashes[i] == hash && ((b->refs[i] & COLD_TEXT) != 0) == cold && strcmp(BuiltText(b, b->refs[i]), text) == 0)
+            return b->refs[i];
+    }
+
+    TextRef ref;
+    if (!cold)
+    {
+        if (b->hotSize + size >= COLD_TEXT || !GrowBuffer(&b->hot, b->hotSize, &b->hotCapacity, size))
+            return 0;
+        ref = b->hotSize;
+        memcpy(b->hot + b->hotSize, text, size);
+        b->hotSize += size;
+    }
+    else
+    {
+        // strings never get split over two blocks
+        if (b->blockCount == 0 || b->coldSize - b->blockStarts[b->blockCount - 1] + size > COLD_BLOCK_SIZE)
+        {
+            if (b->blockCount == MAX_COLD_BLOCKS)
+                return 0;
+            if (b->blockCount == b->blockCapacity)
+            {
+                int new_capacity = b->blockCapacity ? b->blockCapacity * 2 : 64;
+                unsigned int *new_starts = MemRealloc(MEM_TEXT, b->blockStarts, sizeof(unsigned int) * new_capacity);
+                if (!new_starts)
+                    return 0;
+                b->blockStarts = new_starts;
+                b->blockCapacity = new_capacity;
+            }
+            b->blockStarts[b->blockCount++] = b->coldSize;
+        }
+        if (!GrowBuffer(&b->cold, b->coldSize, &b->coldCapacity, size))
+            return 0;
+        int block = b->blockCount - 1;
+        ref = COLD_TEXT | ((TextRef)block << COLD_BLOCK_BITS) | (b->coldSize - b->blockStarts[block]);
+        memcpy(b->cold + b->coldSize, text, size);
+        b->coldSize += size;
+    }
+    b->refs[i] = ref;
+    b->hashes[i] = hash;
+    b->used++;
+    return ref;
+}
+
+static void FreeTextBuilder(TextBuilder *b)
+{
+    MemFree(b->hot);
+    MemFree(b->cold);
+    MemFree(b->blockStarts);
+    MemFree(b->refs);
+    MemFree(b->hashes);
+}
+
+// a text of a component (goes through the builder, and into the file unless it's NULL), false if we ran out of memory
+static bool PutRef(FILE *file, TextBuilder *b, const World *world, TextRef ref, bool cold)
+{
+    const char *text = Text(world, ref);
+    TextRef built = AddText(b, text, cold);
+    if (file)
+        WriteRef(file, built);
+    return built || !text[0];
+}
+
+static void PutInt(FILE *file, int value)
+{
+    if (file)
+        WriteInt(file, value);
+}
+
+// the components, kind after kind in the order of Components: a count, then the parts (sorted like in memory)
+// file NULL only runs their text through the builder (see CollectText)
+static bool WriteParts(FILE *file, TextBuilder *b, const World *world)
+{
+    const Components *c = &world->parts;
+    bool ok = true;
+    PutInt(file, c->riddleCount);
+    for (int i = 0; ok && i < c->riddleCount; i++)
+    {
+        const Riddle *r = &c->riddles[i];
+        PutInt(file, r->of.room);
+        PutInt(file, r->of.slot);
+        ok = PutRef(file, b, world, r->riddle, true) && PutRef(file, b, world, r->answer, false) &&
+             PutRef(file, b, world, r->ask, true) && PutRef(file, b, world, r->right, true) &&
+             PutRef(file, b, world, r->wrong, true) && PutRef(file, b, world, r->nag, true);
+        PutInt(file, r->nagSeconds);
+    }
+    PutInt(file, c->containerCount);
+    for (int i = 0; ok && i < c->containerCount; i++)
+    {
+        const Container *box = &c->containers[i];
+        PutInt(file, box->of.room);
+        PutInt(file, box->of.slot);
+        PutInt(file, box->guard);
+        PutInt(file, box->dropItem);
+        PutInt(file, box->bagItem);
+        ok = PutRef(file, b, world, box->guarded, true) && PutRef(file, b, world, box->open, true) &&
+             PutRef(file, b, world, box->empty, true) && PutRef(file, b, world, box->grab, true) &&
+             PutRef(file, b, world, box->full, true);
+    }
+    PutInt(file, c->lockableCount);
+    for (int i = 0; ok && i < c->lockableCount; i++)
+    {
+        const Lockable *lock = &c->lockables[i];
+        PutInt(file, lock->of.room);
+        PutInt(file, lock->of.slot);
+        PutInt(file, lock->key);
+        PutInt(file, lock->otherKey);
+        PutInt(file, lock->usesUp);
+        PutInt(file, lock->reveals);
+        PutInt(file, lock->laterSeconds);
+        ok = PutRef(file, b, world, lock->use, true) && PutRef(file, b, world, lock->done, true) &&
+             PutRef(file, b, world, lock->later, true);
+    }
+    PutInt(file, c->pushableCount);
+    for (int i = 0; ok && i < c->pushableCount; i++)
+    {
+        const Pushable *push = &c->pushables[i];
+        PutInt(file, push->of.room);
+        PutInt(file, push->of.slot);
+        PutInt(file, push->reveals);
+        ok = PutRef(file, b, world, push->push, true) && PutRef(file, b, world, push->again, true);
+    }
+    PutInt(file, c->descriptionCount);
+    for (int i = 0; ok && i < c->descriptionCount; i++)
+    {
+        const Description *looks = &c->descriptions[i];
+        PutInt(file, looks->of.room);
+        PutInt(file, looks->of.slot);
+        ok = PutRef(file, b, world, looks->ready, true) && PutRef(file, b, world, looks->used, true) &&
+             PutRef(file, b, world, looks->later, true);
+    }
+    PutInt(file, c->doorCount);
+    for (int i = 0; ok && i < c->doorCount; i++)
+    {
+        const Door *door = &c->doors[i];
+        PutInt(file, door->of.room);
+        PutInt(file, door->of.slot);
+        ok = PutRef(file, b, world, door->name, false) && PutRef(file, b, world, door->opens, true);
+    }
+    return ok;
+}
+
+// which thing a part belongs to, it has to come after the one before it (prev, NULL for the first)
+static bool ReadThingId(FILE *file, const World *world, ThingId *of, const ThingId *prev, bool door)
+{
+    return ReadInt(file, &of->room) && ReadInt(file, &of->slot) &&
+           of->room >= 0 && of->room < world->roomCount &&
+           (door ? of->slot == -1 : of->slot >= 0 && of->slot < 10) &&
+           (!prev || prev->room < of->room || (prev->room == of->room && prev->slot < of->slot));
+}
+
+// count and space for one kind of component, the space belongs to the world (loadedParts)
+static void *ReadPartCount(FILE *file, World *world, int kind, size_t size, int perRoom, int *count)
+{
+    if (!ReadInt(file, count) || *count < 0 || *count > (long long)world->roomCount * perRoom)
+        return NULL;
+    world->loadedParts[kind] = MemAlloc(MEM_INTERACTABLES, size * (size_t)(*count ? *count : 1));
+    return world->loadedParts[kind];
+}
+
+// seconds something takes, a day is more than anybody waits
+static bool ReadSeconds(FILE *file, int *seconds)
+{
+    return ReadInt(file, seconds) && *seconds >= 0 && *seconds <= 86400;
+}
+
+static bool ReadParts(FILE *file, World *world)
+{
+    Components *c = &world->parts;
+    Riddle *riddles = ReadPartCount(file, world, 0, sizeof(Riddle), 10, &c->riddleCount);
+    bool ok = riddles != NULL;
+    for (int i = 0; ok && i < c->riddleCount; i++)
+    {
+        Riddle *r = &riddles[i];
+        ok = ReadThingId(file, world, &r->of, i ? &riddles[i - 1].of : NULL, false) &&
+             ReadRef(file, world, &r->riddle) && ReadRef(file, world, &r->answer) &&
+             ReadRef(file, world, &r->ask) && ReadRef(file, world, &r->right) &&
+             ReadRef(file, world, &r->wrong) && ReadRef(file, world, &r->nag) &&
+             ReadSeconds(file, &r->nagSeconds);
+    }
+    c->riddles = riddles;
+
+    Container *boxes = ok ? ReadPartCount(file, world, 1, sizeof(Container), 10, &c->containerCount) : NULL;
+    ok = boxes != NULL;
+    for (int i = 0; ok && i < c->containerCount; i++)
+    {
+        Container *box = &boxes[i];
+        ok = ReadThingId(file, world, &box->of, i ? &boxes[i - 1].of : NULL, false) &&
+             ReadInt(file, &box->guard) && box->guard >= -1 && box->guard < 10 &&
+             ReadItemId(file, world, &box->dropItem) && ReadItemId(file, world, &box->bagItem) &&
+             ReadRef(file, world, &box->guarded) && ReadRef(file, world, &box->open) &&
+             ReadRef(file, world, &box->empty) && ReadRef(file, world, &box->grab) &&
+             ReadRef(file, world, &box->full);
+    }
+    c->containers = boxes;
+
+    Lockable *locks = ok ? ReadPartCount(file, world, 2, sizeof(Lockable), 10, &c->lockableCount) : NULL;
+    ok = locks != NULL;
+    for (int i = 0; ok && i < c->lockableCount; i++)
+    {
+        Lockable *lock = &locks[i];
+        int usesUp = 0;
+        ok = ReadThingId(file, world, &lock->of, i ? &locks[i - 1].of : NULL, false) &&
+             ReadItemId(file, world, &lock->key) && lock->key >= 0 &&
+             ReadItemId(file, world, &lock->otherKey) &&
+             ReadInt(file, &usesUp) && ReadItemId(file, world, &lock->reveals) &&
+             ReadSeconds(file, &lock->laterSeconds) &&
+             ReadRef(file, world, &lock->use) && ReadRef(file, world, &lock->done) &&
+             ReadRef(file, world, &lock->later);
+        lock->usesUp = usesUp != 0;
+    }
+    c->lockables = locks;
+
+    Pushable *pushes = ok ? ReadPartCount(file, world, 3, sizeof(Pushable), 10, &c->pushableCount) : NULL;
+    ok = pushes != NULL;
+    for (int i = 0; ok && i < c->pushableCount; i++)
+    {
+        Pushable *push = &pushes[i];
+        ok = ReadThingId(file, world, &push->of, i ? &pushes[i - 1].of : NULL, false) &&
+             ReadItemId(file, world, &push->reveals) &&
+             ReadRef(file, world, &push->push) && ReadRef(file, world, &push->again);
+    }
+    c->pushables = pushes;
+
+    Description *looks = ok ? ReadPartCount(file, world, 4, sizeof(Description), 10, &c->descriptionCount) : NULL;
+    ok = looks != NULL;
+    for (int i = 0; ok && i < c->descriptionCount; i++)
+    {
+        ok = ReadThingId(file, world, &looks[i].of, i ? &looks[i - 1].of : NULL, false) &&
+             ReadRef(file, world, &looks[i].ready) && ReadRef(file, world, &looks[i].used) &&
+             ReadRef(file, world, &looks[i].later);
+    }
+    c->descriptions = looks;
+
+    Door *doors = ok ? ReadPartCount(file, world, 5, sizeof(Door), 1, &c->doorCount) : NULL;
+    ok = doors != NULL;
+    for (int i = 0; ok && i < c->doorCount; i++)
+    {
+        ok = ReadThingId(file, world, &doors[i].of, i ? &doors[i - 1].of : NULL, true) &&
+             ReadRef(file, world, &doors[i].name) && ReadRef(file, world, &doors[i].opens);
+    }
+    c->doors = doors;
+    return ok;
+}
+
+// run every string of the world through the builder, so it knows the whole pool before we write it
+static bool CollectText(TextBuilder *b, World *world)
+{
+    bool ok = true;
+    for (int i = 0; i < world->itemCount; i++)
+    {
+        const Item *item = &world->items[i];
+        ok = ok && (AddText(b, Text(world, item->name), false) || !Text(world, item->name)[0]);
+        ok = ok && (AddText(b, Text(world, item->description), true) || !Text(world, item->description)[0]);
+    }
+    ok = ok && WriteParts(NULL, b, world);
+    for (int i = 0; ok && i < world->roomCount; i++)
+    {
+        const Room *room = GetRoom(world, i);
+        if (!room)
+            return false;
+        ok = (AddText(b, Text(world, room->name), false) || !Text(world, room->name)[0]) &&
+             (AddText(b, Text(world, room->description), true) || !Text(world, room->description)[0]);
+        for (int j = 0; ok && j < room->interactableCount; j++)
+        {
+            const Interactable *thing = &room->interactables[j];
+            ok = (AddText(b, Text(world, thing->name), false) || !Text(world, thing->name)[0]) &&
+                 (AddText(b, Text(world, thing->description), true) || !Text(world, thing->description)[0]);
+        }
+    }
+    return ok;
+}
+
+// string pool, then the cold blocks (compressed one by one, offsets first)
+static bool WriteTextPool(FILE *file, const TextBuilder *b)
+{
+    WriteInt(file, (int)b->hotSize);
+    fwrite(b->hot, 1, b->hotSize, file);
+
+    WriteInt(file, b->blockCount);
+    unsigned int *offsets = MemAlloc(MEM_TEXT, sizeof(unsigned int) * (b->blockCount + 1));
+    unsigned char *data = MemAlloc(MEM_TEXT, b->coldSize + b->coldSize / LZ_MAX_LITERALS + b->blockCount + 1);
+    if (!offsets || !data)
+    {
+        perror("Memory fail - couldn't compress the text");
+        MemFree(offsets);
+        MemFree(data);
+        return false;
+    }
+    unsigned int size = 0;
+    for (int i = 0; i < b->blockCount; i++)
+    {
+        unsigned int end = i + 1 < b->blockCount ? b->blockStarts[i + 1] : b->coldSize;
+        offsets[i] = size;
+        size += Compress(b->cold + b->blockStarts[i], (int)(end - b->blockStarts[i]), data + size);
+    }
+    offsets[b->blockCount] = size;
+    fwrite(offsets, sizeof(unsigned int), b->blockCount + 1, file);
+    fwrite(data, 1, size, file);
+    MemFree(offsets);
+    MemFree(data);
+    return true;
+}
+
+// an item goes in as the struct itself (padding zeroed, so the same world always makes the same file)
+static void WriteItemRecord(FILE *file, TextBuilder *b, const World *world, const Item *item)
+{
+    Item record;
+    memset(&record, 0, sizeof(record));
+    record.name = AddText(b, Text(world, item->name), false);
+    record.description = AddText(b, Text(world, item->description), true);
+    record.quantity = item->quantity;
+    record.canCombine = item->canCombine;
+    record.combineWith = item->combineWith;
+    record.resultItem = item->resultItem;
+    record.homeRoom = item->homeRoom;
+    record.nameHash = NameHash(Text(world, item->name));
+    fwrite(&record, sizeof(record), 1, file);
+}
+
+// the catalog starts on an Item boundary with the size of an Item in front, a build where
+// Item looks different can't use the file
+static void WriteCatalogStart(FILE *file)
+{
+    WriteInt(file, (int)sizeof(Item));
+    while (ftell(file) % (long)_Alignof(Item) != 0)
+        fputc(0, file);
+}
+
+static bool ReadCatalogStart(FILE *file)
+{
+    int itemSize = 0;
+    if (!ReadInt(file, &itemSize) || itemSize != (int)sizeof(Item))
+        return false;
+    long at = ftell(file), align = (long)_Alignof(Item);
+    return at >= 0 && fseek(file, (align - at % align) % align, SEEK_CUR) == 0;
+}
+
+// write one room (with its interactables) at the current file position
+static void WriteRoomRecord(FILE *file, TextBuilder *b, const World *world, const Room *room)
+{
+    WriteInt(file, room->id);
+    WriteRef(file, AddText(b, Text(world, room->name), false));
+    WriteRef(file, AddText(b, Text(world, room->description), true));
+    WriteBool(file, room->isLocked);
+    WriteInt(file, room->keyItem);
+    WriteInt(file, room->north);
+    WriteInt(file, room->south);
+    WriteInt(file, room->east);
+    WriteInt(file, room->west);
+
+    WriteInt(file, room->itemCount);
+    for (int i = 0; i < room->itemCount; i++)
+        WriteInt(file, room->items[i]);
+
+    WriteInt(file, room->interactableCount);
+    for (int i = 0; i < room->interactableCount; i++)
+    {
+        const Interactable *thing = &room->interactables[i];
+        WriteRef(file, AddText(b, Text(world, thing->name), false));
+        WriteRef(file, AddText(b, Text(world, thing->description), true));
+    }
+}
+
+// read one room record into room, its interactables go into things (room for 10)
+// doesn't allocate anything, the validator runs this on several threads at once
+static bool ReadRoomFields(FILE *file, const World *world, Room *room, Interactable *things)
+{
+    bool ok = ReadInt(file, &room->id) &&
+              ReadRef(file, world, &room->name) &&
+              ReadRef(file, world, &room->description) &&
+              ReadBool(file, &room->isLocked) &&
+              ReadItemId(file, world, &room->keyItem) &&
+              ReadInt(file, &room->north) &&
+              ReadInt(file, &room->south) &&
+              ReadInt(file, &room->east) &&
+              ReadInt(file, &room->west);
+
+    ok = ok && ReadInt(file, &room->itemCount) && room->itemCount >= 0 && room->itemCount <= 10;
+    for (int i = 0; ok && i < room->itemCount; i++)
+    {
+        ok = ReadInt(file, &room->items[i]) && room->items[i] >= 0 && room->items[i] < world->itemCount;
+    }
+
+    int interactableCount = 0;
+    ok = ok && ReadInt(file, &interactableCount) && interactableCount >= 0 && interactableCount <= 10;
+    room->interactables = things;
+    room->interactableCount = 0;
+    for (int i = 0; ok && i < interactableCount; i++)
+    {
+        Interactable *thing = &things[i];
+        ok = ReadRef(file, world, &thing->name) &&
+             ReadRef(file, world, &thing->description);
+        thing->nameHash = ok ? NameHash(Text(world, thing->name)) : 0;
+        room->interactableCount = i + 1;
+    }
+    return ok;
+}
+
+// read one room back, returns NULL if the record is broken
+static Room *ReadRoomRecord(FILE *file, const World *world)
+{
+    Room *room = (Room *)MemCalloc(MEM_ROOMS, 1, sizeof(Room));
+    if (!room)
+    {
+        perror("Memory fail - couldn't load room");
+        return NULL;
+    }
+    Interactable things[10];
+    bool ok = ReadRoomFields(file, world, room, things);
+    room->interactables = NULL;
+    if (ok && room->interactableCount > 0)
+    {
+        Interactable *copy = (Interactable *)MemAlloc(MEM_INTERACTABLES, sizeof(Interactable) * room->interactableCount);
+        if (copy)
+            memcpy(copy, things, sizeof(Interactable) * room->interactableCount);
+        room->interactables = copy;
+        ok = copy != NULL;
+    }
+    if (!ok)
+    {
+        FreeRoom(room);
+        return NULL;
+    }
+    return room;
+}
+
+// write a whole world into a page file, compress = pack the cold text into compressed blocks
+bool SaveWorld(const char *path, World *world, bool compress)
+{
+    TextBuilder text = {0};
+    text.compress = compress;
+    if (!CollectText(&text, world))
+    {
+        fprintf(stderr, "Couldn't collect the text of the world\n");
+        FreeTextBuilder(&text);
+        return false;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        perror("Failed to create world file");
+        FreeTextBuilder(&text);
+        return false;
+    }
+    WriteInt(file, WORLD_MAGIC);
+    WriteInt(file, WORLD_VERSION);
+    WriteInt(file, world->roomCount);
+    WriteInt(file, world->startRoom);
+    WriteInt(file, world->itemCount);
+    bool ok = WriteTextPool(file, &text);
+    if (ok)
+        WriteCatalogStart(file);
+    for (int i = 0; ok && i < world->itemCount; i++)
+        WriteItemRecord(file, &text, world, &world->items[i]);
+    ok = ok && WriteParts(file, &text, world);
+
+    // leave space for the offset table and fill it in once we know where things are
+    long tableOffset = ftell(file);
+    long long offset = 0;
+    for (int i = 0; ok && i < world->roomCount; i++)
+        fwrite(&offset, sizeof(offset), 1, file);
+
+    for (int i = 0; ok && i < world->roomCount; i++)
+    {
+        const Room *room = GetRoom(world, i);
+        ok = room != NULL;
+        if (!ok)
+            break;
+        offset = ftell(file);
+        fseek(file, tableOffset + (long)(i * sizeof(offset)), SEEK_SET);
+        fwrite(&offset, sizeof(offset), 1, file);
+        fseek(file, 0, SEEK_END);
+        WriteRoomRecord(file, &text, world, room);
+    }
+
+    if (ferror(file))
+        ok = false;
+    if (fclose(file) != 0)
+        ok = false;
+    if (!ok)
+        fprintf(stderr, "Couldn't write the world to %s\n", path);
+    FreeTextBuilder(&text);
+    return ok;
+}
+
+// map the whole page file read-only. nothing gets read until somebody touches it, and what the OS pages in
+// it can drop again whenever it likes, so the text of a huge world doesn't sit in memory
+static void MapWorldFile(World *world)
+{
+#ifndef _WIN32
+    struct stat st;
+    if (fstat(fileno(world->file), &st) != 0 || st.st_size <= 0)
+        return;
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(world->file), 0);
+    if (map == MAP_FAILED)
+        return; // we just read it then
+    madvise(map, (size_t)st.st_size, MADV_RANDOM); // we jump around in it, reading ahead only fills memory
+    world->mapped = map;
+    world->mappedSize = (size_t)st.st_size;
+#else
+    (void)world;
+#endif
+}
+
+// the next size bytes of the page file: right out of the mapping, or read into a block of our own
+// (*copy, CloseWorld frees it) if there's no mapping. NULL if the file ends before that
+static const void *FilePiece(World *world, int tag, size_t size, void **copy)
+{
+    long at = ftell(world->file);
+    if (at < 0)
+        return NULL;
+    if (world->mapped)
+    {
+        if ((size_t)at > world->mappedSize || size > world->mappedSize - (size_t)at ||
+            fseek(world->file, (long)size, SEEK_CUR) != 0)
+            return NULL;
+        return world->mapped + at;
+    }
+    *copy = MemAlloc(tag, size ? size : 1);
+    if (!*copy || fread(*copy, 1, size, world->file) != size)
+        return NULL;
+    return *copy;
+}
+
+// the string pool and the cold blocks of a page file (only the block offsets get copied, they're tiny)
+static bool ReadTextPool(FILE *file, World *world)
+{
+    int textSize = 0, blockCount = 0;
+    if (!ReadInt(file, &textSize) || textSize < 1)
+        return false;
+    const char *text = FilePiece(world, MEM_TEXT, (size_t)textSize, &world->loadedText);
+    if (!text || text[0] != '\0' || text[textSize - 1] != '\0')
+        return false;
+    world->text = text;
+    world->textSize = (unsigned int)textSize;
+
+    if (!ReadInt(file, &blockCount) || blockCount < 0 || blockCount > MAX_COLD_BLOCKS)
+        return false;
+    world->coldOffsets = MemAlloc(MEM_TEXT, sizeof(unsigned int) * (blockCount + 1));
+    world->coldCache = MemCalloc(MEM_TEXT, blockCount + 1, sizeof(char *));
+    if (!world->coldOffsets || !world->coldCache ||
+        fread(world->coldOffsets, sizeof(unsigned int), blockCount + 1, file) != (size_t)blockCount + 1 ||
+        world->coldOffsets[0] != 0)
+        return false;
+    for (int i = 0; i < blockCount; i++)
+    {
+        if (world->coldOffsets[i + 1] < world->coldOffsets[i])
+            return false;
+    }
+    world->coldData = FilePiece(world, MEM_TEXT, world->coldOffsets[blockCount], &world->loadedColdData);
+    if (!world->coldData)
+        return false;
+    world->coldBlockCount = blockCount;
+    return true;
+}
+
+// use const tables as the world, nothing to load or set up
+World *OpenTableWorld(const WorldTables *tables)
+{
+    World *world = (World *)MemCalloc(MEM_WORLD, 1, sizeof(World));
+    if (!world)
+    {
+        perror("Memory fail - couldn't open world");
+        return NULL;
+    }
+    world->text = tables->text;
+    world->textSize = tables->textSize;
+    world->tableRooms = tables->rooms;
+    world->roomCount = tables->roomCount;
+    world->startRoom = tables->startRoom;
+    world->items = tables->items;
+    world->itemCount = tables->itemCount;
+    world->parts = tables->parts;
+    return world;
+}
+
+// open a page file, only the components get loaded until someone asks for a room.
+// map = use the text and the item catalog right out of a mapping of the file instead of keeping a copy.
+// the items aren't checked here (that would page in all of them), whatever uses an id out of one checks it
+static World *OpenWorldFile(const char *path, int cacheSize, bool map)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        perror("Failed to open world file");
+        return NULL;
+    }
+    int magic = 0, version = 0, roomCount = 0, startRoom = 0, itemCount = 0;
+    if (!ReadInt(file, &magic) || !ReadInt(file, &version) || !ReadInt(file, &roomCount) ||
+        !ReadInt(file, &startRoom) || !ReadInt(file, &itemCount) ||
+        magic != WORLD_MAGIC || version != WORLD_VERSION ||
+        roomCount <= 0 || roomCount > MAX_WORLD_ROOMS || startRoom < 0 || startRoom >= roomCount ||
+        itemCount < 0 || itemCount > MAX_WORLD_ITEMS)
+    {
+        fprintf(stderr, "%s is not a world file we understand\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    if (cacheSize < MIN_ROOM_CACHE)
+        cacheSize = MIN_ROOM_CACHE;
+    World *world = (World *)MemCalloc(MEM_WORLD, 1, sizeof(World));
+    if (!world)
+    {
+        perror("Memory fail - couldn't open world");
+        fclose(file);
+        return NULL;
+    }
+    world->file = file;
+    if (map)
+        MapWorldFile(world);
+    snprintf(world->path, sizeof(world->path), "%s", path);
+    world->roomCount = roomCount;
+    world->startRoom = startRoom;
+    world->itemCount = itemCount;
+    world->capacity = cacheSize;
+    world->lookupSize = 1;
+    while (world->lookupSize < cacheSize * 2)
+        world->lookupSize *= 2;
+    world->slots = (CacheSlot *)MemCalloc(MEM_ROOMS, (size_t)cacheSize, sizeof(CacheSlot));
+    world->lookup = (int *)MemAlloc(MEM_ROOMS, sizeof(int) * (size_t)world->lookupSize);
+    bool ok = world->slots && world->lookup;
+    if (!ok)
+        perror("Memory fail - couldn't make room cache");
+    if (ok && !ReadTextPool(file, world))
+    {
+        fprintf(stderr, "Couldn't read the text in %s\n", path);
+        ok = false;
+    }
+    if (ok)
+    {
+        world->items = ReadCatalogStart(file) ? FilePiece(world, MEM_ITEMS, sizeof(Item) * (size_t)itemCount, &world->loadedItems) : NULL;
+        ok = world->items != NULL;
+        if (!ok)
+            fprintf(stderr, "Couldn't read the items in %s\n", path);
+    }
+    if (ok && !ReadParts(file, world))
+    {
+        fprintf(stderr, "Couldn't read the components in %s\n", path);
+        ok = false;
+    }
+    if (!ok)
+    {
+        CloseWorld(world);
+        return NULL;
+    }
+    world->tableOffset = ftell(file);
+    for (int i = 0; i < world->lookupSize; i++)
+        world->lookup[i] = -1;
+    world->lruHead = -1;
+    world->lruTail = -1;
+    char hintPath[4096];
+    if (snprintf(hintPath, sizeof(hintPath), "%s.hints", path) < (int)sizeof(hintPath))
+        AttachHints(world, hintPath, true);
+    return world;
+}
+
+World *OpenWorld(const char *path, int cacheSize)
+{
+    return OpenWorldFile(path, cacheSize, true);
+}
+
+// a page file read all at once: every room, every interactable and all the cold text unpacked.
+// after that nothing in it ever changes (no cache, no file, no mapping), so any number of threads can read it
+// and the file can be written over while it's in use
+World *LoadWholeWorld(const char *path)
+{
+    World *world = OpenWorldFile(path, MIN_ROOM_CACHE, false);
+    if (!world)
+        return NULL;
+    int roomCount = world->roomCount;
+    long long *offsets = MemAlloc(MEM_WORLD, sizeof(long long) * roomCount);
+    int *firstThing = MemAlloc(MEM_WORLD, sizeof(int) * roomCount);
+    world->loadedRooms = MemCalloc(MEM_ROOMS, roomCount, sizeof(Room));
+    int thingCount = 0, thingCapacity = 0;
+    bool ok = offsets && firstThing && world->loadedRooms;
+    if (!ok)
+        perror("Memory fail - couldn't load the world");
+    ok = ok && fseek(world->file, world->tableOffset, SEEK_SET) == 0 &&
+         fread(offsets, sizeof(long long), roomCount, world->file) == (size_t)roomCount;
+    for (int id = 0; ok && id < roomCount; id++)
+    {
+        Room *room = &world->loadedRooms[id];
+        Interactable things[10];
+        // the records are usually back to back, only seek when they aren't
+        ok = (ftell(world->file) == (long)offsets[id] || fseek(world->file, (long)offsets[id], SEEK_SET) == 0) &&
+             ReadRoomFields(world->file, world, room, things) && room->id == id;
+        if (ok && thingCount + room->interactableCount > thingCapacity)
+        {
+            int newCapacity = thingCapacity ? thingCapacity * 2 : 1024;
+            Interactable *grown = MemRealloc(MEM_INTERACTABLES, world->loadedInteractables, sizeof(Interactable) * newCapacity);
+            ok = grown != NULL;
+            if (grown)
+            {
+                world->loadedInteractables = grown;
+                thingCapacity = newCapacity;
+            }
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "Room %d in %s is broken\n", id, path);
+            break;
+        }
+        memcpy(&world->loadedInteractables[thingCount], things, sizeof(Interactable) * room->interactableCount);
+        firstThing[id] = thingCount;
+        thingCount += room->interactableCount;
+    }
+    // the interactables only stop moving around once they're all in
+    for (int id = 0; ok && id < roomCount; id++)
+    {
+        Room *room = &world->loadedRooms[id];
+        room->interactables = room->interactableCount ? &world->loadedInteractables[firstThing[id]] : NULL;
+    }
+    for (int block = 0; ok && block < world->coldBlockCount; block++)
+        Text(world, COLD_TEXT | (unsigned int)block << COLD_BLOCK_BITS);
+    MemFree(offsets);
+    MemFree(firstThing);
+    if (!ok)
+    {
+        CloseWorld(world);
+        return NULL;
+    }
+    fclose(world->file);
+    world->file = NULL;
+    world->tableRooms = world->loadedRooms;
+    return world;
+}
+
+// where a room id would sit in the lookup table
+static int LookupIndex(const World *world, int id)
+{
+    unsigned int h = (unsigned int)id * 2654435761u;
+    return (int)(h & (unsigned int)(world->lookupSize - 1));
+}
+
+static int FindSlot(const World *world, int id)
+{
+    for (int i = LookupIndex(world, id);; i = (i + 1) & (world->lookupSize - 1))
+    {
+        int slot = world->lookup[i];
+        if (slot == -1)
+            return -1;
+        if (world->slots[slot].room->id == id)
+            return slot;
+    }
+}
+
+static void AddToLookup(World *world, int id, int slot)
+{
+    int i = LookupIndex(world, id);
+    while (world->lookup[i] != -1)
+        i = (i + 1) & (world->lookupSize - 1);
+    world->lookup[i] = slot;
+}
+
+// linear probing removal, move later entries back so lookups don't stop early
+static void RemoveFromLookup(World *world, int id)
+{
+    int mask = world->lookupSize - 1;
+    int i = LookupIndex(world, id);
+    while (world->slots[world->lookup[i]].room->id != id)
+        i = (i + 1) & mask;
+    world->lookup[i] = -1;
+    for (int j = (i + 1) & mask; world->lookup[j] != -1; j = (j + 1) & mask)
+    {
+        int slot = world->lookup[j];
+        int home = LookupIndex(world, world->slots[slot].room->id);
+        // can the entry at j be moved into the hole at i?
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            world->lookup[i] = slot;
+            world->lookup[j] = -1;
+            i = j;
+        }
+    }
+}
+
+static void UnlinkSlot(World *world, int slot)
+{
+    CacheSlot *s = &world->slots[slot];
+    if (s->prev != -1)
+        world->slots[s->prev].next = s->next;
+    else
+        world->lruHead = s->next;
+    if (s->next != -1)
+        world->slots[s->next].prev = s->prev;
+    else
+        world->lruTail = s->prev;
+}
+
+static void LinkSlotAtHead(World *world, int slot)
+{
+    CacheSlot *s = &world->slots[slot];
+    s->prev = -1;
+    s->next = world->lruHead;
+    if (world->lruHead != -1)
+        world->slots[world->lruHead].prev = slot;
+    world->lruHead = slot;
+    if (world->lruTail == -1)
+        world->lruTail = slot;
+}
+
+// the rooms that went out of the cache leave their text and items in the mapped file paged in. once a whole
+// cache's worth of rooms went, give all of it back, whatever is still in use just gets paged in again
+static void DropMappedPages(World *world)
+{
+#ifndef _WIN32
+    if (world->mapped && world->evictions % world->capacity == 0)
+        madvise((void *)world->mapped, world->mappedSize, MADV_DONTNEED);
+#else
+    (void)world;
+#endif
+}
+
+// throw out the least recently used room that isn't pinned, returns its slot
+// rooms are never changed in memory so there's nothing to write back
+static int EvictRoom(World *world)
+{
+    int slot = world->lruTail;
+    while (slot != -1 && world->slots[slot].pins > 0)
+        slot = world->slots[slot].prev;
+    if (slot == -1)
+        return -1;
+    Room *room = world->slots[slot].room;
+    RemoveFromLookup(world, room->id);
+    UnlinkSlot(world, slot);
+    FreeRoom(room);
+    world->slots[slot].room = NULL;
+    world->evictions++;
+    DropMappedPages(world);
+    return slot;
+}
+
+static Room *LoadRoom(World *world, int id)
+{
+    long long offset = 0;
+    if (fseek(world->file, world->tableOffset + (long)(id * (long)sizeof(offset)), SEEK_SET) != 0 ||
+        fread(&offset, sizeof(offset), 1, world->file) != 1 ||
+        fseek(world->file, (long)offset, SEEK_SET) != 0)
+        return NULL;
+    Room *room = ReadRoomRecord(world->file, world);
+    if (room && room->id != id)
+    {
+        FreeRoom(room);
+        return NULL;
+    }
+    world->loads++;
+    return room;
+}
+
+// get a room, loading it from disk if needed
+// the pointer stays good until the next GetRoom call unless the room is pinned
+const Room *GetRoom(World *world, int id)
+{
+    if (id < 0 || id >= world->roomCount)
+        return NULL;
+    if (world->tableRooms)
+        return &world->tableRooms[id];
+
+    int slot = FindSlot(world, id);
+    if (slot != -1)
+    {
+        if (world->lruHead != slot)
+        {
+            UnlinkSlot(world, slot);
+            LinkSlotAtHead(world, slot);
+        }
+        return world->slots[slot].room;
+    }
+
+    Room *room = LoadRoom(world, id);
+    if (!room)
+    {
+        fprintf(stderr, "Room %d in the world file is broken\n", id);
+        return NULL;
+    }
+    slot = world->used < world->capacity ? world->used++ : EvictRoom(world);
+    if (slot == -1)
+    {
+        fprintf(stderr, "Room cache is full of pinned rooms, can't load room %d\n", id);
+        FreeRoom(room);
+        return NULL;
+    }
+    world->slots[slot].room = room;
+    world->slots[slot].pins = 0;
+    AddToLookup(world, id, slot);
+    LinkSlotAtHead(world, slot);
+    return room;
+}
+
+void PinRoom(World *world, int id)
+{
+    if (world->tableRooms)
+        return;
+    int slot = FindSlot(world, id);
+    if (slot != -1)
+        world->slots[slot].pins++;
+}
+
+void UnpinRoom(World *world, int id)
+{
+    if (world->tableRooms)
+        return;
+    int slot = FindSlot(world, id);
+    if (slot != -1 && world->slots[slot].pins > 0)
+        world->slots[slot].pins--;
+}
+
+// let go of everything
+void CloseWorld(World *world)
+{
+    if (!world)
+        return;
+    for (int i = 0; i < world->used; i++)
+        FreeRoom(world->slots[i].room);
+    if (world->file)
+        fclose(world->file);
+    FreeHints(world->hints);
+    MemFree(world->loadedItems);
+    MemFree(world->loadedRooms);
+    MemFree(world->loadedInteractables);
+    for (int i = 0; i < PART_KINDS; i++)
+        MemFree(world->loadedParts[i]);
+    MemFree(world->slots);
+    MemFree(world->lookup);
+    MemFree(world->loadedText);
+    if (world->coldCache)
+    {
+        for (int i = 0; i < world->coldBlockCount; i++)
+            MemFree(world->coldCache[i]);
+    }
+    MemFree(world->coldCache);
+    MemFree(world->coldOffsets);
+    MemFree(world->loadedColdData);
+#ifndef _WIN32
+    if (world->mapped)
+        munmap((void *)world->mapped, world->mappedSize);
+#endif
+    MemFree(world);
+}
+
+// how the world's text would look with the old fixed size char arrays, just for the report
+typedef struct
+{
+    char name[50];
+    int quantity;
+    char description[200];
+    bool canCombine;
+    char combineWith[50];
+    char resultItem[50];
+    int homeRoom;
+    unsigned int nameHash;
+} OldItem;
+typedef struct
+{
+    char name[50];
+    char description[200];
+    char riddle[200];
+    char answer[50];
+    unsigned int nameHash;
+} OldInteractable;
+typedef struct
+{
+    char name[50];
+    char description[200];
+    int items[10];
+    int itemCount;
+    const Interactable *interactables;
+    int interactableCount;
+    bool isLocked;
+    char keyName[50];
+    int id, north, south, east, west;
+} OldRoom;
+
+// the way string_compare and the command lowercasing used to work, for the benchmark
+static int ToLowerCompare(const char *a, const char *b)
+{
+    for (;; a++, b++)
+    {
+        int d = tolower((unsigned char)*a) - tolower((unsigned char)*b);
+        if (d != 0 || !*a)
+            return d;
+    }
+}
+
+static void ToLowerLoop(char *text)
+{
+    for (int i = 0; text[i]; i++)
+        text[i] = tolower(text[i]);
+}
+
+static double BenchSeconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// old vs new case folding on the world's own names, typed commands and descriptions
+void BenchCaseFolding(World *world)
+{
+    // everything a lookup compares against: item, room and interactable names
+    const char *names[256];
+    int nameCount = 0;
+    for (int i = 0; i < world->itemCount && nameCount < 256; i++)
+        names[nameCount++] = Text(world, world->items[i].name);
+    for (int i = 0; i < world->roomCount && nameCount < 256; i++)
+    {
+        const Room *room = GetRoom(world, i);
+        if (!room)
+            continue;
+        names[nameCount++] = Text(world, room->name);
+        for (int j = 0; j < room->interactableCount && nameCount < 256; j++)
+            names[nameCount++] = Text(world, room->interactables[j].name);
+    }
+    // what players type: mostly lowercase versions of those
+    char typed[256][64];
+    for (int i = 0; i < nameCount; i++)
+    {
+        snprintf(typed[i], sizeof(typed[i]), "%s", names[i]);
+        ToLowerLoop(typed[i]);
+    }
+    const char *commands[] = {"take rusty cog", "combine key part 1 key part 2", "use suspicious fruit kitchen",
+                              "interact jaguar", "TAKE Anti-Rust Solution", "use golden key golden door"};
+    const char *long_text = "A heavily rusted metal cog. Looks like it could fit into some machinery if it wasn't so rusty.";
+    char long_copy[128];
+    snprintf(long_copy, sizeof(long_copy), "%s", long_text);
+    ToLowerLoop(long_copy);
+    volatile int sink = 0;
+    // both sides get called through a pointer like a real out-of-line call, otherwise the compiler
+    // inlines the old loop right here and hoists the tolower table out of it, which the game never gets
+    int (*volatile oldCompare)(const char *, const char *) = ToLowerCompare;
+    int (*volatile newCompare)(const char *, const char *) = string_compare;
+    void (*volatile oldLower)(char *) = ToLowerLoop;
+    void (*volatile newLower)(char *, const char *, size_t) = LowercaseAscii;
+    const int rounds = 20000;
+
+    printf("case folding kernels: %s\n", CaseKernelName());
+    printf("%-34s %12s %12s\n", "", "old ns/call", "new ns/call");
+
+    // every typed name against every name, like the lookups do
+    long calls = (long)rounds * nameCount * nameCount / 10;
+    clock_t start = clock();
+    for (int r = 0; r < rounds / 10; r++)
+        for (int i = 0; i < nameCount; i++)
+            for (int j = 0; j < nameCount; j++)
+                sink += oldCompare(typed[i], names[j]);
+    double old_time = BenchSeconds(start);
+    start = clock();
+    for (int r = 0; r < rounds / 10; r++)
+        for (int i = 0; i < nameCount; i++)
+            for (int j = 0; j < nameCount; j++)
+                sink += newCompare(typed[i], names[j]);
+    double new_time = BenchSeconds(start);
+    printf("%-34s %12.2f %12.2f\n", "string_compare, names", old_time / calls * 1e9, new_time / calls * 1e9);
+
+    // a description against itself (the long equal case)
+    calls = (long)rounds * 50;
+    start = clock();
+    for (long i = 0; i < calls; i++)
+        sink += oldCompare(long_copy, long_text);
+    old_time = BenchSeconds(start);
+    start = clock();
+    for (long i = 0; i < calls; i++)
+        sink += newCompare(long_copy, long_text);
+    new_time = BenchSeconds(start);
+    printf("%-34s %12.2f %12.2f\n", "string_compare, 94 byte text", old_time / calls * 1e9, new_time / calls * 1e9);
+
+    // lowercasing typed commands like DoCommand does
+    int commandCount = sizeof(commands) / sizeof(commands[0]);
+    calls = (long)rounds * 50 * commandCount;
+    char buffer[100];
+    start = clock();
+    for (long i = 0; i < calls; i++)
+    {
+        const char *c = commands[i % commandCount];
+        strcpy(buffer, c);
+        oldLower(buffer);
+        sink += buffer[0];
+    }
+    old_time = BenchSeconds(start);
+    start = clock();
+    for (long i = 0; i < calls; i++)
+    {
+        const char *c = commands[i % commandCount];
+        strcpy(buffer, c);
+        newLower(buffer, buffer, strlen(buffer));
+        sink += buffer[0];
+    }
+    new_time = BenchSeconds(start);
+    printf("%-34s %12.2f %12.2f\n", "lowercase a command", old_time / calls * 1e9, new_time / calls * 1e9);
+    (void)sink;
+}
+
+// print what the world takes in memory now vs. with the old char arrays
+void PrintMemoryReport(World *world)
+{
+    long interactables = 0;
+    for (int i = 0; i < world->roomCount; i++)
+    {
+        const Room *room = GetRoom(world, i);
+        if (room)
+            interactables += room->interactableCount;
+    }
+    const Components *c = &world->parts;
+    int parts = c->riddleCount + c->containerCount + c->lockableCount + c->pushableCount + c->descriptionCount + c->doorCount;
+    long partBytes = (long)c->riddleCount * (long)sizeof(Riddle) + (long)c->containerCount * (long)sizeof(Container) +
+                     (long)c->lockableCount * (long)sizeof(Lockable) + (long)c->pushableCount * (long)sizeof(Pushable) +
+                     (long)c->descriptionCount * (long)sizeof(Description) + (long)c->doorCount * (long)sizeof(Door);
+    long structs = (long)world->itemCount * (long)sizeof(Item) + (long)world->roomCount * (long)sizeof(Room) +
+                   interactables * (long)sizeof(Interactable) + partBytes;
+    long oldStructs = (long)world->itemCount * (long)sizeof(OldItem) + (long)world->roomCount * (long)sizeof(OldRoom) +
+                      interactables * (long)sizeof(OldInteractable);
+    long coldBytes = 0, unpacked = 0;
+    if (world->coldBlockCount > 0)
+    {
+        coldBytes = (long)world->coldOffsets[world->coldBlockCount] + (long)sizeof(unsigned int) * (world->coldBlockCount + 1);
+        for (int i = 0; i < world->coldBlockCount; i++)
+        {
+            if (world->coldCache[i])
+                unpacked += COLD_BLOCK_SIZE + 1;
+        }
+    }
+
+    printf("Items:         %d x %zu bytes (was %zu)\n", world->itemCount, sizeof(Item), sizeof(OldItem));
+    printf("Rooms:         %d x %zu bytes (was %zu)\n", world->roomCount, sizeof(Room), sizeof(OldRoom));
+    printf("Interactables: %ld x %zu bytes (was %zu)\n", interactables, sizeof(Interactable), sizeof(OldInteractable));
+    printf("Components:    %d (%d riddles, %d containers, %d lockables, %d pushables, %d descriptions, %d doors), %ld bytes\n",
+           parts, c->riddleCount, c->containerCount, c->lockableCount, c->pushableCount, c->descriptionCount, c->doorCount,
+           partBytes);
+    printf("String pool:   %u bytes%s\n", world->textSize, world->mapped ? " (mapped, only what gets read is paged in)" : "");
+    printf("Cold text:     %ld bytes in %d compressed blocks, %ld bytes unpacked right now\n", coldBytes, world->coldBlockCount, unpacked);
+    printf("World size:    %ld bytes (was %ld)\n", structs + (long)world->textSize + coldBytes + unpacked, oldStructs);
+
+    // the built-in world is all in the program, a page file only has what's cached or copied out of the file
+    if (!world->slots)
+    {
+        printf("Total:         %ld bytes in memory\n", structs + (long)world->textSize);
+        return;
+    }
+    long resident = (long)sizeof(World) + (long)world->capacity * (long)sizeof(CacheSlot) +
+                    (long)world->lookupSize * (long)sizeof(int) + partBytes + unpacked +
+                    (long)(sizeof(unsigned int) + sizeof(char *)) * (world->coldBlockCount + 1);
+    if (world->loadedItems)
+        resident += (long)world->itemCount * (long)sizeof(Item);
+    if (world->loadedText)
+        resident += (long)world->textSize;
+    if (world->loadedColdData)
+        resident += coldBytes;
+    int cached = 0;
+    if (world->loadedRooms)
+    {
+        resident += (long)world->roomCount * (long)sizeof(Room) + interactables * (long)sizeof(Interactable);
+        cached = world->roomCount;
+    }
+    for (int i = 0; !world->loadedRooms && i < world->used; i++)
+    {
+        const Room *room = world->slots[i].room;
+        if (!room)
+            continue;
+        resident += (long)sizeof(Room) + (long)room->interactableCount * (long)sizeof(Interactable);
+        cached++;
+    }
+    printf("Total:         %ld bytes in memory (%d of %d rooms cached)%s\n", resident, cached, world->roomCount,
+           world->mapped ? ", plus the pages of the file that got read" : "");
+}
+
+// milliseconds since some fixed point, only differences mean anything
+static long long NowMs(void)
+{
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// same in nanoseconds, for timing things that are over in microseconds
+static long long NowNs(void)
+{
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ---------------------------------------------------------------------------
+// Validator
+// Looks over a whole world for the mistakes that otherwise only show up in
+// play: exits into nowhere or that don't lead back, doors whose key can't be
+// had before getting through them, items nobody can ever get to, recipes that
+// need something that doesn't exist or go in circles, and rooms over the 10
+// slot limit. The room by room checks run on several threads, each one with
+// its own slice of the rooms (and its own handle on a page file). What can be
+// reached from the start is worked out afterwards in one pass over a small
+// summary of every room, like a player who tries every door and every recipe.
+// ---------------------------------------------------------------------------
+
+#define MAX_VALIDATOR_THREADS 64
+#define ROOMS_PER_THREAD 4096 // with fewer than this a thread costs more than it saves
+#define MAX_REPORTS 20        // per kind of problem, the rest only gets counted
+
+static const char *const directionNames[4] = {"north", "south", "east", "west"};
+
+// what the validator keeps of a room after looking at it
+typedef struct
+{
+    TextRef name;
+    int exits[4]; // north, south, east, west (NO_ROOM if there's nothing or it's broken)
+    int keyItem;  // -1 if the door isn't locked
+    int items[10];
+    int itemCount;
+    unsigned int problems; // ROOM_... found looking at just this room
+    bool goal;             // the Gold Room, where you win
+} RoomFacts;
+
+// problems a room can have on its own (the exit ones have a bit per direction)
+enum
+{
+    ROOM_UNREADABLE = 1 << 0,
+    ROOM_WRONG_ID = 1 << 1,
+    ROOM_TOO_FULL = 1 << 2,
+    ROOM_BAD_ITEM = 1 << 3,
+    ROOM_ITEM_ELSEWHERE = 1 << 4,
+    ROOM_BAD_KEY = 1 << 5,
+    ROOM_BAD_PART = 1 << 6,
+    ROOM_SAME_NAMES = 1 << 7,
+    ROOM_BAD_EXIT = 1 << 8, // << direction
+    ROOM_ONE_WAY = 1 << 12  // << direction
+};
+
+// the rest of the problem kinds (bits 0-15 are the ROOM_ ones), only for counting what got shown
+enum
+{
+    CHECK_UNREACHABLE = 16,
+    CHECK_LOCKED_OUT,
+    CHECK_ITEM_NEVER,
+    CHECK_ITEM_MISPLACED,
+    CHECK_ITEM_OUT_OF_REACH,
+    CHECK_RECIPE_BROKEN,
+    CHECK_RECIPE_CONFLICT,
+    CHECK_RECIPE_DEAD_END,
+    CHECK_RECIPE_LOOP,
+    CHECK_NO_WIN,
+    CHECK_KINDS
+};
+
+typedef struct
+{
+    FILE *out; // NULL = just count
+    int problems;
+    int shown[CHECK_KINDS];
+} ValidatorReport;
+
+// one thread's share of the rooms
+typedef struct
+{
+    World *world;
+    RoomFacts *facts;
+    int first; // rooms [first, last)
+    int last;
+} ValidatorJob;
+
+static void Problem(ValidatorReport *r, int kind, const char *format, ...)
+{
+    r->problems++;
+    if (!r->out || r->shown[kind]++ >= MAX_REPORTS)
+        return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(r->out, format, args);
+    va_end(args);
+    fputc('\n', r->out);
+}
+
+// parts of room id in a component array that belong to a slot the room doesn't have
+static bool SlotsMissing(const void *parts, int count, size_t size, int id, int things)
+{
+    for (int i = PartBound(parts, count, size, id, 0); i < count; i++)
+    {
+        const ThingId *of = (const ThingId *)((const char *)parts + (size_t)i * size);
+        if (of->room != id)
+            break;
+        if (of->slot >= things)
+            return true;
+    }
+    return false;
+}
+
+// the components of a room make sense: riddles have answers, guards have riddles, every part has its thing
+static bool PartsFit(const World *world, const Room *room, int id)
+{
+    const Components *c = &world->parts;
+    int things = room->interactableCount;
+    if (SlotsMissing(c->riddles, c->riddleCount, sizeof(Riddle), id, things) ||
+        SlotsMissing(c->containers, c->containerCount, sizeof(Container), id, things) ||
+        SlotsMissing(c->lockables, c->lockableCount, sizeof(Lockable), id, things) ||
+        SlotsMissing(c->pushables, c->pushableCount, sizeof(Pushable), id, things) ||
+        SlotsMissing(c->descriptions, c->descriptionCount, sizeof(Description), id, things))
+        return false;
+    for (int i = PartBound(c->riddles, c->riddleCount, sizeof(Riddle), id, 0); i < c->riddleCount && c->riddles[i].of.room == id; i++)
+    {
+        if (!Text(world, c->riddles[i].answer)[0])
+            return false;
+    }
+    for (int i = PartBound(c->containers, c->containerCount, sizeof(Container), id, 0);
+         i < c->containerCount && c->containers[i].of.room == id; i++)
+    {
+        if (c->containers[i].guard >= 0 && !RiddleOf(world, id, c->containers[i].guard))
+            return false;
+    }
+    return true;
+}
+
+// everything that can be checked looking at one room by itself
+static void CheckRoom(const World *world, const Room *room, int id, RoomFacts *f)
+{
+    f->name = room->name;
+    f->goal = strcmp(Text(world, room->name), "Gold Room") == 0;
+    if (room->id != id)
+        f->problems |= ROOM_WRONG_ID;
+    int exits[4] = {room->north, room->south, room->east, room->west};
+    for (int d = 0; d < 4; d++)
+    {
+        bool valid = exits[d] >= 0 && exits[d] < world->roomCount;
+        if (exits[d] != NO_ROOM && !valid)
+            f->problems |= ROOM_BAD_EXIT << d;
+        f->exits[d] = valid ? exits[d] : NO_ROOM;
+    }
+    f->keyItem = -1;
+    if (room->isLocked)
+    {
+        if (room->keyItem >= 0 && room->keyItem < world->itemCount)
+            f->keyItem = room->keyItem;
+        else
+            f->problems |= ROOM_BAD_KEY;
+    }
+
+    if (room->itemCount > 10 || room->interactableCount > 10)
+        f->problems |= ROOM_TOO_FULL;
+    int itemCount = room->itemCount < 10 ? room->itemCount : 10;
+    for (int i = 0; i < itemCount; i++)
+    {
+        int item = room->items[i];
+        if (item < 0 || item >= world->itemCount)
+        {
+            f->problems |= ROOM_BAD_ITEM;
+            continue;
+        }
+        if (world->items[item].homeRoom != id)
+            f->problems |= ROOM_ITEM_ELSEWHERE;
+        f->items[f->itemCount++] = item;
+    }
+    if (!PartsFit(world, room, id))
+        f->problems |= ROOM_BAD_PART;
+    int thingCount = room->interactableCount < 10 ? room->interactableCount : 10;
+    for (int i = 0; i < thingCount; i++)
+    {
+        const Interactable *thing = &room->interactables[i];
+        // FindInteractable always finds the first one
+        for (int j = 0; j < i; j++)
+        {
+            if (room->interactables[j].nameHash == thing->nameHash &&
+                string_compare(Text(world, room->interactables[j].name), Text(world, thing->name)) == 0)
+                f->problems |= ROOM_SAME_NAMES;
+        }
+    }
+}
+
+static void BrokenRoom(RoomFacts *f)
+{
+    f->problems |= ROOM_UNREADABLE;
+    for (int d = 0; d < 4; d++)
+        f->exits[d] = NO_ROOM;
+    f->keyItem = -1;
+}
+
+// first pass: read the job's rooms and check each one
+static void *ReadRoomsJob(void *arg)
+{
+    ValidatorJob *job = arg;
+    World *world = job->world;
+    if (world->tableRooms)
+    {
+        for (int i = job->first; i < job->last; i++)
+            CheckRoom(world, &world->tableRooms[i], i, &job->facts[i]);
+        return NULL;
+    }
+
+    // a page file, read straight through with our own handle (the room cache isn't for sharing)
+    // the offsets come in batches, the records are usually back to back so there's no seeking in between
+    FILE *file = fopen(world->path, "rb");
+    long long offsets[256];
+    Room room;
+    Interactable things[10];
+    for (int i = job->first; i < job->last; i++)
+    {
+        int batch = (i - job->first) % 256;
+        if (batch == 0)
+        {
+            size_t n = job->last - i < 256 ? (size_t)(job->last - i) : 256;
+            if (!file || fseek(file, world->tableOffset + (long)i * (long)sizeof(long long), SEEK_SET) != 0 ||
+                fread(offsets, sizeof(long long), n, file) != n)
+            {
+                for (; i < job->last; i++)
+                    BrokenRoom(&job->facts[i]);
+                break;
+            }
+        }
+        if ((ftell(file) != (long)offsets[batch] && fseek(file, (long)offsets[batch], SEEK_SET) != 0) ||
+            !ReadRoomFields(file, world, &room, things))
+        {
+            BrokenRoom(&job->facts[i]);
+            continue;
+        }
+        CheckRoom(world, &room, i, &job->facts[i]);
+    }
+    if (file)
+        fclose(file);
+    return NULL;
+}
+
+// second pass: every exit has to lead back (north <-> south, east <-> west)
+static void *CheckExitsJob(void *arg)
+{
+    ValidatorJob *job = arg;
+    RoomFacts *facts = job->facts;
+    for (int i = job->first; i < job->last; i++)
+    {
+        for (int d = 0; d < 4; d++)
+        {
+            int to = facts[i].exits[d];
+            if (to != NO_ROOM && !(facts[to].problems & ROOM_UNREADABLE) && facts[to].exits[d ^ 1] != i)
+                facts[i].problems |= ROOM_ONE_WAY << d;
+        }
+    }
+    return NULL;
+}
+
+// run every job, job 0 on this thread and the rest on their own
+static void RunValidatorJobs(ValidatorJob *jobs, int count, void *(*run)(void *))
+{
+#ifndef _WIN32
+    pthread_t threads[MAX_VALIDATOR_THREADS];
+    bool started[MAX_VALIDATOR_THREADS] = {false};
+    for (int i = 1; i < count; i++)
+        started[i] = pthread_create(&threads[i], NULL, run, &jobs[i]) == 0;
+    run(&jobs[0]);
+    for (int i = 1; i < count; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            run(&jobs[i]); // couldn't start a thread, do it here then
+    }
+#else
+    for (int i = 0; i < count; i++)
+        run(&jobs[i]);
+#endif
+}
+
+static void ReportRoom(ValidatorReport *r, const World *world, const RoomFacts *facts, int id)
+{
+    const RoomFacts *f = &facts[id];
+    const char *name = Text(world, f->name);
+    if (f->problems & ROOM_UNREADABLE)
+        Problem(r, 0, "Room %d: its record in the world file is broken", id);
+    if (f->problems & ROOM_WRONG_ID)
+        Problem(r, 1, "Room %d (%s) is stored under the wrong id", id, name);
+    if (f->problems & ROOM_TOO_FULL)
+        Problem(r, 2, "Room %d (%s) has more than 10 items or interactables", id, name);
+    if (f->problems & ROOM_BAD_ITEM)
+        Problem(r, 3, "Room %d (%s) has an item that isn't in the item list", id, name);
+    for (int i = 0; (f->problems & ROOM_ITEM_ELSEWHERE) && i < f->itemCount; i++)
+    {
+        const Item *item = &world->items[f->items[i]];
+        if (item->homeRoom != id)
+            Problem(r, 4, "Room %d (%s) has %s, but that item says it lies in room %d", id, name, Text(world, item->name),
+                    item->homeRoom);
+    }
+    if (f->problems & ROOM_BAD_KEY)
+        Problem(r, 5, "Room %d (%s) is locked, but its key isn't an item", id, name);
+    if (f->problems & ROOM_BAD_PART)
+        Problem(r, 6, "Room %d (%s) has a riddle without an answer, a guard without a riddle or a component for a thing it doesn't have",
+                id, name);
+    if (f->problems & ROOM_SAME_NAMES)
+        Problem(r, 7, "Room %d (%s) has two interactables with the same name, only the first can be used", id, name);
+    for (int d = 0; d < 4; d++)
+    {
+        if (f->problems & (ROOM_BAD_EXIT << d))
+            Problem(r, 8 + d, "Room %d (%s): the %s exit goes to a room that doesn't exist", id, name, directionNames[d]);
+        if (f->problems & (ROOM_ONE_WAY << d))
+            Problem(r, 12 + d, "Room %d (%s): %s goes to %s, which doesn't lead back %s", id, name, directionNames[d],
+                    Text(world, facts[f->exits[d]].name), directionNames[d ^ 1]);
+    }
+}
+
+// the recipe (item, item->combineWith) -> item->resultItem, if it has a working one
+static bool HasRecipe(const World *world, int item)
+{
+    const Item *it = &world->items[item];
+    return it->canCombine && it->combineWith >= 0 && it->combineWith < world->itemCount && it->combineWith != item &&
+           it->resultItem >= 0 && it->resultItem < world->itemCount;
+}
+
+// everything ValidateWorld works with, one entry per room or per item
+typedef struct
+{
+    World *world;
+    ValidatorReport report;
+    RoomFacts *facts;
+    char *roomState;  // 0 = not reached, 1 = reached, 2 = next to a reached room but locked
+    int *roomQueue;
+    int *nextWaiting; // locked rooms waiting on the same key
+    bool *have;       // the item can be had
+    int *itemQueue;
+    int *firstWaiting; // first locked room waiting on this key
+    int *firstUser;    // items that combine with this one (their recipe has it as the second input)
+    int *nextUser;
+    int *firstMaker; // items whose recipe makes this one
+    int *nextMaker;
+    int *listed; // rooms that have the item lying around
+    bool *handedOut; // a component hands the item out (a container, something it gets used on, something pushed)
+    int *count;  // scratch for the recipe loop check
+    char *gone;
+} Validator;
+
+static void Obtain(Validator *v, int item, int *tail)
+{
+    if (!v->have[item])
+    {
+        v->have[item] = true;
+        v->itemQueue[(*tail)++] = item;
+    }
+}
+
+static void Reach(Validator *v, int room, int *tail)
+{
+    v->roomState[room] = 1;
+    v->roomQueue[(*tail)++] = room;
+}
+
+// what the components of a room hand out, all of it as soon as the room is reached
+// (whatever a lockable needs to get used on it isn't checked, nor is the order)
+static void ObtainRewards(Validator *v, int room, int *tail)
+{
+    const Components *c = &v->world->parts;
+    for (int i = PartBound(c->containers, c->containerCount, sizeof(Container), room, 0);
+         i < c->containerCount && c->containers[i].of.room == room; i++)
+    {
+        if (c->containers[i].dropItem >= 0)
+            Obtain(v, c->containers[i].dropItem, tail);
+        if (c->containers[i].bagItem >= 0)
+            Obtain(v, c->containers[i].bagItem, tail);
+    }
+    for (int i = PartBound(c->lockables, c->lockableCount, sizeof(Lockable), room, 0);
+         i < c->lockableCount && c->lockables[i].of.room == room; i++)
+    {
+        if (c->lockables[i].reveals >= 0)
+            Obtain(v, c->lockables[i].reveals, tail);
+    }
+    for (int i = PartBound(c->pushables, c->pushableCount, sizeof(Pushable), room, 0);
+         i < c->pushableCount && c->pushables[i].of.room == room; i++)
+    {
+        if (c->pushables[i].reveals >= 0)
+            Obtain(v, c->pushables[i].reveals, tail);
+    }
+}
+
+// play it through: walk into every room you can, pick up everything, open everything, combine everything
+// and unlock a door once its key is in hand. taking things and using them up doesn't count, this only
+// finds out what can ever be had, not in which order
+static void PlayThrough(Validator *v)
+{
+    World *world = v->world;
+    int roomHead = 0, roomTail = 0, itemHead = 0, itemTail = 0;
+    Reach(v, world->startRoom, &roomTail);
+    while (roomHead < roomTail || itemHead < itemTail)
+    {
+        if (roomHead < roomTail)
+        {
+            int id = v->roomQueue[roomHead++];
+            const RoomFacts *f = &v->facts[id];
+            for (int k = 0; k < f->itemCount; k++)
+                Obtain(v, f->items[k], &itemTail);
+            ObtainRewards(v, id, &itemTail);
+            for (int d = 0; d < 4; d++)
+            {
+                int to = f->exits[d];
+                if (to == NO_ROOM || v->roomState[to] != 0)
+                    continue;
+                int key = v->facts[to].keyItem;
+                if (key == -1 || v->have[key])
+                {
+                    Reach(v, to, &roomTail);
+                    continue;
+                }
+                v->roomState[to] = 2;
+                v->nextWaiting[to] = v->firstWaiting[key];
+                v->firstWaiting[key] = to;
+            }
+            continue;
+        }
+        int item = v->itemQueue[itemHead++];
+        for (int room = v->firstWaiting[item]; room != -1; room = v->nextWaiting[room])
+            Reach(v, room, &roomTail);
+        v->firstWaiting[item] = -1;
+        // the recipes it's in, either way around
+        if (HasRecipe(world, item) && v->have[world->items[item].combineWith])
+            Obtain(v, world->items[item].resultItem, &itemTail);
+        for (int user = v->firstUser[item]; user != -1; user = v->nextUser[user])
+        {
+            if (v->have[user])
+                Obtain(v, world->items[user].resultItem, &itemTail);
+        }
+    }
+}
+
+static void ReportReach(Validator *v)
+{
+    World *world = v->world;
+    bool hasGoal = false, goalReached = false;
+    for (int i = 0; i < world->roomCount; i++)
+    {
+        const RoomFacts *f = &v->facts[i];
+        hasGoal = hasGoal || f->goal;
+        goalReached = goalReached || (f->goal && v->roomState[i] == 1);
+        if (v->roomState[i] == 1 || (f->problems & ROOM_UNREADABLE))
+            continue;
+        const char *name = Text(world, f->name);
+        if (v->roomState[i] == 2)
+        {
+            int key = f->keyItem;
+            bool somewhere = v->listed[key] > 0 || v->firstMaker[key] != -1 || v->handedOut[key];
+            Problem(&v->report, CHECK_LOCKED_OUT, "Room %d (%s) is locked with %s, which %s", i, name,
+                    Text(world, world->items[key].name),
+                    somewhere ? "can't be had without getting in first" : "never shows up anywhere");
+        }
+        else
+        {
+            Problem(&v->report, CHECK_UNREACHABLE, "Room %d (%s) can't be reached from the start", i, name);
+        }
+    }
+    if (!hasGoal)
+        Problem(&v->report, CHECK_NO_WIN, "No room is called Gold Room, nobody can win");
+    else if (!goalReached)
+        Problem(&v->report, CHECK_NO_WIN, "The Gold Room can't be reached, nobody can win");
+}
+
+// where items lie, whether they can be had at all, and what's wrong with their recipes
+static void CheckItems(Validator *v)
+{
+    World *world = v->world;
+    for (int i = 0; i < world->itemCount; i++)
+    {
+        const Item *item = &world->items[i];
+        const char *name = Text(world, item->name);
+        int home = item->homeRoom;
+        bool homeBroken = false; // its room is already reported, nothing more to say about where it lies
+        if (home != NO_ROOM && (home < 0 || home >= world->roomCount))
+            Problem(&v->report, CHECK_ITEM_MISPLACED, "Item %s says it lies in room %d, which doesn't exist", name, home);
+        else if (home != NO_ROOM && (v->facts[home].problems & ROOM_UNREADABLE))
+            homeBroken = true;
+        else if (home != NO_ROOM && v->listed[i] == 0)
+            Problem(&v->report, CHECK_ITEM_MISPLACED, "Item %s says it lies in room %d (%s), but that room doesn't have it",
+                    name, home, Text(world, v->facts[home].name));
+        if (v->listed[i] > 1)
+            Problem(&v->report, CHECK_ITEM_MISPLACED, "Item %s lies in %d rooms at once", name, v->listed[i]);
+        if (!homeBroken && !v->have[i])
+        {
+            if (v->listed[i] == 0 && v->firstMaker[i] == -1 && !v->handedOut[i])
+                Problem(&v->report, CHECK_ITEM_NEVER,
+                        "Item %s never shows up: it doesn't lie anywhere, no recipe makes it and no puzzle hands it out", name);
+            else
+                Problem(&v->report, CHECK_ITEM_OUT_OF_REACH, "Item %s can never be had, everywhere it comes from is out of reach",
+                        name);
+        }
+
+        if (!item->canCombine)
+            continue;
+        if (!HasRecipe(world, i))
+        {
+            Problem(&v->report, CHECK_RECIPE_BROKEN, "Item %s combines with item %d into item %d, %s", name,
+                    item->combineWith, item->resultItem,
+                    item->combineWith == i ? "which is itself" : "one of those doesn't exist");
+            continue;
+        }
+        const Item *with = &world->items[item->combineWith];
+        if (with->canCombine && with->combineWith == i && with->resultItem != item->resultItem && i < item->combineWith)
+            Problem(&v->report, CHECK_RECIPE_CONFLICT, "Combining %s and %s makes %s or %s, depending on which comes first",
+                    name, Text(world, with->name), Text(world, world->items[item->resultItem].name),
+                    Text(world, world->items[with->resultItem].name));
+        if (v->have[i] && !v->have[item->combineWith])
+            Problem(&v->report, CHECK_RECIPE_DEAD_END, "Item %s combines with %s, which can never be had", name,
+                    Text(world, with->name));
+    }
+}
+
+static void TakeOut(Validator *v, int item, int *tail)
+{
+    if (!v->gone[item] && --v->count[item] == 0)
+    {
+        v->gone[item] = 1;
+        v->itemQueue[(*tail)++] = item;
+    }
+}
+
+// recipes that go in circles: keep taking out items that no recipe left over makes, then items
+// that no recipe left over needs. whatever is still there is part of a loop
+static void CheckRecipeLoops(Validator *v)
+{
+    World *world = v->world;
+    int itemCount = world->itemCount;
+    int head = 0, tail = 0;
+    for (int i = 0; i < itemCount; i++)
+    {
+        v->count[i] = 0;
+        v->gone[i] = 0;
+    }
+    for (int i = 0; i < itemCount; i++)
+    {
+        if (HasRecipe(world, i))
+            v->count[world->items[i].resultItem] += 2; // made out of two things
+    }
+    for (int i = 0; i < itemCount; i++)
+    {
+        if (v->count[i] == 0)
+        {
+            v->gone[i] = 1;
+            v->itemQueue[tail++] = i;
+        }
+    }
+    while (head < tail)
+    {
+        int item = v->itemQueue[head++];
+        if (HasRecipe(world, item))
+            TakeOut(v, world->items[item].resultItem, &tail);
+        for (int user = v->firstUser[item]; user != -1; user = v->nextUser[user])
+            TakeOut(v, world->items[user].resultItem, &tail);
+    }
+
+    // now from the other end, only counting what's still there
+    head = tail = 0;
+    for (int i = 0; i < itemCount; i++)
+        v->count[i] = 0;
+    for (int i = 0; i < itemCount; i++)
+    {
+        if (!HasRecipe(world, i) || v->gone[world->items[i].resultItem])
+            continue;
+        v->count[i] += !v->gone[i];
+        v->count[world->items[i].combineWith] += !v->gone[world->items[i].combineWith];
+    }
+    for (int i = 0; i < itemCount; i++)
+    {
+        if (!v->gone[i] && v->count[i] == 0)
+        {
+            v->gone[i] = 1;
+            v->itemQueue[tail++] = i;
+        }
+    }
+    while (head < tail)
+    {
+        int item = v->itemQueue[head++];
+        for (int maker = v->firstMaker[item]; maker != -1; maker = v->nextMaker[maker])
+        {
+            TakeOut(v, maker, &tail);
+            TakeOut(v, world->items[maker].combineWith, &tail);
+        }
+    }
+    for (int i = 0; i < itemCount; i++)
+    {
+        if (!v->gone[i])
+            Problem(&v->report, CHECK_RECIPE_LOOP, "Item %s can be made out of itself (recipe loop)", Text(world, world->items[i].name));
+    }
+}
+
+// check the whole world, threads = 0 means one per core (but not for tiny worlds)
+// prints what's wrong to report (NULL = nowhere), returns how many problems there are (-1 = out of memory)
+int ValidateWorld(World *world, int threads, FILE *report)
+{
+    long long start = NowMs();
+    int roomCount = world->roomCount;
+    int itemCount = world->itemCount;
+    if (threads <= 0)
+    {
+#ifndef _WIN32
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+        threads = 1;
+#endif
+        int enough = (roomCount + ROOMS_PER_THREAD - 1) / ROOMS_PER_THREAD;
+        if (threads > enough)
+            threads = enough;
+    }
+    if (threads > roomCount)
+        threads = roomCount;
+    if (threads > MAX_VALIDATOR_THREADS)
+        threads = MAX_VALIDATOR_THREADS;
+    if (threads < 1)
+        threads = 1;
+
+    Validator v = {0};
+    v.world = world;
+    v.report.out = report;
+    size_t items = (size_t)itemCount + 1; // + 1 so a world without items still gets its arrays
+    v.facts = MemCalloc(MEM_WORLD, roomCount, sizeof(RoomFacts));
+    v.roomState = MemCalloc(MEM_WORLD, roomCount, 1);
+    v.roomQueue = MemAlloc(MEM_WORLD, sizeof(int) * roomCount);
+    v.nextWaiting = MemAlloc(MEM_WORLD, sizeof(int) * roomCount);
+    v.have = MemCalloc(MEM_WORLD, items, sizeof(bool));
+    v.itemQueue = MemAlloc(MEM_WORLD, sizeof(int) * items);
+    v.firstWaiting = MemAlloc(MEM_WORLD, sizeof(int) * items);
+    v.firstUser = MemAlloc(MEM_WORLD, sizeof(int) * items);
+    v.nextUser = MemAlloc(MEM_WORLD, sizeof(int) * items);
+    v.firstMaker = MemAlloc(MEM_WORLD, sizeof(int) * items);
+    v.nextMaker = MemAlloc(MEM_WORLD, sizeof(int) * items);
+    v.listed = MemCalloc(MEM_WORLD, items, sizeof(int));
+    v.handedOut = MemCalloc(MEM_WORLD, items, sizeof(bool));
+    v.count = MemAlloc(MEM_WORLD, sizeof(int) * items);
+    v.gone = MemAlloc(MEM_WORLD, items);
+    bool ok = v.facts && v.roomState && v.roomQueue && v.nextWaiting && v.have && v.itemQueue && v.firstWaiting &&
+              v.firstUser && v.nextUser && v.firstMaker && v.nextMaker && v.listed && v.handedOut && v.count && v.gone;
+    if (!ok)
+    {
+        perror("Memory fail - can't validate the world");
+        v.report.problems = -1;
+    }
+
+    if (ok)
+    {
+        // rooms on their own, then the exits between them
+        CaseKernelName(); // picks the case folding kernels now instead of on several threads at once
+        ValidatorJob jobs[MAX_VALIDATOR_THREADS];
+        for (int i = 0; i < threads; i++)
+        {
+            jobs[i].world = world;
+            jobs[i].facts = v.facts;
+            jobs[i].first = (int)((long long)roomCount * i / threads);
+            jobs[i].last = (int)((long long)roomCount * (i + 1) / threads);
+        }
+        RunValidatorJobs(jobs, threads, ReadRoomsJob);
+        RunValidatorJobs(jobs, threads, CheckExitsJob);
+        for (int i = 0; i < roomCount; i++)
+        {
+            ReportRoom(&v.report, world, v.facts, i);
+            for (int k = 0; k < v.facts[i].itemCount; k++)
+                v.listed[v.facts[i].items[k]]++;
+        }
+
+        // who combines with whom and what makes what
+        for (int i = 0; i < itemCount; i++)
+        {
+            v.firstWaiting[i] = -1;
+            v.firstUser[i] = -1;
+            v.firstMaker[i] = -1;
+        }
+        for (int i = 0; i < itemCount; i++)
+        {
+            if (!HasRecipe(world, i))
+                continue;
+            int with = world->items[i].combineWith;
+            int result = world->items[i].resultItem;
+            v.nextUser[i] = v.firstUser[with];
+            v.firstUser[with] = i;
+            v.nextMaker[i] = v.firstMaker[result];
+            v.firstMaker[result] = i;
+        }
+        const Components *c = &world->parts;
+        for (int i = 0; i < c->containerCount; i++)
+        {
+            if (c->containers[i].dropItem >= 0)
+                v.handedOut[c->containers[i].dropItem] = true;
+            if (c->containers[i].bagItem >= 0)
+                v.handedOut[c->containers[i].bagItem] = true;
+        }
+        for (int i = 0; i < c->lockableCount; i++)
+        {
+            if (c->lockables[i].reveals >= 0)
+                v.handedOut[c->lockables[i].reveals] = true;
+        }
+        for (int i = 0; i < c->pushableCount; i++)
+        {
+            if (c->pushables[i].reveals >= 0)
+                v.handedOut[c->pushables[i].reveals] = true;
+        }
+        PlayThrough(&v);
+        ReportReach(&v);
+        CheckItems(&v);
+        CheckRecipeLoops(&v);
+    }
+
+    if (report && ok)
+    {
+        int hidden = 0;
+        for (int k = 0; k < CHECK_KINDS; k++)
+            hidden += v.report.shown[k] > MAX_REPORTS ? v.report.shown[k] - MAX_REPORTS : 0;
+        if (hidden > 0)
+            fprintf(report, "... and %d more (only the first %d of each kind are shown)\n", hidden, MAX_REPORTS);
+        fprintf(report, "Checked %d rooms and %d items with %d thread%s in %lld ms: ", roomCount, itemCount, threads,
+                threads == 1 ? "" : "s", NowMs() - start);
+        if (v.report.problems == 0)
+            fprintf(report, "no problems\n");
+        else
+            fprintf(report, "%d problem%s\n", v.report.problems, v.report.problems == 1 ? "" : "s");
+    }
+    MemFree(v.facts);
+    MemFree(v.roomState);
+    MemFree(v.roomQueue);
+    MemFree(v.nextWaiting);
+    MemFree(v.have);
+    MemFree(v.itemQueue);
+    MemFree(v.firstWaiting);
+    MemFree(v.firstUser);
+    MemFree(v.nextUser);
+    MemFree(v.firstMaker);
+    MemFree(v.nextMaker);
+    MemFree(v.listed);
+    MemFree(v.handedOut);
+    MemFree(v.count);
+    MemFree(v.gone);
+    return v.report.problems;
+}
+
+// combine two items in inventory
+bool MergeItems(World *world, Session *s, const char *item1, const char *item2)
+{
+    Inventory *inv = &s->inv;
+    int index1 = -1, index2 = -1;
+    for (int i = 0; i < inv->count; i++)
+    {
+        if (string_compare(Text(world, world->items[inv->items[i]].name), item1) == 0)
+        {
+            index1 = i;
+        }
+        if (string_compare(Text(world, world->items[inv->items[i]].name), item2) == 0)
+        {
+            index2 = i;
+        }
+    }
+    if (index1 == -1 || index2 == -1)
+    {
+        NoteFailure(s, false);
+        Say(s, "You don't have both those things to combine.\n");
+        return false;
+    }
+    // check if items can be combined
+    const Item *first = &world->items[inv->items[index1]];
+    const Item *second = &world->items[inv->items[index2]];
+    const char *message;
+    int resultId;
+    if (first->canCombine && first->combineWith == inv->items[index2])
+    {
+        message = "Sweet! Combined %s and %s to make a %s!\n";
+        resultId = first->resultItem;
+    }
+    else if (second->canCombine && second->combineWith == inv->items[index1])
+    {
+        message = "Nice! Combined %s and %s to make a %s!\n";
+        resultId = second->resultItem;
+    }
+    else
+    {
+        resultId = -1;
+    }
+    if (resultId < 0 || resultId >= world->itemCount)
+    {
+        NoteFailure(s, false);
+        Say(s, "Nope, those things don't work together.\n");
+        return false;
+    }
+    // both parts are used up, the result goes in the bag (there's always space since two slots just freed up)
+    DeleteItemFromBag(world, s, item1);
+    DeleteItemFromBag(world, s, item2);
+    AddToBag(s, resultId);
+    Say(s, message, item1, item2, Text(world, world->items[resultId].name));
+    return true;
+}
+
+// a text from the world on a line of its own, nothing if it's 0
+static void SayText(const World *world, const Session *s, TextRef text)
+{
+    if (text)
+        Say(s, "%s\n", Text(world, text));
+}
+
+// switch a thing over to one of its looks, if it has that one
+static void SetLook(const World *world, Session *s, int roomId, int slot, int look)
+{
+    if (ThingText(world, roomId, slot, look))
+        SetDescription(s, roomId, slot, look);
+}
+
+// the Container system: open it once (after its guard's riddle), what's inside drops or goes in the bag
+static void OpenContainer(const World *world, Session *s, const Room *room, const Container *box)
+{
+    int slot = box->of.slot;
+    if (box->guard >= 0 && !HasInteracted(s, room->id, box->guard))
+    {
+        NoteFailure(s, true);
+        SayText(world, s, box->guarded);
+        return;
+    }
+    if (HasUsed(s, room->id, slot))
+    {
+        SayText(world, s, box->empty);
+        return;
+    }
+    SayText(world, s, box->open);
+    if (box->dropItem >= 0)
+        PutItemInRoom(world, s, room, box->dropItem);
+    if (box->bagItem >= 0)
+    {
+        if (s->inv.count < s->inv.capacity)
+        {
+            AddToBag(s, box->bagItem);
+            SayText(world, s, box->grab);
+        }
+        else
+        {
+            // it's out of the container either way, it lands on the floor
+            SayText(world, s, box->full);
+            PutItemInRoom(world, s, room, box->bagItem);
+        }
+    }
+    SetUsed(s, room->id, slot);
+    SetLook(world, s, room->id, slot, LOOK_USED);
+}
+
+// the Lockable system: the item fits, so it does its thing (or says it already did)
+static void UseOn(const World *world, Session *s, const Room *room, const Lockable *lock, const char *itemName)
+{
+    int slot = lock->of.slot;
+    if (lock->done && HasUsed(s, room->id, slot))
+    {
+        SayText(world, s, lock->done);
+        return;
+    }
+    SayText(world, s, lock->use);
+    if (lock->usesUp)
+        DeleteItemFromBag(world, s, itemName);
+    if (lock->reveals >= 0)
+        PutItemInRoom(world, s, room, lock->reveals);
+    // only the once only kind has to remember it
+    if (lock->done)
+        SetUsed(s, room->id, slot);
+    SetLook(world, s, room->id, slot, LOOK_USED);
+    // something more happens a while later (the machine winds down)
+    if (lock->laterSeconds > 0)
+    {
+        long long delay = (long long)lock->laterSeconds * (1000 / TICK_MS);
+        if (lock->later)
+        {
+            TimerEvent later = {EVENT_ROOM_MESSAGE, room->id, slot, SAY_LATER, 0};
+            ScheduleTimer(s, delay, later);
+        }
+        if (ThingText(world, room->id, slot, LOOK_LATER))
+        {
+            TimerEvent looks = {EVENT_DESCRIPTION, room->id, slot, LOOK_LATER, 0};
+            ScheduleTimer(s, delay, looks);
+        }
+    }
+}
+
+// interact with a thing, what happens comes from its components: a riddle gets asked until it
+// has its answer, a container opens, anything else just gets looked at
+void DoInteract(World *world, Session *s, const char *objectName)
+{
+    const Room *currentRoom = GetRoom(world, s->room);
+    int i = FindInteractable(world, currentRoom, objectName);
+    if (i == -1)
+    {
+        NoteFailure(s, false);
+        Say(s, "There's no %s here to mess with.\n", objectName);
+        return;
+    }
+    Say(s, "You check out the %s.\n", objectName);
+    const Riddle *riddle = RiddleOf(world, currentRoom->id, i);
+    const Container *box = ContainerOf(world, currentRoom->id, i);
+    if (riddle && !HasInteracted(s, currentRoom->id, i))
+    {
+        if (riddle->ask)
+        {
+            SayText(world, s, riddle->ask);
+        }
+        else
+        {
+            Say(s, "%s\n", InteractableDescription(world, s, currentRoom, i));
+            Say(s, "Words are carved into the %s:\n", objectName);
+        }
+        Say(s, "\"%s\"\n", Text(world, riddle->riddle));
+        // the answer is the next line the player types (see AnswerRiddle)
+        Say(s, "What's your answer? ");
+        s->riddleSlot = i;
+    }
+    else if (box)
+    {
+        OpenContainer(world, s, currentRoom, box);
+    }
+    else
+    {
+        Say(s, "%s\n", InteractableDescription(world, s, currentRoom, i));
+    }
+}
+
+// a line typed while a riddle waits for an answer, its first word is the answer
+// (a line without words doesn't count, the riddle keeps waiting)
+void AnswerRiddle(World *world, Session *s, const char *line)
+{
+    char answer[50];
+    if (sscanf(line, "%49s", answer) != 1)
+        return;
+    const Room *currentRoom = GetRoom(world, s->room);
+    int slot = s->riddleSlot;
+    s->riddleSlot = -1;
+    const Riddle *riddle = RiddleOf(world, currentRoom->id, slot);
+    if (!riddle)
+        return;
+    if (string_compare(answer, Text(world, riddle->answer)) != 0)
+    {
+        NoteFailure(s, false);
+        if (riddle->wrong)
+            SayText(world, s, riddle->wrong);
+        else
+            Say(s, "Nothing happens. That wasn't it.\n");
+        return;
+    }
+    if (riddle->right)
+        SayText(world, s, riddle->right);
+    else
+        Say(s, "Something clicks inside the %s. That was right.\n", Text(world, currentRoom->interactables[slot].name));
+    // whatever it guarded can be opened now
+    const Container *boxes = world->parts.containers;
+    int count = world->parts.containerCount;
+    for (int i = PartBound(boxes, count, sizeof(Container), currentRoom->id, 0); i < count && boxes[i].of.room == currentRoom->id; i++)
+    {
+        if (boxes[i].guard == slot)
+            SetLook(world, s, currentRoom->id, boxes[i].of.slot, LOOK_READY);
+    }
+    SetInteracted(s, currentRoom->id, slot);
+}
+
+// Use an item on a target: a thing in the room it fits (Lockable) or a locked door
+void DoUseItem(World *world, Session *s, const char *itemName, const char *targetName)
+{
+    const Room *currentRoom = GetRoom(world, s->room);
+    int bagIndex = FindInBag(world, &s->inv, itemName);
+    if (bagIndex == -1)
+    {
+        NoteFailure(s, false);
+        Say(s, "You don't have a %s to use.\n", itemName);
+        return;
+    }
+    int itemId = s->inv.items[bagIndex]; // not FindItemId, that goes through the whole catalog
+    int slot = FindInteractable(world, currentRoom, targetName);
+    const Lockable *lock = slot != -1 ? LockableOf(world, currentRoom->id, slot) : NULL;
+    if (lock && (lock->key == itemId || lock->otherKey == itemId))
+    {
+        UseOn(world, s, currentRoom, lock, itemName);
+        return;
+    }
+    // a locked door opens with the key it was made for, by direction ("use Iron Key north door")
+    // or by its name if it has one ("use Golden Key golden door")
+    int exits[4] = {currentRoom->north, currentRoom->south, currentRoom->east, currentRoom->west};
+    for (int d = 0; d < 4; d++)
+    {
+        if (exits[d] == NO_ROOM)
+            continue;
+        char door[16];
+        snprintf(door, sizeof(door), "%s door", directionNames[d]);
+        const Door *named = DoorOf(world, exits[d]);
+        bool byName = named && named->name && string_compare(targetName, Text(world, named->name)) == 0;
+        if (!byName && string_compare(targetName, door) != 0)
+            continue;
+        const Room *next = GetRoom(world, exits[d]);
+        if (!next || !RoomLocked(s, next))
+        {
+            NoteFailure(s, false);
+            Say(s, "The %s isn't locked.\n", targetName);
+            return;
+        }
+        if (next->keyItem != itemId)
+        {
+            NoteFailure(s, false);
+            Say(s, "The %s doesn't fit the lock.\n", itemName);
+            return;
+        }
+        if (named && named->opens)
+            SayText(world, s, named->opens);
+        else
+            Say(s, "You turn the %s in the lock and the door swings open!\n", itemName);
+        UnlockRoom(s, next->id);
+        DeleteItemFromBag(world, s, itemName);
+        return;
+    }
+    NoteFailure(s, false);
+    Say(s, "You can't use %s on %s.\n", itemName, targetName);
+}
+
+// Log player actions
+void WriteToLog(FILE *logFile, const char *action, const char *result)
+{
+    if (!logFile)
+        return;
+    // localtime goes and checks the timezone file every time, only do it when the second changes
+    static time_t last = -1;
+    static char timestamp[20];
+    time_t now = time(NULL);
+    if (now != last)
+    {
+        struct tm *timeinfo = localtime(&now);
+        strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", timeinfo);
+        last = now;
+    }
+    fprintf(logFile, "[%s] %s: %s\n", timestamp, action, result);
+    // a script can wait for the buffer to fill up, a person looking at the log wants it now
+    if (Interactive())
+        fflush(logFile);
+}
+
+// walk through an exit, the next room gets loaded from the world if it isn't in memory
+void GoThroughExit(World *world, Session *s, int exitId, const char *direction, char *result)
+{
+    const Room *next = exitId != NO_ROOM ? GetRoom(world, exitId) : NULL;
+    if (next == NULL)
+    {
+        sprintf(result, "You can't go %s from here.", direction);
+        Say(s, "%s\n", result);
+        NoteFailure(s, false);
+    }
+    else if (RoomLocked(s, next))
+    {
+        sprintf(result, "The door to the %s is locked.", direction);
+        Say(s, "%s\n", result);
+        NoteFailure(s, true);
+    }
+    else
+    {
+        // keep the room we're standing in around, let the old one be evicted
+        SetRoom(world, s, next->id);
+        sprintf(result, "Moved %s to %s", direction, Text(world, next->name));
+        Say(s, "%s\n", Text(world, next->description));
+    }
+}
+
+// Process player commands
+void DoCommand(char *command, World *world, Session *s, bool *gameRunning, bool *hasWon, FILE *logFile)
+{
+    // a riddle asked something, this line is the answer and not a command
+    if (s->riddleSlot >= 0)
+    {
+        StartUndoStep(s, command);
+        AnswerRiddle(world, s, command);
+        EndUndoStep(s);
+        WriteToLog(logFile, command, s->riddleSlot >= 0 ? "Gave no answer" : "Answered the riddle");
+        return;
+    }
+    char cmd[100] = "";
+    char param1[100] = "";
+    char param2[100] = "";
+    // Convert command to lowercase
+    LowercaseAscii(command, command, strlen(command));
+    // Parse command
+    int params = sscanf(command, "%s %s %[^\n]", cmd, param1, param2);
+    char result[256] = "";
+    // the room we're in is pinned, so this pointer is good for the whole command
+    const Room *currentRoom = GetRoom(world, s->room);
+    // what this command changes can be taken back (undo and redo themselves don't count)
+    if (strcmp(cmd, "undo") != 0 && strcmp(cmd, "redo") != 0)
+        StartUndoStep(s, command);
+
+    // navigation commands
+    if (strcmp(cmd, "north") == 0 || strcmp(cmd, "n") == 0)
+    {
+        GoThroughExit(world, s, currentRoom->north, "north", result);
+    }
+    else if (strcmp(cmd, "south") == 0 || strcmp(cmd, "s") == 0)
+    {
+        GoThroughExit(world, s, currentRoom->south, "south", result);
+    }
+    else if (strcmp(cmd, "east") == 0 || strcmp(cmd, "e") == 0)
+    {
+        GoThroughExit(world, s, currentRoom->east, "east", result);
+    }
+    else if (strcmp(cmd, "west") == 0 || strcmp(cmd, "w") == 0)
+    {
+        GoThroughExit(world, s, currentRoom->west, "west", result);
+    }
+    // Inventory commands
+    else if (strcmp(cmd, "inventory") == 0 || strcmp(cmd, "i") == 0)
+    {
+        ShowInventory(world, s);
+        sprintf(result, "Displayed inventory");
+    }
+    else if (strcmp(cmd, "pick") == 0 && strcmp(param1, "up") == 0)
+    {
+        char *itemName = command + strlen("pick up ");
+        while (*itemName == ' ')
+            itemName++;
+        if (!GetItem(world, s, itemName))
+            *gameRunning = false;
+        sprintf(result, "Attempted to pick up %s", itemName);
+    }
+    else if (strcmp(cmd, "take") == 0 && params >= 2)
+    {
+        char *itemName = command + strlen("take ");
+        while (*itemName == ' ')
+            itemName++;
+        if (!GetItem(world, s, itemName))
+            *gameRunning = false;
+        sprintf(result, "Attempted to take %s", itemName);
+    }
+    else if (strcmp(cmd, "drop") == 0 && params >= 2)
+    {
+        char *itemName = command + strlen("drop ");
+        while (*itemName == ' ')
+            itemName++;
+        ThrowItem(world, s, itemName);
+        sprintf(result, "Attempted to drop %s", itemName);
+    }
+    else if (strcmp(cmd, "examine") == 0 && params >= 2)
+    {
+        char *itemName = command + strlen("examine ");
+        while (*itemName == ' ')
+            itemName++;
+        LookAtItem(world, s, itemName);
+        sprintf(result, "Examined %s", itemName);
+    }
+    else if (strcmp(cmd, "interact") == 0 && params >= 2)
+    {
+        char *objectName = command + strlen("interact ");
+        while (*objectName == ' ')
+            objectName++;
+        DoInteract(world, s, objectName);
+        sprintf(result, "Interacted with %s", objectName);
+    }
+    else if (strcmp(cmd, "use") == 0 && params >= 3)
+    {
+        char *args = command + strlen("use ");
+        while (*args == ' ')
+            args++;
+        char *lastSpace = strrchr(args, ' ');
+        if (lastSpace)
+        {
+            char *itemName, *targetName;
+            char fixedTarget[100];
+            *lastSpace = '\0';
+            itemName = args;
+            targetName = lastSpace + 1;
+            while (*targetName == ' ')
+                targetName++;
+
+            // Fix for known multi-word targets
+            if (
+                (strcmp(targetName, "door") == 0 || strcmp(targetName, "pane") == 0))
+            {
+                // Move the last word from itemName to targetName
+                char *secondLastSpace = strrchr(itemName, ' ');
+                if (secondLastSpace)
+                {
+                    *secondLastSpace = '\0';
+                    // Prepend the last word to targetName
+                    snprintf(fixedTarget, sizeof(fixedTarget), "%s %s", secondLastSpace + 1, targetName);
+                    targetName = fixedTarget;
+                }
+            }
+
+            DoUseItem(world, s, itemName, targetName);
+            sprintf(result, "Used %s on %s", itemName, targetName);
+        }
+        else
+        {
+            NoteFailure(s, false);
+            Say(s, "Usage: use [item] [target]\n");
+            sprintf(result, "Incorrect use command");
+        }
+    }
+    else if (strcmp(cmd, "combine") == 0 && params >= 3)
+    {
+        char *args = command + strlen("combine ");
+        while (*args == ' ')
+            args++;
+
+        // Find the split point (the space between the two items)
+        // We'll split at the first space that is followed by a word that matches an item in inventory
+        // But for simplicity, split at the middle space
+        char *split = NULL;
+        int spaceCount = 0;
+        for (char *p = args; *p; ++p)
+        {
+            if (*p == ' ')
+                spaceCount++;
+        }
+        if (spaceCount == 0)
+        {
+            NoteFailure(s, false);
+            Say(s, "Usage: combine [item1] [item2]\n");
+            sprintf(result, "Incorrect combine command");
+        }
+        else
+        {
+            int mid = spaceCount / 2;
+            int count = 0;
+            for (char *p = args; *p; ++p)
+            {
+                if (*p == ' ')
+                {
+                    if (count == mid)
+                    {
+                        split = p;
+                        break;
+                    }
+                    count++;
+                }
+            }
+            if (split)
+            {
+                *split = '\0';
+                char *item1 = args;
+                char *item2 = split + 1;
+                while (*item2 == ' ')
+                    item2++;
+                MergeItems(world, s, item1, item2);
+                sprintf(result, "Combined %s with %s", item1, item2);
+            }
+            else
+            {
+                NoteFailure(s, false);
+                Say(s, "Usage: combine [item1] [item2]\n");
+                sprintf(result, "Incorrect combine command");
+            }
+        }
+    }
+    else if (strcmp(cmd, "push") == 0 && params >= 2)
+    {
+        char *objectName = command + strlen("push ");
+        while (*objectName == ' ')
+            objectName++;
+        int slot = FindInteractable(world, currentRoom, objectName);
+        const Pushable *push = slot != -1 ? PushableOf(world, currentRoom->id, slot) : NULL;
+        if (push && !HasUsed(s, currentRoom->id, slot))
+        {
+            SayText(world, s, push->push);
+            if (push->reveals >= 0)
+                PutItemInRoom(world, s, currentRoom, push->reveals);
+            SetUsed(s, currentRoom->id, slot);
+            SetLook(world, s, currentRoom->id, slot, LOOK_USED);
+            snprintf(result, sizeof(result), "Pushed %s, revealed %s", objectName,
+                     push->reveals >= 0 ? Text(world, world->items[push->reveals].name) : "nothing");
+        }
+        else if (push)
+        {
+            // there's only one of what was behind it, pushing again doesn't make a new one
+            SayText(world, s, push->again);
+            sprintf(result, "Pushed %s again", objectName);
+        }
+        else
+        {
+            NoteFailure(s, false);
+            Say(s, "You can't push that here.\n");
+            sprintf(result, "Attempted to push %s", objectName);
+        }
+    }
+    else if (strcmp(cmd, "look") == 0)
+    {
+        Say(s, "You are in %s.\n", Text(world, currentRoom->name));
+        Say(s, "%s\n", Text(world, currentRoom->description));
+        Say(s, "Exits: ");
+        bool hasExits = false;
+        if (currentRoom->north != NO_ROOM)
+        {
+            Say(s, "north");
+            hasExits = true;
+        }
+        if (currentRoom->south != NO_ROOM)
+        {
+            if (hasExits)
+                Say(s, ", ");
+            Say(s, "south");
+            hasExits = true;
+        }
+        if (currentRoom->east != NO_ROOM)
+        {
+            if (hasExits)
+                Say(s, ", ");
+            Say(s, "east");
+            hasExits = true;
+        }
+        if (currentRoom->west != NO_ROOM)
+        {
+            if (hasExits)
+                Say(s, ", ");
+            Say(s, "west");
+            hasExits = true;
+        }
+        Say(s, "\n");
+        int roomItems[10];
+        int roomItemCount = RoomItems(world, s, currentRoom, roomItems);
+        if (roomItemCount > 0)
+        {
+            Say(s, "Items in the room:\n");
+            for (int i = 0; i < roomItemCount; i++)
+            {
+                Say(s, "- %s\n", Text(world, world->items[roomItems[i]].name));
+            }
+        }
+        if (currentRoom->interactableCount > 0)
+        {
+            Say(s, "You can interact with:\n");
+            for (int i = 0; i < currentRoom->interactableCount; i++)
+            {
+                Say(s, "- %s\n", Text(world, currentRoom->interactables[i].name));
+            }
+        }
+        sprintf(result, "Looked around");
+    }
+    // Help command
+    else if (strcmp(cmd, "help") == 0)
+    {
+        Say(s, "Available commands:\n");
+        Say(s, "- north/n, south/s, east/e, west/w: Move in a direction\n");
+        Say(s, "- look: Look around the room\n");
+        Say(s, "- inventory/i: Check your inventory\n");
+        Say(s, "- take [item] or pick up [item]: Take an item from the room\n");
+        Say(s, "- drop [item]: Drop an item from your inventory\n");
+        Say(s, "- examine [item]: Look at an item in your inventory\n");
+        Say(s, "- interact [object]: Interact with an object in the room\n");
+        Say(s, "- use [item] [target]: Use an item on a target\n");
+        Say(s, "- combine [item1] [item2]: Combine two items in your inventory\n");
+        Say(s, "- push [object]: Push an object in the room\n");
+        Say(s, "- undo / redo: Take back what you just did, or do it again\n");
+        Say(s, "- memstats: See how much memory the game is using\n");
+        Say(s, "- hint: What to do next\n");
+        Say(s, "- suggest [start of a command]: List the ways it could be finished (Tab does it at the prompt)\n");
+        Say(s, "- quit: Exit the game\n");
+        sprintf(result, "Displayed help");
+    }
+    // take back what the last command did, or do it again
+    else if (strcmp(cmd, "undo") == 0)
+    {
+        sprintf(result, Undo(world, s) ? "Undid a command" : "Nothing to undo");
+    }
+    else if (strcmp(cmd, "redo") == 0)
+    {
+        sprintf(result, Redo(world, s) ? "Redid a command" : "Nothing to redo");
+    }
+    // Memory numbers
+    else if (strcmp(cmd, "memstats") == 0)
+    {
+        PrintMemStats(s);
+        sprintf(result, "Showed memory stats");
+    }
+    // the next step towards the Gold Room, from the hint table
+    else if (strcmp(cmd, "hint") == 0)
+    {
+        GiveHint(world, s);
+        sprintf(result, "Asked for a hint");
+    }
+    // what could come next, for front ends that do their own completion
+    else if (strcmp(cmd, "suggest") == 0)
+    {
+        char *typed = command + strlen("suggest");
+        if (*typed == ' ')
+            typed++;
+        ListSuggestions(s, typed);
+        sprintf(result, "Suggested for '%s'", typed);
+    }
+    // Quit commands
+    else if (strcmp(cmd, "quit") == 0)
+    {
+        Say(s, "Thanks for playing!\n");
+        *gameRunning = false;
+        sprintf(result, "Quit game");
+    }
+    // Special case for winning
+    else if (strcmp(cmd, "win") == 0 && strcmp(Text(world, currentRoom->name), "Gold Room") == 0)
+    {
+        SayWinArt(s);
+        Say(s, "Congratulations!\n");
+        Say(s, "You've unlocked the secrets of the temple and won the game!\n");
+        *hasWon = true;
+        *gameRunning = false;
+        sprintf(result, "Won the game");
+    }
+    else
+    {
+        Say(s, "Unknown command. Type 'help' for a list of commands.\n");
+        sprintf(result, "Unknown command");
+        if (s->machine)
+            s->machine->unknownCommand = true;
+    }
+    EndUndoStep(s);
+    WriteToLog(logFile, command, result);
+}
+
+// the big letters, only for people (programs get the sentence that comes after)
+void SayWinArt(const Session *s)
+{
+    if (s->machine)
+        return;
+    Say(s, "\n");
+    Say(s, " ██╗   ██╗ ██████╗ ██╗   ██╗    ██     ██ ██╗███╗   ██╗\n");
+    Say(s, " ╚██╗ ██╔╝██╔═══██╗██║   ██║    ██     ██ ██║████╗  ██║\n");
+    Say(s, "  ╚████╔╝ ██║   ██║██║   ██║    ██  █  ██ ██║██╔██╗ ██║\n");
+    Say(s, "   ╚██╔╝  ██║   ██║██║   ██║    ██ ███ ██ ██║██║╚██╗██║\n");
+    Say(s, "    ██║   ╚██████╔╝╚██████╔╝    ╚███╔███╔╝██║██║ ╚████║\n");
+    Say(s, "    ╚═╝    ╚═════╝  ╚═════╝      ╚══╝╚══╝ ╚═╝╚═╝  ╚═══╝\n");
+    Say(s, "\n");
+}
+
+void SayGameOverArt(const Session *s)
+{
+    if (s->machine)
+        return;
+    Say(s, "\n");
+    Say(s, "  ██████╗  █████╗ ███╗   ███╗███████╗     ██████╗ ██╗   ██╗███████╗██████╗ \n");
+    Say(s, " ██╔════╝ ██╔══██╗████╗ ████║██╔════╝    ██╔═══██╗██║   ██║██╔════╝██╔══██╗\n");
+    Say(s, " ██║  ███╗███████║██╔████╔██║█████╗      ██║   ██║██║   ██║█████╗  ██████╔╝\n");
+    Say(s, " ██║   ██║██╔══██║██║╚██╔╝██║██╔══╝      ██║   ██║╚██╗ ██╔╝██╔══╝  ██╔══██╗\n");
+    Say(s, " ╚██████╔╝██║  ██║██║ ╚═╝ ██║███████╗    ╚██████╔╝ ╚████╔╝ ███████╗██║  ██║\n");
+    Say(s, "  ╚═════╝ ╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝     ╚═════╝   ╚═══╝  ╚══════╝╚═╝  ╚═╝\n");
+    Say(s, "\n");
+}
+
+// the title screen
+static void SayTitle(const Session *s)
+{
+    Say(s, " ████████╗███████╗███╗░░░███╗██████╗░██╗░░░░░███████╗░░░░░░░░██████╗███████╗░█████╗ ░██████╗░███████╗████████╗░██████╗\n");
+    Say(s, "╚══██╔══╝██╔════╝████╗░████║██╔══██╗██║░░░░░██╔════╝░░░░░░░██╔════╝██╔════╝██╔══██╗ ██╔══██╗██╔════╝╚══██╔══╝██╔════╝\n");
+    Say(s, " ░░░██║░░░█████╗░░██╔████╔██║██████╔╝██║░░░░░█████╗░░░░░░░░░╚█████╗░█████╗░░██║░░╚═ ╝██████╔╝█████╗░░░░░██║░░░╚█████╗░\n");
+    Say(s, " ░░░██║░░░██╔══╝░░██║╚██╔╝██║██╔═══╝░██║░░░░░██╔══╝░░░░░░░░░░╚═══██╗██╔══╝░░██║░░██╗ ██╔══██╗██╔══╝░░░░░██║░░░░╚═══██╗\n");
+    Say(s, " ░░░██║░░░███████╗██║░╚═╝░██║██║░░░░░███████╗███████╗░░░░░░░██████╔╝███████╗╚█████╔╝ ██║░░██║███████╗░░░██║░░░██████╔╝\n");
+    Say(s, " ░░░╚═╝░░░╚══════╝╚═╝░░░░░╚═╝╚═╝░░░░░╚══════╝╚══════╝░░░░░░░░═════╝░╚══════╝░╚════╝░ ╚═╝░░╚═╝╚══════╝░░░╚═╝░░░╚═════╝░\n");
+    Say(s, "Welcome to the Temple of Secrets!\n");
+    Say(s, "You are an explorer seeking the treasures of an ancient temple.\n");
+    Say(s, "Navigate through the rooms, solve puzzles, and find the golden key to win!\n");
+    Say(s, "Type 'help' for a list of commands.\n\n");
+}
+
+// the title, the intro and where the player is (main and game_intro)
+void SayWelcome(World *world, const Session *s, bool recovered)
+{
+    const Room *room = GetRoom(world, s->room);
+    if (!s->machine)
+        SayTitle(s);
+    if (recovered)
+        Say(s, "Welcome back! Picking up right where you left off.\n");
+    Say(s, "You are in %s.\n", Text(world, room->name));
+    Say(s, "%s\n", Text(world, room->description));
+    if (s->riddleSlot >= 0)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "%s", Text(world, room->interactables[s->riddleSlot].name));
+        LowercaseAscii(name, name, strlen(name));
+        Say(s, "The %s is still waiting for your answer.\nWhat's your answer? ", name);
+    }
+}
+
+// one command plus the checks that come after it
+void RunCommand(char *command, World *world, Session *s, bool *gameRunning, bool *hasWon, FILE *logFile)
+{
+    DoCommand(command, world, s, gameRunning, hasWon, logFile);
+    const Room *currentRoom = GetRoom(world, s->room);
+    if (strcmp(Text(world, currentRoom->name), "Gold Room") == 0 && !*hasWon)
+    {
+        SayWinArt(s);
+        Say(s, "Congratulations! You've made it to the Gold Room and found the treasure!\n");
+        *hasWon = true;
+        *gameRunning = false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Undo
+// Everything that changes a player goes through a handful of functions
+// (SetChange, MoveItem, SetFlag, SetRoom, the bag, MakeBiggerInventory,
+// ScheduleTimer) and each of them writes down what it did as one small op
+// that knows the before and the after. A command's ops make one step. undo
+// walks the last step's ops backwards, redo walks them forwards again, so a
+// step costs as much as the command itself did and no state gets copied.
+// The rings show up with the first command that changes something, room
+// for one command, and double whenever they're full until they hold depth
+// commands (--undo-depth), so a player who never does much never pays for
+// the whole history. Then older steps fall off the end, and so does the
+// oldest step when a command needs more ops than there's room for.
+// A journal checkpoint forgets the history: replaying the journal has to
+// come out the same, and the checkpoint doesn't have the history in it.
+// ---------------------------------------------------------------------------
+
+static int UndoOpCapacity(const UndoHistory *h)
+{
+    return h->size * UNDO_OPS_PER_STEP;
+}
+
+// twice the room (up to depth), what's in the rings moves over to the same positions. false = no memory,
+// and if there weren't any rings yet undo is off now
+static bool GrowHistory(UndoHistory *h)
+{
+    int size = h->size ? h->size * 2 : 1;
+    if (size > h->depth)
+        size = h->depth;
+    UndoOp *ops = MemAlloc(MEM_UNDO, sizeof(UndoOp) * size * UNDO_OPS_PER_STEP);
+    UndoStep *steps = MemAlloc(MEM_UNDO, sizeof(UndoStep) * size);
+    if (!ops || !steps)
+    {
+        MemFree(ops);
+        MemFree(steps);
+        if (!h->ops)
+        {
+            perror("No memory for the undo history, undo is off");
+            h->depth = 0;
+        }
+        return false;
+    }
+    for (long long i = h->firstOp; i < h->lastOp; i++)
+        ops[i % (size * UNDO_OPS_PER_STEP)] = h->ops[i % UndoOpCapacity(h)];
+    for (long long i = h->firstStep; i < h->lastStep; i++)
+        steps[i % size] = h->steps[i % h->size];
+    MemFree(h->ops);
+    MemFree(h->steps);
+    h->ops = ops;
+    h->steps = steps;
+    h->size = size;
+    return true;
+}
+
+// throw away the oldest step
+static void DropOldestStep(UndoHistory *h)
+{
+    h->firstStep++;
+    h->firstOp = h->firstStep < h->lastStep ? h->steps[h->firstStep % h->size].firstOp : h->lastOp;
+}
+
+void ForgetHistory(UndoHistory *h)
+{
+    h->firstStep = h->doneSteps = h->lastStep = 0;
+    h->firstOp = h->doneOps = h->lastOp = 0;
+    h->stepOpen = false;
+}
+
+// a command is about to run, what it changes can be taken back
+void StartUndoStep(Session *s, const char *command)
+{
+    UndoHistory *h = &s->history;
+    if (h->depth <= 0)
+        return;
+    snprintf(h->command, sizeof(h->command), "%s", command);
+    h->recording = true;
+    h->stepOpen = false;
+}
+
+void EndUndoStep(Session *s)
+{
+    s->history.recording = false;
+}
+
+// the first change of a command: a new step, and whatever was taken back before is gone for good
+// false = there's no memory for any history
+static bool OpenStep(UndoHistory *h)
+{
+    h->lastStep = h->doneSteps;
+    h->lastOp = h->doneOps;
+    if (h->doneSteps - h->firstStep == h->size && (h->size == h->depth || !GrowHistory(h)))
+    {
+        if (!h->ops)
+            return false;
+        DropOldestStep(h);
+    }
+    UndoStep *step = &h->steps[h->doneSteps % h->size];
+    step->firstOp = h->doneOps;
+    memcpy(step->command, h->command, sizeof(step->command));
+    h->doneSteps++;
+    h->lastStep = h->doneSteps;
+    h->stepOpen = true;
+    return true;
+}
+
+static void Remember(Session *s, const UndoOp *op)
+{
+    UndoHistory *h = &s->history;
+    if (!h->recording || h->applying)
+        return;
+    if (!h->stepOpen && !OpenStep(h))
+    {
+        h->recording = false;
+        return;
+    }
+    while (h->doneOps - h->firstOp == UndoOpCapacity(h))
+    {
+        if (h->size < h->depth && GrowHistory(h))
+            continue;
+        if (h->doneSteps - h->firstStep == 1)
+        {
+            // this one command did more than the whole history holds, it can't be taken back
+            ForgetHistory(h);
+            h->recording = false;
+            return;
+        }
+        DropOldestStep(h);
+    }
+    h->ops[h->doneOps % UndoOpCapacity(h)] = *op;
+    h->doneOps++;
+    h->lastOp = h->doneOps;
+}
+
+void RememberChange(Session *s, int kind, unsigned int key, int index, int from, int to)
+{
+    UndoOp op;
+    op.kind = kind;
+    op.u.change.key = key;
+    op.u.change.index = index;
+    op.u.change.from = from;
+    op.u.change.to = to;
+    Remember(s, &op);
+}
+
+void RememberTimer(Session *s, TimerEvent event, TimerHandle handle)
+{
+    UndoOp op;
+    op.kind = UNDO_TIMER;
+    op.u.timer.event = event;
+    op.u.timer.handle = handle;
+    op.u.timer.delay = -1;
+    Remember(s, &op);
+}
+
+// where an item is, for the things that follow items around (completion, --json)
+static int UndoItemLocation(const World *world, const Session *s, const UndoOp *op)
+{
+    if (op->kind > UNDO_CHANGE_SET || CHANGE_KIND(op->u.change.key) != CHANGE_ITEM_MOVED)
+        return NO_ROOM;
+    return ItemLocation(world, s, CHANGE_TARGET(op->u.change.key));
+}
+
+// one op, backwards (undo) or forwards (redo)
+static void ApplyUndoOp(World *world, Session *s, UndoOp *op, bool forward)
+{
+    int itemFrom = UndoItemLocation(world, s, op);
+    unsigned int key = op->u.change.key;
+    int index = op->u.change.index;
+    int value = forward ? op->u.change.to : op->u.change.from;
+    switch (op->kind)
+    {
+    case UNDO_CHANGE_ADD:
+    case UNDO_CHANGE_REMOVE:
+        if (forward == (op->kind == UNDO_CHANGE_ADD))
+            InsertChange(&s->delta, index, key, op->kind == UNDO_CHANGE_ADD ? op->u.change.to : op->u.change.from);
+        else
+            RemoveChange(&s->delta, index);
+        break;
+    case UNDO_CHANGE_SET:
+        SetChangeAt(&s->delta, index, value);
+        break;
+    case UNDO_ROOM:
+        SetRoom(world, s, value);
+        break;
+    case UNDO_BAG_ADD:
+    case UNDO_BAG_REMOVE:
+        if (forward == (op->kind == UNDO_BAG_ADD))
+        {
+            // the array never shrinks, so there's room for everything it ever held
+            Inventory *inv = &s->inv;
+            memmove(&inv->items[index + 1], &inv->items[index], sizeof(int) * (inv->count - index));
+            inv->items[index] = (int)key;
+            inv->count++;
+        }
+        else
+        {
+            RemoveFromBag(s, index);
+        }
+        break;
+    case UNDO_CAPACITY:
+        s->inv.capacity = value;
+        break;
+    case UNDO_TIMER:
+        if (forward)
+        {
+            if (op->u.timer.delay >= 0)
+                op->u.timer.handle = AddTimer(s, s->timers.now + op->u.timer.delay, s->timers.nextSeq++, op->u.timer.event);
+        }
+        else
+        {
+            // if it's still waiting it gets called off, and comes back with the time it had left
+            TimerHandle handle = op->u.timer.handle;
+            const Timer *timer = handle.index >= 0 && handle.index < s->timers.capacity ? &s->timers.timers[handle.index] : NULL;
+            long long left = timer ? timer->expires - s->timers.now : 0;
+            op->u.timer.delay = CancelTimer(s, handle) ? (int)left : -1;
+        }
+        break;
+    }
+    if (itemFrom != NO_ROOM)
+    {
+        int itemTo = UndoItemLocation(world, s, op);
+        if (itemTo != itemFrom)
+        {
+            ScopeItemMoved(s, CHANGE_TARGET(key), itemFrom, itemTo);
+            if (s->machine)
+                NoteMove(s->machine, CHANGE_TARGET(key), itemFrom);
+        }
+    }
+}
+
+// take the last command back, false if there's nothing to take back
+bool Undo(World *world, Session *s)
+{
+    UndoHistory *h = &s->history;
+    if (s->seat)
+    {
+        NoteFailure(s, false);
+        Say(s, "Undo doesn't work in a shared world, the others have carried on since.\n");
+        return false;
+    }
+    if (h->depth <= 0 || h->doneSteps == h->firstStep)
+    {
+        NoteFailure(s, false);
+        Say(s, "There's nothing to undo.\n");
+        return false;
+    }
+    int room = s->room;
+    const UndoStep *step = &h->steps[(h->doneSteps - 1) % h->size];
+    h->applying = true;
+    for (long long op = h->doneOps - 1; op >= step->firstOp; op--)
+        ApplyUndoOp(world, s, &h->ops[op % UndoOpCapacity(h)], false);
+    h->applying = false;
+    h->doneOps = step->firstOp;
+    h->doneSteps--;
+    Say(s, "Took back '%s'.\n", step->command);
+    if (s->room != room)
+        Say(s, "You're back in %s.\n", Text(world, GetRoom(world, s->room)->name));
+    return true;
+}
+
+// do the last command that was taken back again
+bool Redo(World *world, Session *s)
+{
+    UndoHistory *h = &s->history;
+    if (s->seat)
+    {
+        NoteFailure(s, false);
+        Say(s, "Redo doesn't work in a shared world, the others have carried on since.\n");
+        return false;
+    }
+    if (h->depth <= 0 || h->doneSteps == h->lastStep)
+    {
+        NoteFailure(s, false);
+        Say(s, "There's nothing to redo.\n");
+        return false;
+    }
+    int room = s->room;
+    const UndoStep *step = &h->steps[h->doneSteps % h->size];
+    long long end = h->doneSteps + 1 < h->lastStep ? h->steps[(h->doneSteps + 1) % h->size].firstOp : h->lastOp;
+    h->applying = true;
+    for (long long op = h->doneOps; op < end; op++)
+        ApplyUndoOp(world, s, &h->ops[op % UndoOpCapacity(h)], true);
+    h->applying = false;
+    h->doneOps = end;
+    h->doneSteps++;
+    Say(s, "Did '%s' again.\n", step->command);
+    if (s->room != room)
+        Say(s, "You're in %s.\n", Text(world, GetRoom(world, s->room)->name));
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Journal
+// Every line the player types is appended to the journal before the game
+// acts on it (and flushed, so a crash of the process can't lose it). When
+// the game starts and finds a journal it loads the last checkpoint and feeds
+// the lines after it back through the game with the output turned off,
+// which puts the player exactly where they were.
+// fsync is batched (group commit): once syncEvery records piled up, or right
+// before we sit and wait on a player at a terminal.
+// ---------------------------------------------------------------------------
+
+#define JOURNAL_MAGIC "TEMPLE-JOURNAL 3"
+#define DEFAULT_SYNC_EVERY 32
+#define DEFAULT_CHECKPOINT_EVERY 100
+
+void SyncJournal(Journal *journal)
+{
+    if (!journal || !journal->file)
+        return;
+    fflush(journal->file);
+    if (journal->pending > 0 && fsync(fileno(journal->file)) != 0)
+        perror("Couldn't sync the journal");
+    journal->pending = 0;
+}
+
+static void AppendRecord(Journal *journal, const char *kind, const char *text)
+{
+    fprintf(journal->file, "%s%s%s\n", kind, text ? " " : "", text ? text : "");
+    fflush(journal->file);
+    journal->pending++;
+    journal->sinceCheckpoint++;
+    if (journal->pending >= journal->syncEvery)
+        SyncJournal(journal);
+}
+
+bool JournalReplaying(const Journal *journal)
+{
+    return journal && journal->replayNext < journal->replayCount;
+}
+
+// done recovering, forget the old lines
+void FinishReplay(Journal *journal)
+{
+    MemFree(journal->replayLines);
+    MemFree(journal->replayText);
+    journal->replayLines = NULL;
+    journal->replayText = NULL;
+    journal->replayCount = 0;
+    journal->replayNext = 0;
+}
+
+// move the clock, and journal it so a replay has the same timers go off at the same moment
+int AdvanceClock(Session *s, long long tick)
+{
+    if (tick <= s->timers.now)
+        return 0;
+    if (s->journal && !s->journal->replayLines)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%lld", tick);
+        AppendRecord(s->journal, "T", text);
+    }
+    return AdvanceTimers(s, tick);
+}
+
+// while recovering, apply the clock records up to the next line
+void ReplayClock(Session *s)
+{
+    Journal *journal = s->journal;
+    while (JournalReplaying(journal) && journal->replayLines[journal->replayNext][0] == 'T')
+    {
+        AdvanceTimers(s, strtoll(journal->replayLines[journal->replayNext] + 2, NULL, 10));
+        journal->replayNext++;
+        journal->sinceCheckpoint++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Completion
+// Tab completion and the suggest command look words up in two radix tries:
+// the verbs, and the names of everything in reach (the room's items and
+// interactables plus the bag). The names trie is never rebuilt while playing,
+// MoveItem and SetRoom add and take out just the names that came into reach
+// or left it, so a lookup is only a walk down a few edges.
+// ---------------------------------------------------------------------------
+
+// every command there is (the first word of a line)
+static const char *const verbs[] = {
+    "north", "south", "east", "west", "look", "inventory", "take", "pick up", "drop", "examine",
+    "interact", "use", "combine", "push", "undo", "redo", "help", "memstats", "hint", "suggest", "quit",
+};
+
+static TrieNode *NewTrieNode(const char *label, int length)
+{
+    TrieNode *node = MemAlloc(MEM_COMPLETION, sizeof(TrieNode) + length + 1);
+    if (!node)
+        return NULL;
+    node->child = NULL;
+    node->sibling = NULL;
+    node->refs = 0;
+    node->words = 0;
+    node->length = length;
+    memcpy(node->label, label, length);
+    node->label[length] = '\0';
+    return node;
+}
+
+static void FreeTrie(TrieNode *node)
+{
+    while (node)
+    {
+        TrieNode *next = node->sibling;
+        FreeTrie(node->child);
+        MemFree(node);
+        node = next;
+    }
+}
+
+// add a (lowercase) word below node. the same word can go in more than once (two things called "crate")
+// and stays until it's taken out as often. 1 = new word, 0 = had it already, -1 = out of memory
+static int TrieInsert(TrieNode *node, const char *word)
+{
+    if (!*word)
+    {
+        node->refs++;
+        if (node->refs > 1)
+            return 0;
+        node->words++;
+        return 1;
+    }
+    TrieNode **link = &node->child;
+    while (*link && (unsigned char)(*link)->label[0] < (unsigned char)*word)
+        link = &(*link)->sibling;
+    TrieNode *child = *link;
+    if (!child || child->label[0] != *word)
+    {
+        // nothing starts like this yet, the whole rest of the word is one new edge
+        TrieNode *leaf = NewTrieNode(word, (int)strlen(word));
+        if (!leaf)
+            return -1;
+        leaf->refs = 1;
+        leaf->words = 1;
+        leaf->sibling = child;
+        *link = leaf;
+        node->words++;
+        return 1;
+    }
+    int same = 1;
+    while (same < child->length && word[same] == child->label[same])
+        same++;
+    if (same < child->length)
+    {
+        // the word leaves this edge halfway, split it there
+        TrieNode *fork = NewTrieNode(child->label, same);
+        if (!fork)
+            return -1;
+        fork->sibling = child->sibling;
+        fork->child = child;
+        fork->words = child->words;
+        child->sibling = NULL;
+        child->length -= same;
+        memmove(child->label, child->label + same, child->length + 1);
+        *link = fork;
+        child = fork;
+    }
+    int added = TrieInsert(child, word + same);
+    if (added == 1)
+        node->words++;
+    return added;
+}
+
+// take a word out again. 1 = it's gone, 0 = still there (was added more than once), -1 = wasn't there
+static int TrieErase(TrieNode *node, const char *word)
+{
+    if (!*word)
+    {
+        if (node->refs == 0)
+            return -1;
+        node->refs--;
+        if (node->refs > 0)
+            return 0;
+        node->words--;
+        return 1;
+    }
+    TrieNode **link = &node->child;
+    while (*link && (*link)->label[0] != *word)
+        link = &(*link)->sibling;
+    TrieNode *child = *link;
+    if (!child || strncmp(word, child->label, child->length) != 0)
+        return -1;
+    int erased = TrieErase(child, word + child->length);
+    if (erased != 1)
+        return erased;
+    node->words--;
+    if (child->words == 0)
+    {
+        *link = child->sibling;
+        FreeTrie(child->child);
+        MemFree(child);
+    }
+    else if (child->refs == 0 && !child->child->sibling)
+    {
+        // only one way to go from here now, glue the edge below onto this one (stays split if there's no memory)
+        TrieNode *below = child->child;
+        char label[COMPLETION_LINE]; // words are shorter than this, so two edges of one are too
+        memcpy(label, child->label, child->length);
+        memcpy(label + child->length, below->label, below->length + 1);
+        TrieNode *merged = NewTrieNode(label, child->length + below->length);
+        if (merged)
+        {
+            merged->child = below->child;
+            merged->sibling = child->sibling;
+            merged->refs = below->refs;
+            merged->words = below->words;
+            *link = merged;
+            MemFree(child);
+            MemFree(below);
+        }
+    }
+    return 1;
+}
+
+// where prefix ends up: the node whose edge it stops on, *used = how much of that edge it covered
+// NULL if no word starts like that
+static const TrieNode *TrieFind(const TrieNode *node, const char *prefix, int *used)
+{
+    *used = node->length;
+    while (*prefix)
+    {
+        const TrieNode *child = node->child;
+        while (child && child->label[0] != *prefix)
+            child = child->sibling;
+        if (!child)
+            return NULL;
+        int i = 0;
+        while (i < child->length && prefix[i] && prefix[i] == child->label[i])
+            i++;
+        if (prefix[i] && i < child->length)
+            return NULL;
+        prefix += i;
+        node = child;
+        *used = i;
+    }
+    return node;
+}
+
+static bool TrieHas(const TrieNode *root, const char *word)
+{
+    int used;
+    const TrieNode *node = TrieFind(root, word, &used);
+    return node && used == node->length && node->refs > 0;
+}
+
+// every word below node, in order, as stem + the rest of the word. returns the new count
+static int TrieCollect(const TrieNode *node, char *stem, int stemLength, char lines[][COMPLETION_LINE], int count, int max)
+{
+    if (node->refs > 0 && count < max)
+        memcpy(lines[count++], stem, stemLength + 1);
+    for (const TrieNode *child = node->child; child && count < max; child = child->sibling)
+    {
+        if (stemLength + child->length >= COMPLETION_LINE)
+            continue;
+        memcpy(stem + stemLength, child->label, child->length + 1);
+        count = TrieCollect(child, stem, stemLength + child->length, lines, count, max);
+        stem[stemLength] = '\0';
+    }
+    return count;
+}
+
+// complete the word that starts at line + start, returns how many words fit
+static int CompleteWord(const TrieNode *root, const char *line, int start, char lines[][COMPLETION_LINE], int max,
+                        char *common)
+{
+    int used;
+    const TrieNode *node = TrieFind(root, line + start, &used);
+    if (!node || node->words == 0)
+        return 0;
+    char stem[COMPLETION_LINE];
+    int length = snprintf(stem, sizeof(stem), "%s%s", line, node->label + used);
+    if (length >= (int)sizeof(stem))
+        return 0;
+    TrieCollect(node, stem, length, lines, 0, max);
+    if (common)
+    {
+        // as long as there's only one way down, every match goes that way
+        while (node->refs == 0 && node->child && !node->child->sibling &&
+               length + node->child->length < COMPLETION_LINE)
+        {
+            node = node->child;
+            memcpy(stem + length, node->label, node->length + 1);
+            length += node->length;
+        }
+        memcpy(common, stem, length + 1);
+    }
+    return node->words;
+}
+
+// the ways the line typed so far can go on, as whole lines (the first max go into lines)
+// returns how many there are, common gets the longest line that all of them start with
+int CompleteLine(const Completer *c, const char *typed, char lines[][COMPLETION_LINE], int max, char *common)
+{
+    if (!c->world || strlen(typed) >= COMPLETION_LINE)
+        return 0;
+    char line[COMPLETION_LINE];
+    strcpy(line, typed);
+    LowercaseAscii(line, line, strlen(line));
+
+    // still on the verb. a finished one gets its space so the name can come right after
+    int total = CompleteWord(c->verbs, line, 0, lines, max, common);
+    if (total > 0)
+    {
+        if (common && total == 1 && strlen(common) + 1 < COMPLETION_LINE)
+            strcat(common, " ");
+        return total;
+    }
+
+    // past the verb (the longest one the line starts with, "pick up" is two words)
+    int verbEnd = 0;
+    for (int i = 0; line[i]; i++)
+    {
+        if (line[i] != ' ')
+            continue;
+        line[i] = '\0';
+        if (TrieHas(c->verbs, line))
+            verbEnd = i + 1;
+        line[i] = ' ';
+    }
+    if (verbEnd == 0)
+        return 0;
+    // names have spaces too, so try the longest tail of the line first: in "use golden key gol" that's
+    // "golden key gol" (no), "key gol" (no), then "gol"
+    while (line[verbEnd] == ' ')
+        verbEnd++;
+    for (int i = verbEnd; i == verbEnd || line[i - 1]; i++)
+    {
+        if (i > verbEnd && line[i - 1] != ' ')
+            continue;
+        total = CompleteWord(c->names, line, i, lines, max, common);
+        if (total > 0)
+            return total;
+    }
+    return 0;
+}
+
+// a name of something coming into reach (or leaving it)
+static void ScopeName(Completer *c, TextRef name, bool entering)
+{
+    char word[COMPLETION_LINE];
+    const char *text = Text(c->world, name);
+    if (strlen(text) >= sizeof(word))
+        return; // can't type that anyway
+    LowercaseAscii(word, text, strlen(text) + 1);
+    if (entering)
+        TrieInsert(c->names, word);
+    else
+        TrieErase(c->names, word);
+}
+
+static bool InReach(const Session *s, int location)
+{
+    return location == IN_INVENTORY || location == s->room;
+}
+
+// an item went somewhere else, which only matters if it came into reach or left it
+void ScopeItemMoved(Session *s, int itemId, int from, int to)
+{
+    Completer *c = &s->completer;
+    if (!c->world || InReach(s, from) == InReach(s, to))
+        return;
+    ScopeName(c, c->world->items[itemId].name, InReach(s, to));
+}
+
+// walking into a room puts what's lying in it and what's built into it in reach, leaving takes it away again
+void ScopeRoom(World *world, Session *s, int roomId, bool entering)
+{
+    Completer *c = &s->completer;
+    const Room *room = c->world ? GetRoom(world, roomId) : NULL;
+    if (!room)
+        return;
+    int items[10];
+    int count = RoomItems(world, s, room, items);
+    for (int i = 0; i < count; i++)
+        ScopeName(c, world->items[items[i]].name, entering);
+    for (int i = 0; i < room->interactableCount; i++)
+        ScopeName(c, room->interactables[i].name, entering);
+}
+
+// build the names from scratch, for when the whole state got replaced (loading a checkpoint)
+void FillScope(World *world, Session *s)
+{
+    Completer *c = &s->completer;
+    if (!c->world)
+        return;
+    FreeTrie(c->names);
+    c->names = NewTrieNode("", 0);
+    if (!c->names)
+    {
+        EndCompletion(c);
+        return;
+    }
+    ScopeRoom(world, s, s->room, true);
+    for (int i = 0; i < s->inv.count; i++)
+        ScopeName(c, world->items[s->inv.items[i]].name, true);
+}
+
+// no memory for it just means no completion, the game doesn't need it
+void StartCompletion(World *world, Session *s)
+{
+    Completer *c = &s->completer;
+    c->world = world;
+    c->verbs = NewTrieNode("", 0);
+    c->names = NULL;
+    if (!c->verbs)
+    {
+        EndCompletion(c);
+        return;
+    }
+    for (size_t i = 0; i < sizeof(verbs) / sizeof(verbs[0]); i++)
+    {
+        if (TrieInsert(c->verbs, verbs[i]) < 0)
+        {
+            EndCompletion(c);
+            return;
+        }
+    }
+    FillScope(world, s);
+}
+
+void EndCompletion(Completer *c)
+{
+    FreeTrie(c->verbs);
+    FreeTrie(c->names);
+    c->verbs = NULL;
+    c->names = NULL;
+    c->world = NULL;
+}
+
+// the suggest command: every way the line could be finished, one per line (for bots and front ends)
+void ListSuggestions(const Session *s, const char *typed)
+{
+    char lines[MAX_SUGGESTIONS][COMPLETION_LINE];
+    int total = CompleteLine(&s->completer, typed, lines, MAX_SUGGESTIONS, NULL);
+    if (total == 0)
+    {
+        Say(s, "No suggestions.\n");
+        return;
+    }
+    for (int i = 0; i < total && i < MAX_SUGGESTIONS; i++)
+        Say(s, "%s\n", lines[i]);
+    if (total > MAX_SUGGESTIONS)
+        Say(s, "(and %d more)\n", total - MAX_SUGGESTIONS);
+}
+
+// ---------------------------------------------------------------------------
+// Input
+// stdin is read in big blocks and split into lines with memchr (which libc
+// does with SIMD), so scripts and bots can pipe in commands as fast as they
+// like. One line can hold several commands split by ';'.
+// ---------------------------------------------------------------------------
+
+#define INPUT_BUFFER 65536
+
+static struct
+{
+    char data[INPUT_BUFFER];
+    int start; // unread stuff is data[start..end)
+    int end;
+    bool eof;
+    char *line; // commands of the current line we haven't handed out yet, NULL if none
+    char *lineEnd;
+    bool batch; // the current line has ';'s in it
+    const Completer *completer; // at a terminal: we edit the line ourselves and Tab completes (NULL = plain reads)
+} input;
+
+#ifndef _WIN32
+static struct termios cookedTerminal; // how the terminal was set up before we took over the line editing
+
+static void RestoreTerminal(void)
+{
+    if (input.completer)
+        tcsetattr(fileno(stdin), TCSANOW, &cookedTerminal);
+}
+
+// Tab: one match gets filled in, several get filled in as far as they agree and listed if that's nowhere
+static int TabComplete(char *line, int length, int size)
+{
+    char lines[MAX_SUGGESTIONS][COMPLETION_LINE];
+    char common[COMPLETION_LINE];
+    line[length] = '\0';
+    int total = CompleteLine(input.completer, line, lines, MAX_SUGGESTIONS, common);
+    int commonLength = (int)strlen(common);
+    if (total == 0)
+    {
+        fputs("\a", stdout);
+        return length;
+    }
+    if (commonLength > length && commonLength < size)
+    {
+        // what the player typed stays as they typed it, only the rest comes from the trie
+        fputs(common + length, stdout);
+        memcpy(line + length, common + length, commonLength - length);
+        return commonLength;
+    }
+    printf("\n");
+    for (int i = 0; i < total && i < MAX_SUGGESTIONS; i++)
+        printf("  %s\n", lines[i]);
+    if (total > MAX_SUGGESTIONS)
+        printf("  (and %d more)\n", total - MAX_SUGGESTIONS);
+    printf("> %s", line);
+    return length;
+}
+
+// read one line from the terminal key by key (the terminal's own editing can't do Tab)
+// returns its length with the newline, 0 at the end of input
+static int EditLine(char *line, int size)
+{
+    int length = 0;
+    fflush(stdout);
+    for (;;)
+    {
+        unsigned char c;
+        long n = (long)read(fileno(stdin), &c, 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        if (c == '\r' || c == '\n')
+        {
+            printf("\n");
+            line[length++] = '\n';
+            return length;
+        }
+        if (c == '\t')
+        {
+            length = TabComplete(line, length, size - 1);
+        }
+        else if (c == 127 || c == '\b')
+        {
+            if (length > 0)
+            {
+                length--;
+                fputs("\b \b", stdout);
+            }
+        }
+        else if (c == 21) // Ctrl-U
+        {
+            for (; length > 0; length--)
+                fputs("\b \b", stdout);
+        }
+        else if (c == 4) // Ctrl-D
+        {
+            if (length == 0)
+                return 0;
+        }
+        else if (c == 3) // Ctrl-C, do what it would have done
+        {
+            RestoreTerminal();
+            printf("\n");
+            fflush(stdout);
+            raise(SIGINT);
+        }
+        else if (c == 27)
+        {
+            // arrow keys and such, skip the whole escape sequence
+            if (read(fileno(stdin), &c, 1) == 1 && (c == '[' || c == 'O'))
+            {
+                while (read(fileno(stdin), &c, 1) == 1 && !(c >= 0x40 && c <= 0x7E))
+                    ;
+            }
+        }
+        else if (c >= 32 && length < size - 2)
+        {
+            line[length++] = (char)c;
+            fputc(c, stdout);
+        }
+        fflush(stdout);
+    }
+}
+#endif
+
+// let Tab complete from these words, only does something when a person is typing at a terminal
+bool EnableTabCompletion(const Completer *c)
+{
+#ifndef _WIN32
+    if (!c->world || !Interactive() || tcgetattr(fileno(stdin), &cookedTerminal) != 0)
+        return false;
+    struct termios raw = cookedTerminal;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(fileno(stdin), TCSANOW, &raw) != 0)
+        return false;
+    input.completer = c;
+    atexit(RestoreTerminal);
+    return true;
+#else
+    (void)c;
+    return false;
+#endif
+}
+
+// get more from stdin, false at the end of input
+static bool FillInput(void)
+{
+    if (input.eof)
+        return false;
+    if (input.start > 0)
+    {
+        memmove(input.data, input.data + input.start, input.end - input.start);
+        input.end -= input.start;
+        input.start = 0;
+    }
+    for (;;)
+    {
+        long n;
+#ifndef _WIN32
+        if (input.completer)
+            n = EditLine(input.data + input.end, INPUT_BUFFER - input.end < COMPLETION_LINE ? INPUT_BUFFER - input.end : COMPLETION_LINE);
+        else
+#endif
+            n = (long)read(fileno(stdin), input.data + input.end, INPUT_BUFFER - input.end);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            input.eof = true;
+            return false;
+        }
+        input.end += (int)n;
+        return true;
+    }
+}
+
+// the next whole line, newline cut off. lines that don't fit in the buffer get thrown away
+static bool NextInputLine(void)
+{
+    for (;;)
+    {
+        char *from = input.data + input.start;
+        char *newline = memchr(from, '\n', input.end - input.start);
+        if (newline)
+        {
+            input.line = from;
+            input.lineEnd = newline;
+            input.start = (int)(newline - input.data) + 1;
+            return true;
+        }
+        if (input.start == 0 && input.end == INPUT_BUFFER)
+        {
+            // 64 KB without a newline, nobody typed that. skip to the end of it
+            fprintf(stderr, "Input line too long, skipped\n");
+            input.start = input.end = 0;
+            while (FillInput())
+            {
+                newline = memchr(input.data, '\n', input.end);
+                if (newline)
+                {
+                    input.start = (int)(newline - input.data) + 1;
+                    break;
+                }
+                input.start = input.end = 0;
+            }
+            continue;
+        }
+        if (!FillInput())
+        {
+            // last line without a newline still counts
+            if (input.start == input.end)
+                return false;
+            input.line = input.data + input.start;
+            input.lineEnd = input.data + input.end;
+            input.start = input.end;
+            return true;
+        }
+    }
+}
+
+// the next command the player typed, false at the end of input
+static bool NextCommand(const Session *s, char *line, int size)
+{
+    for (;;)
+    {
+        if (!input.line)
+        {
+            if (!NextInputLine())
+                return false;
+            input.batch = memchr(input.line, ';', input.lineEnd - input.line) != NULL;
+        }
+        // whole line, or up to the next ';'
+        char *end = input.batch ? memchr(input.line, ';', input.lineEnd - input.line) : NULL;
+        if (!end)
+            end = input.lineEnd;
+        char *from = input.line;
+        input.line = end < input.lineEnd ? end + 1 : NULL;
+
+        char *to = end;
+        if (input.batch)
+        {
+            while (from < to && isspace((unsigned char)*from))
+                from++;
+            while (to > from && isspace((unsigned char)to[-1]))
+                to--;
+            if (from == to)
+                continue; // "look;;east" or a ';' at the end
+        }
+        else if (to > from && to[-1] == '\r')
+            to--;
+        if (to - from >= size)
+        {
+            Say(s, "That command is way too long, ignored it.\n");
+            continue;
+        }
+        memcpy(line, from, to - from);
+        line[to - from] = '\0';
+        return true;
+    }
+}
+
+// is a person typing at a terminal? (asked once, it doesn't change)
+bool Interactive(void)
+{
+    static int terminal = -1;
+    if (terminal == -1)
+        terminal = isatty(fileno(stdin)) ? 1 : 0;
+    return terminal == 1;
+}
+
+// true if we already have input nobody has read yet (so don't wait on stdin for it)
+static bool InputPending(void)
+{
+    return input.line != NULL || memchr(input.data + input.start, '\n', input.end - input.start) != NULL;
+}
+
+// read a line from the player (without the newline), false at the end of input
+// while recovering the lines come out of the journal instead of stdin
+bool ReadLine(Session *s, char *line, int size)
+{
+    Journal *journal = s->journal;
+    line[0] = '\0';
+    if (journal && journal->replayLines)
+    {
+        ReplayClock(s);
+        // asked for more than the journal has, that's the end of input, same as it'll be next time
+        if (journal->replayNext == journal->replayCount)
+        {
+            AppendRecord(journal, "E", NULL);
+            return false;
+        }
+        const char *record = journal->replayLines[journal->replayNext++];
+        journal->sinceCheckpoint++;
+        if (record[0] == 'E')
+            return false;
+        snprintf(line, size, "%s", record + 2);
+        return true;
+    }
+
+    // about to wait on a real person, make sure what they already did is on disk
+    if (journal && journal->pending > 0 && !InputPending() && Interactive())
+        SyncJournal(journal);
+    if (!NextCommand(s, line, size))
+    {
+        line[0] = '\0';
+        if (journal)
+            AppendRecord(journal, "E", NULL);
+        return false;
+    }
+    if (journal)
+        AppendRecord(journal, "L", line);
+    if (s->broadcast)
+    {
+        // spectators can't see the keyboard
+        BroadcastWrite(s->broadcast, line, (int)strlen(line));
+        BroadcastWrite(s->broadcast, "\n", 1);
+    }
+    return true;
+}
+
+// make a rename stick (the directory entry needs syncing too)
+static void SyncDirectoryOf(const char *path)
+{
+#ifndef _WIN32
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash)
+        *(slash == dir ? slash + 1 : slash) = '\0';
+    else
+        strcpy(dir, ".");
+    FILE *d = fopen(dir, "r");
+    if (d)
+    {
+        fsync(fileno(d));
+        fclose(d);
+    }
+#else
+    (void)path;
+#endif
+}
+
+// where a session's state gets written: " <number>" text into a file (journal checkpoints)
+// or zigzag varints into a buffer (a game moving to another process, see game_save)
+typedef struct
+{
+    FILE *file;          // NULL = varints into data
+    unsigned char *data; // snprintf rules: only size bytes land in here, length counts all of them
+    size_t size;
+    size_t length;
+} StateWriter;
+
+// and where it gets read back from
+typedef struct
+{
+    char *text;                // NULL = varints in [data, end)
+    const unsigned char *data;
+    const unsigned char *end;
+} StateReader;
+
+static void WriteNumber(StateWriter *w, long long value)
+{
+    if (w->file)
+    {
+        fprintf(w->file, " %lld", value);
+        return;
+    }
+    // zigzag so the -1s stay one byte too, then 7 bits a byte
+    unsigned long long v = ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+    do
+    {
+        unsigned char byte = v & 0x7F;
+        v >>= 7;
+        if (v)
+            byte |= 0x80;
+        if (w->length < w->size)
+            w->data[w->length] = byte;
+        w->length++;
+    } while (v);
+}
+
+// next number, false if it's missing or out of range
+static bool ReadNumber(StateReader *r, long long min, long long max, long long *value)
+{
+    if (r->text)
+    {
+        char *end;
+        *value = strtoll(r->text, &end, 10);
+        if (end == r->text)
+            return false;
+        r->text = end;
+    }
+    else
+    {
+        unsigned long long v = 0;
+        int shift = 0;
+        for (;;)
+        {
+            if (r->data == r->end || shift > 63)
+                return false;
+            unsigned char byte = *r->data++;
+            v |= (unsigned long long)(byte & 0x7F) << shift;
+            shift += 7;
+            if (!(byte & 0x80))
+                break;
+        }
+        *value = (long long)(v >> 1) ^ -(long long)(v & 1);
+    }
+    return *value >= min && *value <= max;
+}
+
+// room, bag, changes, clock and timers: everything a session is that isn't the world
+// <room> <bag capacity> <item count> <item ids...> <change count> <key value...>
+//   <clock> <next timer seq> <timer count> <expires seq kind room slot value period...>
+static void WriteSessionState(StateWriter *w, const Session *s)
+{
+    WriteNumber(w, s->room);
+    WriteNumber(w, s->inv.capacity);
+    WriteNumber(w, s->inv.count);
+    for (int i = 0; i < s->inv.count; i++)
+        WriteNumber(w, s->inv.items[i]);
+    WriteNumber(w, s->delta.count);
+    for (int i = 0; i < s->delta.count; i++)
+    {
+        WriteNumber(w, s->delta.changes[i].key);
+        WriteNumber(w, s->delta.changes[i].value);
+    }
+    // the clock and every timer that's still waiting
+    const Scheduler *sched = &s->timers;
+    WriteNumber(w, sched->now);
+    WriteNumber(w, sched->nextSeq);
+    WriteNumber(w, sched->active);
+    for (int i = 0; i < sched->capacity; i++)
+    {
+        const Timer *t = &sched->timers[i];
+        if (t->wheelSlot != -1)
+        {
+            WriteNumber(w, t->expires);
+            WriteNumber(w, t->seq);
+            WriteNumber(w, t->event.kind);
+            WriteNumber(w, t->event.room);
+            WriteNumber(w, t->event.slot);
+            WriteNumber(w, t->event.value);
+            WriteNumber(w, t->event.period);
+        }
+    }
+}
+
+// write the whole session into a fresh journal and swap it in for the old one
+// K <session state, see WriteSessionState>
+void WriteCheckpoint(Journal *journal, World *world, Session *s)
+{
+    char tmpPath[300];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", journal->path);
+    FILE *file = fopen(tmpPath, "w");
+    if (!file)
+    {
+        perror("Couldn't write a journal checkpoint");
+        return;
+    }
+    fprintf(file, "%s %d %d\n", JOURNAL_MAGIC, world->roomCount, world->itemCount);
+    fprintf(file, "K");
+    StateWriter w = {file, NULL, 0, 0};
+    WriteSessionState(&w, s);
+    fprintf(file, "\n");
+    bool ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        perror("Couldn't write a journal checkpoint");
+        remove(tmpPath);
+        return;
+    }
+
+    if (journal->file)
+        fclose(journal->file);
+#ifdef _WIN32
+    remove(journal->path); // rename doesn't replace files on windows
+#endif
+    if (rename(tmpPath, journal->path) != 0)
+        perror("Couldn't swap in the journal checkpoint");
+    SyncDirectoryOf(journal->path);
+    journal->file = fopen(journal->path, "a");
+    if (!journal->file)
+        perror("Couldn't reopen the journal");
+    journal->pending = 0;
+    journal->sinceCheckpoint = 0;
+    // a replay starts here with no history, so the game that's running can't undo past here either
+    ForgetHistory(&s->history);
+}
+
+// put the session back the way WriteSessionState wrote it, false (and nothing changed) if it doesn't fit the world
+static bool ReadSessionState(World *world, Session *s, StateReader *r)
+{
+    long long room, capacity, count, changeCount, value;
+    if (!ReadNumber(r, 0, world->roomCount - 1, &room) || !ReadNumber(r, 1, 1 << 20, &capacity) ||
+        !ReadNumber(r, 0, capacity, &count))
+        return false;
+
+    int *items = MemAlloc(MEM_INVENTORY, sizeof(int) * capacity);
+    if (!items)
+        return false;
+    for (int i = 0; i < count; i++)
+    {
+        if (!ReadNumber(r, 0, world->itemCount - 1, &value))
+        {
+            MemFree(items);
+            return false;
+        }
+        items[i] = (int)value;
+    }
+
+    Change *changes = NULL;
+    if (!ReadNumber(r, 0, 1 << 24, &changeCount) ||
+        (changeCount > 0 && !(changes = MemAlloc(MEM_CHANGES, sizeof(Change) * changeCount))))
+    {
+        MemFree(items);
+        return false;
+    }
+    for (int i = 0; i < changeCount; i++)
+    {
+        long long key;
+        if (!ReadNumber(r, 0, 0xFFFFFFFFLL, &key) || !ReadNumber(r, -2147483647LL - 1, 2147483647LL, &value))
+        {
+            MemFree(items);
+            MemFree(changes);
+            return false;
+        }
+        changes[i].key = (unsigned int)key;
+        changes[i].value = (int)value;
+    }
+    long long now, nextSeq, timerCount;
+    Timer *timers = NULL;
+    if (!ReadNumber(r, 0, LLONG_MAX, &now) ||
+        !ReadNumber(r, 0, LLONG_MAX, &nextSeq) || !ReadNumber(r, 0, 1 << 24, &timerCount) ||
+        (timerCount > 0 && !(timers = MemAlloc(MEM_TIMERS, sizeof(Timer) * timerCount))))
+    {
+        MemFree(items);
+        MemFree(changes);
+        return false;
+    }
+    for (int i = 0; i < timerCount; i++)
+    {
+        long long kind, eventRoom, slot, text, period;
+        if (!ReadNumber(r, now + 1, LLONG_MAX, &timers[i].expires) || !ReadNumber(r, 0, nextSeq - 1, &timers[i].seq) ||
+            !ReadNumber(r, EVENT_MESSAGE, EVENT_NAG, &kind) ||
+            !ReadNumber(r, NO_ROOM, world->roomCount - 1, &eventRoom) || !ReadNumber(r, -1, 15, &slot) ||
+            !ReadNumber(r, 0, THING_TEXTS - 1, &text) ||
+            !ReadNumber(r, 0, INT_MAX, &period))
+        {
+            MemFree(items);
+            MemFree(changes);
+            MemFree(timers);
+            return false;
+        }
+        TimerEvent event = {(int)kind, (int)eventRoom, (int)slot, (int)text, (int)period};
+        timers[i].event = event;
+    }
+    if (!GetRoom(world, (int)room))
+    {
+        MemFree(items);
+        MemFree(changes);
+        MemFree(timers);
+        return false;
+    }
+
+    MemFree(s->inv.items);
+    s->inv.items = items;
+    s->inv.capacity = (int)capacity;
+    s->inv.count = (int)count;
+    MemFree(s->delta.changes);
+    s->delta.changes = changes;
+    s->delta.count = (int)changeCount;
+    s->delta.capacity = (int)changeCount;
+    FreeTimers(&s->timers);
+    s->timers.now = now;
+    s->timers.nextSeq = nextSeq;
+    for (int i = 0; i < timerCount; i++)
+        AddTimer(s, timers[i].expires, timers[i].seq, timers[i].event);
+    MemFree(timers);
+    s->delta.hash = DeltaHash(&s->delta);
+    SetRoom(world, s, (int)room);
+    FillScope(world, s); // the bag and the changes got swapped out under the completion
+    return true;
+}
+
+// put the session back the way a checkpoint says
+static bool LoadCheckpoint(World *world, Session *s, char *record)
+{
+    StateReader r = {record + 1, NULL, NULL};
+    return ReadSessionState(world, s, &r);
+}
+
+// read a whole file into memory (NULL if it isn't there)
+static char *ReadWholeFile(const char *path, long *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+    char *text = NULL;
+    if (fseek(file, 0, SEEK_END) == 0 && (*size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        text = MemAlloc(MEM_JOURNAL, *size + 1);
+        if (text && fread(text, 1, *size, file) != (size_t)*size)
+        {
+            MemFree(text);
+            text = NULL;
+        }
+    }
+    fclose(file);
+    if (text)
+        text[*size] = '\0';
+    return text;
+}
+
+// look at what an old journal left us, false if it's not usable
+static bool RecoverJournal(Journal *journal, World *world, Session *s, char *text, long size)
+{
+    char header[64];
+    snprintf(header, sizeof(header), "%s %d %d\n", JOURNAL_MAGIC, world->roomCount, world->itemCount);
+    if (strncmp(text, header, strlen(header)) != 0)
+        return false;
+
+    // split into lines, a last line without a newline got cut off by the crash and doesn't count
+    int lineCount = 0;
+    for (long i = 0; i < size; i++)
+    {
+        if (text[i] == '\n')
+            lineCount++;
+    }
+    journal->replayLines = MemAlloc(MEM_JOURNAL, sizeof(char *) * (lineCount + 1));
+    if (!journal->replayLines)
+        return false;
+    char *line = text + strlen(header);
+    char *end = text + size;
+    char *newline;
+    while (line < end && (newline = memchr(line, '\n', end - line)) != NULL)
+    {
+        *newline = '\0';
+        if (line[0] == 'K')
+        {
+            // everything before a checkpoint is already in it
+            if (!LoadCheckpoint(world, s, line))
+                return false;
+            journal->replayCount = 0;
+            journal->recovered = true;
+        }
+        else if ((line[0] == 'L' && line[1] == ' ') || (line[0] == 'E' && line[1] == '\0') ||
+                 (line[0] == 'T' && line[1] == ' ' && isdigit((unsigned char)line[2])))
+        {
+            journal->replayLines[journal->replayCount++] = line;
+            journal->recovered = true;
+        }
+        else
+        {
+            break; // garbage, stop trusting the file here
+        }
+        line = newline + 1;
+    }
+
+    // chop off whatever we didn't use so new records don't get glued onto it
+    long validSize = line - text;
+    if (validSize < size)
+    {
+        FILE *file = fopen(journal->path, "r+b");
+        if (!file || ftruncate(fileno(file), validSize) != 0)
+            perror("Couldn't trim the journal");
+        if (file)
+            fclose(file);
+    }
+    journal->replayText = text;
+    return true;
+}
+
+// open the player's journal, picking up the game it has if there is one
+// nothing to recover means a fresh journal with just the starting state
+Journal *OpenJournal(const char *path, World *world, Session *s, int syncEvery, int checkpointEvery)
+{
+    Journal *journal = MemCalloc(MEM_JOURNAL, 1, sizeof(Journal));
+    if (!journal)
+    {
+        perror("Memory fail - no journal for you");
+        return NULL;
+    }
+    snprintf(journal->path, sizeof(journal->path), "%s", path);
+    journal->syncEvery = syncEvery > 0 ? syncEvery : 1;
+    journal->checkpointEvery = checkpointEvery > 0 ? checkpointEvery : 1;
+
+    long size = 0;
+    char *text = ReadWholeFile(path, &size);
+    if (text && !RecoverJournal(journal, world, s, text, size))
+    {
+        // don't delete somebody's game just because we can't read it
+        char oldPath[300];
+        snprintf(oldPath, sizeof(oldPath), "%s.old", path);
+        fprintf(stderr, "Can't recover the game in %s, moved it to %s\n", path, oldPath);
+        rename(path, oldPath);
+        MemFree(text);
+        FinishReplay(journal);
+        journal->recovered = false;
+        EndSession(s, world);
+        StartSession(s, world);
+        text = NULL;
+    }
+
+    if (text)
+    {
+        journal->file = fopen(path, "a");
+        if (!journal->file)
+        {
+            perror("Couldn't open the journal");
+            FinishReplay(journal);
+            MemFree(journal);
+            return NULL;
+        }
+    }
+    else
+    {
+        WriteCheckpoint(journal, world, s);
+        if (!journal->file)
+        {
+            MemFree(journal);
+            return NULL;
+        }
+    }
+    return journal;
+}
+
+// the game ended properly, nothing to recover next time
+// otherwise (ran out of input) the journal stays so the game can go on later
+void CloseJournal(Journal *journal, bool gameOver)
+{
+    if (!journal)
+        return;
+    if (journal->file)
+    {
+        SyncJournal(journal);
+        fclose(journal->file);
+    }
+    if (gameOver)
+        remove(journal->path);
+    FinishReplay(journal);
+    MemFree(journal);
+}
+
+// ---------------------------------------------------------------------------
+// Hints
+// "hint" says what to do next and how far the Gold Room still is. Searching
+// the puzzles every time somebody asks would cost far more than a command
+// should, so the search happens once, offline (--save-hints), and the game
+// only looks the answer up. The search plays the world with the engine
+// itself, breadth first from the start: in every state it tries walking
+// every way, taking what lies there, interacting with and pushing every
+// thing (answering a riddle right away), using what's in the bag on
+// whatever it fits and combining whatever has a recipe. Then it walks back
+// from every state where the game is won, so every state knows how far it
+// is from winning and which step gets it one closer.
+// A state is only what matters for getting there: the room, the bag size,
+// every door, riddle and thing that got opened, solved or used, and where
+// the key items are (keys, whatever a lock or a recipe needs, and what
+// recipes make). Junk, looks and timers don't count, so a player who picked
+// up the Note is in the same state as one who didn't.
+// The states go into a table with a perfect hash (hash and displace): the
+// state's hash picks a bucket, the bucket's displacement picks the slot, and
+// nothing else can be in that slot. So a hint is one probe, the slot also
+// keeps the high half of the hash to tell states that aren't in the table.
+// The table is a file next to the world (<world file>.hints, or --hints),
+// made for one world and refused by any other.
+// ---------------------------------------------------------------------------
+
+#define HINT_MAGIC 0x54485754 // "TWHT"
+#define HINT_VERSION 1
+#define MAX_HINT_STATES (1 << 20)
+#define HINT_FAR 0xFFFF // distance of a state the Gold Room can't be reached from anymore
+#define HINT_DOOR 16    // target of HINT_USE: HINT_DOOR + direction is the door that way
+#define HINT_BUCKET_SIZE 4
+#define MAX_DISPLACEMENT (1 << 20) // tries for one bucket before the table gets more slots
+
+enum
+{
+    HINT_NONE,     // no way to the Gold Room from here
+    HINT_GO,       // target = direction
+    HINT_TAKE,     // item
+    HINT_INTERACT, // target = slot, the riddle's answer comes right after if it asks one
+    HINT_PUSH,     // target = slot
+    HINT_USE,      // item on target (slot or HINT_DOOR + direction)
+    HINT_COMBINE   // item with other
+};
+
+typedef struct
+{
+    unsigned int check;      // high half of the state's hash, 0 = empty slot
+    unsigned short distance; // steps to the Gold Room, HINT_FAR = none
+    unsigned char action;    // HINT_...
+    unsigned char target;
+    int item;
+    int other;
+} HintEntry;
+
+struct HintTable
+{
+    int stateCount;
+    int slotCount;
+    int bucketCount;
+    unsigned int *displace; // per bucket
+    HintEntry *entries;     // slotCount of them
+    int *keyItems;          // the items whose place is part of a state
+    int keyItemCount;
+    bool *keyItem; // the same per item id
+};
+
+void FreeHints(HintTable *hints)
+{
+    if (!hints)
+        return;
+    MemFree(hints->displace);
+    MemFree(hints->entries);
+    MemFree(hints->keyItems);
+    MemFree(hints->keyItem);
+    MemFree(hints);
+}
+
+// the items that open something, go into a recipe or come out of one
+static bool FindKeyItems(World *world, HintTable *hints)
+{
+    hints->keyItem = MemCalloc(MEM_WORLD, world->itemCount ? world->itemCount : 1, sizeof(bool));
+    if (!hints->keyItem)
+        return false;
+    for (int id = 0; id < world->roomCount; id++)
+    {
+        const Room *room = GetRoom(world, id);
+        if (!room)
+            return false;
+        if (room->keyItem >= 0 && room->keyItem < world->itemCount)
+            hints->keyItem[room->keyItem] = true;
+    }
+    const Components *c = &world->parts;
+    for (int i = 0; i < c->lockableCount; i++)
+    {
+        if (c->lockables[i].key >= 0 && c->lockables[i].key < world->itemCount)
+            hints->keyItem[c->lockables[i].key] = true;
+        if (c->lockables[i].otherKey >= 0 && c->lockables[i].otherKey < world->itemCount)
+            hints->keyItem[c->lockables[i].otherKey] = true;
+    }
+    for (int i = 0; i < world->itemCount; i++)
+    {
+        if (!HasRecipe(world, i))
+            continue;
+        hints->keyItem[i] = true;
+        hints->keyItem[world->items[i].combineWith] = true;
+        hints->keyItem[world->items[i].resultItem] = true;
+    }
+    for (int i = 0; i < world->itemCount; i++)
+        hints->keyItemCount += hints->keyItem[i];
+    hints->keyItems = MemAlloc(MEM_WORLD, sizeof(int) * (hints->keyItemCount ? hints->keyItemCount : 1));
+    if (!hints->keyItems)
+        return false;
+    for (int i = 0, n = 0; i < world->itemCount; i++)
+    {
+        if (hints->keyItem[i])
+            hints->keyItems[n++] = i;
+    }
+    return true;
+}
+
+// StateHash with only the changes that matter for getting to the Gold Room. A key item back in the
+// room it started in counts as never moved
+static unsigned long long ProgressHash(const World *world, const Session *s, const bool *keyItem)
+{
+    unsigned long long hash = ZobristKey(ZOBRIST_ROOM, (unsigned int)s->room, 0) ^
+                              ZobristKey(ZOBRIST_CAPACITY, (unsigned int)s->inv.capacity, 0);
+    for (int i = 0; i < s->delta.count; i++)
+    {
+        const Change *c = &s->delta.changes[i];
+        int kind = CHANGE_KIND(c->key);
+        if (kind == CHANGE_DESCRIPTION)
+            continue;
+        if (kind == CHANGE_ITEM_MOVED &&
+            (!keyItem[CHANGE_TARGET(c->key)] || c->value == world->items[CHANGE_TARGET(c->key)].homeRoom))
+            continue;
+        hash ^= ZobristKey(ZOBRIST_CHANGE, c->key, c->value);
+    }
+    return hash;
+}
+
+static unsigned int HintBucket(const HintTable *hints, unsigned long long hash)
+{
+    return (unsigned int)(hash % (unsigned long long)hints->bucketCount);
+}
+
+static unsigned int HintSlot(const HintTable *hints, unsigned long long hash, unsigned int displace)
+{
+    return (unsigned int)(ZobristKey(ZOBRIST_CHANGE, (unsigned int)(hash >> 32) ^ displace, (int)hash) %
+                          (unsigned long long)hints->slotCount);
+}
+
+static unsigned int HintCheck(unsigned long long hash)
+{
+    return (unsigned int)(hash >> 32) | 1;
+}
+
+// the one probe, NULL if the state isn't in the table
+static const HintEntry *FindHint(const HintTable *hints, unsigned long long hash)
+{
+    const HintEntry *e = &hints->entries[HintSlot(hints, hash, hints->displace[HintBucket(hints, hash)])];
+    return e->check == HintCheck(hash) ? e : NULL;
+}
+
+// what to type for a hint (lowercase, like people type it), without the riddle's answer
+static void HintCommand(World *world, const Room *room, const HintEntry *e, char *out, size_t size)
+{
+    const char *item = e->item >= 0 && e->item < world->itemCount ? Text(world, world->items[e->item].name) : "";
+    const char *other = e->other >= 0 && e->other < world->itemCount ? Text(world, world->items[e->other].name) : "";
+    const char *thing = e->target < room->interactableCount ? Text(world, room->interactables[e->target].name) : "";
+    switch (e->action)
+    {
+    case HINT_GO:
+        snprintf(out, size, "%s", directionNames[e->target & 3]);
+        break;
+    case HINT_TAKE:
+        snprintf(out, size, "take %s", item);
+        break;
+    case HINT_INTERACT:
+        snprintf(out, size, "interact %s", thing);
+        break;
+    case HINT_PUSH:
+        snprintf(out, size, "push %s", thing);
+        break;
+    case HINT_USE:
+        if (e->target >= HINT_DOOR)
+        {
+            int exits[4] = {room->north, room->south, room->east, room->west};
+            const Door *door = DoorOf(world, exits[(e->target - HINT_DOOR) & 3]);
+            if (door && door->name)
+                snprintf(out, size, "use %s %s", item, Text(world, door->name));
+            else
+                snprintf(out, size, "use %s %s door", item, directionNames[(e->target - HINT_DOOR) & 3]);
+        }
+        else
+        {
+            snprintf(out, size, "use %s %s", item, thing);
+        }
+        break;
+    case HINT_COMBINE:
+        snprintf(out, size, "combine %s %s", item, other);
+        break;
+    default:
+        snprintf(out, size, "%s", "");
+    }
+    LowercaseAscii(out, out, strlen(out));
+}
+
+// ----- the search -----
+
+typedef struct
+{
+    unsigned long long hash;
+    int state; // its session state (WriteSessionState) starts here in the pool
+    int stateLength;
+    int firstEdge;
+    int edgeCount;
+    int distance; // steps to the Gold Room, -1 = none
+    bool won;
+    HintEntry best;
+} HintNode;
+
+typedef struct
+{
+    int from;
+    int to;
+    HintEntry action;
+} HintEdge;
+
+typedef struct
+{
+    World *world;
+    HintTable *hints;
+    Session s;
+    Output sink; // nobody reads what the search says
+    HintNode *nodes;
+    int nodeCount;
+    int nodeCapacity;
+    int *lookup; // open addressing over node hashes, node index + 1 (0 = empty)
+    int lookupSize;
+    HintEdge *edges;
+    int edgeCount;
+    int edgeCapacity;
+    unsigned char *pool; // the session states
+    size_t poolUsed;
+    size_t poolSize;
+    bool failed; // out of memory or too many states
+} HintSearch;
+
+static bool GrowHintLookup(HintSearch *h)
+{
+    int newSize = h->lookupSize ? h->lookupSize * 2 : 1024;
+    int *lookup = MemCalloc(MEM_WORLD, newSize, sizeof(int));
+    if (!lookup)
+        return false;
+    for (int i = 0; i < h->nodeCount; i++)
+    {
+        unsigned int slot = (unsigned int)h->nodes[i].hash & (newSize - 1);
+        while (lookup[slot])
+            slot = (slot + 1) & (newSize - 1);
+        lookup[slot] = i + 1;
+    }
+    MemFree(h->lookup);
+    h->lookup = lookup;
+    h->lookupSize = newSize;
+    return true;
+}
+
+// the node of the state the search session is in, added if it's new. -1 = no memory or too many
+static int HintNodeOf(HintSearch *h, unsigned long long hash, bool won)
+{
+    unsigned int slot = (unsigned int)hash & (h->lookupSize - 1);
+    for (; h->lookup[slot]; slot = (slot + 1) & (h->lookupSize - 1))
+    {
+        if (h->nodes[h->lookup[slot] - 1].hash == hash)
+            return h->lookup[slot] - 1;
+    }
+    if (h->nodeCount >= MAX_HINT_STATES)
+    {
+        h->failed = true;
+        return -1;
+    }
+    StateWriter w = {NULL, NULL, 0, 0};
+    WriteSessionState(&w, &h->s); // just counts
+    if (h->poolUsed + w.length > h->poolSize)
+    {
+        size_t newSize = h->poolSize ? h->poolSize * 2 : 65536;
+        while (newSize < h->poolUsed + w.length)
+            newSize *= 2;
+        unsigned char *grown = MemRealloc(MEM_WORLD, h->pool, newSize);
+        if (!grown)
+        {
+            h->failed = true;
+            return -1;
+        }
+        h->pool = grown;
+        h->poolSize = newSize;
+    }
+    if (h->nodeCount == h->nodeCapacity)
+    {
+        int newCapacity = h->nodeCapacity ? h->nodeCapacity * 2 : 1024;
+        HintNode *grown = MemRealloc(MEM_WORLD, h->nodes, sizeof(HintNode) * newCapacity);
+        if (!grown)
+        {
+            h->failed = true;
+            return -1;
+        }
+        h->nodes = grown;
+        h->nodeCapacity = newCapacity;
+    }
+    StateWriter fill = {NULL, h->pool + h->poolUsed, w.length, 0};
+    WriteSessionState(&fill, &h->s);
+    HintNode *node = &h->nodes[h->nodeCount];
+    memset(node, 0, sizeof(*node));
+    node->hash = hash;
+    node->state = (int)h->poolUsed;
+    node->stateLength = (int)w.length;
+    node->distance = -1;
+    node->won = won;
+    h->poolUsed += w.length;
+    h->lookup[slot] = ++h->nodeCount;
+    if (h->nodeCount * 2 > h->lookupSize && !GrowHintLookup(h))
+    {
+        h->failed = true;
+        return -1;
+    }
+    return h->nodeCount - 1;
+}
+
+static bool LoadHintNode(HintSearch *h, int node)
+{
+    StateReader r = {NULL, h->pool + h->nodes[node].state, h->pool + h->nodes[node].state + h->nodes[node].stateLength};
+    h->s.riddleSlot = -1;
+    return ReadSessionState(h->world, &h->s, &r);
+}
+
+// play one step from node, and remember where it went if that's somewhere else
+static void TryHintStep(HintSearch *h, int node, const HintEntry *step)
+{
+    World *world = h->world;
+    if (!LoadHintNode(h, node))
+    {
+        h->failed = true;
+        return;
+    }
+    const Room *room = GetRoom(world, h->s.room);
+    char command[COMPLETION_LINE * 2];
+    HintCommand(world, room, step, command, sizeof(command));
+    bool running = true, won = false;
+    int slot = step->action == HINT_INTERACT ? step->target : -1;
+    RunCommand(command, world, &h->s, &running, &won, NULL);
+    if (running && slot >= 0 && h->s.riddleSlot == slot)
+    {
+        const Riddle *riddle = RiddleOf(world, room->id, slot);
+        snprintf(command, sizeof(command), "%s", riddle ? Text(world, riddle->answer) : "");
+        RunCommand(command, world, &h->s, &running, &won, NULL);
+    }
+    if (!running && !won)
+        return; // that was the end of the game, not a way forward
+    unsigned long long hash = ProgressHash(world, &h->s, h->hints->keyItem);
+    if (hash == h->nodes[node].hash)
+        return;
+    int to = HintNodeOf(h, hash, won);
+    if (to < 0)
+        return;
+    if (h->edgeCount == h->edgeCapacity)
+    {
+        int newCapacity = h->edgeCapacity ? h->edgeCapacity * 2 : 4096;
+        HintEdge *grown = MemRealloc(MEM_WORLD, h->edges, sizeof(HintEdge) * newCapacity);
+        if (!grown)
+        {
+            h->failed = true;
+            return;
+        }
+        h->edges = grown;
+        h->edgeCapacity = newCapacity;
+    }
+    h->edges[h->edgeCount].from = node;
+    h->edges[h->edgeCount].to = to;
+    h->edges[h->edgeCount].action = *step;
+    h->edgeCount++;
+}
+
+// every step worth trying from where the search session is now
+static int HintSteps(HintSearch *h, HintEntry *steps, int max)
+{
+    World *world = h->world;
+    const Session *s = &h->s;
+    const Room *room = GetRoom(world, s->room);
+    int count = 0;
+    HintEntry step = {0, 0, HINT_NONE, 0, -1, -1};
+    int exits[4] = {room->north, room->south, room->east, room->west};
+    for (int d = 0; d < 4 && count < max; d++)
+    {
+        if (exits[d] == NO_ROOM)
+            continue;
+        step.action = HINT_GO;
+        step.target = (unsigned char)d;
+        steps[count++] = step;
+    }
+    int roomItems[10];
+    int roomItemCount = RoomItems(world, s, room, roomItems);
+    for (int i = 0; i < roomItemCount && count < max; i++)
+    {
+        step.action = HINT_TAKE;
+        step.target = 0;
+        step.item = roomItems[i];
+        steps[count++] = step;
+    }
+    step.item = -1;
+    for (int slot = 0; slot < room->interactableCount && count < max; slot++)
+    {
+        step.target = (unsigned char)slot;
+        step.action = HINT_INTERACT;
+        steps[count++] = step;
+        if (PushableOf(world, room->id, slot) && !HasUsed(s, room->id, slot) && count < max)
+        {
+            step.action = HINT_PUSH;
+            steps[count++] = step;
+        }
+        const Lockable *lock = LockableOf(world, room->id, slot);
+        for (int i = 0; lock && i < s->inv.count && count < max; i++)
+        {
+            if (s->inv.items[i] != lock->key && s->inv.items[i] != lock->otherKey)
+                continue;
+            step.action = HINT_USE;
+            step.item = s->inv.items[i];
+            steps[count++] = step;
+        }
+        step.item = -1;
+    }
+    for (int d = 0; d < 4; d++)
+    {
+        const Room *next = exits[d] != NO_ROOM ? GetRoom(world, exits[d]) : NULL;
+        if (!next || !RoomLocked(s, next))
+            continue;
+        for (int i = 0; i < s->inv.count && count < max; i++)
+        {
+            if (s->inv.items[i] != next->keyItem)
+                continue;
+            step.action = HINT_USE;
+            step.target = (unsigned char)(HINT_DOOR + d);
+            step.item = s->inv.items[i];
+            steps[count++] = step;
+        }
+    }
+    for (int i = 0; i < s->inv.count; i++)
+    {
+        int item = s->inv.items[i];
+        for (int k = 0; HasRecipe(world, item) && k < s->inv.count && count < max; k++)
+        {
+            if (s->inv.items[k] != world->items[item].combineWith)
+                continue;
+            step.action = HINT_COMBINE;
+            step.item = item;
+            step.other = s->inv.items[k];
+            steps[count++] = step;
+        }
+    }
+    return count;
+}
+
+// the walk back from the won states: every node learns how far it is and its first step
+static bool WalkBackFromWins(HintSearch *h)
+{
+    int n = h->nodeCount;
+    int *firstIn = MemCalloc(MEM_WORLD, n + 1, sizeof(int)); // the edges into node i are in[firstIn[i]] up to firstIn[i + 1]
+    int *fill = MemAlloc(MEM_WORLD, sizeof(int) * n);
+    int *in = MemAlloc(MEM_WORLD, sizeof(int) * (h->edgeCount ? h->edgeCount : 1));
+    int *queue = MemAlloc(MEM_WORLD, sizeof(int) * n);
+    bool ok = firstIn && fill && in && queue;
+    if (ok)
+    {
+        for (int e = 0; e < h->edgeCount; e++)
+            firstIn[h->edges[e].to + 1]++;
+        for (int i = 0; i < n; i++)
+        {
+            firstIn[i + 1] += firstIn[i];
+            fill[i] = firstIn[i];
+        }
+        for (int e = 0; e < h->edgeCount; e++)
+            in[fill[h->edges[e].to]++] = e;
+        int head = 0, tail = 0;
+        for (int i = 0; i < n; i++)
+        {
+            if (h->nodes[i].won)
+            {
+                h->nodes[i].distance = 0;
+                queue[tail++] = i;
+            }
+        }
+        while (head < tail)
+        {
+            int to = queue[head++];
+            for (int k = firstIn[to]; k < firstIn[to + 1]; k++)
+            {
+                const HintEdge *e = &h->edges[in[k]];
+                if (h->nodes[e->from].distance != -1)
+                    continue;
+                h->nodes[e->from].distance = h->nodes[to].distance + 1;
+                h->nodes[e->from].best = e->action;
+                queue[tail++] = e->from;
+            }
+        }
+    }
+    MemFree(firstIn);
+    MemFree(fill);
+    MemFree(in);
+    MemFree(queue);
+    return ok;
+}
+
+// ----- the table -----
+
+typedef struct
+{
+    int size;
+    int bucket;
+} HintBucketSize;
+
+static int CompareBucketSizes(const void *a, const void *b)
+{
+    const HintBucketSize *x = a;
+    const HintBucketSize *y = b;
+    if (x->size != y->size)
+        return y->size - x->size;
+    return x->bucket - y->bucket;
+}
+
+// hash and displace: the biggest buckets go first, each one gets the first displacement that puts all of
+// its states into free slots. false if a bucket doesn't fit anywhere, the table needs more slots then
+static bool PlaceHints(HintTable *hints, const HintSearch *h, const int *states, int stateCount)
+{
+    int bucketCount = hints->bucketCount;
+    int *first = MemCalloc(MEM_WORLD, bucketCount + 1, sizeof(int)); // bucket b has members[first[b]] up to first[b + 1]
+    int *fill = MemAlloc(MEM_WORLD, sizeof(int) * bucketCount);
+    int *members = MemAlloc(MEM_WORLD, sizeof(int) * (stateCount ? stateCount : 1));
+    unsigned int *slots = MemAlloc(MEM_WORLD, sizeof(unsigned int) * (stateCount ? stateCount : 1));
+    HintBucketSize *order = MemAlloc(MEM_WORLD, sizeof(HintBucketSize) * bucketCount);
+    bool ok = first && fill && members && slots && order;
+    if (ok)
+    {
+        for (int i = 0; i < stateCount; i++)
+            first[HintBucket(hints, h->nodes[states[i]].hash) + 1]++;
+        for (int b = 0; b < bucketCount; b++)
+        {
+            first[b + 1] += first[b];
+            fill[b] = first[b];
+        }
+        for (int i = 0; i < stateCount; i++)
+            members[fill[HintBucket(hints, h->nodes[states[i]].hash)]++] = states[i];
+        for (int b = 0; b < bucketCount; b++)
+        {
+            order[b].size = first[b + 1] - first[b];
+            order[b].bucket = b;
+        }
+        qsort(order, bucketCount, sizeof(HintBucketSize), CompareBucketSizes);
+    }
+    for (int k = 0; ok && k < bucketCount && order[k].size > 0; k++)
+    {
+        int b = order[k].bucket;
+        const int *mine = &members[first[b]];
+        unsigned int d = 0;
+        bool fits = false;
+        for (; !fits && d < MAX_DISPLACEMENT; d++)
+        {
+            fits = true;
+            for (int j = 0; fits && j < order[k].size; j++)
+            {
+                slots[j] = HintSlot(hints, h->nodes[mine[j]].hash, d);
+                fits = hints->entries[slots[j]].check == 0;
+                for (int i = 0; fits && i < j; i++)
+                    fits = slots[i] != slots[j];
+            }
+        }
+        if (!fits)
+        {
+            ok = false;
+            break;
+        }
+        hints->displace[b] = d - 1;
+        for (int j = 0; j < order[k].size; j++)
+        {
+            const HintNode *node = &h->nodes[mine[j]];
+            HintEntry e = node->best;
+            if (node->distance < 0)
+            {
+                memset(&e, 0, sizeof(e));
+                e.action = HINT_NONE;
+                e.distance = HINT_FAR;
+            }
+            else
+            {
+                e.distance = (unsigned short)(node->distance < HINT_FAR ? node->distance : HINT_FAR - 1);
+            }
+            e.check = HintCheck(node->hash);
+            hints->entries[slots[j]] = e;
+        }
+    }
+    MemFree(first);
+    MemFree(fill);
+    MemFree(members);
+    MemFree(slots);
+    MemFree(order);
+    return ok;
+}
+
+// the whole search and the table out of it, NULL (and report says why) if it can't be done
+static HintTable *BuildHints(World *world, FILE *report)
+{
+    long long start = NowMs();
+    HintSearch h;
+    memset(&h, 0, sizeof(h));
+    h.world = world;
+    h.hints = MemCalloc(MEM_WORLD, 1, sizeof(HintTable));
+    bool ok = h.hints && FindKeyItems(world, h.hints) && StartSession(&h.s, world);
+    if (!ok)
+    {
+        fprintf(report, "Memory fail - couldn't start the hint search\n");
+        FreeHints(h.hints);
+        return NULL;
+    }
+    h.s.history.depth = 0; // nothing to take back
+    h.s.out = &h.sink;
+    ok = GrowHintLookup(&h) && HintNodeOf(&h, ProgressHash(world, &h.s, h.hints->keyItem), false) == 0;
+    HintEntry steps[128];
+    for (int node = 0; ok && !h.failed && node < h.nodeCount; node++)
+    {
+        h.nodes[node].firstEdge = h.edgeCount;
+        if (h.nodes[node].won)
+            continue;
+        if (!LoadHintNode(&h, node))
+        {
+            h.failed = true;
+            break;
+        }
+        int stepCount = HintSteps(&h, steps, 128);
+        for (int i = 0; i < stepCount && !h.failed; i++)
+            TryHintStep(&h, node, &steps[i]);
+        h.nodes[node].edgeCount = h.edgeCount - h.nodes[node].firstEdge;
+    }
+    EndSession(&h.s, world);
+    if (h.nodeCount >= MAX_HINT_STATES)
+        fprintf(report, "More than %d states, that's too many for a hint table\n", MAX_HINT_STATES);
+    else if (!ok || h.failed)
+        fprintf(report, "Memory fail - couldn't finish the hint search\n");
+    ok = ok && !h.failed && WalkBackFromWins(&h);
+
+    // the won states never ask for a hint, the game is over there
+    HintTable *hints = h.hints;
+    int *states = ok ? MemAlloc(MEM_WORLD, sizeof(int) * h.nodeCount) : NULL;
+    int stateCount = 0, winnable = 0;
+    for (int i = 0; states && i < h.nodeCount; i++)
+    {
+        if (h.nodes[i].won)
+            continue;
+        states[stateCount++] = i;
+        winnable += h.nodes[i].distance >= 0;
+    }
+    ok = ok && states;
+    hints->stateCount = stateCount;
+    hints->slotCount = stateCount + stateCount / 4 + 1;
+    hints->bucketCount = stateCount / HINT_BUCKET_SIZE + 1;
+    bool placed = false;
+    for (int tries = 0; ok && !placed && tries < 8; tries++)
+    {
+        MemFree(hints->displace);
+        MemFree(hints->entries);
+        hints->displace = MemCalloc(MEM_WORLD, hints->bucketCount, sizeof(unsigned int));
+        hints->entries = MemCalloc(MEM_WORLD, hints->slotCount, sizeof(HintEntry));
+        ok = hints->displace && hints->entries;
+        placed = ok && PlaceHints(hints, &h, states, stateCount);
+        if (!placed)
+            hints->slotCount += hints->slotCount / 4 + 1;
+    }
+    if (ok && !placed)
+        fprintf(report, "Couldn't find a perfect hash for %d states\n", stateCount);
+    ok = ok && placed;
+    if (ok)
+    {
+        fprintf(report, "%d states (%d of them can still win, from the start it's %d steps), %d key items\n", stateCount,
+                winnable, h.nodes[0].distance, hints->keyItemCount);
+        fprintf(report, "table: %d slots, %d buckets, %zu bytes, made in %lld ms\n", hints->slotCount, hints->bucketCount,
+                sizeof(HintEntry) * hints->slotCount + sizeof(unsigned int) * hints->bucketCount, NowMs() - start);
+    }
+    MemFree(states);
+    MemFree(h.nodes);
+    MemFree(h.lookup);
+    MemFree(h.edges);
+    MemFree(h.pool);
+    if (!ok)
+    {
+        FreeHints(hints);
+        return NULL;
+    }
+    return hints;
+}
+
+// what a hint file says it was made for, so it doesn't get used with another world
+static unsigned int WorldFingerprint(const World *world)
+{
+    unsigned int h = 2166136261u;
+    for (unsigned int i = 0; i < world->textSize; i++)
+        h = (h ^ (unsigned char)world->text[i]) * 16777619u;
+    return (h ^ (unsigned int)world->startRoom) * 16777619u;
+}
+
+// the offline pass: search the world and write the table for it
+// file layout: header | key items | one displacement per bucket | the slots
+bool SaveHints(const char *path, World *world)
+{
+    HintTable *hints = BuildHints(world, stdout);
+    if (!hints)
+        return false;
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        perror("Failed to create hint file");
+        FreeHints(hints);
+        return false;
+    }
+    WriteInt(file, HINT_MAGIC);
+    WriteInt(file, HINT_VERSION);
+    WriteInt(file, world->roomCount);
+    WriteInt(file, world->itemCount);
+    WriteInt(file, (int)WorldFingerprint(world));
+    WriteInt(file, hints->stateCount);
+    WriteInt(file, hints->slotCount);
+    WriteInt(file, hints->bucketCount);
+    WriteInt(file, hints->keyItemCount);
+    fwrite(hints->keyItems, sizeof(int), hints->keyItemCount, file);
+    fwrite(hints->displace, sizeof(unsigned int), hints->bucketCount, file);
+    fwrite(hints->entries, sizeof(HintEntry), hints->slotCount, file);
+    bool ok = !ferror(file);
+    if (fclose(file) != 0)
+        ok = false;
+    if (!ok)
+        fprintf(stderr, "Couldn't write the hints to %s\n", path);
+    FreeHints(hints);
+    return ok;
+}
+
+// read the table for world, quiet = say nothing if there's no file (most worlds don't have one)
+bool AttachHints(World *world, const char *path, bool quiet)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        if (!quiet)
+            perror(path);
+        return false;
+    }
+    int magic = 0, version = 0, roomCount = 0, itemCount = 0, fingerprint = 0;
+    HintTable *hints = MemCalloc(MEM_WORLD, 1, sizeof(HintTable));
+    bool ok = hints && ReadInt(file, &magic) && ReadInt(file, &version) && ReadInt(file, &roomCount) &&
+              ReadInt(file, &itemCount) && ReadInt(file, &fingerprint) && ReadInt(file, &hints->stateCount) &&
+              ReadInt(file, &hints->slotCount) && ReadInt(file, &hints->bucketCount) &&
+              ReadInt(file, &hints->keyItemCount) && magic == HINT_MAGIC && version == HINT_VERSION &&
+              hints->stateCount >= 0 && hints->stateCount <= MAX_HINT_STATES && hints->slotCount > hints->stateCount &&
+              hints->slotCount <= 4 * MAX_HINT_STATES && hints->bucketCount > 0 && hints->bucketCount <= MAX_HINT_STATES &&
+              hints->keyItemCount >= 0 && hints->keyItemCount <= world->itemCount;
+    bool sameWorld = ok && roomCount == world->roomCount && itemCount == world->itemCount &&
+                     (unsigned int)fingerprint == WorldFingerprint(world);
+    if (sameWorld)
+    {
+        hints->keyItems = MemAlloc(MEM_WORLD, sizeof(int) * (hints->keyItemCount ? hints->keyItemCount : 1));
+        hints->keyItem = MemCalloc(MEM_WORLD, world->itemCount ? world->itemCount : 1, sizeof(bool));
+        hints->displace = MemAlloc(MEM_WORLD, sizeof(unsigned int) * hints->bucketCount);
+        hints->entries = MemAlloc(MEM_WORLD, sizeof(HintEntry) * hints->slotCount);
+        ok = hints->keyItems && hints->keyItem && hints->displace && hints->entries &&
+             fread(hints->keyItems, sizeof(int), hints->keyItemCount, file) == (size_t)hints->keyItemCount &&
+             fread(hints->displace, sizeof(unsigned int), hints->bucketCount, file) == (size_t)hints->bucketCount &&
+             fread(hints->entries, sizeof(HintEntry), hints->slotCount, file) == (size_t)hints->slotCount;
+        for (int i = 0; ok && i < hints->keyItemCount; i++)
+        {
+            ok = hints->keyItems[i] >= 0 && hints->keyItems[i] < world->itemCount;
+            if (ok)
+                hints->keyItem[hints->keyItems[i]] = true;
+        }
+    }
+    fclose(file);
+    if (!sameWorld || !ok)
+    {
+        if (ok || sameWorld)
+            fprintf(stderr, "%s is for %s, no hints (make new ones with --save-hints)\n", path,
+                    sameWorld ? "a world we can't read" : "another world");
+        else
+            fprintf(stderr, "%s is not a hint file we understand\n", path);
+        FreeHints(hints);
+        return false;
+    }
+    FreeHints(world->hints);
+    world->hints = hints;
+    return true;
+}
+
+// the hint command
+void GiveHint(World *world, Session *s)
+{
+    const HintTable *hints = world->hints;
+    if (s->seat)
+    {
+        NoteFailure(s, false);
+        Say(s, "Hints don't work in a shared world, everybody's changes are mixed up in it.\n");
+        return;
+    }
+    if (!hints)
+    {
+        NoteFailure(s, false);
+        Say(s, "There are no hints for this world.\n");
+        return;
+    }
+    const HintEntry *e = FindHint(hints, ProgressHash(world, s, hints->keyItem));
+    if (!e)
+    {
+        // the search never drops anything, so a key item left lying somewhere else is the usual reason
+        for (int i = 0; i < hints->keyItemCount; i++)
+        {
+            int item = hints->keyItems[i];
+            int at = ItemLocation(world, s, item);
+            if (at >= 0 && at != world->items[item].homeRoom)
+            {
+                Say(s, "You'll need the %s, it's lying in the %s.\n", Text(world, world->items[item].name),
+                    Text(world, GetRoom(world, at)->name));
+                return;
+            }
+        }
+        Say(s, "The temple has no hint for you here.\n");
+        return;
+    }
+    if (e->distance == HINT_FAR)
+    {
+        Say(s, "There's no way to the Gold Room from here anymore. Undo might help.\n");
+        return;
+    }
+    const Room *room = GetRoom(world, s->room);
+    char command[COMPLETION_LINE * 2];
+    HintCommand(world, room, e, command, sizeof(command));
+    Say(s, "Try: %s\n", command);
+    if (e->action == HINT_INTERACT && RiddleOf(world, room->id, e->target) && !HasInteracted(s, room->id, e->target))
+        Say(s, "It asks a riddle, the answer is up to you.\n");
+    Say(s, "The Gold Room is %d step%s away.\n", e->distance, e->distance == 1 ? "" : "s");
+}
+
+// ---------------------------------------------------------------------------
+// Spectators
+// Everything the player sees is also written once into the session's
+// broadcast: a list of append-only chunks. Every spectator is just a cursor
+// into that list and gets sent straight out of the chunks (no copy per
+// spectator). A chunk is freed once every cursor is past it. Sending never
+// blocks, a spectator that can't keep up falls behind and gets dropped when
+// it's more than MAX_SPECTATOR_LAG bytes back, the player never waits.
+// ---------------------------------------------------------------------------
+
+// a chunk holds one ref for every spectator sitting in it plus one from whatever points at it
+// (the chunk before it, or the broadcast itself for the newest one)
+static BroadcastChunk *NewChunk(void)
+{
+    BroadcastChunk *chunk = (BroadcastChunk *)MemAlloc(MEM_SPECTATORS, sizeof(BroadcastChunk));
+    if (!chunk)
+        return NULL;
+    chunk->next = NULL;
+    chunk->refs = 1;
+    chunk->used = 0;
+    return chunk;
+}
+
+// let go of a chunk, the ones after it go too if nobody else holds them
+static void ReleaseChunk(BroadcastChunk *chunk)
+{
+    while (chunk && --chunk->refs == 0)
+    {
+        BroadcastChunk *next = chunk->next;
+        MemFree(chunk);
+        chunk = next;
+    }
+}
+
+Broadcast *OpenBroadcast(void)
+{
+    Broadcast *b = (Broadcast *)MemCalloc(MEM_SPECTATORS, 1, sizeof(Broadcast));
+    if (!b || !(b->tail = NewChunk()))
+    {
+        perror("Memory fail - can't set up spectators");
+        MemFree(b);
+        return NULL;
+    }
+    b->listenFd = -1;
+    return b;
+}
+
+// add output to the end, this is the only copy
+void BroadcastWrite(Broadcast *b, const char *text, int length)
+{
+    while (length > 0)
+    {
+        if (b->tail->used == BROADCAST_CHUNK)
+        {
+            BroadcastChunk *chunk = NewChunk();
+            if (!chunk)
+                return; // spectators miss some output, the player doesn't care
+            b->tail->next = chunk; // the new chunk's first ref is this link
+            chunk->refs++;         // and the broadcast's ref moves over to it
+            ReleaseChunk(b->tail);
+            b->tail = chunk;
+        }
+        int n = BROADCAST_CHUNK - b->tail->used;
+        if (n > length)
+            n = length;
+        memcpy(b->tail->data + b->tail->used, text, n);
+        b->tail->used += n;
+        b->written += n;
+        text += n;
+        length -= n;
+    }
+}
+
+// new spectator starts watching from now on, fd -1 = nobody to send to (benchmarks)
+bool AddSpectator(Broadcast *b, int fd)
+{
+    if (b->count == b->capacity)
+    {
+        int new_capacity = b->capacity ? b->capacity * 2 : 8;
+        Spectator *new_spectators = MemRealloc(MEM_SPECTATORS, b->spectators, sizeof(Spectator) * new_capacity);
+        if (!new_spectators)
+            return false;
+        b->spectators = new_spectators;
+        b->capacity = new_capacity;
+    }
+    Spectator *v = &b->spectators[b->count++];
+    v->fd = fd;
+    v->chunk = b->tail;
+    v->offset = b->tail->used;
+    v->position = b->written;
+    b->tail->refs++;
+    return true;
+}
+
+static void DropSpectator(Broadcast *b, int index)
+{
+    Spectator *v = &b->spectators[index];
+#ifndef _WIN32
+    if (v->fd >= 0)
+        close(v->fd);
+#endif
+    ReleaseChunk(v->chunk);
+    b->spectators[index] = b->spectators[--b->count];
+}
+
+// point iov at what a spectator hasn't seen yet (straight into the chunks), returns how many pieces
+static int PendingOutput(const Spectator *v, struct iovec *iov, int max)
+{
+    int n = 0;
+    const BroadcastChunk *chunk = v->chunk;
+    int offset = v->offset;
+    while (chunk && n < max)
+    {
+        if (offset < chunk->used)
+        {
+            iov[n].iov_base = (void *)(chunk->data + offset);
+            iov[n].iov_len = (size_t)(chunk->used - offset);
+            n++;
+        }
+        chunk = chunk->next;
+        offset = 0;
+    }
+    return n;
+}
+
+// move a spectator's cursor forward, dropping refs on chunks it's done with
+static void Consume(Spectator *v, long long bytes)
+{
+    v->position += bytes;
+    while (bytes > 0 || (v->offset == v->chunk->used && v->chunk->next))
+    {
+        if (v->offset == v->chunk->used)
+        {
+            BroadcastChunk *next = v->chunk->next;
+            next->refs++;
+            ReleaseChunk(v->chunk);
+            v->chunk = next;
+            v->offset = 0;
+            continue;
+        }
+        int n = v->chunk->used - v->offset;
+        if (n > bytes)
+            n = (int)bytes;
+        v->offset += n;
+        bytes -= n;
+    }
+}
+
+#ifndef _WIN32
+// let in everybody who's waiting to watch
+static void AcceptSpectators(Broadcast *b)
+{
+    for (;;)
+    {
+        int fd = accept(b->listenFd, NULL, NULL);
+        if (fd < 0)
+            return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        if (!AddSpectator(b, fd))
+            close(fd);
+    }
+}
+#endif
+
+// let new spectators in and send everybody as much as their connection takes right now, never waits
+void PumpSpectators(Broadcast *b)
+{
+    if (!b)
+        return;
+#ifndef _WIN32
+    if (b->listenFd >= 0)
+        AcceptSpectators(b);
+#endif
+    for (int i = b->count - 1; i >= 0; i--)
+    {
+        Spectator *v = &b->spectators[i];
+        if (b->written - v->position > MAX_SPECTATOR_LAG)
+        {
+            b->dropped++;
+            DropSpectator(b, i);
+            continue;
+        }
+        struct iovec iov[16];
+        int pieces = PendingOutput(v, iov, 16);
+        if (pieces == 0)
+            continue;
+        long long sent = 0;
+        if (v->fd < 0)
+        {
+            // nobody on the other end, pretend it all went out
+            for (int k = 0; k < pieces; k++)
+                sent += (long long)iov[k].iov_len;
+        }
+        else
+        {
+#ifndef _WIN32
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = (size_t)pieces;
+            ssize_t result = sendmsg(v->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                continue; // their connection is full, try again later
+            if (result < 0)
+            {
+                DropSpectator(b, i); // they left
+                continue;
+            }
+            sent = result;
+#endif
+        }
+        Consume(v, sent);
+    }
+}
+
+#ifndef _WIN32
+// start taking spectators on a unix socket (nc -U <path> to watch)
+bool ListenForSpectators(Broadcast *b, const char *path)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Spectator socket path is too long: %s\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror("Failed to make spectator socket");
+        return false;
+    }
+    unlink(path); // left over from a game that crashed
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 64) != 0)
+    {
+        perror("Failed to open spectator socket");
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    b->listenFd = fd;
+    snprintf(b->path, sizeof(b->path), "%s", path);
+    return true;
+}
+
+// add our sockets to a select() call, returns the highest fd
+int SpectatorFds(const Broadcast *b, fd_set *input, fd_set *output, int top)
+{
+    if (!b)
+        return top;
+    if (b->listenFd >= 0)
+    {
+        FD_SET(b->listenFd, input);
+        if (b->listenFd > top)
+            top = b->listenFd;
+    }
+    for (int i = 0; i < b->count; i++)
+    {
+        const Spectator *v = &b->spectators[i];
+        if (v->fd >= 0 && v->fd < FD_SETSIZE && v->position < b->written)
+        {
+            FD_SET(v->fd, output);
+            if (v->fd > top)
+                top = v->fd;
+        }
+    }
+    return top;
+}
+
+#endif
+
+void CloseBroadcast(Broadcast *b)
+{
+    if (!b)
+        return;
+    PumpSpectators(b); // last chance for everybody to see how it ended
+    while (b->count > 0)
+        DropSpectator(b, b->count - 1);
+    MemFree(b->spectators);
+#ifndef _WIN32
+    if (b->listenFd >= 0)
+    {
+        close(b->listenFd);
+        unlink(b->path);
+    }
+#endif
+    ReleaseChunk(b->tail);
+    MemFree(b);
+}
+
+// how much CPU one more spectator costs: stream a game's worth of output to n in-process spectators
+void BenchSpectators(int spectators)
+{
+    const char *line = "A room filled with strange machinery. There's a large control panel in the center.\n";
+    int lineLength = (int)strlen(line);
+    const int messages = 20000;
+    int counts[2] = {0, spectators};
+    double seconds[2];
+    for (int run = 0; run < 2; run++)
+    {
+        Broadcast *b = OpenBroadcast();
+        if (!b)
+            return;
+        for (int i = 0; i < counts[run]; i++)
+            AddSpectator(b, -1);
+        clock_t start = clock();
+        for (int i = 0; i < messages; i++)
+        {
+            BroadcastWrite(b, line, lineLength);
+            PumpSpectators(b);
+        }
+        seconds[run] = (double)(clock() - start) / CLOCKS_PER_SEC;
+        CloseBroadcast(b);
+    }
+    double perSpectator = spectators ? (seconds[1] - seconds[0]) / spectators / messages * 1e9 : 0;
+    printf("%d messages of %d bytes\n", messages, lineLength);
+    printf("  no spectators:   %.3f s CPU\n", seconds[0]);
+    printf("  %d spectators: %.3f s CPU\n", spectators, seconds[1]);
+    printf("  per spectator per message: %.1f ns (%.3f ns per byte), nothing copied\n",
+           perSpectator, perSpectator / lineLength);
+    printf("  (sending to a real socket adds one sendmsg per spectator on top)\n");
+}
+
+// ---------------------------------------------------------------------------
+// World versions (--watch-world, host_* in temple.h)
+// A world that can be swapped while people play on it. Every version is a
+// page file loaded whole (LoadWholeWorld) and never changes after it's out,
+// so sessions read it without locks. A new version gets loaded and checked
+// on whatever thread asked for it, then goes out with one atomic store, and
+// each session switches over between two commands (FollowWorld).
+// An old version can't be freed while some session might still be on it.
+// Every session says which epoch it saw at its last command boundary
+// (quiescent state based reclamation): a version replaced in epoch e is
+// freed once every session has seen e or later. Publishing, freeing and
+// sessions joining or leaving take the host's lock, commands never do.
+// ---------------------------------------------------------------------------
+
+#define WATCH_MS 500 // how often --watch-world looks at the file
+
+typedef struct WorldVersion
+{
+    World *world;
+    int number;                // 1 for the first one
+    long long retiredAt;       // the epoch it was replaced in
+    struct WorldVersion *next; // retired list
+} WorldVersion;
+
+// one session following a host
+typedef struct WorldReader
+{
+    atomic_llong seen; // the epoch at its last command boundary
+    struct WorldReader *next;
+} WorldReader;
+
+struct TempleHost
+{
+    _Atomic(WorldVersion *) current;
+    atomic_llong epoch; // goes up every time a version is replaced
+    atomic_flag lock;   // everything below (only held for a moment, never by a command)
+    WorldReader *readers;
+    WorldVersion *retired;
+    int versions; // how many have been published
+    char path[256];
+#ifndef _WIN32
+    pthread_t watcher;
+    bool watching;
+    atomic_bool stopWatching;
+#endif
+};
+typedef struct TempleHost WorldHost;
+
+static void LockHost(WorldHost *host)
+{
+    while (atomic_flag_test_and_set_explicit(&host->lock, memory_order_acquire))
+        ;
+}
+
+static void UnlockHost(WorldHost *host)
+{
+    atomic_flag_clear_explicit(&host->lock, memory_order_release);
+}
+
+// free the versions nobody can be on anymore, returns how many old ones are still around
+int CollectVersions(WorldHost *host)
+{
+    LockHost(host);
+    long long oldest = atomic_load(&host->epoch);
+    for (WorldReader *r = host->readers; r; r = r->next)
+    {
+        long long seen = atomic_load(&r->seen);
+        if (seen < oldest)
+            oldest = seen;
+    }
+    int left = 0;
+    WorldVersion *done = NULL;
+    WorldVersion **link = &host->retired;
+    while (*link)
+    {
+        WorldVersion *v = *link;
+        if (v->retiredAt <= oldest)
+        {
+            *link = v->next;
+            v->next = done;
+            done = v;
+        }
+        else
+        {
+            link = &v->next;
+            left++;
+        }
+    }
+    UnlockHost(host);
+    // a whole world can take a while to free, nobody has to wait for that
+    while (done)
+    {
+        WorldVersion *v = done;
+        done = v->next;
+        CloseWorld(v->world);
+        MemFree(v);
+    }
+    return left;
+}
+
+// load path (NULL = the host's file again) and put it out as the next version
+// sessions keep their room and item ids, so a new version can add rooms and items at the end but
+// not take any away, and it has to pass the validator. returns the version number, -1 if it didn't go out
+int ReloadWorld(WorldHost *host, const char *path)
+{
+    World *world = LoadWholeWorld(path ? path : host->path);
+    if (!world)
+        return -1;
+    int problems = ValidateWorld(world, 0, NULL);
+    if (problems > 0)
+        fprintf(stderr, "The new world has %d problems (see --validate), keeping the old one\n", problems);
+    WorldVersion *v = problems ? NULL : MemCalloc(MEM_WORLD, 1, sizeof(WorldVersion));
+    if (!v)
+    {
+        CloseWorld(world);
+        return -1;
+    }
+    v->world = world;
+    LockHost(host);
+    const World *now = atomic_load(&host->current)->world;
+    if (world->roomCount < now->roomCount || world->itemCount < now->itemCount)
+    {
+        fprintf(stderr, "The new world has %d rooms and %d items, it needs at least the %d and %d of the old one\n",
+                world->roomCount, world->itemCount, now->roomCount, now->itemCount);
+        UnlockHost(host);
+        CloseWorld(world);
+        MemFree(v);
+        return -1;
+    }
+    v->number = ++host->versions;
+    // the new one has to be out before the epoch moves: whoever sees the new epoch gets the new version
+    WorldVersion *old = atomic_exchange(&host->current, v);
+    old->retiredAt = atomic_fetch_add(&host->epoch, 1) + 1;
+    old->next = host->retired;
+    host->retired = old;
+    UnlockHost(host);
+    CollectVersions(host);
+    return v->number;
+}
+
+WorldHost *OpenWorldHost(const char *path)
+{
+    WorldHost *host = MemCalloc(MEM_WORLD, 1, sizeof(WorldHost));
+    WorldVersion *v = MemCalloc(MEM_WORLD, 1, sizeof(WorldVersion));
+    World *world = host && v ? LoadWholeWorld(path) : NULL;
+    if (!world)
+    {
+        MemFree(host);
+        MemFree(v);
+        return NULL;
+    }
+    atomic_flag_clear(&host->lock);
+    snprintf(host->path, sizeof(host->path), "%s", path);
+    v->world = world;
+    v->number = host->versions = 1;
+    atomic_init(&host->current, v);
+    atomic_init(&host->epoch, 0);
+    return host;
+}
+
+// a session starts following the host, it's on the version that's out right now
+WorldReader *JoinWorldHost(WorldHost *host, WorldVersion **version)
+{
+    WorldReader *r = MemCalloc(MEM_WORLD, 1, sizeof(WorldReader));
+    if (!r)
+        return NULL;
+    LockHost(host);
+    atomic_init(&r->seen, atomic_load(&host->epoch));
+    r->next = host->readers;
+    host->readers = r;
+    *version = atomic_load(&host->current);
+    UnlockHost(host);
+    return r;
+}
+
+void LeaveWorldHost(WorldHost *host, WorldReader *reader)
+{
+    if (!reader)
+        return;
+    LockHost(host);
+    for (WorldReader **link = &host->readers; *link; link = &(*link)->next)
+    {
+        if (*link == reader)
+        {
+            *link = reader->next;
+            break;
+        }
+    }
+    UnlockHost(host);
+    MemFree(reader);
+}
+
+// at a command boundary: say we're done with whatever came before, true if there's a newer version
+// to go to (version is set to it). two atomic loads and a store, nothing else
+bool FollowWorld(WorldHost *host, WorldReader *reader, WorldVersion **version)
+{
+    atomic_store(&reader->seen, atomic_load(&host->epoch));
+    WorldVersion *v = atomic_load(&host->current);
+    if (v == *version)
+        return false;
+    *version = v;
+    return true;
+}
+
+// the session goes over to another version of its world (between commands, never in a riddle)
+// ids stay the same, so the only thing that has to change is what tab completion calls things
+void MoveSession(Session *s, World *world)
+{
+    s->world = world;
+    if (!s->completer.world)
+        return;
+    s->completer.world = world;
+    FillScope(world, s);
+}
+
+#ifndef _WIN32
+// --watch-world: load the file again whenever it changes (write the new one next to it and rename it over)
+static void *WatchWorldJob(void *arg)
+{
+    WorldHost *host = arg;
+    struct stat st;
+    struct timespec last = {0, 0};
+    off_t lastSize = -1;
+    if (stat(host->path, &st) == 0)
+    {
+        last = st.st_mtim;
+        lastSize = st.st_size;
+    }
+    while (!atomic_load(&host->stopWatching))
+    {
+        struct timespec nap = {0, WATCH_MS * 1000000L};
+        nanosleep(&nap, NULL);
+        if (stat(host->path, &st) == 0 &&
+            (st.st_mtim.tv_sec != last.tv_sec || st.st_mtim.tv_nsec != last.tv_nsec || st.st_size != lastSize))
+        {
+            last = st.st_mtim;
+            lastSize = st.st_size;
+            ReloadWorld(host, NULL);
+        }
+        CollectVersions(host);
+    }
+    return NULL;
+}
+
+bool WatchWorldFile(WorldHost *host)
+{
+    atomic_init(&host->stopWatching, false);
+    host->watching = pthread_create(&host->watcher, NULL, WatchWorldJob, host) == 0;
+    if (!host->watching)
+        perror("Couldn't start watching the world file");
+    return host->watching;
+}
+#endif
+
+// after every session left
+void CloseWorldHost(WorldHost *host)
+{
+    if (!host)
+        return;
+#ifndef _WIN32
+    if (host->watching)
+    {
+        atomic_store(&host->stopWatching, true);
+        pthread_join(host->watcher, NULL);
+    }
+#endif
+    while (host->readers)
+    {
+        WorldReader *r = host->readers;
+        host->readers = r->next;
+        MemFree(r);
+    }
+    while (host->retired)
+    {
+        WorldVersion *v = host->retired;
+        host->retired = v->next;
+        CloseWorld(v->world);
+        MemFree(v);
+    }
+    WorldVersion *v = atomic_load(&host->current);
+    CloseWorld(v->world);
+    MemFree(v);
+    MemFree(host);
+}
+
+// ---------------------------------------------------------------------------
+// Machine mode (--json)
+// For bots and test drivers. There's no title, no prompt and no ASCII art, and
+// every command gets answered with one JSON object on one line:
+//   {"seq":3,"status":"ok","room":0,"inv_add":[0],"room_del":[0],"message":"..."}
+// What the game says goes into a fixed buffer (session.out) and becomes the
+// message. MoveItem notes where each item was before the command touched it,
+// and that's enough to work out what changed in the bag and in the room.
+// A record is written in one pass into a buffer on the stack and goes out in
+// one fwrite, nothing gets allocated.
+// ---------------------------------------------------------------------------
+
+#define MACHINE_TEXT 16384 // longest message a record carries, more gets cut off (and says so)
+
+// MoveItem tells us about every move, only the first one per item matters (that's where it came from)
+void NoteMove(MachineState *m, int itemId, int from)
+{
+    if (m->moveCount > MAX_TRACKED_MOVES)
+        return; // lost track already
+    for (int i = 0; i < m->moveCount; i++)
+    {
+        if (m->moves[i].item == itemId)
+            return;
+    }
+    if (m->moveCount < MAX_TRACKED_MOVES)
+    {
+        m->moves[m->moveCount].item = itemId;
+        m->moves[m->moveCount].from = from;
+    }
+    m->moveCount++;
+}
+
+// the command was understood but didn't happen, so its record says so and a bot doesn't have to read the message:
+// "blocked" = something's in the way (a locked door, a full bag or room, a riddle first),
+// "failed" = anything else (nothing by that name, not in the bag, doesn't fit, wrong answer)
+void NoteFailure(const Session *s, bool blocked)
+{
+    if (s->machine && !s->machine->failure)
+        s->machine->failure = blocked ? "blocked" : "failed";
+}
+
+// a record gets put together here and goes out in one fwrite (or a few, if the message is long)
+typedef struct
+{
+    FILE *file;
+    int used;
+    char text[4096];
+} JsonOut;
+
+static void JsonFlush(JsonOut *j)
+{
+    fwrite(j->text, 1, j->used, j->file);
+    j->used = 0;
+}
+
+static void JsonPut(JsonOut *j, const char *text, size_t length)
+{
+    while (length > 0)
+    {
+        if (j->used == (int)sizeof(j->text))
+            JsonFlush(j);
+        size_t room = sizeof(j->text) - j->used;
+        size_t n = length < room ? length : room;
+        memcpy(j->text + j->used, text, n);
+        j->used += (int)n;
+        text += n;
+        length -= n;
+    }
+}
+
+static void JsonLiteral(JsonOut *j, const char *text)
+{
+    JsonPut(j, text, strlen(text));
+}
+
+static void JsonInt(JsonOut *j, long long value)
+{
+    char digits[24];
+    int n = sizeof(digits);
+    unsigned long long v = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do
+    {
+        digits[--n] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    if (value < 0)
+        digits[--n] = '-';
+    JsonPut(j, digits + n, sizeof(digits) - n);
+}
+
+// a JSON string, quotes and all. the plain runs between escapes get copied in one go
+static void JsonString(JsonOut *j, const char *text, size_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+    JsonPut(j, "\"", 1);
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = (unsigned char)text[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue; // UTF-8 goes through as it is
+        JsonPut(j, text + run, i - run);
+        run = i + 1;
+        char escape[6] = {'\\', (char)c, 0, 0, 0, 0};
+        int n = 2;
+        if (c == '\n')
+            escape[1] = 'n';
+        else if (c == '\r')
+            escape[1] = 'r';
+        else if (c == '\t')
+            escape[1] = 't';
+        else if (c < 0x20)
+        {
+            memcpy(escape + 1, "u00", 3);
+            escape[4] = hex[c >> 4];
+            escape[5] = hex[c & 15];
+            n = 6;
+        }
+        JsonPut(j, escape, n);
+    }
+    JsonPut(j, text + run, length - run);
+    JsonPut(j, "\"", 1);
+}
+
+// ,"key":[1,2,3] (left out when there's nothing in it, unless always)
+static void JsonIds(JsonOut *j, const char *key, const int *ids, int count, bool always)
+{
+    if (count == 0 && !always)
+        return;
+    JsonLiteral(j, ",\"");
+    JsonLiteral(j, key);
+    JsonLiteral(j, "\":[");
+    for (int i = 0; i < count; i++)
+    {
+        if (i)
+            JsonPut(j, ",", 1);
+        JsonInt(j, ids[i]);
+    }
+    JsonPut(j, "]", 1);
+}
+
+// ,"message":"..." with everything said since the last record, then the buffer is empty again
+static void JsonMessage(JsonOut *j, Session *s)
+{
+    Output *out = s->out;
+    size_t length = out ? out->length : 0;
+    bool truncated = out && length >= out->size;
+    if (truncated)
+    {
+        // don't cut a UTF-8 character in half
+        length = out->size - 1;
+        while (length > 0 && ((unsigned char)out->text[length] & 0xC0) == 0x80)
+            length--;
+    }
+    JsonLiteral(j, ",\"message\":");
+    JsonString(j, out ? out->text : "", length);
+    if (truncated)
+        JsonLiteral(j, ",\"truncated\":true");
+    if (out)
+    {
+        out->length = 0;
+        out->text[0] = '\0';
+    }
+}
+
+// {"seq":n,"status":"...","room":n (how every record starts)
+static void JsonStart(JsonOut *j, FILE *file, long long seq, const char *status, int room)
+{
+    j->file = file;
+    j->used = 0;
+    JsonLiteral(j, "{\"seq\":");
+    JsonInt(j, seq);
+    JsonLiteral(j, ",\"status\":\"");
+    JsonLiteral(j, status);
+    JsonLiteral(j, "\",\"room\":");
+    JsonInt(j, room);
+}
+
+static void JsonRoomName(JsonOut *j, const World *world, const Room *room)
+{
+    const char *name = Text(world, room->name);
+    JsonLiteral(j, ",\"room_name\":");
+    JsonString(j, name, strlen(name));
+}
+
+static void JsonEnd(JsonOut *j)
+{
+    JsonPut(j, "}\n", 2);
+    JsonFlush(j);
+}
+
+// the next command starts from here
+static void StartMachineCommand(Session *s)
+{
+    MachineState *m = s->machine;
+    m->startRoom = s->room;
+    m->unknownCommand = false;
+    m->failure = NULL;
+    m->moveCount = 0;
+}
+
+// the first record: where the player is, what's there and what's in the bag,
+// plus every item's name (the other records only have ids, an id is where its name is in here)
+void WriteMachineIntro(FILE *f, World *world, Session *s, bool recovered)
+{
+    SayWelcome(world, s, recovered);
+    const Room *room = GetRoom(world, s->room);
+    JsonOut j;
+    JsonStart(&j, f, s->machine->seq, s->riddleSlot >= 0 ? "riddle" : "start", s->room);
+    if (recovered)
+        JsonLiteral(&j, ",\"recovered\":true");
+    JsonRoomName(&j, world, room);
+    int items[10];
+    JsonIds(&j, "room_items", items, RoomItems(world, s, room, items), true);
+    JsonIds(&j, "inventory", s->inv.items, s->inv.count, true);
+    JsonLiteral(&j, ",\"items\":[");
+    for (int i = 0; i < world->itemCount; i++)
+    {
+        if (i)
+            JsonPut(&j, ",", 1);
+        const char *name = Text(world, world->items[i].name);
+        JsonString(&j, name, strlen(name));
+    }
+    JsonPut(&j, "]", 1);
+    JsonMessage(&j, s);
+    JsonEnd(&j);
+    StartMachineCommand(s);
+}
+
+// one record for the command that just ran:
+// status is ok, failed or blocked (understood but it didn't happen, see NoteFailure), unknown (didn't get the command),
+// riddle (waiting for an answer), won or over,
+// room_name and room_items only when the player walked into another room,
+// inv_add/inv_del/room_add/room_del are item ids that came or went (left out when empty)
+void WriteMachineRecord(FILE *f, World *world, Session *s, bool running, bool won)
+{
+    MachineState *m = s->machine;
+    const char *status = won                  ? "won"
+                         : !running           ? "over"
+                         : s->riddleSlot >= 0 ? "riddle"
+                         : m->unknownCommand  ? "unknown"
+                         : m->failure         ? m->failure
+                                              : "ok";
+    JsonOut j;
+    JsonStart(&j, f, ++m->seq, status, s->room);
+    const Room *room = GetRoom(world, s->room);
+    bool entered = s->room != m->startRoom;
+    bool lostTrack = m->moveCount > MAX_TRACKED_MOVES;
+    if (entered)
+        JsonRoomName(&j, world, room);
+    if (entered || lostTrack)
+    {
+        int items[10];
+        JsonIds(&j, "room_items", items, RoomItems(world, s, room, items), true);
+    }
+    if (lostTrack)
+    {
+        // too much moved around to list it, here's all of it
+        JsonIds(&j, "inventory", s->inv.items, s->inv.count, true);
+    }
+    else
+    {
+        int invAdd[MAX_TRACKED_MOVES], invDel[MAX_TRACKED_MOVES];
+        int roomAdd[MAX_TRACKED_MOVES], roomDel[MAX_TRACKED_MOVES];
+        int invAdded = 0, invDeleted = 0, roomAdded = 0, roomDeleted = 0;
+        for (int i = 0; i < m->moveCount; i++)
+        {
+            int item = m->moves[i].item;
+            int from = m->moves[i].from;
+            int now = ItemLocation(world, s, item);
+            if (now == from)
+                continue; // picked up and dropped again
+            if (now == IN_INVENTORY)
+                invAdd[invAdded++] = item;
+            if (from == IN_INVENTORY)
+                invDel[invDeleted++] = item;
+            // a new room got its full list already
+            if (!entered && now == s->room)
+                roomAdd[roomAdded++] = item;
+            if (!entered && from == s->room)
+                roomDel[roomDeleted++] = item;
+        }
+        JsonIds(&j, "inv_add", invAdd, invAdded, false);
+        JsonIds(&j, "inv_del", invDel, invDeleted, false);
+        JsonIds(&j, "room_add", roomAdd, roomAdded, false);
+        JsonIds(&j, "room_del", roomDel, roomDeleted, false);
+    }
+    JsonMessage(&j, s);
+    JsonEnd(&j);
+    StartMachineCommand(s);
+}
+
+// ---------------------------------------------------------------------------
+// Library (temple.h)
+// A TempleGame is a world and one session, that's all the state a game has,
+// so a process can hold as many of them as it likes. Every call points the
+// session's output at the caller's buffer (Say writes there instead of
+// stdout) and takes it away again before returning. There's no journal, no
+// log file and no real clock: time is whatever game_tick adds up to.
+// ---------------------------------------------------------------------------
+
+struct TempleGame
+{
+    World *world;
+    Session session;
+    long long clockMs; // game_tick adds up here, the timers move a whole tick at a time
+    bool running;
+    bool won;
+    WorldHost *host; // NULL if the game has its own world
+    WorldReader *reader;
+    WorldVersion *version;
+    SharedWorld *shared; // NULL unless the game joined a shared world
+    SharedSeat seat;
+};
+
+TempleGame *game_create(const char *worldPath)
+{
+    TempleGame *game = MemCalloc(MEM_WORLD, 1, sizeof(TempleGame));
+    if (!game)
+        return NULL;
+    game->world = worldPath ? OpenWorld(worldPath, DEFAULT_ROOM_CACHE) : OpenTableWorld(&builtinWorld);
+    if (!game->world || !StartSession(&game->session, game->world))
+    {
+        if (game->world)
+            CloseWorld(game->world);
+        MemFree(game);
+        return NULL;
+    }
+    game->running = true;
+    return game;
+}
+
+TempleHost *host_create(const char *worldPath)
+{
+    return worldPath ? OpenWorldHost(worldPath) : NULL;
+}
+
+int host_reload(TempleHost *host, const char *worldPath)
+{
+    return ReloadWorld(host, worldPath);
+}
+
+int host_collect(TempleHost *host)
+{
+    return CollectVersions(host);
+}
+
+void host_destroy(TempleHost *host)
+{
+    CloseWorldHost(host);
+}
+
+TempleGame *game_create_on(TempleHost *host)
+{
+    TempleGame *game = MemCalloc(MEM_WORLD, 1, sizeof(TempleGame));
+    if (!game)
+        return NULL;
+    game->host = host;
+    game->reader = JoinWorldHost(host, &game->version);
+    if (!game->reader || !StartSession(&game->session, game->version->world))
+    {
+        LeaveWorldHost(host, game->reader);
+        MemFree(game);
+        return NULL;
+    }
+    game->world = game->version->world;
+    game->running = true;
+    return game;
+}
+
+int game_world_version(const TempleGame *game)
+{
+    return game->host ? game->version->number : 1;
+}
+
+// ----- shared worlds -----
+// Players who join the same TempleShared are in one world together: what one of them takes is gone
+// for the others and a door one opens is open for everybody. Their room, bag, clock and timers stay
+// their own. The world is loaded whole (like a host's), so nothing in it changes while they read it.
+// Every line a player types runs holding the turn of the room they're in (a mutex per room): players
+// in one room go one after the other and hear about each other's changes in that order, players in
+// different rooms never wait on each other. A line that reaches into another room (unlocking its door)
+// only takes that room's spin lock for a moment. Undo is off, a player's changes are mixed up with
+// everybody else's.
+
+TempleShared *shared_create(const char *worldPath)
+{
+    SharedWorld *shared = MemCalloc(MEM_WORLD, 1, sizeof(SharedWorld));
+    World *world = !shared ? NULL : worldPath ? LoadWholeWorld(worldPath) : OpenTableWorld(&builtinWorld);
+    if (world)
+    {
+        shared->rooms = MemCalloc(MEM_CHANGES, world->roomCount, sizeof(SharedRoom));
+        shared->itemAt = MemAlloc(MEM_CHANGES, sizeof(atomic_int) * (world->itemCount + 1));
+        shared->moved = MemCalloc(MEM_CHANGES, world->itemCount + 1, 1);
+    }
+    if (!world || !shared->rooms || !shared->itemAt || !shared->moved)
+    {
+        if (shared)
+        {
+            MemFree(shared->rooms);
+            MemFree(shared->itemAt);
+            MemFree(shared->moved);
+        }
+        CloseWorld(world);
+        MemFree(shared);
+        return NULL;
+    }
+    shared->world = world;
+    for (int i = 0; i < world->roomCount; i++)
+    {
+#ifndef _WIN32
+        pthread_mutex_init(&shared->rooms[i].turn, NULL);
+#else
+        atomic_flag_clear(&shared->rooms[i].turn);
+#endif
+        atomic_flag_clear(&shared->rooms[i].lock);
+        atomic_init(&shared->rooms[i].waits, 0);
+    }
+    for (int i = 0; i < world->itemCount; i++)
+        atomic_init(&shared->itemAt[i], world->items[i].homeRoom);
+    atomic_init(&shared->players, 0);
+    return shared;
+}
+
+void shared_destroy(TempleShared *shared)
+{
+    if (!shared)
+        return;
+    for (int i = 0; i < shared->world->roomCount; i++)
+    {
+        SharedRoom *room = &shared->rooms[i];
+#ifndef _WIN32
+        pthread_mutex_destroy(&room->turn);
+#endif
+        MemFree(room->delta.changes);
+        MemFree(room->items);
+        MemFree(room->note);
+    }
+    MemFree(shared->rooms);
+    MemFree(shared->itemAt);
+    MemFree(shared->moved);
+    CloseWorld(shared->world);
+    MemFree(shared);
+}
+
+TempleGame *game_join(TempleShared *shared, const char *name)
+{
+    TempleGame *game = MemCalloc(MEM_WORLD, 1, sizeof(TempleGame));
+    if (!game)
+        return NULL;
+    if (!StartSession(&game->session, shared->world))
+    {
+        MemFree(game);
+        return NULL;
+    }
+    game->world = shared->world;
+    game->shared = shared;
+    game->running = true;
+    SharedSeat *seat = &game->seat;
+    seat->world = shared;
+    seat->id = atomic_fetch_add(&shared->players, 1) + 1;
+    if (name && *name)
+        snprintf(seat->name, sizeof(seat->name), "%s", name);
+    else
+        snprintf(seat->name, sizeof(seat->name), "Player %d", seat->id);
+    game->session.seat = seat;
+    game->session.history.depth = 0;
+    MoveSharedPlayer(&game->session, NO_ROOM, game->session.room);
+    FillScope(game->world, &game->session); // StartSession filled it from the empty delta
+    return game;
+}
+
+// wait until nobody else's command runs in the room
+static void TakeTurn(SharedRoom *room)
+{
+#ifndef _WIN32
+    if (pthread_mutex_trylock(&room->turn) == 0)
+        return;
+    atomic_fetch_add_explicit(&room->waits, 1, memory_order_relaxed);
+    pthread_mutex_lock(&room->turn);
+#else
+    if (!atomic_flag_test_and_set_explicit(&room->turn, memory_order_acquire))
+        return;
+    atomic_fetch_add_explicit(&room->waits, 1, memory_order_relaxed);
+    while (atomic_flag_test_and_set_explicit(&room->turn, memory_order_acquire))
+        ;
+#endif
+}
+
+static void EndTurn(SharedRoom *room)
+{
+#ifndef _WIN32
+    pthread_mutex_unlock(&room->turn);
+#else
+    atomic_flag_clear_explicit(&room->turn, memory_order_release);
+#endif
+}
+
+// one line in a shared world, the room it starts in is the one that's held (walking out doesn't let go early)
+static void RunSharedCommand(TempleGame *game, char *command)
+{
+    SharedRoom *room = &game->shared->rooms[game->session.room];
+    TakeTurn(room);
+    RunCommand(command, game->world, &game->session, &game->running, &game->won, NULL);
+    EndTurn(room);
+}
+
+// what the others did in the player's room since they last heard, in the order they did it
+static void HearRoom(Session *s)
+{
+    SharedSeat *seat = s->seat;
+    SharedRoom *room = &seat->world->rooms[s->room];
+    RoomNote heard[ROOM_NOTES];
+    int count = 0;
+    LockRoomState(room);
+    long long first = seat->heard + 1;
+    if (first < room->notes - ROOM_NOTES + 1)
+        first = room->notes - ROOM_NOTES + 1;
+    for (long long n = first; n <= room->notes; n++)
+    {
+        const RoomNote *note = &room->note[(n - 1) % ROOM_NOTES];
+        if (note->player != seat->id)
+            heard[count++] = *note;
+    }
+    seat->heard = room->notes;
+    UnlockRoomState(room);
+    for (int i = 0; i < count; i++)
+        Say(s, "%s\n", heard[i].text);
+    // things may have come or gone, what's in reach gets counted again
+    if (count > 0)
+        FillScope(seat->world->world, s);
+}
+
+// what's in the bag stays behind in the room (as much as fits there, the rest goes with them)
+static void LeaveSharedWorld(TempleGame *game)
+{
+    Session *s = &game->session;
+    SharedRoom *room = &game->shared->rooms[s->room];
+    TakeTurn(room);
+    const Room *here = GetRoom(game->world, s->room);
+    for (int i = 0; i < s->inv.count; i++)
+        PutItemInRoom(game->world, s, here, s->inv.items[i]);
+    NoteRoom(s, s->room, "%s leaves the temple.", game->seat.name);
+    EndTurn(room);
+}
+
+// everything the game says until EndOutput goes into text (snprintf rules, see temple.h)
+static void StartOutput(TempleGame *game, Output *out, char *text, size_t size)
+{
+    out->text = text && size > 0 ? text : NULL;
+    out->size = out->text ? size : 0;
+    out->length = 0;
+    if (out->text)
+        out->text[0] = '\0';
+    game->session.out = out;
+}
+
+static int EndOutput(TempleGame *game, Output *out)
+{
+    game->session.out = NULL;
+    return out->length > INT_MAX ? INT_MAX : (int)out->length;
+}
+
+int game_intro(TempleGame *game, char *out, size_t outSize)
+{
+    Output output;
+    StartOutput(game, &output, out, outSize);
+    SayWelcome(game->world, &game->session, false);
+    return EndOutput(game, &output);
+}
+
+int game_step(TempleGame *game, const char *line, char *out, size_t outSize)
+{
+    Output output;
+    StartOutput(game, &output, out, outSize);
+    if (game->shared)
+        HearRoom(&game->session);
+    // between two lines is where a game goes over to a new version of its world
+    if (game->host && game->session.riddleSlot < 0 && FollowWorld(game->host, game->reader, &game->version))
+    {
+        MoveSession(&game->session, game->version->world);
+        game->world = game->version->world;
+    }
+    // same rules as typing it: with a ';' in it the line is a batch, blank pieces don't count
+    bool batch = strchr(line, ';') != NULL;
+    const char *next = line;
+    while (next && game->running)
+    {
+        const char *from = next;
+        const char *to = batch ? strchr(from, ';') : NULL;
+        if (!to)
+            to = from + strlen(from);
+        next = *to == ';' ? to + 1 : NULL;
+        if (batch)
+        {
+            while (from < to && isspace((unsigned char)*from))
+                from++;
+            while (to > from && isspace((unsigned char)to[-1]))
+                to--;
+            if (from == to)
+                continue;
+        }
+        else
+        {
+            while (to > from && (to[-1] == '\n' || to[-1] == '\r'))
+                to--;
+        }
+        char command[100];
+        if (to - from >= (long)sizeof(command))
+        {
+            Say(&game->session, "That command is way too long, ignored it.\n");
+            continue;
+        }
+        memcpy(command, from, to - from);
+        command[to - from] = '\0';
+        if (game->shared)
+            RunSharedCommand(game, command);
+        else
+            RunCommand(command, game->world, &game->session, &game->running, &game->won, NULL);
+    }
+    return EndOutput(game, &output);
+}
+
+int game_tick(TempleGame *game, long long ms, char *out, size_t outSize)
+{
+    Output output;
+    StartOutput(game, &output, out, outSize);
+    if (game->shared)
+        HearRoom(&game->session);
+    if (game->running && ms > 0)
+    {
+        game->clockMs += ms;
+        AdvanceClock(&game->session, game->clockMs / TICK_MS);
+    }
+    return EndOutput(game, &output);
+}
+
+int game_status(const TempleGame *game)
+{
+    if (game->won)
+        return TEMPLE_WON;
+    return game->running ? TEMPLE_PLAYING : TEMPLE_OVER;
+}
+
+void game_destroy(TempleGame *game)
+{
+    if (!game)
+        return;
+    if (game->shared)
+        LeaveSharedWorld(game);
+    EndSession(&game->session, game->world);
+    if (game->host)
+        LeaveWorldHost(game->host, game->reader);
+    else if (!game->shared)
+        CloseWorld(game->world);
+    MemFree(game);
+}
+
+// ----- taking turns -----
+// A server that runs whatever it just read from a player lets one bot that pastes a few thousand
+// commands hold up everybody else until all of them are done. The scheduler sits between reading
+// and running: what comes in goes into the player's queue (scheduler_queue), and scheduler_run gives
+// every player with a whole command queued one turn per round. A turn is deficit round robin over
+// CPU time: the player's credit goes up by turnNs, commands run while there's credit left (at most
+// turnLines of them), and each one costs what it really took. A command that went over leaves the
+// credit below zero and the player sits out rounds until it's paid back; a player whose queue runs
+// dry loses what's left, so nobody saves up for a burst. A queue holds queueBytes, what doesn't fit
+// isn't taken and stays in the player's socket (backpressure, the server stops reading from them).
+// Commands end at a newline or a ';' (a batch gets no more turns than typing it line by line would),
+// blank ones are skipped. One scheduler belongs to one thread, like the games in it.
+
+#define DEFAULT_TURN_LINES 4
+#define DEFAULT_TURN_NS 250000 // 0.25 ms of CPU per player and round
+#define DEFAULT_QUEUE_BYTES 2048
+#define SCHEDULER_OUTPUT 16384 // what one command can say, more than that gets cut off
+
+typedef struct
+{
+    TempleGame *game; // NULL = free
+    TempleOutput output;
+    void *user;
+    char *queue; // queueBytes of what came in and didn't run yet
+    size_t queued;
+    long long credit; // ns the player can still use this turn, below 0 = paying back
+    bool waiting;     // in the round robin list
+    int next;         // next in the list, or the next free slot
+} SchedulerSlot;
+
+struct TempleScheduler
+{
+    SchedulerSlot *slots;
+    int count;
+    int capacity;
+    int freeSlot;    // -1 = none
+    int first, last; // players with a whole command queued, in turn order (-1 = nobody)
+    int waiting;     // how many that is
+    int turnLines;
+    long long turnNs;
+    size_t queueBytes;
+    char *command; // queueBytes + 1, the command that's running
+    char *said;    // SCHEDULER_OUTPUT, what it said
+};
+typedef struct TempleScheduler CommandScheduler;
+
+TempleScheduler *scheduler_create(int turnLines, long long turnNs, size_t queueBytes)
+{
+    CommandScheduler *sched = MemCalloc(MEM_WORLD, 1, sizeof(CommandScheduler));
+    if (!sched)
+        return NULL;
+    sched->turnLines = turnLines > 0 ? turnLines : DEFAULT_TURN_LINES;
+    sched->turnNs = turnNs > 0 ? turnNs : DEFAULT_TURN_NS;
+    sched->queueBytes = queueBytes > 0 ? queueBytes : DEFAULT_QUEUE_BYTES;
+    sched->freeSlot = sched->first = sched->last = -1;
+    sched->command = MemAlloc(MEM_WORLD, sched->queueBytes + 1);
+    sched->said = MemAlloc(MEM_WORLD, SCHEDULER_OUTPUT);
+    if (!sched->command || !sched->said)
+    {
+        scheduler_destroy(sched);
+        return NULL;
+    }
+    return sched;
+}
+
+void scheduler_destroy(TempleScheduler *sched)
+{
+    if (!sched)
+        return;
+    for (int i = 0; i < sched->count; i++)
+        MemFree(sched->slots[i].queue);
+    MemFree(sched->slots);
+    MemFree(sched->command);
+    MemFree(sched->said);
+    MemFree(sched);
+}
+
+int scheduler_add(TempleScheduler *sched, TempleGame *game, TempleOutput output, void *user)
+{
+    int id = sched->freeSlot;
+    if (id == -1 && sched->count == sched->capacity)
+    {
+        int newCapacity = sched->capacity ? sched->capacity * 2 : 16;
+        SchedulerSlot *grown = MemRealloc(MEM_WORLD, sched->slots, sizeof(SchedulerSlot) * newCapacity);
+        if (!grown)
+            return -1;
+        sched->slots = grown;
+        sched->capacity = newCapacity;
+    }
+    char *queue = MemAlloc(MEM_WORLD, sched->queueBytes);
+    if (!queue)
+        return -1;
+    if (id == -1)
+        id = sched->count++;
+    else
+        sched->freeSlot = sched->slots[id].next;
+    SchedulerSlot *slot = &sched->slots[id];
+    memset(slot, 0, sizeof(*slot));
+    slot->game = game;
+    slot->output = output;
+    slot->user = user;
+    slot->queue = queue;
+    slot->next = -1;
+    return id;
+}
+
+static void UnlinkWaiting(CommandScheduler *sched, int id)
+{
+    int *link = &sched->first;
+    int before = -1;
+    while (*link != id)
+    {
+        before = *link;
+        link = &sched->slots[*link].next;
+    }
+    *link = sched->slots[id].next;
+    if (sched->last == id)
+        sched->last = before;
+    sched->slots[id].waiting = false;
+    sched->waiting--;
+}
+
+void scheduler_remove(TempleScheduler *sched, int player)
+{
+    SchedulerSlot *slot = &sched->slots[player];
+    if (slot->waiting)
+        UnlinkWaiting(sched, player);
+    MemFree(slot->queue);
+    slot->queue = NULL;
+    slot->game = NULL;
+    slot->next = sched->freeSlot;
+    sched->freeSlot = player;
+}
+
+size_t scheduler_room(const TempleScheduler *sched, int player)
+{
+    return sched->queueBytes - sched->slots[player].queued;
+}
+
+// where the first command in the queue ends, queued if it isn't whole yet
+static size_t CommandEnd(const SchedulerSlot *slot)
+{
+    size_t end = 0;
+    while (end < slot->queued && slot->queue[end] != '\n' && slot->queue[end] != ';')
+        end++;
+    return end;
+}
+
+// a full queue without an end in it is one (way too long) command, otherwise nothing would ever fit again
+static bool HasCommand(const CommandScheduler *sched, const SchedulerSlot *slot)
+{
+    return slot->queued == sched->queueBytes || CommandEnd(slot) < slot->queued;
+}
+
+static void PushWaiting(CommandScheduler *sched, int id)
+{
+    sched->slots[id].next = -1;
+    sched->slots[id].waiting = true;
+    if (sched->last == -1)
+        sched->first = id;
+    else
+        sched->slots[sched->last].next = id;
+    sched->last = id;
+    sched->waiting++;
+}
+
+size_t scheduler_queue(TempleScheduler *sched, int player, const char *text, size_t length)
+{
+    SchedulerSlot *slot = &sched->slots[player];
+    size_t taken = sched->queueBytes - slot->queued;
+    if (taken > length)
+        taken = length;
+    memcpy(slot->queue + slot->queued, text, taken);
+    slot->queued += taken;
+    if (!slot->waiting && HasCommand(sched, slot))
+        PushWaiting(sched, player);
+    return taken;
+}
+
+// the first command out of the queue and through the game, false if it was blank
+static bool RunQueued(CommandScheduler *sched, SchedulerSlot *slot)
+{
+    size_t end = CommandEnd(slot);
+    size_t next = end < slot->queued ? end + 1 : end;
+    const char *from = slot->queue;
+    while (end > 0 && isspace((unsigned char)from[end - 1]))
+        end--;
+    size_t start = 0;
+    while (start < end && isspace((unsigned char)from[start]))
+        start++;
+    memcpy(sched->command, from + start, end - start);
+    sched->command[end - start] = '\0';
+    memmove(slot->queue, slot->queue + next, slot->queued - next);
+    slot->queued -= next;
+    if (start == end)
+        return false;
+    int said = game_step(slot->game, sched->command, sched->said, SCHEDULER_OUTPUT);
+    if (slot->output && said > 0)
+        slot->output(slot->user, sched->said, said < SCHEDULER_OUTPUT ? (size_t)said : SCHEDULER_OUTPUT - 1);
+    return true;
+}
+
+int scheduler_run(TempleScheduler *sched)
+{
+    // everybody who's waiting now gets one turn, whoever comes in during the round waits for the next one
+    for (int turns = sched->waiting; turns > 0; turns--)
+    {
+        int id = sched->first;
+        UnlinkWaiting(sched, id);
+        SchedulerSlot *slot = &sched->slots[id];
+        slot->credit += sched->turnNs;
+        int lines = 0;
+        while (lines < sched->turnLines && slot->credit > 0 && HasCommand(sched, slot))
+        {
+            long long start = NowNs();
+            if (RunQueued(sched, slot))
+                lines++;
+            slot->credit -= NowNs() - start;
+        }
+        if (game_status(slot->game) != TEMPLE_PLAYING)
+            slot->queued = 0; // nothing left to run it on
+        if (HasCommand(sched, slot))
+            PushWaiting(sched, id);
+        else if (slot->credit > 0)
+            slot->credit = 0;
+    }
+    return sched->waiting;
+}
+
+// ----- moving a game to another process -----
+// A saved game is the session state (WriteSessionState) as varints behind a
+// small header: which world it was on (room and item counts, like a journal
+// says it), the game clock, how the game stands and a riddle that waits for
+// an answer. Rooms and items are ids, nothing in there points anywhere, so
+// any process with the same world can pick the game up. Undo history stays
+// behind, a moved game starts without one (same as after a checkpoint).
+
+#define SAVED_GAME_MAGIC 0x7E3B  // changes whenever the layout does
+#define MAX_SAVED_GAME (1 << 24) // game_receive won't take anything bigger
+
+size_t game_save(const TempleGame *game, void *buf, size_t size)
+{
+    if (game->shared)
+        return 0; // what it changed is part of the rooms, it can't go anywhere without the others
+    StateWriter w = {NULL, buf, buf ? size : 0, 0};
+    WriteNumber(&w, SAVED_GAME_MAGIC);
+    WriteNumber(&w, game->world->roomCount);
+    WriteNumber(&w, game->world->itemCount);
+    WriteNumber(&w, game->clockMs);
+    WriteNumber(&w, game->running);
+    WriteNumber(&w, game->won);
+    WriteNumber(&w, game->session.riddleSlot);
+    WriteSessionState(&w, &game->session);
+    return w.length;
+}
+
+// put a saved game into a game that was just made, false if it's from another world or broken
+static bool LoadGame(TempleGame *game, const void *data, size_t size)
+{
+    StateReader r = {NULL, data, (const unsigned char *)data + size};
+    long long magic, rooms, items, clockMs, running, won, riddleSlot;
+    if (!ReadNumber(&r, SAVED_GAME_MAGIC, SAVED_GAME_MAGIC, &magic) ||
+        !ReadNumber(&r, game->world->roomCount, game->world->roomCount, &rooms) ||
+        !ReadNumber(&r, game->world->itemCount, game->world->itemCount, &items) ||
+        !ReadNumber(&r, 0, LLONG_MAX, &clockMs) || !ReadNumber(&r, 0, 1, &running) || !ReadNumber(&r, 0, 1, &won) ||
+        !ReadNumber(&r, -1, 15, &riddleSlot) || !ReadSessionState(game->world, &game->session, &r) || r.data != r.end)
+        return false;
+    const Room *room = GetRoom(game->world, game->session.room);
+    if (!room || riddleSlot >= room->interactableCount)
+        return false;
+    game->clockMs = clockMs;
+    game->running = running;
+    game->won = won;
+    game->session.riddleSlot = (int)riddleSlot;
+    return true;
+}
 
-                // Use static flags for this function only
-                static bool keycardTaken = false;
-                static bool fruitDropped = false;
+TempleGame *game_load(const char *worldPath, const void *data, size_t size)
+{
+    TempleGame *game = game_create(worldPath);
+    if (game && !LoadGame(game, data, size))
+    {
+        game_destroy(game);
+        return NULL;
+    }
+    return game;
+}
 
-                if (!jaguarSatisfied)
-                {
-                    printf("That darn jaguar is blocking you from checking out the tree properly.\n");
-                    return;
-                }
+TempleGame *game_load_on(TempleHost *host, const void *data, size_t size)
+{
+    TempleGame *game = game_create_on(host);
+    if (game && !LoadGame(game, data, size))
+    {
+        game_destroy(game);
+        return NULL;
+    }
+    return game;
+}
 
-                // If neither has happened, do both at once
-                if (!keycardTaken && !fruitDropped)
-                {
-                    printf("You shake the tree hard! A weird fruit falls down, and there's a keycard stuck in the trunk!\n");
+// The handoff: one game per message on a unix stream socket. The message is
+// 4 bytes of length (little endian) and the saved game, sent with one
+// sendmsg. The player's socket rides along on it as SCM_RIGHTS, so the other
+// process gets its own fd for the same connection. The other side answers
+// one byte, 1 = it took the game over, 0 = it couldn't (other world, no
+// memory), and only after a 1 may the sender let the game go.
 
-                    // Drop fruit to the ground
-                    Item *fruit = MakeItem("Suspicious fruit", 1,
-                                           "A strange glowing fruit. Definitely not for eating, but maybe useful?",
-                                           false, "", "");
-                    PutItemInRoom(currentRoom, fruit);
-                    fruitDropped = true;
+#ifndef _WIN32
+// the whole buffer or false, stream sockets can send less than asked
+static bool SendAll(int fd, const unsigned char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
 
-                    // Add keycard to inventory if possible, else drop to ground
-                    if (inv->count < inv->capacity)
-                    {
-                        strcpy(inv->items[inv->count].name, "Keycard");
-                        strcpy(inv->items[inv->count].description, "High-tech keycard. Probably opens an electronic door somewhere.");
-                        inv->items[inv->count].quantity = 1;
-                        inv->items[inv->count].canCombine = false;
-                        strcpy(inv->items[inv->count].combineWith, "");
-                        strcpy(inv->items[inv->count].resultItem, "");
-                        inv->count++;
-                        printf("You grab the keycard!\n");
-                    }
-                    else
-                    {
-                        printf("No room in your inventory for the keycard!\n");
-                        Item *keycard = MakeItem("Keycard", 1,
-                                                 "High-tech keycard. Probably opens an electronic door somewhere.",
-                                                 false, "", "");
-                        PutItemInRoom(currentRoom, keycard);
-                    }
-                    keycardTaken = true;
+static bool ReceiveAll(int fd, unsigned char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
 
-                    // update tree description
-                    strcpy(currentRoom->interactables[i]->description,
-                           "A weird tree with metal bits in the trunk. Fruit's gone and so is the keycard.");
-                    return;
-                }
+int game_send(int sock, const TempleGame *game, int clientFd)
+{
+    if (game->shared)
+        return -1;
+    unsigned char small[512];
+    unsigned char *saved = small;
+    size_t size = game_save(game, small, sizeof(small));
+    if (size > sizeof(small))
+    {
+        // a big bag or lots of changes, that's rare
+        saved = MemAlloc(MEM_JOURNAL, size);
+        if (!saved)
+            return -1;
+        game_save(game, saved, size);
+    }
+    unsigned char header[4] = {size & 0xFF, (size >> 8) & 0xFF, (size >> 16) & 0xFF, (size >> 24) & 0xFF};
+    struct iovec iov[2] = {{header, sizeof(header)}, {saved, size}};
+    union
+    {
+        struct cmsghdr align;
+        char space[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    if (clientFd >= 0)
+    {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.space;
+        msg.msg_controllen = sizeof(control.space);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(c), &clientFd, sizeof(int));
+    }
+    ssize_t sent;
+    do
+        sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    while (sent < 0 && errno == EINTR);
+    // the fd went with the first byte, whatever didn't fit goes after it
+    bool ok = sent >= 0;
+    if (ok && (size_t)sent < sizeof(header) + size)
+    {
+        size_t done = sent;
+        ok = (done >= sizeof(header) || SendAll(sock, header + done, sizeof(header) - done)) &&
+             SendAll(sock, saved + (done > sizeof(header) ? done - sizeof(header) : 0),
+                     size - (done > sizeof(header) ? done - sizeof(header) : 0));
+    }
+    if (saved != small)
+        MemFree(saved);
+    unsigned char answer = 0;
+    if (!ok || !ReceiveAll(sock, &answer, 1) || answer != 1)
+        return -1;
+    return 0;
+}
 
-                // if only fruit not dropped
-                if (!fruitDropped)
-                {
-                    printf("You shake the tree and a weird fruit falls down!\n");
-                    Item *fruit = MakeItem("Suspicious fruit", 1,
-                                           "A strange glowing fruit. Definitely not for eating, but maybe useful?",
-                                           false, "", "");
-                    PutItemInRoom(currentRoom, fruit);
-                    fruitDropped = true;
-                    strcpy(currentRoom->interactables[i]->description,
-                           "A weird tree with metal bits in the trunk. The fruit is gone now.");
-                    return; //non trove perchè questo non funzionaba. sembra bene.
-                }
+static TempleGame *ReceiveGame(int sock, WorldHost *host, const char *worldPath, int *clientFd)
+{
+    *clientFd = -1;
+    unsigned char header[4];
+    union
+    {
+        struct cmsghdr align;
+        char space[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = {header, sizeof(header)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.space;
+    msg.msg_controllen = sizeof(control.space);
+    ssize_t got;
+    do
+        got = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    while (got < 0 && errno == EINTR);
+    if (got <= 0)
+        return NULL; // the other side is done sending
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+    {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS && c->cmsg_len == CMSG_LEN(sizeof(int)))
+            memcpy(clientFd, CMSG_DATA(c), sizeof(int));
+    }
+    size_t size = 0;
+    TempleGame *game = NULL;
+    unsigned char *saved = NULL;
+    if (ReceiveAll(sock, header + got, sizeof(header) - got))
+    {
+        size = header[0] | header[1] << 8 | header[2] << 16 | (size_t)header[3] << 24;
+        saved = size <= MAX_SAVED_GAME ? MemAlloc(MEM_JOURNAL, size ? size : 1) : NULL;
+        if (saved && ReceiveAll(sock, saved, size))
+            game = host ? game_load_on(host, saved, size) : game_load(worldPath, saved, size);
+    }
+    MemFree(saved);
+    unsigned char answer = game != NULL;
+    SendAll(sock, &answer, 1);
+    if (!game && *clientFd >= 0)
+    {
+        // the player stays with the sender
+        close(*clientFd);
+        *clientFd = -1;
+    }
+    return game;
+}
 
-                // If only keycard not taken.
-                if (!keycardTaken)
-                {
-                    printf("With the jaguar out of the way, you get a better look at the tree...\n");
-                    printf("There's something shiny in the trunk - a keycard!\n");
-                    if (inv->count < inv->capacity)
-                    {
-                        strcpy(inv->items[inv->count].name, "Keycard");
-                        strcpy(inv->items[inv->count].description, "High-tech keycard. Probably opens an electronic door somewhere.");
-                        inv->items[inv->count].quantity = 1;
-                        inv->items[inv->count].canCombine = false;
-                        strcpy(inv->items[inv->count].combineWith, "");
-                        strcpy(inv->items[inv->count].resultItem, "");
-                        inv->count++;
-                        printf("You grab the keycard!\n");
-                    }
-                    else
-                    {
-                        printf("Your inventory is full! Can't take the keycard!\n");
-                        Item *keycard = MakeItem("Keycard", 1,
-                                                 "High-tech keycard. Probably opens an electronic door somewhere.",
-                                                 false, "", "");
-                        PutItemInRoom(currentRoom, keycard);
-                    }
-                    keycardTaken = true;
-                    strcpy(currentRoom->interactables[i]->description,
-                           "A weird tree with metal bits in the trunk. The keycard is gone now.");
-                    return;
-                }
+TempleGame *game_receive(int sock, const char *worldPath, int *clientFd)
+{
+    return ReceiveGame(sock, NULL, worldPath, clientFd);
+}
 
-                // If both already done
-                printf("Nothing else interesting about this tree.\n");
-                return;
-            }
-            // Default: print description
-            printf("%s\n", currentRoom->interactables[i]->description);
-            return;
-        }
-    }
-    printf("There's no %s here to mess with.\n", objectName);
+TempleGame *game_receive_on(int sock, TempleHost *host, int *clientFd)
+{
+    return ReceiveGame(sock, host, NULL, clientFd);
 }
 
-// Use an item on a target
-void DoUseItem(Room *currentRoom, Inventory *inv, const char *itemName, const char *targetName)
+// --bench-migrate: n games move to a second process, one after the other, each with a socket
+// that stands in for its player. The new process answers the player with the game saved again,
+// so every game gets checked for coming over the same, and the pause is what the player waits
+// from the game stopping here to hearing from the other process
+void BenchMigrate(int games)
 {
-    if (!GotItem(inv, itemName))
+    int link[2];
+    if (games <= 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, link) != 0)
+    {
+        perror("Can't set up the migration benchmark");
+        return;
+    }
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0)
     {
-        printf("You don't have a %s to use.\n", itemName);
+        perror("Can't start the second process");
+        close(link[0]);
+        close(link[1]);
         return;
     }
-    // Special case for Golden Key on the golden door
-    if (string_compare(itemName, "Golden Key") == 0 && string_compare(targetName, "golden door") == 0)
+    if (child == 0)
     {
-        if (currentRoom->north && string_compare(currentRoom->north->name, "Gold Room") == 0)
+        // the other engine: take games over until the sender hangs up
+        close(link[0]);
+        int fd;
+        TempleGame *game;
+        unsigned char saved[512];
+        while ((game = game_receive(link[1], NULL, &fd)) != NULL)
         {
-            printf("You put the Golden Key in the door and it clicks open!\n");
-            currentRoom->north->isLocked = false;
-            DeleteItemFromBag(inv, "Golden Key");
-            return;
+            size_t size = game_save(game, saved, sizeof(saved));
+            if (fd >= 0)
+            {
+                if (size > sizeof(saved) || !SendAll(fd, saved, size))
+                    SendAll(fd, (const unsigned char *)"", 1);
+                close(fd);
+            }
+            game_destroy(game);
         }
+        _exit(0);
+    }
+    close(link[1]);
+
+    // games in all kinds of states: some way into the walkthrough, a little time gone by
+    static const char *const moves[] = {"take note", "east", "push crate", "take rucksack", "west", "south",
+                                        "interact chest", "interact jaguar", "tomorrow", "interact tree",
+                                        "take suspicious fruit", "take rusty cog", "north"};
+    const int moveCount = sizeof(moves) / sizeof(moves[0]);
+    TempleGame **all = MemAlloc(MEM_WORLD, sizeof(TempleGame *) * games);
+    long long *pauses = MemAlloc(MEM_WORLD, sizeof(long long) * games);
+    int made = 0;
+    while (all && pauses && made < games && (all[made] = game_create(NULL)) != NULL)
+    {
+        for (int i = 0; i < made % (moveCount + 1); i++)
+            game_step(all[made], moves[i], NULL, 0);
+        game_tick(all[made], made * 37 % 5000, NULL, 0);
+        made++;
+    }
+
+    int moved = 0, different = 0;
+    long long savedBytes = 0;
+    long long start = NowNs();
+    for (int i = 0; i < made; i++)
+    {
+        unsigned char before[512], after[512];
+        size_t size = game_save(all[i], before, sizeof(before));
+        int player[2];
+        if (size > sizeof(before) || socketpair(AF_UNIX, SOCK_STREAM, 0, player) != 0)
+            break;
+        long long stopped = NowNs();
+        bool ok = game_send(link[0], all[i], player[1]) == 0;
+        close(player[1]); // the other process has its own now
+        ok = ok && ReceiveAll(player[0], after, size);
+        pauses[moved] = NowNs() - stopped;
+        close(player[0]);
+        if (!ok)
+            break;
+        if (memcmp(before, after, size) != 0)
+            different++;
+        savedBytes += size;
+        moved++;
+        game_destroy(all[i]); // it lives over there now
+        all[i] = NULL;
+    }
+    double seconds = (NowNs() - start) / 1e9;
+    shutdown(link[0], SHUT_RDWR);
+    close(link[0]);
+    waitpid(child, NULL, 0);
+    for (int i = 0; i < made; i++)
+        game_destroy(all[i]);
+
+    // pauses sorted for the percentiles (insertion sort is fine, they come in nearly sorted)
+    for (int i = 1; i < moved; i++)
+    {
+        long long p = pauses[i];
+        int j = i;
+        for (; j > 0 && pauses[j - 1] > p; j--)
+            pauses[j] = pauses[j - 1];
+        pauses[j] = p;
+    }
+    printf("%d of %d games moved to another process in %.3f s, %d came over different\n", moved, games, seconds,
+           different);
+    if (moved > 0)
+    {
+        printf("  saved game: %.1f bytes on average\n", (double)savedBytes / moved);
+        printf("  pause per game: median %.1f us, 99%% %.1f us, worst %.1f us\n", pauses[moved / 2] / 1e3,
+               pauses[(int)(moved * 0.99)] / 1e3, pauses[moved - 1] / 1e3);
     }
-    // Special case for Keycard on cyber room door
-    if (string_compare(itemName, "Keycard") == 0 && string_compare(targetName, "metal door") == 0)
+    MemFree(all);
+    MemFree(pauses);
+}
+#else
+int game_send(int sock, const TempleGame *game, int clientFd)
+{
+    (void)sock;
+    (void)game;
+    (void)clientFd;
+    return -1; // no fd passing on windows
+}
+
+TempleGame *game_receive(int sock, const char *worldPath, int *clientFd)
+{
+    (void)sock;
+    (void)worldPath;
+    *clientFd = -1;
+    return NULL;
+}
+
+TempleGame *game_receive_on(int sock, TempleHost *host, int *clientFd)
+{
+    (void)sock;
+    (void)host;
+    *clientFd = -1;
+    return NULL;
+}
+
+void BenchMigrate(int games)
+{
+    (void)games;
+    printf("moving games between processes needs unix sockets, not on Windows\n");
+}
+#endif
+
+// --bench-shared: n players in one shared world, each on a thread of its own, first all of them in the
+// start room and then spread over the rooms (one room each if there are enough). Every player takes and
+// drops the first item lying in its room, looks around and checks its bag, over and over, so in one room
+// they all grab for the same item. Says how many lines went through per second and how many of them had
+// to wait for their room, then checks that every item ended up in exactly one place
+#define SHARED_BENCH_LINES 20000 // per player
+
+#ifndef _WIN32
+typedef struct
+{
+    TempleGame *game;
+    char take[COMPLETION_LINE];
+    char drop[COMPLETION_LINE];
+} SharedBenchPlayer;
+
+static void *PlaySharedBench(void *arg)
+{
+    SharedBenchPlayer *p = arg;
+    const char *lines[4] = {p->take, "look", p->drop, "inventory"};
+    for (int i = 0; i < SHARED_BENCH_LINES; i++)
+        game_step(p->game, lines[i % 4], NULL, 0);
+    return NULL;
+}
+
+// every item in one bag or in one room (or nowhere, if it's used up or didn't show up yet)
+static bool SharedItemsAddUp(SharedWorld *shared, SharedBenchPlayer *players, int count)
+{
+    World *world = shared->world;
+    int *places = MemCalloc(MEM_WORLD, world->itemCount + 1, sizeof(int));
+    if (!places)
+        return false;
+    bool ok = true;
+    for (int i = 0; i < count; i++)
     {
-        if (currentRoom->west && string_compare(currentRoom->west->name, "Cyber Room") == 0)
+        const Inventory *inv = &players[i].game->session.inv;
+        for (int k = 0; k < inv->count; k++)
         {
-            printf("You swipe the keycard and the door slides open with a whoosh!\n");
-            currentRoom->west->isLocked = false;
-            DeleteItemFromBag(inv, "Keycard");
-            return;
+            places[inv->items[k]]++;
+            ok = ok && atomic_load(&shared->itemAt[inv->items[k]]) == IN_INVENTORY;
         }
     }
-    // Blend suspicious fruit in kitchen to get anti-rust solution
-    if (string_compare(itemName, "Suspicious fruit") == 0 && string_compare(targetName, "kitchen") == 0)
+    for (int id = 0; id < world->roomCount; id++)
     {
-        if (currentRoom->interactableCount > 0)
+        int items[10];
+        int n = RoomItems(world, &players[0].game->session, GetRoom(world, id), items);
+        for (int k = 0; k < n; k++)
         {
-            bool foundKitchen = false;
-            for (int i = 0; i < currentRoom->interactableCount; i++)
-            {
-                if (string_compare(currentRoom->interactables[i]->name, "Kitchen") == 0)
-                {
-                    foundKitchen = true;
-                    break;
-                }
-            }
-            if (foundKitchen)
-            {
-                printf("You toss the fruit in the blender and it turns into some kind of anti-Rust Solution!\n");
-                DeleteItemFromBag(inv, "Suspicious fruit");
-                Item *antiRust = MakeItem("Anti-Rust Solution", 1,
-                                          "Weird chemical goop that can clean rust off metal stuff.",
-                                          true, "Rusty Cog", "Clean Cog");
-                PutItemInRoom(currentRoom, antiRust);
-                return;
-            }
+            places[items[k]]++;
+            ok = ok && atomic_load(&shared->itemAt[items[k]]) == id;
         }
-        printf("There's no kitchen here to use the fruit in.\n");
-        return;
     }
-    // Use cog or clean cog to break glass pane and get crowbar
-    if (
-        (string_compare(itemName, "Rusty Cog") == 0 || string_compare(itemName, "Clean Cog") == 0) &&
-        string_compare(targetName, "glass pane") == 0)
+    for (int id = 0; id < world->itemCount; id++)
     {
-        if (currentRoom->interactableCount > 0)
+        int at = atomic_load(&shared->itemAt[id]);
+        ok = ok && places[id] == (at >= 0 || at == IN_INVENTORY ? 1 : 0);
+    }
+    MemFree(places);
+    return ok;
+}
+
+static void RunSharedBench(const char *worldPath, int count, bool spread)
+{
+    SharedWorld *shared = shared_create(worldPath);
+    SharedBenchPlayer *players = shared ? MemCalloc(MEM_WORLD, count, sizeof(SharedBenchPlayer)) : NULL;
+    pthread_t *threads = MemAlloc(MEM_WORLD, sizeof(pthread_t) * count);
+    bool *started = MemCalloc(MEM_WORLD, count, sizeof(bool));
+    int joined = 0;
+    while (players && threads && started && joined < count && (players[joined].game = game_join(shared, NULL)))
+        joined++;
+    if (joined < count)
+    {
+        fprintf(stderr, "Can't set up %d players for the shared world benchmark\n", count);
+        joined = 0;
+    }
+    World *world = shared ? shared->world : NULL;
+    int rooms = 0;
+    for (int i = 0; i < joined; i++)
+    {
+        TempleGame *game = players[i].game;
+        Output quiet;
+        StartOutput(game, &quiet, NULL, 0);
+        MakeBiggerInventory(&game->session, 9); // nobody drops a cog on their foot
+        if (spread)
         {
-            bool foundGlass = false;
-            static bool crowbarTaken = false;
-            for (int i = 0; i < currentRoom->interactableCount; i++)
-            {
-                if (string_compare(currentRoom->interactables[i]->name, "Glass Pane") == 0)
-                {
-                    foundGlass = true;
-                    if (!crowbarTaken)
-                    {
-                        printf("You smash the glass with the cog. CRASH! There's a crowbar inside!\n");
-                        Item *crowbar = MakeItem("Crowbar", 1,
-                                                 "Heavy crowbar for prying stuff open. Also good for smashing things!",
-                                                 false, "", "");
-                        PutItemInRoom(currentRoom, crowbar);
-                        crowbarTaken = true;
-                        strcpy(currentRoom->interactables[i]->description,
-                               "Broken glass everywhere. The crowbar is gone.");
-                    }
-                    else
-                    {
-                        printf("The glass is already smashed and the crowbar is gone.\n");
-                    }
-                    break;
-                }
-            }
-            if (!foundGlass)
-            {
-                printf("There's no glass pane here to break.\n");
-            }
-            return;
+            int id = (int)((long long)i * world->roomCount / count);
+            // the Gold Room would end the game at the first line
+            if (strcmp(Text(world, GetRoom(world, id)->name), "Gold Room") == 0)
+                id = world->startRoom;
+            SetRoom(world, &game->session, id);
         }
+        if (i == 0 || game->session.room != players[i - 1].game->session.room)
+            rooms++;
+        int items[10];
+        int n = RoomItems(world, &game->session, GetRoom(world, game->session.room), items);
+        const char *name = n > 0 ? Text(world, world->items[items[0]].name) : NULL;
+        snprintf(players[i].take, sizeof(players[i].take), name ? "take %s" : "look", name);
+        snprintf(players[i].drop, sizeof(players[i].drop), name ? "drop %s" : "look", name);
+        EndOutput(game, &quiet);
+    }
+
+    long long start = NowNs();
+    for (int i = 0; i < joined; i++)
+        started[i] = pthread_create(&threads[i], NULL, PlaySharedBench, &players[i]) == 0;
+    for (int i = 0; i < joined; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            PlaySharedBench(&players[i]); // couldn't start a thread, do it here then
+    }
+    double seconds = (NowNs() - start) / 1e9;
+
+    if (joined > 0)
+    {
+        long waits = 0;
+        for (int id = 0; id < world->roomCount; id++)
+            waits += atomic_load(&shared->rooms[id].waits);
+        double lines = (double)joined * SHARED_BENCH_LINES;
+        printf("  %-26s %10.0f lines/s, %5.1f%% waited for their room, items add up: %s\n",
+               spread ? "spread over the rooms" : "all in one room", lines / seconds, waits * 100.0 / lines,
+               SharedItemsAddUp(shared, players, joined) ? "yes" : "NO");
+        if (spread)
+            printf("  (%d players in %d rooms)\n", joined, rooms);
+    }
+    for (int i = 0; i < joined; i++)
+        game_destroy(players[i].game);
+    MemFree(players);
+    MemFree(threads);
+    MemFree(started);
+    shared_destroy(shared);
+}
+
+void BenchShared(const char *worldPath, int players)
+{
+    if (players <= 0)
+        return;
+    printf("%d players in a shared world, %d lines each\n", players, SHARED_BENCH_LINES);
+    RunSharedBench(worldPath, players, false);
+    RunSharedBench(worldPath, players, true);
+}
+#else
+void BenchShared(const char *worldPath, int players)
+{
+    (void)worldPath;
+    (void)players;
+    printf("the shared world benchmark needs threads, not on Windows\n");
+}
+#endif
+
+// --bench-fair: n people who play like people (a command, then a few ms of thinking) and a few bots
+// that paste commands as fast as they get read, all served by one loop. First the way a server without
+// a scheduler does it, everything read from a player runs right away, then through a scheduler. Says
+// how long the people waited for their answers (from typing to hearing back) and how much the bots got
+// through. With the scheduler the bots shouldn't make the people wait any longer than they'd wait anyway
+#define FAIR_BENCH_BOTS 4
+#define FAIR_BENCH_MS 2000
+#define FAIR_BENCH_READ 4096 // what one read from a bot brings in
+
+typedef struct
+{
+    long long *waits; // ns every answer took, for the percentiles
+    int count;
+    int capacity;
+    long long botLines;
+} FairBenchStats;
+
+typedef struct
+{
+    TempleGame *game;
+    int player; // in the scheduler
+    bool bot;
+    long long typedAt; // ns, 0 = thinking
+    long long nextAt;  // when they type the next command
+    int line;
+    unsigned int random;
+    FairBenchStats *stats;
+} FairBenchPlayer;
+
+static void FairBenchAnswer(void *user, const char *text, size_t length)
+{
+    (void)text;
+    (void)length;
+    FairBenchPlayer *p = user;
+    FairBenchStats *stats = p->stats;
+    if (p->bot)
+    {
+        stats->botLines++;
+        return;
+    }
+    long long now = NowNs();
+    if (stats->count == stats->capacity)
+    {
+        int newCapacity = stats->capacity ? stats->capacity * 2 : 4096;
+        long long *grown = MemRealloc(MEM_WORLD, stats->waits, sizeof(long long) * newCapacity);
+        if (!grown)
+            return;
+        stats->waits = grown;
+        stats->capacity = newCapacity;
+    }
+    stats->waits[stats->count++] = now - p->typedAt;
+    // think 1-10 ms about the next one
+    p->random = p->random * 1103515245u + 12345u;
+    p->nextAt = now + (1 + (long long)(p->random >> 16) % 10) * 1000000;
+    p->typedAt = 0;
+}
+
+static int CompareWaits(const void *a, const void *b)
+{
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+static void RunFairBench(int people, bool fair)
+{
+    static const char *const script[] = {"look\n", "i\n", "east\n", "west\n", "take note\n", "drop note\n"};
+    const int scriptLines = sizeof(script) / sizeof(script[0]);
+    char paste[FAIR_BENCH_READ];
+    for (int i = 0; i + 5 <= FAIR_BENCH_READ; i += 5)
+        memcpy(paste + i, "look\n", 5);
+    int total = people + FAIR_BENCH_BOTS;
+    FairBenchStats stats = {NULL, 0, 0, 0};
+    FairBenchPlayer *players = MemCalloc(MEM_WORLD, total, sizeof(FairBenchPlayer));
+    TempleScheduler *sched = fair ? scheduler_create(0, 0, 0) : NULL;
+    char out[SCHEDULER_OUTPUT];
+    int made = 0;
+    while (players && (sched || !fair) && made < total && (players[made].game = game_create(NULL)))
+    {
+        FairBenchPlayer *p = &players[made];
+        p->bot = made >= people;
+        p->random = (unsigned int)made * 2654435761u;
+        p->stats = &stats;
+        p->player = sched ? scheduler_add(sched, p->game, FairBenchAnswer, p) : -1;
+        made++;
+        if (sched && p->player < 0)
+            break;
+    }
+    if (made < total)
+    {
+        fprintf(stderr, "Can't set up %d players for the fairness benchmark\n", total);
+        total = 0;
     }
-    // Use crowbar on crate in Entrance Hall
-    if (string_compare(itemName, "Crowbar") == 0 && string_compare(targetName, "crate") == 0)
+
+    long long start = NowNs();
+    long long end = start + (long long)FAIR_BENCH_MS * 1000000;
+    for (int i = 0; i < total; i++)
+        players[i].nextAt = start;
+    for (long long now = start; total > 0 && now < end; now = NowNs())
     {
-        if (string_compare(currentRoom->name, "Entrance Hall") == 0)
+        // what the loop reads this time around
+        for (int i = 0; i < total; i++)
         {
-            static bool crateOpened = false;
-            if (!crateOpened)
+            FairBenchPlayer *p = &players[i];
+            if (p->bot)
             {
-                printf("You pry open the crate with the crowbar! Inside, you find the second part of the golden key.\n");
-                Item *keyPart2 = MakeItem("Key Part 2", 1,
-                                          "The second part of a three-part golden key.",
-                                          true, "Key Part 1", "Combined Key Parts");
-                PutItemInRoom(currentRoom, keyPart2);
-                crateOpened = true;
-                // Update crate description
-                for (int i = 0; i < currentRoom->interactableCount; i++)
+                if (fair)
                 {
-                    if (string_compare(currentRoom->interactables[i]->name, "Crate") == 0)
-                    {
-                        strcpy(currentRoom->interactables[i]->description, "An empty crate, now pried open.");
-                        break;
-                    }
+                    scheduler_queue(sched, p->player, paste, FAIR_BENCH_READ);
+                }
+                else
+                {
+                    // no scheduler: the whole read runs before anybody else gets looked at
+                    for (int k = 0; k + 5 <= FAIR_BENCH_READ; k += 5)
+                        FairBenchAnswer(p, out, game_step(p->game, "look", out, sizeof(out)));
                 }
             }
-            else
+            else if (p->typedAt == 0 && now >= p->nextAt)
             {
-                printf("The crate is already open and empty.\n");
+                const char *line = script[p->line++ % scriptLines];
+                p->typedAt = p->nextAt; // they typed it then, whenever the loop got around to reading it
+                if (fair)
+                    scheduler_queue(sched, p->player, line, strlen(line));
+                else
+                    FairBenchAnswer(p, out, game_step(p->game, line, out, sizeof(out)));
             }
-            return;
         }
+        if (fair)
+            scheduler_run(sched);
     }
-    // Use clean cog on machine in Engine Room to get Key Part 3
-    if (string_compare(itemName, "Clean Cog") == 0 && string_compare(targetName, "machine") == 0)
+    double seconds = (NowNs() - start) / 1e9;
+
+    if (total > 0 && stats.count > 0)
     {
-        if (string_compare(currentRoom->name, "Engine Room") == 0)
-        {
-            static bool machineUsed = false;
-            if (!machineUsed)
-            {
-                printf("You insert the clean cog into the machine. The machinery whirs to life and a hidden compartment opens, revealing the third part of the golden key!\n");
-                Item *keyPart3 = MakeItem("Key Part 3", 1,
-                                          "The third part of a three-part golden key.",
-                                          true, "Combined Key Parts", "Golden Key");
-                PutItemInRoom(currentRoom, keyPart3);
-                machineUsed = true;
-            }
-            else
-            {
-                printf("The machine is already running and the compartment is empty.\n");
-            }
-            return;
-        }
+        qsort(stats.waits, stats.count, sizeof(long long), CompareWaits);
+        printf("  %-10s people got %7d answers, waited p50 %8.1f us, p99 %8.1f us, worst %8.1f us; bots got %8.0f commands/s through\n",
+               fair ? "scheduled:" : "inline:", stats.count, stats.waits[stats.count / 2] / 1e3,
+               stats.waits[(int)(stats.count * 0.99)] / 1e3, stats.waits[stats.count - 1] / 1e3, stats.botLines / seconds);
     }
-    printf("You can't use %s on %s.\n", itemName, targetName);
+    for (int i = 0; i < made; i++)
+        game_destroy(players[i].game);
+    scheduler_destroy(sched);
+    MemFree(players);
+    MemFree(stats.waits);
 }
 
-// Log player actions
-void WriteToLog(FILE *logFile, const char *action, const char *result)
+void BenchFair(int people)
 {
-    if (!logFile)
+    if (people <= 0)
         return;
-    time_t now = time(NULL);
-    struct tm *timeinfo = localtime(&now);
-    char timestamp[20];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", timeinfo);
-    fprintf(logFile, "[%s] %s: %s\n", timestamp, action, result);
-    fflush(logFile);
+    printf("%d people and %d bots pasting commands, %.1f s each way\n", people, FAIR_BENCH_BOTS, FAIR_BENCH_MS / 1000.0);
+    RunFairBench(people, false);
+    RunFairBench(people, true);
 }
 
-// Process player commands
-void DoCommand(char *command, Inventory *inv, Room **currentRoom, bool *gameRunning, bool *hasWon, FILE *logFile)
+// the game itself (bench.c includes this file with TEMPLE_NO_MAIN to get at the engine)
+#ifndef TEMPLE_NO_MAIN
+
+// a world that came from a host (--watch-world) goes away with the host
+static void CloseGameWorld(World *world, WorldHost *host)
 {
-    char cmd[100];
-    char param1[100] = "";
-    char param2[100] = "";
-    // Convert command to lowercase
-    for (int i = 0; command[i]; i++)
+    if (host)
+        CloseWorldHost(host);
+    else
+        CloseWorld(world);
+}
+
+// sit at the prompt until the player types something, timers that come due in the meantime go off on time
+// and spectators get served. without timers or spectators (or when the input isn't a terminal) read does all the waiting
+static void WaitForPlayer(Session *s, long long clockBase)
+{
+#ifndef _WIN32
+    if (!Interactive())
+        return;
+    for (;;)
     {
-        command[i] = tolower(command[i]);
+        if (InputPending())
+            return;
+        long long next = NextTimerTick(&s->timers);
+        bool watched = s->broadcast && s->broadcast->listenFd >= 0;
+        if (next == LLONG_MAX && !watched)
+            return;
+        long long wait = next == LLONG_MAX ? LLONG_MAX : next * TICK_MS + clockBase - NowMs();
+        if (wait > 0)
+        {
+            fflush(stdout);
+            PumpSpectators(s->broadcast);
+            fd_set input, output;
+            FD_ZERO(&input);
+            FD_ZERO(&output);
+            FD_SET(fileno(stdin), &input);
+            int top = SpectatorFds(s->broadcast, &input, &output, fileno(stdin));
+            struct timeval timeout = {(time_t)(wait / 1000), (suseconds_t)(wait % 1000) * 1000};
+            int ready = select(top + 1, &input, &output, NULL, wait == LLONG_MAX ? NULL : &timeout);
+            if (ready < 0 || FD_ISSET(fileno(stdin), &input))
+                return; // something to read (or select broke, the read will find out)
+            if (ready > 0)
+                continue; // spectator stuff, the pump at the top takes care of it
+        }
+        AdvanceClock(s, (NowMs() - clockBase) / TICK_MS);
+        if (!s->atPrompt && !s->machine)
+        {
+            // a timer said something, put the prompt back
+            Say(s, "\n> ");
+            s->atPrompt = true;
+        }
     }
-    // Parse command
-    int params = sscanf(command, "%s %s %[^\n]", cmd, param1, param2);
-    char result[256] = "";
+#else
+    (void)s;
+    (void)clockBase;
+#endif
+}
 
-    // navigation commands
-    if (strcmp(cmd, "north") == 0 || strcmp(cmd, "n") == 0)
+int main(int argc, char *argv[])
+{
+    // --world <file> plays a world file instead of the built-in temple
+    // --cache <rooms> is how many rooms of a world file we keep in memory at once
+    // --save-world <file> writes the world out as a page file and quits
+    // --compress-text packs the descriptions and riddles of a saved page file into compressed blocks
+    // --memory-report prints how much memory the world's structs and text take and quits
+    // --validate checks the world for broken exits, locked out rooms, items nobody can get and broken recipes and quits
+    // --validate-threads <n> checks with n threads (one per core by default)
+    // --journal <file> is where the game gets journaled (temple.journal by default), --no-journal turns it off
+    // --sync-every <records> is how many journal records can wait for one fsync
+    // --checkpoint-every <records> is how often the journal gets squashed into a checkpoint
+    // --virtual-clock <ms> makes every command take exactly that long instead of following the real clock
+    // --hash-trace <file> writes the state hash after every command there (replaydiff compares two of these)
+    // --spectate <socket> lets people watch the game live (nc -U <socket>)
+    // --bench-spectators <n> measures what n spectators cost and quits
+    // --bench-migrate <n> moves n games to a second process over a unix socket, checks them and quits
+    // --bench-shared <n> has n players on n threads play in one shared world (--world or the built-in one) and quits
+    // --bench-fair <n> serves n people and a few flooding bots from one loop, without and with the scheduler, and quits
+    // --mem-debug reports every allocation that's still alive when the game ends (with where it came from)
+    // --mem-warn <KB> complains on stderr once a session uses more memory than that
+    // --bench-case compares the case folding kernels with the old tolower loops and quits
+    // --prompt shows the "> " prompt even when the input isn't a terminal (scripts don't need it)
+    // --json answers every command with one JSON record per line instead of the text (for bots, see the README)
+    // --undo-depth <commands> is how many commands undo can take back (0 turns undo off)
+    // --watch-world keeps the --world file in memory and switches to the new version whenever the file changes
+    // --hints <file> takes the hint table from there (default: <world file>.hints, or temple.hints for the built-in world)
+    // --save-hints <file> searches the world for the hint table, writes it there and quits
+    const char *worldPath = NULL;
+    const char *savePath = NULL;
+    const char *hintPath = NULL;
+    const char *saveHintPath = NULL;
+    bool compressText = false;
+    bool memoryReport = false;
+    bool validate = false;
+    int validateThreads = 0;
+    bool benchCase = false;
+    const char *journalPath = "temple.journal";
+    int cacheSize = DEFAULT_ROOM_CACHE;
+    int syncEvery = DEFAULT_SYNC_EVERY;
+    int checkpointEvery = DEFAULT_CHECKPOINT_EVERY;
+    long long virtualStep = 0; // ticks per command, 0 = real time
+    const char *tracePath = NULL;
+    const char *spectatePath = NULL;
+    int benchSpectators = -1;
+    int benchMigrate = -1;
+    int benchShared = -1;
+    int benchFair = -1;
+    bool showPrompt = Interactive();
+    long long memWarn = 0;
+    bool json = false;
+    int undoDepth = DEFAULT_UNDO_DEPTH;
+    bool watchWorld = false;
+    for (int i = 1; i < argc; i++)
     {
-        if ((*currentRoom)->north != NULL)
+        if (strcmp(argv[i], "--world") == 0 && i + 1 < argc)
+        {
+            worldPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            cacheSize = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--save-world") == 0 && i + 1 < argc)
+        {
+            savePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--hints") == 0 && i + 1 < argc)
+        {
+            hintPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save-hints") == 0 && i + 1 < argc)
+        {
+            saveHintPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--compress-text") == 0)
+        {
+            compressText = true;
+        }
+        else if (strcmp(argv[i], "--memory-report") == 0)
+        {
+            memoryReport = true;
+        }
+        else if (strcmp(argv[i], "--validate") == 0)
+        {
+            validate = true;
+        }
+        else if (strcmp(argv[i], "--validate-threads") == 0 && i + 1 < argc)
+        {
+            validate = true;
+            validateThreads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc)
+        {
+            journalPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-journal") == 0)
+        {
+            journalPath = NULL;
+        }
+        else if (strcmp(argv[i], "--sync-every") == 0 && i + 1 < argc)
+        {
+            syncEvery = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc)
+        {
+            checkpointEvery = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--virtual-clock") == 0 && i + 1 < argc)
+        {
+            virtualStep = atoi(argv[++i]) / TICK_MS;
+            if (virtualStep < 1)
+                virtualStep = 1;
+        }
+        else if (strcmp(argv[i], "--hash-trace") == 0 && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--spectate") == 0 && i + 1 < argc)
+        {
+            spectatePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--mem-debug") == 0)
         {
-            if ((*currentRoom)->north->isLocked)
-            {
-                sprintf(result, "The door to the north is locked.");
-                printf("%s\n", result);
-            }
-            else
-            {
-                *currentRoom = (*currentRoom)->north;
-                sprintf(result, "Moved north to %s", (*currentRoom)->name);
-                printf("%s\n", (*currentRoom)->description);
-            }
+            MemDebug(true);
         }
-        else
+        else if (strcmp(argv[i], "--mem-warn") == 0 && i + 1 < argc)
         {
-            sprintf(result, "You can't go north from here.");
-            printf("%s\n", result);
+            memWarn = atoll(argv[++i]) * 1024;
         }
-    }
-    else if (strcmp(cmd, "south") == 0 || strcmp(cmd, "s") == 0)
-    {
-        if ((*currentRoom)->south != NULL)
+        else if (strcmp(argv[i], "--bench-case") == 0)
         {
-            if ((*currentRoom)->south->isLocked)
-            {
-                sprintf(result, "The door to the south is locked.");
-                printf("%s\n", result);
-            }
-            else
-            {
-                *currentRoom = (*currentRoom)->south;
-                sprintf(result, "Moved south to %s", (*currentRoom)->name);
-                printf("%s\n", (*currentRoom)->description);
-            }
+            benchCase = true;
         }
-        else
+        else if (strcmp(argv[i], "--prompt") == 0)
         {
-            sprintf(result, "You can't go south from here.");
-            printf("%s\n", result);
+            showPrompt = true;
         }
-    }
-    else if (strcmp(cmd, "east") == 0 || strcmp(cmd, "e") == 0)
-    {
-        if ((*currentRoom)->east != NULL)
+        else if (strcmp(argv[i], "--json") == 0)
         {
-            if ((*currentRoom)->east->isLocked)
-            {
-                sprintf(result, "The door to the east is locked.");
-                printf("%s\n", result);
-            }
-            else
-            {
-                *currentRoom = (*currentRoom)->east;
-                sprintf(result, "Moved east to %s", (*currentRoom)->name);
-                printf("%s\n", (*currentRoom)->description);
-            }
+            json = true;
         }
-        else
+        else if (strcmp(argv[i], "--undo-depth") == 0 && i + 1 < argc)
         {
-            sprintf(result, "You can't go east from here.");
-            printf("%s\n", result);
+            undoDepth = atoi(argv[++i]);
+            if (undoDepth < 0)
+                undoDepth = 0;
         }
-    }
-    else if (strcmp(cmd, "west") == 0 || strcmp(cmd, "w") == 0)
-    {
-        if ((*currentRoom)->west != NULL)
+        else if (strcmp(argv[i], "--watch-world") == 0)
         {
-            if ((*currentRoom)->west->isLocked)
-            {
-                sprintf(result, "The door to the west is locked.");
-                printf("%s\n", result);
-            }
-            else
-            {
-                *currentRoom = (*currentRoom)->west;
-                sprintf(result, "Moved west to %s", (*currentRoom)->name);
-                printf("%s\n", (*currentRoom)->description);
-            }
+            watchWorld = true;
+        }
+        else if (strcmp(argv[i], "--bench-spectators") == 0 && i + 1 < argc)
+        {
+            benchSpectators = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bench-migrate") == 0 && i + 1 < argc)
+        {
+            benchMigrate = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bench-shared") == 0 && i + 1 < argc)
+        {
+            benchShared = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bench-fair") == 0 && i + 1 < argc)
+        {
+            benchFair = atoi(argv[++i]);
         }
         else
         {
-            sprintf(result, "You can't go west from here.");
-            printf("%s\n", result);
+            fprintf(stderr, "Usage: %s [--world file] [--cache rooms] [--save-world file [--compress-text]] [--memory-report] [--validate] [--validate-threads n] [--journal file | --no-journal] [--sync-every records] [--checkpoint-every records] [--virtual-clock ms] [--hash-trace file] [--spectate socket] [--bench-spectators n] [--bench-migrate n] [--bench-shared n] [--bench-fair n] [--mem-debug] [--mem-warn KB] [--bench-case] [--prompt] [--json] [--undo-depth commands] [--watch-world] [--hints file] [--save-hints file]\n", argv[0]);
+            return EXIT_FAILURE;
         }
     }
-    // Inventory commands
-    else if (strcmp(cmd, "inventory") == 0 || strcmp(cmd, "i") == 0)
+    if (json && spectatePath)
     {
-        ShowInventory(inv);
-        sprintf(result, "Displayed inventory");
+        fprintf(stderr, "--json and --spectate don't go together, spectators would only get to see the JSON\n");
+        return EXIT_FAILURE;
     }
-    else if (strcmp(cmd, "pick") == 0 && strcmp(param1, "up") == 0)
+    if (watchWorld && (!worldPath || savePath || validate || memoryReport || benchCase))
     {
-        char *itemName = command + strlen("pick up ");
-        while (*itemName == ' ')
-            itemName++;
-        GetItem(inv, *currentRoom, itemName);
-        sprintf(result, "Attempted to pick up %s", itemName);
+        fprintf(stderr, "--watch-world needs --world <file> and a game to play on it\n");
+        return EXIT_FAILURE;
     }
-    else if (strcmp(cmd, "take") == 0 && params >= 2)
+    if (watchWorld && memDebug)
     {
-        char *itemName = command + strlen("take ");
-        while (*itemName == ' ')
-            itemName++;
-        GetItem(inv, *currentRoom, itemName);
-        sprintf(result, "Attempted to take %s", itemName);
+        fprintf(stderr, "--watch-world loads new versions on another thread, --mem-debug's block list isn't made for that\n");
+        return EXIT_FAILURE;
     }
-    else if (strcmp(cmd, "drop") == 0 && params >= 2)
+#ifdef _WIN32
+    if (watchWorld)
     {
-        char *itemName = command + strlen("drop ");
-        while (*itemName == ' ')
-            itemName++;
-        ThrowItem(inv, *currentRoom, itemName);
-        sprintf(result, "Attempted to drop %s", itemName);
+        fprintf(stderr, "--watch-world needs threads, not on Windows\n");
+        return EXIT_FAILURE;
     }
-    else if (strcmp(cmd, "examine") == 0 && params >= 2)
+#endif
+    if (benchSpectators >= 0)
     {
-        char *itemName = command + strlen("examine ");
-        while (*itemName == ' ')
-            itemName++;
-        LookAtItem(inv, itemName);
-        sprintf(result, "Examined %s", itemName);
+        BenchSpectators(benchSpectators);
+        return 0;
     }
-    else if (strcmp(cmd, "interact") == 0 && params >= 2)
+    if (benchMigrate >= 0)
     {
-        char *objectName = command + strlen("interact ");
-        while (*objectName == ' ')
-            objectName++;
-        DoInteract(*currentRoom, inv, objectName);
-        sprintf(result, "Interacted with %s", objectName);
+        BenchMigrate(benchMigrate);
+        return 0;
     }
-    else if (strcmp(cmd, "use") == 0 && params >= 3)
+    if (benchShared >= 0)
     {
-        char *args = command + strlen("use ");
-        while (*args == ' ')
-            args++;
-        char *lastSpace = strrchr(args, ' ');
-        if (lastSpace)
-        {
-            char *itemName, *targetName;
-            *lastSpace = '\0';
-            itemName = args;
-            targetName = lastSpace + 1;
-            while (*targetName == ' ')
-                targetName++;
-
-            // Fix for known multi-word targets
-            if (
-                (strcmp(targetName, "door") == 0 || strcmp(targetName, "pane") == 0))
-            {
-                // Move the last word from itemName to targetName
-                char *secondLastSpace = strrchr(itemName, ' ');
-                if (secondLastSpace)
-                {
-                    *secondLastSpace = '\0';
-                    // Prepend the last word to targetName
-                    static char fixedTarget[100];
-                    snprintf(fixedTarget, sizeof(fixedTarget), "%s %s", secondLastSpace + 1, targetName);
-                    targetName = fixedTarget;
-                }
-            }
+        BenchShared(worldPath, benchShared);
+        return 0;
+    }
+    if (benchFair >= 0)
+    {
+        BenchFair(benchFair);
+        return 0;
+    }
 
-            DoUseItem(*currentRoom, inv, itemName, targetName);
-            sprintf(result, "Used %s on %s", itemName, targetName);
-        }
-        else
-        {
-            printf("Usage: use [item] [target]\n");
-            sprintf(result, "Incorrect use command");
-        }
+    // Initialize game
+    bool gameRunning = true;
+    bool hasWon = false;
+    WorldHost *host = NULL;
+    WorldReader *reader = NULL;
+    WorldVersion *version = NULL;
+    World *world;
+    if (watchWorld)
+    {
+        // the whole world stays in memory, the next version gets loaded next to it and swapped in
+        host = OpenWorldHost(worldPath);
+        reader = host ? JoinWorldHost(host, &version) : NULL;
+        world = reader ? version->world : NULL;
     }
-    else if (strcmp(cmd, "combine") == 0 && params >= 3)
+    else
     {
-        char *args = command + strlen("combine ");
-        while (*args == ' ')
-            args++;
+        world = worldPath ? OpenWorld(worldPath, cacheSize) : OpenTableWorld(&builtinWorld);
+    }
+    if (!world)
+    {
+        CloseWorldHost(host);
+        return EXIT_FAILURE;
+    }
+    if (savePath)
+    {
+        bool saved = SaveWorld(savePath, world, compressText);
+        CloseWorld(world);
+        return saved ? 0 : EXIT_FAILURE;
+    }
+    if (saveHintPath)
+    {
+        bool saved = SaveHints(saveHintPath, world);
+        CloseWorld(world);
+        return saved ? 0 : EXIT_FAILURE;
+    }
+    if (hintPath)
+        AttachHints(world, hintPath, false);
+    else if (!worldPath)
+        AttachHints(world, "temple.hints", true);
+    if (benchCase)
+    {
+        BenchCaseFolding(world);
+        CloseWorld(world);
+        return 0;
+    }
+    if (validate)
+    {
+        int problems = ValidateWorld(world, validateThreads, stdout);
+        CloseWorld(world);
+        return problems == 0 ? 0 : EXIT_FAILURE;
+    }
+    if (memoryReport)
+    {
+        PrintMemoryReport(world);
+        CloseWorld(world);
+        return 0;
+    }
 
-        // Find the split point (the space between the two items)
-        // We'll split at the first space that is followed by a word that matches an item in inventory
-        // But for simplicity, split at the middle space
-        char *split = NULL;
-        int spaceCount = 0;
-        for (char *p = args; *p; ++p)
-        {
-            if (*p == ' ')
-                spaceCount++;
-        }
-        if (spaceCount == 0)
-        {
-            printf("Usage: combine [item1] [item2]\n");
-            sprintf(result, "Incorrect combine command");
-        }
-        else
-        {
-            int mid = spaceCount / 2;
-            int count = 0;
-            for (char *p = args; *p; ++p)
-            {
-                if (*p == ' ')
-                {
-                    if (count == mid)
-                    {
-                        split = p;
-                        break;
-                    }
-                    count++;
-                }
-            }
-            if (split)
-            {
-                *split = '\0';
-                char *item1 = args;
-                char *item2 = split + 1;
-                while (*item2 == ' ')
-                    item2++;
-                MergeItems(inv, item1, item2);
-                sprintf(result, "Combined %s with %s", item1, item2);
-            }
-            else
-            {
-                printf("Usage: combine [item1] [item2]\n");
-                sprintf(result, "Incorrect combine command");
-            }
-        }
+    // Set up the player in the first room
+    Session session;
+    if (!StartSession(&session, world))
+    {
+        CloseGameWorld(world, host);
+        return EXIT_FAILURE;
     }
-    else if (strcmp(cmd, "push") == 0 && params >= 2)
+    session.history.depth = undoDepth;
+
+    // if the last game died halfway, the journal has it
+    Journal *journal = NULL;
+    if (journalPath)
     {
-        char *objectName = command + strlen("push ");
-        while (*objectName == ' ')
-            objectName++;
-        if (string_compare(objectName, "crate") == 0 && strcmp((*currentRoom)->name, "Engine Room") == 0)
-        {
-            printf("You push the crate aside, revealing a rucksack hidden behind it!\n");
-            Item *rucksack = MakeItem("Rucksack", 1,
-                                      "A sturdy rucksack that allows you to carry more items.",
-                                      false, "", "");
-            PutItemInRoom(*currentRoom, rucksack);
-            sprintf(result, "Pushed crate, revealed rucksack");
-        }
-        else
+        journal = OpenJournal(journalPath, world, &session, syncEvery, checkpointEvery);
+        if (!journal)
         {
-            printf("You can't push that here.\n");
-            sprintf(result, "Attempted to push %s", objectName);
+            EndSession(&session, world);
+            CloseGameWorld(world, host);
+            return EXIT_FAILURE;
         }
+        session.journal = journal;
     }
-    else if (strcmp(cmd, "look") == 0)
+    bool recovered = journal && journal->recovered;
+
+    // replay it at full speed, the player already saw all of this once
+    char command[100];
+    if (recovered)
     {
-        printf("You are in %s.\n", (*currentRoom)->name);
-        printf("%s\n", (*currentRoom)->description);
-        printf("Exits: ");
-        bool hasExits = false;
-        if ((*currentRoom)->north)
-        {
-            printf("north");
-            hasExits = true;
-        }
-        if ((*currentRoom)->south)
-        {
-            if (hasExits)
-                printf(", ");
-            printf("south");
-            hasExits = true;
-        }
-        if ((*currentRoom)->east)
+        session.quiet = true;
+        while (gameRunning)
         {
-            if (hasExits)
-                printf(", ");
-            printf("east");
-            hasExits = true;
+            ReplayClock(&session);
+            if (!JournalReplaying(journal))
+                break;
+            if (ReadLine(&session, command, sizeof(command)))
+                RunCommand(command, world, &session, &gameRunning, &hasWon, NULL);
         }
-        if ((*currentRoom)->west)
+        session.quiet = false;
+        FinishReplay(journal);
+        if (!gameRunning)
         {
-            if (hasExits)
-                printf(", ");
-            printf("west");
-            hasExits = true;
+            // that game was already over, we just didn't get to clean up. new game
+            EndSession(&session, world);
+            StartSession(&session, world);
+            session.journal = journal;
+            session.history.depth = undoDepth;
+            gameRunning = true;
+            hasWon = false;
+            recovered = false;
+            WriteCheckpoint(journal, world, &session);
         }
-        printf("\n");
-        if ((*currentRoom)->itemCount > 0)
+        else if (session.riddleSlot < 0 && journal->sinceCheckpoint >= journal->checkpointEvery)
         {
-            printf("Items in the room:\n");
-            for (int i = 0; i < (*currentRoom)->itemCount; i++)
-            {
-                printf("- %s\n", (*currentRoom)->items[i]->name);
-            }
+            WriteCheckpoint(journal, world, &session);
         }
-        if ((*currentRoom)->interactableCount > 0)
+    }
+
+    // a recovered game keeps adding to its old log
+    // open the doors for spectators
+    if (spectatePath)
+    {
+        session.broadcast = OpenBroadcast();
+#ifndef _WIN32
+        bool listening = session.broadcast && ListenForSpectators(session.broadcast, spectatePath);
+#else
+        bool listening = false;
+        fprintf(stderr, "Spectating needs unix sockets, not on Windows\n");
+#endif
+        if (!listening)
         {
-            printf("You can interact with:\n");
-            for (int i = 0; i < (*currentRoom)->interactableCount; i++)
-            {
-                printf("- %s\n", (*currentRoom)->interactables[i]->name);
-            }
+            CloseBroadcast(session.broadcast);
+            CloseJournal(journal, false);
+            EndSession(&session, world);
+            CloseGameWorld(world, host);
+            return EXIT_FAILURE;
         }
-        sprintf(result, "Looked around");
     }
-    // Help command
-    else if (strcmp(cmd, "help") == 0)
+
+    FILE *logFile = fopen("game_log.txt", recovered ? "a" : "w");
+    if (!logFile)
     {
-        printf("Available commands:\n");
-        printf("- north/n, south/s, east/e, west/w: Move in a direction\n");
-        printf("- look: Look around the room\n");
-        printf("- inventory/i: Check your inventory\n");
-        printf("- take [item] or pick up [item]: Take an item from the room\n");
-        printf("- drop [item]: Drop an item from your inventory\n");
-        printf("- examine [item]: Look at an item in your inventory\n");
-        printf("- interact [object]: Interact with an object in the room\n");
-        printf("- use [item] [target]: Use an item on a target\n");
-        printf("- combine [item1] [item2]: Combine two items in your inventory\n");
-        printf("- push [object]: Push an object in the room\n");
-        printf("- quit: Exit the game\n");
-        sprintf(result, "Displayed help");
+        perror("Failed to open log file");
+        CloseBroadcast(session.broadcast);
+        CloseJournal(journal, false);
+        EndSession(&session, world);
+        CloseGameWorld(world, host);
+        return EXIT_FAILURE;
     }
-    // Quit commands
-    else if (strcmp(cmd, "quit") == 0)
+    FILE *traceFile = NULL;
+    int traced = 0;
+    if (tracePath)
     {
-        printf("Thanks for playing!\n");
-        *gameRunning = false;
-        sprintf(result, "Quit game");
+        traceFile = fopen(tracePath, "w");
+        if (!traceFile)
+            perror("Failed to open hash trace");
     }
-    // Special case for winning
-    else if (strcmp(cmd, "win") == 0 && strcmp((*currentRoom)->name, "Gold Room") == 0)
-    {
-        printf("\n");
-        printf(" ██╗   ██╗ ██████╗ ██╗   ██╗    ██     ██ ██╗███╗   ██╗\n");
-        printf(" ╚██╗ ██╔╝██╔═══██╗██║   ██║    ██     ██ ██║████╗  ██║\n");
-        printf("  ╚████╔╝ ██║   ██║██║   ██║    ██  █  ██ ██║██╔██╗ ██║\n");
-        printf("   ╚██╔╝  ██║   ██║██║   ██║    ██ ███ ██ ██║██║╚██╗██║\n");
-        printf("    ██║   ╚██████╔╝╚██████╔╝    ╚███╔███╔╝██║██║ ╚████║\n");
-        printf("    ╚═╝    ╚═════╝  ╚═════╝      ╚══╝╚══╝ ╚═╝╚═╝  ╚═══╝\n");
-        printf("\n");
-        printf("Congratulations!\n");
-        printf("You've unlocked the secrets of the temple and won the game!\n");
-        *hasWon = true;
-        *gameRunning = false;
-        sprintf(result, "Won the game");
+    // in machine mode everything the game says gets collected for the next record
+    MachineState machine = {0};
+    char machineText[MACHINE_TEXT];
+    Output machineOut = {machineText, sizeof(machineText), 0};
+    if (json)
+    {
+        session.machine = &machine;
+        session.out = &machineOut;
+        machineText[0] = '\0';
+        showPrompt = false;
+        WriteMachineIntro(stdout, world, &session, recovered);
+        fflush(stdout);
     }
     else
     {
-        printf("Unknown command. Type 'help' for a list of commands.\n");
-        sprintf(result, "Unknown command");
-    }
-    WriteToLog(logFile, command, result);
-}
+        // Print welcome message
+        SayWelcome(world, &session, recovered);
 
-int main()
-{
-    // Initialize game
-    bool gameRunning = true;
-    bool hasWon = false;
-    FILE *logFile = fopen("game_log.txt", "w");
-    if (!logFile)
-    {
-        perror("Failed to open log file");
-        return EXIT_FAILURE;
+        // at a terminal Tab completes commands and names (the terminal goes back to normal when we exit)
+        EnableTabCompletion(&session.completer);
     }
-    Inventory playerInventory;
-    StartInventory(&playerInventory);
 
-    // Create rooms
-    Room *startingRoom = (Room *)malloc(sizeof(Room));
-    Room *jungleRoom = (Room *)malloc(sizeof(Room));
-    Room *engineRoom = (Room *)malloc(sizeof(Room));
-    Room *cyberRoom = (Room *)malloc(sizeof(Room));
-    Room *goldRoom = (Room *)malloc(sizeof(Room));
-    if (!startingRoom || !jungleRoom || !engineRoom || !cyberRoom || !goldRoom)
-    {
-        perror("Failed to allocate memory for rooms");
-        return EXIT_FAILURE;
-    }
+    if (host)
+        WatchWorldFile(host); // if it can't, the game goes on with the version it has
 
-    // Setup starting room
-    strcpy(startingRoom->name, "Entrance Hall");
-    strcpy(startingRoom->description, "A dimly lit entrance hall with ancient stone walls. A golden door is visible to the north.");
-    startingRoom->itemCount = 0;
-    startingRoom->interactableCount = 0;
-    startingRoom->isLocked = false;
-    strcpy(startingRoom->keyName, "");
-    // Add note to starting room
-    Item *note = MakeItem("Note", 1,
-                          "A faded note that reads: 'The guardian of the jungle seeks wisdom. The answer is Time.'",
-                          false, "", "");
-    startingRoom->items[startingRoom->itemCount++] = note;
-    // Add crate to starting room
-    Interactable *crate = MakeInteractable("Crate",
-                                           "A heavy wooden crate. It looks like it needs a tool to open it.",
-                                           "", "");
-    startingRoom->interactables[startingRoom->interactableCount++] = crate;
-
-    // Setup jungle room
-    strcpy(jungleRoom->name, "Jungle Room");
-    strcpy(jungleRoom->description, "A room filled with lush vegetation and the sounds of jungle creatures.");
-    jungleRoom->itemCount = 0;
-    jungleRoom->interactableCount = 0;
-    jungleRoom->isLocked = false;
-    strcpy(jungleRoom->keyName, "");
-    // Add Rusty Cog to jungle room
-    Item *rustyCog = MakeItem("Rusty Cog", 1,
-                              "A heavily rusted metal cog. Looks like it could fit into some machinery if it wasn't so rusty.",
-                              true, "Anti-Rust Solution", "Clean Cog");
-    jungleRoom->items[jungleRoom->itemCount++] = rustyCog;
-    // Add jaguar to jungle room
-    Interactable *jaguar = MakeInteractable("Jaguar",
-                                            "A majestic stone jaguar statue with emerald eyes.",
-                                            "I am always coming but never arrive. What am I?", "Tomorrow");
-    jungleRoom->interactables[jungleRoom->interactableCount++] = jaguar;
-    // Add chest to jungle room
-    Interactable *chest = MakeInteractable("Chest",
-                                           "A wooden chest guarded by the jaguar statue.",
-                                           "", "");
-    jungleRoom->interactables[jungleRoom->interactableCount++] = chest;
-    // Add tree to jungle room
-    Interactable *tree = MakeInteractable("Tree",
-                                          "An unusual tree with metal components embedded in its trunk.",
-                                          "", "");
-    jungleRoom->interactables[jungleRoom->interactableCount++] = tree;
-
-    // Setup engine room
-    strcpy(engineRoom->name, "Engine Room");
-    strcpy(engineRoom->description, "A room filled with strange machinery. There's a large control panel in the center.");
-    engineRoom->itemCount = 0;
-    engineRoom->interactableCount = 0;
-    engineRoom->isLocked = false;
-    strcpy(engineRoom->keyName, "");
-    // Add crate to engine room
-    Interactable *engineCrate = MakeInteractable("Crate",
-                                                 "A heavy crate pushed against the wall. Maybe there's something behind it?",
-                                                 "", "");
-    engineRoom->interactables[engineRoom->interactableCount++] = engineCrate;
-    // Add machine to engine room
-    Interactable *machine = MakeInteractable("Machine",
-                                             "A complex machine with a slot that seems to fit a cog.",
-                                             "", "");
-    engineRoom->interactables[engineRoom->interactableCount++] = machine;
-
-    // Setup cyber room
-    strcpy(cyberRoom->name, "Cyber Room");
-    strcpy(cyberRoom->description, "A futuristic room with blinking lights and high-tech equipment.");
-    cyberRoom->itemCount = 0;
-    cyberRoom->interactableCount = 0;
-    cyberRoom->isLocked = true;
-    strcpy(cyberRoom->keyName, "Keycard");
-    // Add crowbar container to cyber room
-    Interactable *glassPane = MakeInteractable("Glass Pane",
-                                               "A reinforced glass pane with a crowbar behind it.",
-                                               "", "");
-    cyberRoom->interactables[cyberRoom->interactableCount++] = glassPane;
-    // Add kitchen to cyber room
-    Interactable *kitchen = MakeInteractable("Kitchen",
-                                             "A hi-tech kitchen with various appliances, including a futuristic blender.",
-                                             "", "");
-    cyberRoom->interactables[cyberRoom->interactableCount++] = kitchen;
-
-    // Setup gold room (win condition)
-    strcpy(goldRoom->name, "Gold Room");
-    strcpy(goldRoom->description, "A magnificent room filled with golden treasures! You have won the game!");
-    goldRoom->itemCount = 0;
-    goldRoom->interactableCount = 0;
-    goldRoom->isLocked = true;
-    strcpy(goldRoom->keyName, "Golden Key");
-
-    // Connect rooms
-    startingRoom->north = goldRoom;
-    startingRoom->south = jungleRoom;
-    startingRoom->east = engineRoom;
-    startingRoom->west = cyberRoom;
-
-    jungleRoom->north = startingRoom;
-    jungleRoom->south = NULL;
-    jungleRoom->east = NULL;
-    jungleRoom->west = NULL;
-
-    engineRoom->north = NULL;
-    engineRoom->south = NULL;
-    engineRoom->east = NULL;
-    engineRoom->west = startingRoom;
-
-    cyberRoom->north = NULL;
-    cyberRoom->south = NULL;
-    cyberRoom->east = startingRoom;
-    cyberRoom->west = NULL;
-
-    goldRoom->north = NULL;
-    goldRoom->south = startingRoom;
-    goldRoom->east = NULL;
-    goldRoom->west = NULL;
-
-    // Set the current room
-    Room *currentRoom = startingRoom;
-
-    // Print welcome message
-    printf(" ████████╗███████╗███╗░░░███╗██████╗░██╗░░░░░███████╗░░░░░░░░██████╗███████╗░█████╗ ░██████╗░███████╗████████╗░██████╗\n");
-    printf( "╚══██╔══╝██╔════╝████╗░████║██╔══██╗██║░░░░░██╔════╝░░░░░░░██╔════╝██╔════╝██╔══██╗ ██╔══██╗██╔════╝╚══██╔══╝██╔════╝\n");
-    printf(" ░░░██║░░░█████╗░░██╔████╔██║██████╔╝██║░░░░░█████╗░░░░░░░░░╚█████╗░█████╗░░██║░░╚═ ╝██████╔╝█████╗░░░░░██║░░░╚█████╗░\n");
-    printf(" ░░░██║░░░██╔══╝░░██║╚██╔╝██║██╔═══╝░██║░░░░░██╔══╝░░░░░░░░░░╚═══██╗██╔══╝░░██║░░██╗ ██╔══██╗██╔══╝░░░░░██║░░░░╚═══██╗\n");
-    printf(" ░░░██║░░░███████╗██║░╚═╝░██║██║░░░░░███████╗███████╗░░░░░░░██████╔╝███████╗╚█████╔╝ ██║░░██║███████╗░░░██║░░░██████╔╝\n");
-    printf(" ░░░╚═╝░░░╚══════╝╚═╝░░░░░╚═╝╚═╝░░░░░╚══════╝╚══════╝░░░░░░░░═════╝░╚══════╝░╚════╝░ ╚═╝░░╚═╝╚══════╝░░░╚═╝░░░╚═════╝░\n");
-    printf("Welcome to the Temple of Secrets!\n");
-    printf("You are an explorer seeking the treasures of an ancient temple.\n");
-    printf("Navigate through the rooms, solve puzzles, and find the golden key to win!\n");
-    printf("Type 'help' for a list of commands.\n\n");
-    printf("You are in %s.\n", currentRoom->name);
-    printf("%s\n", currentRoom->description);
+    // the real clock picks up where the session's clock is (0 for a new game)
+    long long clockBase = NowMs() - session.timers.now * TICK_MS;
 
     // Main game loop
-    char command[100];
     while (gameRunning)
     {
-        printf("\n> ");
-        fgets(command, sizeof(command), stdin);
-        command[strcspn(command, "\n")] = 0;
-        DoCommand(command, &playerInventory, &currentRoom, &gameRunning, &hasWon, logFile);
-        if (strcmp(currentRoom->name, "Gold Room") == 0 && !hasWon)
+        if (session.riddleSlot >= 0)
         {
-            printf("\n");
-            printf(" ██╗   ██╗ ██████╗ ██╗   ██╗    ██     ██ ██╗███╗   ██╗\n");
-            printf(" ╚██╗ ██╔╝██╔═══██╗██║   ██║    ██     ██ ██║████╗  ██║\n");
-            printf("  ╚████╔╝ ██║   ██║██║   ██║    ██  █  ██ ██║██╔██╗ ██║\n");
-            printf("   ╚██╔╝  ██║   ██║██║   ██║    ██ ███ ██ ██║██║╚██╗██║\n");
-            printf("    ██║   ╚██████╔╝╚██████╔╝    ╚███╔███╔╝██║██║ ╚████║\n");
-            printf("    ╚═╝    ╚═════╝  ╚═════╝      ╚══╝╚══╝ ╚═╝╚═╝  ╚═══╝\n");
-            printf("\n");
-            printf("Congratulations! You've made it to the Gold Room and found the treasure!\n");
-            hasWon = true;
-            gameRunning = false;
+            session.atPrompt = true; // "What's your answer? " is the prompt this time
+        }
+        else if (showPrompt)
+        {
+            Say(&session, "\n> ");
+            session.atPrompt = true;
+        }
+        WaitForPlayer(&session, clockBase);
+        bool gotLine = ReadLine(&session, command, sizeof(command));
+        session.atPrompt = false;
+        if (!gotLine)
+            break; // out of input, the journal keeps the game for next time
+        AdvanceClock(&session, virtualStep ? session.timers.now + virtualStep : (NowMs() - clockBase) / TICK_MS);
+        // between commands is where the game goes over to a new version of the world
+        if (host && session.riddleSlot < 0 && FollowWorld(host, reader, &version))
+        {
+            MoveSession(&session, version->world);
+            world = version->world;
+            // the journal's header and records are for the old version, a recovery on the new file needs a
+            // checkpoint made on it. the line we're about to run was journaled before the switch, so again after it
+            if (journal)
+            {
+                WriteCheckpoint(journal, world, &session);
+                AppendRecord(journal, "L", command);
+            }
+            char note[40];
+            snprintf(note, sizeof(note), "Now on version %d", version->number);
+            WriteToLog(logFile, "World file changed", note);
+        }
+        RunCommand(command, world, &session, &gameRunning, &hasWon, logFile);
+        if (json)
+        {
+            WriteMachineRecord(stdout, world, &session, gameRunning, hasWon);
+            // a bot waits for the answer before it sends more, one that sent a pile of commands can wait for the pile
+            if (!InputPending())
+                fflush(stdout);
+        }
+        PumpSpectators(session.broadcast);
+        if (memWarn > 0 && SessionMemory(&session) > memWarn)
+        {
+            fprintf(stderr, "Warning: this session is using %lld bytes (limit %lld)\n", SessionMemory(&session), memWarn);
+            memWarn *= 2; // next warning when it doubles again, not after every command
+        }
+        if (traceFile)
+        {
+            // one line per command: number, hash, what was typed
+            unsigned long long hash = StateHash(&session);
+            fprintf(traceFile, "%d %016llx %s\n", ++traced, hash, command);
+            if (hash != ComputeStateHash(&session))
+                fprintf(stderr, "State hash is off after command %d (%s)\n", traced, command);
         }
+        // a checkpoint can't hold a riddle halfway through, it waits for the answer
+        if (journal && gameRunning && session.riddleSlot < 0 && journal->sinceCheckpoint >= journal->checkpointEvery)
+            WriteCheckpoint(journal, world, &session);
     }
     fclose(logFile);
+    if (traceFile)
+        fclose(traceFile);
+    CloseBroadcast(session.broadcast);
+    CloseJournal(journal, !gameRunning);
 
     // Free allocated memory
-    for (int i = 0; i < startingRoom->itemCount; i++)
-        free(startingRoom->items[i]);
-    for (int i = 0; i < jungleRoom->itemCount; i++)
-        free(jungleRoom->items[i]);
-    for (int i = 0; i < engineRoom->itemCount; i++)
-        free(engineRoom->items[i]);
-    for (int i = 0; i < cyberRoom->itemCount; i++)
-        free(cyberRoom->items[i]);
-    for (int i = 0; i < goldRoom->itemCount; i++)
-        free(goldRoom->items[i]);
-    for (int i = 0; i < startingRoom->interactableCount; i++)
-        free(startingRoom->interactables[i]);
-    for (int i = 0; i < jungleRoom->interactableCount; i++)
-        free(jungleRoom->interactables[i]);
-    for (int i = 0; i < engineRoom->interactableCount; i++)
-        free(engineRoom->interactables[i]);
-    for (int i = 0; i < cyberRoom->interactableCount; i++)
-        free(cyberRoom->interactables[i]);
-    for (int i = 0; i < goldRoom->interactableCount; i++)
-        free(goldRoom->interactables[i]);
-    free(startingRoom);
-    free(jungleRoom);
-    free(engineRoom);
-    free(cyberRoom);
-    free(goldRoom);
-    free(playerInventory.items);
+    EndSession(&session, world);
+    CloseGameWorld(world, host);
+    ReportLeaks();
     return 0;
 }
+#endif
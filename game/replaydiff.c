@@ -0,0 +1,158 @@
+// Replay divergence finder for the Temple of Secrets
+// Plays the same transcript on two builds of the game and tells you the first
+// command after which their state hashes differ (see StateHash in
+// full_game.c). Both runs use a virtual clock so timed events go off at the
+// same commands, and run in a temp directory so they don't touch your saves.
+//
+//   gcc replaydiff.c -o replaydiff
+//   ./replaydiff ./old_build ./new_build transcript.txt [more game options]
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// run one build on the transcript inside dir, the hash trace ends up in dir/trace
+static bool RunBuild(const char *build, const char *transcript, const char *dir, int extraCount, char **extra)
+{
+    char program[PATH_MAX];
+    if (!realpath(build, program))
+    {
+        perror(build);
+        return false;
+    }
+    int input = open(transcript, O_RDONLY);
+    if (input < 0)
+    {
+        perror(transcript);
+        return false;
+    }
+
+    char **args = malloc(sizeof(char *) * (extraCount + 8));
+    if (!args)
+    {
+        close(input);
+        return false;
+    }
+    int n = 0;
+    args[n++] = program;
+    args[n++] = "--no-journal";
+    args[n++] = "--virtual-clock";
+    args[n++] = "1000";
+    args[n++] = "--hash-trace";
+    args[n++] = "trace";
+    for (int i = 0; i < extraCount; i++)
+        args[n++] = extra[i];
+    args[n] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int quiet = open("/dev/null", O_WRONLY);
+        dup2(input, STDIN_FILENO);
+        dup2(quiet, STDOUT_FILENO);
+        dup2(quiet, STDERR_FILENO);
+        if (chdir(dir) == 0)
+            execv(program, args);
+        _exit(127);
+    }
+    close(input);
+    free(args);
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0)
+    {
+        perror("Couldn't run the game");
+        return false;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) == 127)
+    {
+        fprintf(stderr, "%s didn't run properly\n", build);
+        return false;
+    }
+    return true;
+}
+
+static FILE *OpenTrace(const char *dir)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/trace", dir);
+    FILE *file = fopen(path, "r");
+    if (!file)
+        perror(path);
+    return file;
+}
+
+// throw away what a run left behind
+static void CleanUp(const char *dir)
+{
+    const char *files[] = {"trace", "game_log.txt"};
+    char path[PATH_MAX];
+    for (int i = 0; i < 2; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+        remove(path);
+    }
+    rmdir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        fprintf(stderr, "Usage: %s <build A> <build B> <transcript> [game options...]\n", argv[0]);
+        return 2;
+    }
+    char dirA[] = "/tmp/replaydiff-XXXXXX";
+    char dirB[] = "/tmp/replaydiff-XXXXXX";
+    if (!mkdtemp(dirA) || !mkdtemp(dirB))
+    {
+        perror("Couldn't make temp directory");
+        return 2;
+    }
+
+    bool ran = RunBuild(argv[1], argv[3], dirA, argc - 4, argv + 4) &&
+               RunBuild(argv[2], argv[3], dirB, argc - 4, argv + 4);
+    FILE *a = ran ? OpenTrace(dirA) : NULL;
+    FILE *b = ran ? OpenTrace(dirB) : NULL;
+    int result = 2;
+    if (a && b)
+    {
+        // lines look like "<command number> <hash> <command>"
+        char lineA[256], lineB[256];
+        int matched = 0;
+        result = 0;
+        while (true)
+        {
+            bool gotA = fgets(lineA, sizeof(lineA), a) != NULL;
+            bool gotB = fgets(lineB, sizeof(lineB), b) != NULL;
+            if (!gotA && !gotB)
+                break;
+            if (gotA && gotB && strcmp(lineA, lineB) == 0)
+            {
+                matched++;
+                continue;
+            }
+
+            result = 1;
+            lineA[strcspn(lineA, "\n")] = '\0';
+            lineB[strcspn(lineB, "\n")] = '\0';
+            printf("Diverged at command %d (first %d match)\n", matched + 1, matched);
+            printf("  A: %s\n", gotA ? lineA : "(game already over)");
+            printf("  B: %s\n", gotB ? lineB : "(game already over)");
+            break;
+        }
+        if (result == 0)
+            printf("Same state after all %d commands\n", matched);
+    }
+    if (a)
+        fclose(a);
+    if (b)
+        fclose(b);
+    CleanUp(dirA);
+    CleanUp(dirB);
+    return result;
+}
@@ -0,0 +1,187 @@
+// Temple of Secrets as a library
+// Every game lives in its own TempleGame, there's nothing global that one game can see of another
+// (unless they joined the same shared world) and nothing in here ever exits the process, so a server can run thousands of games side by side.
+// Output goes into the caller's buffer instead of stdout, time only moves when you call game_tick.
+//
+//   TempleGame *game = game_create(NULL);
+//   char out[4096];
+//   game_intro(game, out, sizeof(out));
+//   game_step(game, "take note; north", out, sizeof(out));
+//   ...
+//   game_destroy(game);
+//
+// The output functions work like snprintf: they return how many bytes the game said (not counting
+// the '\0'), at most outSize - 1 of them land in out, and out is always '\0' terminated (if outSize > 0).
+// out can be NULL with outSize 0 to just throw the output away.
+// One game must not be used by two threads at the same time (different games are fine, see README).
+//
+//   ar rcs libtemple.a ...   (make libtemple.a), full_game.c built with -DTEMPLE_NO_MAIN
+
+#ifndef TEMPLE_H
+#define TEMPLE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TempleGame TempleGame;
+
+// what game_status says
+enum
+{
+    TEMPLE_PLAYING,
+    TEMPLE_WON,
+    TEMPLE_OVER // quit, or lost for good
+};
+
+// a new game on a world file (page file from --save-world), NULL = the built-in temple
+// NULL if the world can't be opened or there's no memory
+TempleGame *game_create(const char *worldPath);
+
+// the title screen and the first room
+int game_intro(TempleGame *game, char *out, size_t outSize);
+
+// one line like a player would type it ("look", or a batch like "take note; north")
+// after the game is over lines don't do anything anymore
+int game_step(TempleGame *game, const char *line, char *out, size_t outSize);
+
+// ms of game time go by, timers that come due go off (and may say something)
+int game_tick(TempleGame *game, long long ms, char *out, size_t outSize);
+
+int game_status(const TempleGame *game);
+
+void game_destroy(TempleGame *game);
+
+// ----- worlds that can change while games are running on them -----
+// a host keeps one page file loaded whole. host_reload loads it again (or another file) and every
+// game on the host goes over to the new version before its next game_step, without losing anything.
+// games never wait for a reload, old versions are freed once no game can still be on them
+//
+//   TempleHost *host = host_create("big.pages");
+//   TempleGame *game = game_create_on(host);
+//   ...
+//   host_reload(host, NULL);   // from any thread, say after the file changed
+//   ...
+//   game_destroy(game);        // every game first, then
+//   host_destroy(host);
+
+typedef struct TempleHost TempleHost;
+
+// NULL if the world can't be loaded or there's no memory
+TempleHost *host_create(const char *worldPath);
+
+// load worldPath (NULL = the same file again) and put it out as the next version, returns its number
+// (the first one is 1), -1 if it can't be loaded, fails the validator or has fewer rooms or items than
+// the one before (games keep their room and item ids). can be called from any thread
+int host_reload(TempleHost *host, const char *worldPath);
+
+// free old versions that no game is on anymore (host_reload does this too), returns how many are left
+int host_collect(TempleHost *host);
+
+// after all of its games are destroyed
+void host_destroy(TempleHost *host);
+
+TempleGame *game_create_on(TempleHost *host);
+
+// the version of the world the game is on (1 for games with their own world)
+int game_world_version(const TempleGame *game);
+
+// ----- moving a game to another process -----
+// a saved game is a few dozen bytes with nothing in it that points anywhere (rooms and items are ids),
+// any process with the same world can load it. undo history doesn't come along.
+// games in a shared world can't be saved or sent (game_save says 0, game_send -1)
+//
+//   // old process: stop reading from the player, then
+//   if (game_send(sock, game, playerFd) == 0) { game_destroy(game); close(playerFd); }
+//   // new process:
+//   TempleGame *game = game_receive_on(sock, host, &playerFd);
+
+// the game into buf, works like snprintf: returns how many bytes it takes, only complete if that's <= size
+size_t game_save(const TempleGame *game, void *buf, size_t size);
+
+// a new game that carries on from a saved one, NULL if it's from another world, broken or there's no memory
+TempleGame *game_load(const char *worldPath, const void *data, size_t size);
+TempleGame *game_load_on(TempleHost *host, const void *data, size_t size);
+
+// hand the game over on a connected unix stream socket, clientFd (the player's socket, -1 = none) goes
+// along with it (SCM_RIGHTS). waits for the other side to answer: 0 = it has the game now, -1 = it
+// doesn't (the game and the player are still yours). not on Windows, always -1 there
+int game_send(int sock, const TempleGame *game, int clientFd);
+
+// take over the next game sent on sock, *clientFd = the player's socket that came with it (or -1)
+// NULL when the sender hung up (or the game couldn't be loaded, the sender hears about that)
+TempleGame *game_receive(int sock, const char *worldPath, int *clientFd);
+TempleGame *game_receive_on(int sock, TempleHost *host, int *clientFd);
+
+// ----- serving lots of players fairly -----
+// a server shouldn't run whatever it just read from a player right away: one bot pasting thousands of
+// commands would make everybody else wait for all of them. queue what comes in instead and let
+// scheduler_run give every player a turn: each round every player with a whole command queued gets
+// up to turnLines commands and turnNs of CPU (deficit round robin: whoever goes over sits out until
+// it's paid back). a player's queue holds queueBytes, scheduler_queue takes what fits and the rest is
+// for later, stop reading from that player until scheduler_room says there's room again (backpressure).
+// commands end at '\n' or ';', blank ones don't count. one scheduler must only be used by one thread
+//
+//   TempleScheduler *sched = scheduler_create(0, 0, 0);       // 0 = defaults (4 lines, 0.25 ms, 2 KB)
+//   int ana = scheduler_add(sched, game, SendToPlayer, conn);
+//   ... in the event loop:
+//   if (scheduler_room(sched, ana) > 0) { n = read(fd, buf, scheduler_room(sched, ana)); scheduler_queue(sched, ana, buf, n); }
+//   while (scheduler_run(sched) > 0 && nothing to read) ;
+
+typedef struct TempleScheduler TempleScheduler;
+
+// gets what a command said (not '\0' terminated, cut off after 16 KB)
+typedef void (*TempleOutput)(void *user, const char *text, size_t length);
+
+TempleScheduler *scheduler_create(int turnLines, long long turnNs, size_t queueBytes);
+
+// the game stays the caller's, returns the player's number for the calls below (-1 = no memory)
+int scheduler_add(TempleScheduler *sched, TempleGame *game, TempleOutput output, void *user);
+
+// takes as much of text as fits into the player's queue, returns how much that was
+size_t scheduler_queue(TempleScheduler *sched, int player, const char *text, size_t length);
+
+// how much scheduler_queue would take right now
+size_t scheduler_room(const TempleScheduler *sched, int player);
+
+// one round, returns how many players still have commands waiting (0 = all caught up)
+int scheduler_run(TempleScheduler *sched);
+
+// whatever is still queued is dropped, the player's number can come back from scheduler_add
+void scheduler_remove(TempleScheduler *sched, int player);
+
+void scheduler_destroy(TempleScheduler *sched);
+
+// ----- several players in one world -----
+// games that join the same shared world see each other's changes: what one takes is gone for the others,
+// a door one opens is open for everybody. each game still has its own room, bag and clock, and hears
+// about what the others do in its room at the start of its next game_step or game_tick
+// ("Ana picks up the Note."). games in a shared world can run on different threads at the same time,
+// lines in the same room take turns and lines in different rooms don't wait for each other
+//
+//   TempleShared *shared = shared_create(NULL);
+//   TempleGame *ana = game_join(shared, "Ana");
+//   TempleGame *ben = game_join(shared, "Ben");
+//   ...
+//   game_destroy(ana);           // what Ana carried stays in the room Ana was in
+//   game_destroy(ben);           // every game first, then
+//   shared_destroy(shared);
+
+typedef struct TempleShared TempleShared;
+
+// the world is loaded whole, NULL = the built-in temple. NULL if it can't be loaded or there's no memory
+TempleShared *shared_create(const char *worldPath);
+
+// a new player at the start room, name is what the others hear about (NULL = "Player <n>")
+TempleGame *game_join(TempleShared *shared, const char *name);
+
+// after all of its games are destroyed
+void shared_destroy(TempleShared *shared);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1026 @@
+// Traffic model for the Temple of Secrets
+// Learns how people really play from game logs (game_log.txt, as many as you have) and makes up as many
+// new players as you want who play the same way, for load tests. People look around, check their bag,
+// walk back and forth and get the jaguar riddle wrong twice, random commands don't, and the numbers
+// you get from random commands are off.
+//
+// The model is a Markov chain per room: what comes next depends on the room and on the verb of the
+// command before (after "interact jaguar" comes an answer, after "take" often an "i"). How long people
+// think before a command depends on that verb too, learned from the time stamps (to the second, that's
+// all the log has). A session ends where it did in the logs, so how long people play is learned as
+// well. The log doesn't say which room anybody was in, so learning plays every session through the
+// engine again to find out (use the same --world the logs were made on). The log doesn't say where a
+// game starts either: a new one starts after --gap seconds without a command, after a game was won or
+// lost, and with every log file.
+//
+// run plays the model against the engine, in this process or through the game's stdin and stdout
+// (--pipe, one game process per player, in --json mode). Every player plays one session after the
+// other for as long as the run goes. --speed 10 makes everybody think 10 times faster.
+//
+//   make trafficgen   (or: gcc -O2 -pthread trafficgen.c -o trafficgen)
+//   ./trafficgen learn -o players.model game_log.txt more/game_log.txt
+//   ./trafficgen run players.model --players 1000 --seconds 60
+//   ./trafficgen run players.model --players 50 --pipe ./temple_of_secrets
+
+#define TEMPLE_NO_MAIN
+#include "full_game.c"
+
+#include <poll.h>
+
+#define TRAFFIC_LINE 1024
+#define MAX_VERB 24
+#define MAX_THINK 60        // s, longer pauses count as 60
+#define DEFAULT_GAP 1800    // s without a command and it's a new game
+#define MIN_THINK_SAMPLES 5 // fewer than that after a verb and the pauses after any verb are used
+#define RECORD_START 160    // what's kept of a JSON record, status and room are right at the start
+#define MIX_VERBS 64
+#define ANY "*"
+
+typedef struct
+{
+    char *command; // NULL = the session ends here
+    int count;
+} ChainNext;
+
+typedef struct
+{
+    char *room;          // its name, "*" = any room
+    char verb[MAX_VERB]; // of the command before, "" = the session just started, "*" = any
+    ChainNext *next;
+    int nextCount;
+    int nextCapacity;
+    int total;
+} ChainState;
+
+typedef struct
+{
+    char verb[MAX_VERB]; // of the command before the pause, "*" = any
+    int seconds[MAX_THINK + 1];
+    int total;
+} ThinkTimes;
+
+typedef struct
+{
+    ChainState *states;
+    int stateCount;
+    int stateCapacity;
+    int *table; // open addressing over room and verb, state index + 1 (0 = empty)
+    int tableSize;
+    ThinkTimes *think; // only a few verbs, looked up one by one
+    int thinkCount;
+    int thinkCapacity;
+    int sessions;
+    long long lines;
+} TrafficModel;
+
+typedef struct
+{
+    const char *worldPath;
+    const char *pipeProgram;
+    int players;
+    double seconds;
+    double speed;
+    unsigned long long seed;
+    int gap;
+} TrafficOptions;
+
+typedef struct
+{
+    char verb[MAX_VERB];
+    long long count;
+} VerbCount;
+
+typedef struct
+{
+    long long *waits; // ns every command took to answer, for the percentiles
+    int waitCount;
+    int waitCapacity;
+    long long commands;
+    int sessions;
+    int won;
+    VerbCount mix[MIX_VERBS]; // what the players typed, the last one is everything else
+    int mixCount;
+} TrafficStats;
+
+typedef struct
+{
+    unsigned long long random;
+    char verb[MAX_VERB]; // of the last command, "" = the session just started
+    long long nextAt;    // ns, when the next command gets typed
+    // in this process
+    TempleGame *game;
+    // through a pipe
+    pid_t pid; // 0 = no game running
+    int in, out;
+    char dir[32]; // the game runs in here, so its log doesn't land in ours
+    char record[RECORD_START];
+    size_t recordLength;
+    long long sentAt; // 0 = not waiting for an answer
+    bool started;     // got the first record
+    int room;
+} TrafficPlayer;
+
+static unsigned int NextRandom(unsigned long long *state)
+{
+    // xorshift64*, the top 32 bits
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (unsigned int)((*state * 2685821657736338717ULL) >> 32);
+}
+
+// trimmed, lowercase and one space between words, like the game reads it
+static void NormalizeCommand(const char *in, char *out, size_t size)
+{
+    size_t n = 0;
+    bool space = false;
+    for (; *in && n + 1 < size; in++)
+    {
+        unsigned char c = (unsigned char)*in;
+        if (isspace(c))
+        {
+            space = n > 0;
+            continue;
+        }
+        if (space && n + 2 < size)
+            out[n++] = ' ';
+        space = false;
+        out[n++] = (char)LowerAscii(c);
+    }
+    out[n] = '\0';
+}
+
+static void VerbOf(const char *command, char *verb)
+{
+    size_t n = 0;
+    while (command[n] && command[n] != ' ' && n + 1 < MAX_VERB)
+    {
+        verb[n] = command[n];
+        n++;
+    }
+    verb[n] = '\0';
+}
+
+// ----- the model -----
+
+static unsigned int HashState(const char *room, const char *verb)
+{
+    // FNV-1a over both, with the tab the file has between them
+    unsigned int h = 2166136261u;
+    for (const char *p = room; *p; p++)
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    h = (h ^ '\t') * 16777619u;
+    for (const char *p = verb; *p; p++)
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    return h;
+}
+
+static bool GrowStateTable(TrafficModel *m)
+{
+    int newSize = m->tableSize ? m->tableSize * 2 : 256;
+    int *table = MemCalloc(MEM_WORLD, newSize, sizeof(int));
+    if (!table)
+        return false;
+    for (int i = 0; i < m->stateCount; i++)
+    {
+        unsigned int slot = HashState(m->states[i].room, m->states[i].verb) & (newSize - 1);
+        while (table[slot])
+            slot = (slot + 1) & (newSize - 1);
+        table[slot] = i + 1;
+    }
+    MemFree(m->table);
+    m->table = table;
+    m->tableSize = newSize;
+    return true;
+}
+
+static ChainState *FindState(TrafficModel *m, const char *room, const char *verb, bool add)
+{
+    if (m->tableSize)
+    {
+        unsigned int slot = HashState(room, verb) & (m->tableSize - 1);
+        for (; m->table[slot]; slot = (slot + 1) & (m->tableSize - 1))
+        {
+            ChainState *st = &m->states[m->table[slot] - 1];
+            if (strcmp(st->room, room) == 0 && strcmp(st->verb, verb) == 0)
+                return st;
+        }
+    }
+    if (!add)
+        return NULL;
+    // keep the table at most half full
+    if ((m->stateCount + 1) * 2 > m->tableSize && !GrowStateTable(m))
+        return NULL;
+    if (m->stateCount == m->stateCapacity)
+    {
+        int newCapacity = m->stateCapacity ? m->stateCapacity * 2 : 64;
+        ChainState *grown = MemRealloc(MEM_WORLD, m->states, sizeof(ChainState) * newCapacity);
+        if (!grown)
+            return NULL;
+        m->states = grown;
+        m->stateCapacity = newCapacity;
+    }
+    ChainState *st = &m->states[m->stateCount];
+    memset(st, 0, sizeof(*st));
+    st->room = MemAlloc(MEM_WORLD, strlen(room) + 1);
+    if (!st->room)
+        return NULL;
+    strcpy(st->room, room);
+    snprintf(st->verb, sizeof(st->verb), "%s", verb);
+    unsigned int slot = HashState(room, st->verb) & (m->tableSize - 1);
+    while (m->table[slot])
+        slot = (slot + 1) & (m->tableSize - 1);
+    m->table[slot] = ++m->stateCount;
+    return st;
+}
+
+static bool CountNext(ChainState *st, const char *command, int count)
+{
+    st->total += count;
+    for (int i = 0; i < st->nextCount; i++)
+    {
+        const char *known = st->next[i].command;
+        if (known == command || (known && command && strcmp(known, command) == 0))
+        {
+            st->next[i].count += count;
+            return true;
+        }
+    }
+    if (st->nextCount == st->nextCapacity)
+    {
+        int newCapacity = st->nextCapacity ? st->nextCapacity * 2 : 4;
+        ChainNext *grown = MemRealloc(MEM_WORLD, st->next, sizeof(ChainNext) * newCapacity);
+        if (!grown)
+            return false;
+        st->next = grown;
+        st->nextCapacity = newCapacity;
+    }
+    ChainNext *next = &st->next[st->nextCount];
+    next->command = NULL;
+    next->count = count;
+    if (command)
+    {
+        next->command = MemAlloc(MEM_WORLD, strlen(command) + 1);
+        if (!next->command)
+            return false;
+        strcpy(next->command, command);
+    }
+    st->nextCount++;
+    return true;
+}
+
+static ThinkTimes *FindThink(TrafficModel *m, const char *verb, bool add)
+{
+    for (int i = 0; i < m->thinkCount; i++)
+        if (strcmp(m->think[i].verb, verb) == 0)
+            return &m->think[i];
+    if (!add)
+        return NULL;
+    if (m->thinkCount == m->thinkCapacity)
+    {
+        int newCapacity = m->thinkCapacity ? m->thinkCapacity * 2 : 16;
+        ThinkTimes *grown = MemRealloc(MEM_WORLD, m->think, sizeof(ThinkTimes) * newCapacity);
+        if (!grown)
+            return NULL;
+        m->think = grown;
+        m->thinkCapacity = newCapacity;
+    }
+    ThinkTimes *t = &m->think[m->thinkCount++];
+    memset(t, 0, sizeof(*t));
+    snprintf(t->verb, sizeof(t->verb), "%s", verb);
+    return t;
+}
+
+// one command (NULL = the session ended) typed in room after verb, counted for the exact state and
+// for the ones generating falls back on when it gets somewhere the logs never went
+static bool LearnCommand(TrafficModel *m, const char *room, const char *verb, const char *command)
+{
+    const char *rooms[4] = {room, room, ANY, ANY};
+    const char *verbs[4] = {verb, ANY, verb, ANY};
+    for (int i = 0; i < 4; i++)
+    {
+        ChainState *st = FindState(m, rooms[i], verbs[i], true);
+        if (!st || !CountNext(st, command, 1))
+            return false;
+    }
+    return true;
+}
+
+static bool LearnPause(TrafficModel *m, const char *verb, long long seconds)
+{
+    if (seconds < 0)
+        seconds = 0;
+    if (seconds > MAX_THINK)
+        seconds = MAX_THINK;
+    ThinkTimes *exact = FindThink(m, verb, true);
+    ThinkTimes *any = FindThink(m, ANY, true);
+    if (!exact || !any)
+        return false;
+    exact->seconds[seconds]++;
+    exact->total++;
+    any->seconds[seconds]++;
+    any->total++;
+    return true;
+}
+
+static void FreeModel(TrafficModel *m)
+{
+    for (int i = 0; i < m->stateCount; i++)
+    {
+        for (int k = 0; k < m->states[i].nextCount; k++)
+            MemFree(m->states[i].next[k].command);
+        MemFree(m->states[i].next);
+        MemFree(m->states[i].room);
+    }
+    MemFree(m->states);
+    MemFree(m->table);
+    MemFree(m->think);
+    memset(m, 0, sizeof(*m));
+}
+
+// what comes after verb in room, NULL if the session ends
+static const char *PickCommand(TrafficModel *m, const char *room, const char *verb, unsigned long long *random)
+{
+    ChainState *st = FindState(m, room, verb, false);
+    if (!st || st->total == 0)
+        st = FindState(m, room, ANY, false);
+    if (!st || st->total == 0)
+        st = FindState(m, ANY, verb, false);
+    if (!st || st->total == 0)
+        st = FindState(m, ANY, ANY, false);
+    if (!st || st->total == 0)
+        return NULL;
+    int pick = (int)(NextRandom(random) % (unsigned int)st->total);
+    for (int i = 0; i < st->nextCount; i++)
+    {
+        pick -= st->next[i].count;
+        if (pick < 0)
+            return st->next[i].command;
+    }
+    return NULL;
+}
+
+// ns somebody thinks after typing verb
+static long long PickThink(TrafficModel *m, const char *verb, double speed, unsigned long long *random)
+{
+    ThinkTimes *t = FindThink(m, verb, false);
+    if (!t || t->total < MIN_THINK_SAMPLES)
+        t = FindThink(m, ANY, false);
+    int second = 1;
+    if (t && t->total > 0)
+    {
+        int pick = (int)(NextRandom(random) % (unsigned int)t->total);
+        for (second = 0; second < MAX_THINK && pick >= t->seconds[second]; second++)
+            pick -= t->seconds[second];
+    }
+    // the log only has whole seconds, anywhere in that second
+    double seconds = second + NextRandom(random) / 4294967296.0;
+    return (long long)(seconds * 1e9 / speed);
+}
+
+// ----- learning -----
+
+static const char *RoomName(TempleGame *game, int room)
+{
+    const Room *r = room >= 0 && room < game->world->roomCount ? GetRoom(game->world, room) : NULL;
+    return r ? Text(game->world, r->name) : ANY;
+}
+
+static TempleGame *NewGame(TempleHost *host)
+{
+    return host ? game_create_on(host) : game_create(NULL);
+}
+
+// "[2025-05-19 23:22:37] take note: Attempted to take note", the command comes out normalized
+static bool ParseLogLine(const char *line, time_t *when, char *command, size_t size)
+{
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    int used = 0;
+    if (sscanf(line, "[%d-%d-%d %d:%d:%d] %n", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec,
+               &used) != 6 ||
+        used == 0)
+        return false;
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    t.tm_isdst = -1;
+    *when = mktime(&t);
+    const char *end = strstr(line + used, ": ");
+    if (!end || (size_t)(end - (line + used)) >= size)
+        return false;
+    char raw[TRAFFIC_LINE];
+    memcpy(raw, line + used, end - (line + used));
+    raw[end - (line + used)] = '\0';
+    NormalizeCommand(raw, command, size);
+    return command[0] != '\0';
+}
+
+typedef struct
+{
+    TempleGame *game; // NULL = no session going
+    char verb[MAX_VERB];
+    time_t last;
+} LearnSession;
+
+static bool EndLearnSession(TrafficModel *m, LearnSession *ls)
+{
+    if (!ls->game)
+        return true;
+    bool ok = LearnCommand(m, RoomName(ls->game, ls->game->session.room), ls->verb, NULL);
+    game_destroy(ls->game);
+    ls->game = NULL;
+    return ok;
+}
+
+static bool LearnLog(TrafficModel *m, const char *path, TempleHost *host, int gap)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+    LearnSession ls = {NULL, "", 0};
+    char line[TRAFFIC_LINE];
+    char command[TRAFFIC_LINE];
+    char out[4096];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file))
+    {
+        time_t when;
+        if (!ParseLogLine(line, &when, command, sizeof(command)) || strcmp(command, "world file changed") == 0)
+            continue;
+        if (ls.game && (when - ls.last > gap || game_status(ls.game) != TEMPLE_PLAYING))
+            ok = EndLearnSession(m, &ls);
+        if (!ok)
+            break;
+        if (!ls.game)
+        {
+            ls.game = NewGame(host);
+            if (!ls.game)
+            {
+                fprintf(stderr, "trafficgen: Can't start a game to play %s on\n", path);
+                ok = false;
+                break;
+            }
+            ls.verb[0] = '\0';
+            m->sessions++;
+        }
+        else
+        {
+            ok = LearnPause(m, ls.verb, (long long)(when - ls.last));
+        }
+        ok = ok && LearnCommand(m, RoomName(ls.game, ls.game->session.room), ls.verb, command);
+        game_step(ls.game, command, out, sizeof(out));
+        VerbOf(command, ls.verb);
+        ls.last = when;
+        m->lines++;
+    }
+    ok = EndLearnSession(m, &ls) && ok;
+    fclose(file);
+    return ok;
+}
+
+// the model file, tab separated:
+//   think <verb> <how often people waited 0, 1, ... 60 seconds before the next command>
+//   next <room> <verb> <count> <command>
+// an empty verb is the start of a session, an empty command its end, "*" is any room or verb
+static bool SaveModel(const TrafficModel *m, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "# temple traffic model: %d sessions, %lld commands\n", m->sessions, m->lines);
+    for (int i = 0; i < m->thinkCount; i++)
+    {
+        fprintf(file, "think\t%s\t", m->think[i].verb);
+        for (int s = 0; s <= MAX_THINK; s++)
+            fprintf(file, s ? " %d" : "%d", m->think[i].seconds[s]);
+        fputc('\n', file);
+    }
+    for (int i = 0; i < m->stateCount; i++)
+    {
+        const ChainState *st = &m->states[i];
+        for (int k = 0; k < st->nextCount; k++)
+            fprintf(file, "next\t%s\t%s\t%d\t%s\n", st->room, st->verb, st->next[k].count,
+                    st->next[k].command ? st->next[k].command : "");
+    }
+    bool ok = !ferror(file);
+    if (fclose(file) != 0 || !ok)
+    {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+// cut line at its tabs, returns how many fields there are
+static int SplitTabs(char *line, char **fields, int max)
+{
+    line[strcspn(line, "\r\n")] = '\0';
+    int count = 0;
+    while (count < max)
+    {
+        fields[count++] = line;
+        char *tab = strchr(line, '\t');
+        if (!tab)
+            break;
+        *tab = '\0';
+        line = tab + 1;
+    }
+    return count;
+}
+
+static bool LoadModel(TrafficModel *m, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+    char line[TRAFFIC_LINE];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file))
+    {
+        lineNumber++;
+        char *fields[5];
+        int count = SplitTabs(line, fields, 5);
+        if (line[0] == '#' || line[0] == '\0')
+            continue;
+        if (count == 3 && strcmp(fields[0], "think") == 0)
+        {
+            ThinkTimes *t = FindThink(m, fields[1], true);
+            char *p = fields[2];
+            for (int s = 0; t && s <= MAX_THINK; s++)
+            {
+                int n = (int)strtol(p, &p, 10);
+                t->seconds[s] += n;
+                t->total += n;
+            }
+            ok = t != NULL;
+        }
+        else if (count == 5 && strcmp(fields[0], "next") == 0)
+        {
+            ChainState *st = FindState(m, fields[1], fields[2], true);
+            ok = st && CountNext(st, fields[4][0] ? fields[4] : NULL, atoi(fields[3]));
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: not a line of a traffic model\n", path, lineNumber);
+            ok = false;
+        }
+    }
+    fclose(file);
+    ChainState *any = ok ? FindState(m, ANY, ANY, false) : NULL;
+    if (ok && (!any || any->total == 0))
+    {
+        fprintf(stderr, "%s: no commands in there\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+// ----- playing it -----
+
+static void CountCommand(TrafficStats *stats, const char *verb)
+{
+    stats->commands++;
+    int i = 0;
+    while (i < stats->mixCount && i < MIX_VERBS - 1 && strcmp(stats->mix[i].verb, verb) != 0)
+        i++;
+    if (i == stats->mixCount)
+    {
+        snprintf(stats->mix[i].verb, MAX_VERB, "%s", i == MIX_VERBS - 1 ? "(other)" : verb);
+        stats->mixCount++;
+    }
+    stats->mix[i].count++;
+}
+
+static void CountWait(TrafficStats *stats, long long ns)
+{
+    if (stats->waitCount == stats->waitCapacity)
+    {
+        int newCapacity = stats->waitCapacity ? stats->waitCapacity * 2 : 4096;
+        long long *grown = MemRealloc(MEM_WORLD, stats->waits, sizeof(long long) * newCapacity);
+        if (!grown)
+            return;
+        stats->waits = grown;
+        stats->waitCapacity = newCapacity;
+    }
+    stats->waits[stats->waitCount++] = ns;
+}
+
+// a command to type, or the end of the session (false)
+static bool NextLine(TrafficModel *m, TrafficPlayer *p, const char *room, TrafficStats *stats, char *line)
+{
+    const char *command = PickCommand(m, room, p->verb, &p->random);
+    if (!command)
+        return false;
+    strcpy(line, command);
+    VerbOf(command, p->verb);
+    CountCommand(stats, p->verb);
+    return true;
+}
+
+static void StepInProcess(TrafficModel *m, TrafficPlayer *p, TempleHost *host, const TrafficOptions *o,
+                          TrafficStats *stats, long long now)
+{
+    static char out[16384];
+    char line[TRAFFIC_LINE];
+    if (!p->game)
+    {
+        p->game = NewGame(host);
+        if (!p->game)
+        {
+            p->nextAt = now + 1000000000; // no memory, try again in a second
+            return;
+        }
+        p->verb[0] = '\0';
+        stats->sessions++;
+    }
+    if (NextLine(m, p, RoomName(p->game, p->game->session.room), stats, line))
+    {
+        long long start = NowNs();
+        game_step(p->game, line, out, sizeof(out));
+        CountWait(stats, NowNs() - start);
+    }
+    else
+    {
+        game_destroy(p->game);
+        p->game = NULL;
+        p->nextAt = now; // somebody else comes along right away
+        return;
+    }
+    if (game_status(p->game) != TEMPLE_PLAYING)
+    {
+        stats->won += game_status(p->game) == TEMPLE_WON;
+        game_destroy(p->game);
+        p->game = NULL;
+    }
+    p->nextAt = now + PickThink(m, p->verb, o->speed, &p->random);
+}
+
+static char programPath[PATH_MAX];
+static char worldFullPath[PATH_MAX];
+
+static bool SpawnGame(TrafficPlayer *p, const TrafficOptions *o)
+{
+    int toGame[2], fromGame[2];
+    if (pipe(toGame) != 0)
+        return false;
+    if (pipe(fromGame) != 0)
+    {
+        close(toGame[0]);
+        close(toGame[1]);
+        return false;
+    }
+    // the other games mustn't hold this one's stdin open
+    fcntl(toGame[1], F_SETFD, FD_CLOEXEC);
+    fcntl(fromGame[0], F_SETFD, FD_CLOEXEC);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        dup2(toGame[0], STDIN_FILENO);
+        dup2(fromGame[1], STDOUT_FILENO);
+        close(toGame[0]);
+        close(toGame[1]);
+        close(fromGame[0]);
+        close(fromGame[1]);
+        if (chdir(p->dir) != 0)
+            _exit(127);
+        char *args[] = {programPath, "--json", "--no-journal", NULL, NULL, NULL};
+        if (o->worldPath)
+        {
+            args[3] = "--world";
+            args[4] = worldFullPath;
+        }
+        execv(programPath, args);
+        _exit(127);
+    }
+    close(toGame[0]);
+    close(fromGame[1]);
+    if (pid < 0)
+    {
+        perror("fork");
+        close(toGame[1]);
+        close(fromGame[0]);
+        return false;
+    }
+    p->pid = pid;
+    p->in = toGame[1];
+    p->out = fromGame[0];
+    p->recordLength = 0;
+    p->sentAt = 0;
+    p->started = false;
+    p->room = 0;
+    return true;
+}
+
+static void StopGame(TrafficPlayer *p)
+{
+    if (!p->pid)
+        return;
+    close(p->in); // the game quits at the end of its input
+    close(p->out);
+    waitpid(p->pid, NULL, 0);
+    p->pid = 0;
+}
+
+// {"seq":n,"status":"...","room":n,... is one answer
+static void GotRecord(TrafficModel *m, TrafficPlayer *p, const TrafficOptions *o, TrafficStats *stats, long long now)
+{
+    p->record[p->recordLength] = '\0';
+    const char *status = strstr(p->record, "\"status\":\"");
+    const char *room = strstr(p->record, "\"room\":");
+    if (room)
+        p->room = atoi(room + 7);
+    if (p->sentAt)
+        CountWait(stats, now - p->sentAt);
+    p->sentAt = 0;
+    p->started = true;
+    if (status && (strncmp(status + 10, "won\"", 4) == 0 || strncmp(status + 10, "over\"", 5) == 0))
+    {
+        stats->won += status[10] == 'w';
+        StopGame(p);
+        p->nextAt = now;
+        return;
+    }
+    p->nextAt = now + PickThink(m, p->verb, o->speed, &p->random);
+}
+
+static void ReadGame(TrafficModel *m, TrafficPlayer *p, const TrafficOptions *o, TrafficStats *stats)
+{
+    char buffer[16384];
+    ssize_t got = read(p->out, buffer, sizeof(buffer));
+    if (got <= 0)
+    {
+        StopGame(p); // it went away
+        return;
+    }
+    long long now = NowNs();
+    for (ssize_t i = 0; i < got && p->pid; i++)
+    {
+        if (buffer[i] == '\n')
+        {
+            GotRecord(m, p, o, stats, now);
+            p->recordLength = 0;
+        }
+        else if (p->recordLength + 1 < RECORD_START)
+        {
+            p->record[p->recordLength++] = buffer[i];
+        }
+    }
+}
+
+static void StepPiped(TrafficModel *m, TrafficPlayer *p, TempleGame *atlas, const TrafficOptions *o,
+                      TrafficStats *stats, long long now)
+{
+    char line[TRAFFIC_LINE + 1];
+    if (!p->pid)
+    {
+        if (!SpawnGame(p, o))
+        {
+            p->nextAt = now + 1000000000;
+            return;
+        }
+        p->verb[0] = '\0';
+        stats->sessions++;
+        p->nextAt = LLONG_MAX; // until it says hello
+        return;
+    }
+    if (!NextLine(m, p, RoomName(atlas, p->room), stats, line))
+    {
+        StopGame(p);
+        p->nextAt = now;
+        return;
+    }
+    strcat(line, "\n");
+    p->sentAt = NowNs();
+    p->nextAt = LLONG_MAX; // until it answers
+    if (write(p->in, line, strlen(line)) < 0)
+        StopGame(p);
+}
+
+static void Report(TrafficStats *stats, const TrafficOptions *o, double seconds)
+{
+    printf("%d players for %.1f s%s: %d sessions (%d won), %lld commands, %.0f commands/s\n", o->players, seconds,
+           o->pipeProgram ? " through pipes" : "", stats->sessions, stats->won, stats->commands,
+           stats->commands / seconds);
+    if (stats->waitCount > 0)
+    {
+        qsort(stats->waits, stats->waitCount, sizeof(long long), CompareWaits);
+        printf("answered in p50 %.1f us, p99 %.1f us, worst %.1f us\n", stats->waits[stats->waitCount / 2] / 1e3,
+               stats->waits[(int)(stats->waitCount * 0.99)] / 1e3, stats->waits[stats->waitCount - 1] / 1e3);
+    }
+    // the mix, most typed first
+    for (int i = 0; i < stats->mixCount; i++)
+        for (int k = i + 1; k < stats->mixCount; k++)
+            if (stats->mix[k].count > stats->mix[i].count)
+            {
+                VerbCount swap = stats->mix[i];
+                stats->mix[i] = stats->mix[k];
+                stats->mix[k] = swap;
+            }
+    printf("typed:");
+    for (int i = 0; i < stats->mixCount && i < 10; i++)
+        printf(" %s %.1f%%", stats->mix[i].verb, 100.0 * stats->mix[i].count / (stats->commands ? stats->commands : 1));
+    printf("\n");
+}
+
+static bool Run(TrafficModel *m, const TrafficOptions *o)
+{
+    TempleHost *host = NULL;
+    if (o->worldPath && !(host = host_create(o->worldPath)))
+    {
+        fprintf(stderr, "trafficgen: Can't load %s\n", o->worldPath);
+        return false;
+    }
+    TrafficPlayer *players = MemCalloc(MEM_WORLD, o->players, sizeof(TrafficPlayer));
+    TempleGame *atlas = NewGame(host); // the room names, for the piped games
+    TrafficStats stats;
+    memset(&stats, 0, sizeof(stats));
+    bool ok = players && atlas;
+    struct pollfd *polls = o->pipeProgram ? MemCalloc(MEM_WORLD, o->players, sizeof(struct pollfd)) : NULL;
+    int *polled = o->pipeProgram ? MemCalloc(MEM_WORLD, o->players, sizeof(int)) : NULL;
+    ok = ok && (!o->pipeProgram || (polls && polled));
+    if (ok && o->pipeProgram)
+    {
+        signal(SIGPIPE, SIG_IGN); // a game that died shows up as a failed write
+        if (!realpath(o->pipeProgram, programPath) || (o->worldPath && !realpath(o->worldPath, worldFullPath)))
+        {
+            perror(o->pipeProgram);
+            ok = false;
+        }
+        for (int i = 0; ok && i < o->players; i++)
+        {
+            strcpy(players[i].dir, "/tmp/trafficgen.XXXXXX");
+            if (!mkdtemp(players[i].dir))
+            {
+                perror("mkdtemp");
+                players[i].dir[0] = '\0';
+                ok = false;
+            }
+        }
+    }
+
+    long long start = NowNs();
+    long long end = start + (long long)(o->seconds * 1e9);
+    for (int i = 0; ok && i < o->players; i++)
+    {
+        players[i].random = o->seed * 0x9E3779B97F4A7C15ULL + (unsigned long long)i + 1;
+        // not everybody starts in the same second
+        players[i].nextAt = start + PickThink(m, "", o->speed, &players[i].random);
+    }
+    for (long long now = start; ok && now < end; now = NowNs())
+    {
+        long long wake = end;
+        int pollCount = 0;
+        for (int i = 0; i < o->players; i++)
+        {
+            TrafficPlayer *p = &players[i];
+            if (now >= p->nextAt)
+            {
+                if (o->pipeProgram)
+                    StepPiped(m, p, atlas, o, &stats, now);
+                else
+                    StepInProcess(m, p, host, o, &stats, now);
+            }
+            if (p->nextAt < wake)
+                wake = p->nextAt;
+            if (p->pid)
+            {
+                polls[pollCount].fd = p->out;
+                polls[pollCount].events = POLLIN;
+                polled[pollCount++] = i;
+            }
+        }
+        long long wait = wake - NowNs();
+        if (wait <= 0)
+            continue;
+        if (o->pipeProgram)
+        {
+            int ready = poll(polls, pollCount, (int)((wait + 999999) / 1000000));
+            for (int k = 0; ready > 0 && k < pollCount; k++)
+                if (polls[k].revents)
+                    ReadGame(m, &players[polled[k]], o, &stats);
+            continue;
+        }
+        struct timespec nap = {wait / 1000000000, wait % 1000000000};
+        nanosleep(&nap, NULL);
+    }
+    double seconds = (NowNs() - start) / 1e9;
+
+    for (int i = 0; players && i < o->players; i++)
+    {
+        game_destroy(players[i].game);
+        StopGame(&players[i]);
+        if (players[i].dir[0])
+        {
+            char log[64];
+            snprintf(log, sizeof(log), "%s/game_log.txt", players[i].dir);
+            unlink(log);
+            rmdir(players[i].dir);
+        }
+    }
+    if (ok)
+        Report(&stats, o, seconds);
+    MemFree(polls);
+    MemFree(polled);
+    MemFree(stats.waits);
+    game_destroy(atlas);
+    MemFree(players);
+    host_destroy(host);
+    return ok;
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s learn [options] -o <model> <game log>...\n"
+            "       %s run [options] <model>\n"
+            "  --world file     the world the logs were made on / to play on (default the built-in one)\n"
+            "  --gap s          learn: a new game starts after s seconds without a command (default %d)\n"
+            "  --players n      run: how many play at once (default 100)\n"
+            "  --seconds s      run: for how long (default 10)\n"
+            "  --speed x        run: think x times faster than the people in the logs (default 1)\n"
+            "  --seed n         run: which made up players (default 1)\n"
+            "  --pipe program   run: every player gets their own game process (program --json) instead\n",
+            name, name, DEFAULT_GAP);
+}
+
+int main(int argc, char *argv[])
+{
+    TrafficOptions o = {NULL, NULL, 100, 10, 1, 1, DEFAULT_GAP};
+    const char *modelPath = NULL;
+    const char *logs[256];
+    int logCount = 0;
+    if (argc < 2 || (strcmp(argv[1], "learn") != 0 && strcmp(argv[1], "run") != 0))
+    {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    bool learn = strcmp(argv[1], "learn") == 0;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--world") == 0 && i + 1 < argc)
+            o.worldPath = argv[++i];
+        else if (strcmp(argv[i], "--gap") == 0 && i + 1 < argc)
+            o.gap = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--players") == 0 && i + 1 < argc)
+            o.players = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            o.seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+            o.speed = atof(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            o.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--pipe") == 0 && i + 1 < argc)
+            o.pipeProgram = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc && learn)
+            modelPath = argv[++i];
+        else if (argv[i][0] != '-' && learn && logCount < 256)
+            logs[logCount++] = argv[i];
+        else if (argv[i][0] != '-' && !learn && !modelPath)
+            modelPath = argv[i];
+        else
+        {
+            Usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!modelPath || (learn && logCount == 0) || o.players <= 0 || o.seconds <= 0 || o.speed <= 0 || o.gap <= 0)
+    {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    TrafficModel m;
+    memset(&m, 0, sizeof(m));
+    bool ok = true;
+    if (learn)
+    {
+        TempleHost *host = NULL;
+        if (o.worldPath && !(host = host_create(o.worldPath)))
+        {
+            fprintf(stderr, "trafficgen: Can't load %s\n", o.worldPath);
+            return EXIT_FAILURE;
+        }
+        for (int i = 0; ok && i < logCount; i++)
+            ok = LearnLog(&m, logs[i], host, o.gap);
+        ok = ok && SaveModel(&m, modelPath);
+        if (ok)
+            printf("%s: %d sessions, %lld commands, %d states\n", modelPath, m.sessions, m.lines, m.stateCount);
+        host_destroy(host);
+    }
+    else
+    {
+        ok = LoadModel(&m, modelPath) && Run(&m, &o);
+    }
+    FreeModel(&m);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,416 @@
+// Generated by worldc from temple.world - don't edit, change the world file and run worldc again
+// (included by full_game.c after the Room/Item/Interactable structs and the components)
+
+static const char worldText[] =
+    "\0"
+    "Entrance Hall\0"
+    "A dimly lit entrance hall with ancient stone walls. A golden door is visible to the north.\0"
+    "Crate\0"
+    "A heavy wooden crate. It looks like it needs a tool to open it.\0"
+    "You pry open the crate with the crowbar! Inside, you find the second part of the golden key.\0"
+    "The crate is already open and empty.\0"
+    "An empty crate, now pried open.\0"
+    "Jungle Room\0"
+    "A room filled with lush vegetation and the sounds of jungle creatures.\0"
+    "Jaguar\0"
+    "A majestic stone jaguar statue with emerald eyes.\0"
+    "I am always coming but never arrive. What am I?\0"
+    "Tomorrow\0"
+    "The jaguar stares at you with ancient eyes and speaks:\0"
+    "The jaguar nods. \"You have wisdom, traveler.\"\nThe jaguar moves aside, and you see a gleaming key part in the chest!\0"
+    "The jaguar growls. \"Wrong! Try again or leave.\"\0"
+    "The jaguar's emerald eyes follow you around the room.\0"
+    "Chest\0"
+    "A wooden chest guarded by the jaguar statue.\0"
+    "The jaguar is guarding this chest. Deal with it first.\0"
+    "You open the chest and find a piece of golden key!\0"
+    "Chest is empty. You already took the key part.\0"
+    "You grab the key part!\0"
+    "Your inventory is full! Can't take the key part.\0"
+    "A chest with the first part of a golden key inside.\0"
+    "An empty chest. Nothing left in here.\0"
+    "Tree\0"
+    "An unusual tree with metal components embedded in its trunk.\0"
+    "That darn jaguar is blocking you from checking out the tree properly.\0"
+    "You shake the tree hard! A weird fruit falls down, and there's a keycard stuck in the trunk!\0"
+    "Nothing else interesting about this tree.\0"
+    "You grab the keycard!\0"
+    "No room in your inventory for the keycard!\0"
+    "A weird tree with metal bits in the trunk. Fruit's gone and so is the keycard.\0"
+    "Engine Room\0"
+    "A room filled with strange machinery. There's a large control panel in the center.\0"
+    "A heavy crate pushed against the wall. Maybe there's something behind it?\0"
+    "You push the crate aside, revealing a rucksack hidden behind it!\0"
+    "You push the crate around a bit, but there's nothing else behind it.\0"
+    "Machine\0"
+    "A complex machine with a slot that seems to fit a cog.\0"
+    "You insert the clean cog into the machine. The machinery whirs to life and a hidden compartment opens, revealing the third part of the golden key!\0"
+    "The machine is already running and the compartment is empty.\0"
+    "The machine's whirring slows down to a steady hum.\0"
+    "A complex machine humming quietly, its hidden compartment hanging open.\0"
+    "Cyber Room\0"
+    "A futuristic room with blinking lights and high-tech equipment.\0"
+    "metal door\0"
+    "You swipe the keycard and the door slides open with a whoosh!\0"
+    "Glass Pane\0"
+    "A reinforced glass pane with a crowbar behind it.\0"
+    "You smash the glass with the cog. CRASH! There's a crowbar inside!\0"
+    "The glass is already smashed and the crowbar is gone.\0"
+    "Broken glass everywhere. The crowbar is gone.\0"
+    "Kitchen\0"
+    "A hi-tech kitchen with various appliances, including a futuristic blender.\0"
+    "You toss the fruit in the blender and it turns into some kind of anti-Rust Solution!\0"
+    "Gold Room\0"
+    "A magnificent room filled with golden treasures! You have won the game!\0"
+    "golden door\0"
+    "You put the Golden Key in the door and it clicks open!\0"
+    "Note\0"
+    "A faded note that reads: 'The guardian of the jungle seeks wisdom. The answer is Time.'\0"
+    "Rusty Cog\0"
+    "A heavily rusted metal cog. Looks like it could fit into some machinery if it wasn't so rusty.\0"
+    "Rucksack\0"
+    "A sturdy rucksack that allows you to carry more items.\0"
+    "Key Part 1\0"
+    "First piece of a three-part golden key.\0"
+    "Key Part 2\0"
+    "The second part of a three-part golden key.\0"
+    "Key Part 3\0"
+    "The third part of a three-part golden key.\0"
+    "Keycard\0"
+    "High-tech keycard. Probably opens an electronic door somewhere.\0"
+    "Suspicious fruit\0"
+    "A strange glowing fruit. Definitely not for eating, but maybe useful?\0"
+    "Anti-Rust Solution\0"
+    "Weird chemical goop that can clean rust off metal stuff.\0"
+    "Crowbar\0"
+    "Heavy crowbar for prying stuff open. Also good for smashing things!\0"
+    "Clean Cog\0"
+    "A shiny, rust-free cog that looks like it'll work in machinery now.\0"
+    "Combined Key Parts\0"
+    "Two key parts stuck together. Hmm, looks like there might be a third piece?\0"
+    "Golden Key\0"
+    "A super fancy golden key. Bet this opens something important!\0";
+
+static const Interactable worldInteractables[8] = {
+    {.name = 106 /* Crate */,
+     .description = 112 /* A heavy wooden crate. It looks like it n... */,
+     .nameHash = 0x175e9a40u},
+    {.name = 421 /* Jaguar */,
+     .description = 428 /* A majestic stone jaguar statue with emer... */,
+     .nameHash = 0xe111a487u},
+    {.name = 808 /* Chest */,
+     .description = 814 /* A wooden chest guarded by the jaguar sta... */,
+     .nameHash = 0x98484f56u},
+    {.name = 1174 /* Tree */,
+     .description = 1179 /* An unusual tree with metal components em... */,
+     .nameHash = 0x6d8b34d5u},
+    {.name = 106 /* Crate */,
+     .description = 1684 /* A heavy crate pushed against the wall. M... */,
+     .nameHash = 0x175e9a40u},
+    {.name = 1892 /* Machine */,
+     .description = 1900 /* A complex machine with a slot that seems... */,
+     .nameHash = 0xe103566eu},
+    {.name = 2434 /* Glass Pane */,
+     .description = 2445 /* A reinforced glass pane with a crowbar b... */,
+     .nameHash = 0x77d8efb7u},
+    {.name = 2662 /* Kitchen */,
+     .description = 2670 /* A hi-tech kitchen with various appliance... */,
+     .nameHash = 0x33e6572fu},
+};
+
+static const Item worldItems[13] = {
+    {.name = 2979 /* Note */,
+     .quantity = 1,
+     .description = 2984 /* A faded note that reads: 'The guardian o... */,
+     .canCombine = false,
+     .combineWith = -1,
+     .resultItem = -1,
+     .homeRoom = 0,
+     .nameHash = 0x919a0c3du},
+    {.name = 3072 /* Rusty Cog */,
+     .quantity = 1,
+     .description = 3082 /* A heavily rusted metal cog. Looks like i... */,
+     .canCombine = true,
+     .combineWith = 8,
+     .resultItem = 10,
+     .homeRoom = 1,
+     .nameHash = 0xcc58db7du},
+    {.name = 3177 /* Rucksack */,
+     .quantity = 1,
+     .description = 3186 /* A sturdy rucksack that allows you to car... */,
+     .canCombine = false,
+     .combineWith = -1,
+     .resultItem = -1,
+     .homeRoom = -1,
+     .nameHash = 0x9b8a8110u},
+    {.name = 3241 /* Key Part 1 */,
+     .quantity = 1,
+     .description = 3252 /* First piece of a three-part golden key. */,
+     .canCombine = true,
+     .combineWith = 4,
+     .resultItem = 11,
+     .homeRoom = -1,
+     .nameHash = 0x6819ac06u},
+    {.name = 3292 /* Key Part 2 */,
+     .quantity = 1,
+     .description = 3303 /* The second part of a three-part golden k... */,
+     .canCombine = true,
+     .combineWith = 3,
+     .resultItem = 11,
+     .homeRoom = -1,
+     .nameHash = 0x6719aa73u},
+    {.name = 3347 /* Key Part 3 */,
+     .quantity = 1,
+     .description = 3358 /* The third part of a three-part golden ke... */,
+     .canCombine = true,
+     .combineWith = 11,
+     .resultItem = 12,
+     .homeRoom = -1,
+     .nameHash = 0x6619a8e0u},
+    {.name = 3401 /* Keycard */,
+     .quantity = 1,
+     .description = 3409 /* High-tech keycard. Probably opens an ele... */,
+     .canCombine = false,
+     .combineWith = -1,
+     .resultItem = -1,
+     .homeRoom = -1,
+     .nameHash = 0x800b56e2u},
+    {.name = 3473 /* Suspicious fruit */,
+     .quantity = 1,
+     .description = 3490 /* A strange glowing fruit. Definitely not ... */,
+     .canCombine = false,
+     .combineWith = -1,
+     .resultItem = -1,
+     .homeRoom = -1,
+     .nameHash = 0x49c5e22cu},
+    {.name = 3560 /* Anti-Rust Solution */,
+     .quantity = 1,
+     .description = 3579 /* Weird chemical goop that can clean rust ... */,
+     .canCombine = true,
+     .combineWith = 1,
+     .resultItem = 10,
+     .homeRoom = -1,
+     .nameHash = 0xa55fa6a1u},
+    {.name = 3636 /* Crowbar */,
+     .quantity = 1,
+     .description = 3644 /* Heavy crowbar for prying stuff open. Als... */,
+     .canCombine = false,
+     .combineWith = -1,
+     .resultItem = -1,
+     .homeRoom = -1,
+     .nameHash = 0x61dc7ec7u},
+    {.name = 3712 /* Clean Cog */,
+     .quantity = 1,
+     .description = 3722 /* A shiny, rust-free cog that looks like i... */,
+     .canCombine = false,
+     .combineWith = -1,
+     .resultItem = -1,
+     .homeRoom = -1,
+     .nameHash = 0xd60b2d21u},
+    {.name = 3790 /* Combined Key Parts */,
+     .quantity = 1,
+     .description = 3809 /* Two key parts stuck together. Hmm, looks... */,
+     .canCombine = false,
+     .combineWith = -1,
+     .resultItem = -1,
+     .homeRoom = -1,
+     .nameHash = 0xac2db233u},
+    {.name = 3885 /* Golden Key */,
+     .quantity = 1,
+     .description = 3896 /* A super fancy golden key. Bet this opens... */,
+     .canCombine = false,
+     .combineWith = -1,
+     .resultItem = -1,
+     .homeRoom = -1,
+     .nameHash = 0xe519401bu},
+};
+
+static const Room worldRooms[5] = {
+    {.name = 1 /* Entrance Hall */,
+     .description = 15 /* A dimly lit entrance hall with ancient s... */,
+     .items = {0},
+     .itemCount = 1,
+     .interactables = &worldInteractables[0],
+     .interactableCount = 1,
+     .isLocked = false,
+     .keyItem = -1,
+     .id = 0,
+     .north = 4,
+     .south = 1,
+     .east = 2,
+     .west = 3},
+    {.name = 338 /* Jungle Room */,
+     .description = 350 /* A room filled with lush vegetation and t... */,
+     .items = {1},
+     .itemCount = 1,
+     .interactables = &worldInteractables[1],
+     .interactableCount = 3,
+     .isLocked = false,
+     .keyItem = -1,
+     .id = 1,
+     .north = 0,
+     .south = -1,
+     .east = -1,
+     .west = -1},
+    {.name = 1589 /* Engine Room */,
+     .description = 1601 /* A room filled with strange machinery. Th... */,
+     .items = {},
+     .itemCount = 0,
+     .interactables = &worldInteractables[4],
+     .interactableCount = 2,
+     .isLocked = false,
+     .keyItem = -1,
+     .id = 2,
+     .north = -1,
+     .south = -1,
+     .east = -1,
+     .west = 0},
+    {.name = 2286 /* Cyber Room */,
+     .description = 2297 /* A futuristic room with blinking lights a... */,
+     .items = {},
+     .itemCount = 0,
+     .interactables = &worldInteractables[6],
+     .interactableCount = 2,
+     .isLocked = true,
+     .keyItem = 6,
+     .id = 3,
+     .north = -1,
+     .south = -1,
+     .east = 0,
+     .west = -1},
+    {.name = 2830 /* Gold Room */,
+     .description = 2840 /* A magnificent room filled with golden tr... */,
+     .items = {},
+     .itemCount = 0,
+     .interactables = NULL,
+     .interactableCount = 0,
+     .isLocked = true,
+     .keyItem = 12,
+     .id = 4,
+     .north = -1,
+     .south = 0,
+     .east = -1,
+     .west = -1},
+};
+
+static const Riddle worldRiddles[1] = {
+    {.of = {1, 0},
+     .riddle = 478 /* I am always coming but never arrive. Wha... */,
+     .answer = 526 /* Tomorrow */,
+     .ask = 535 /* The jaguar stares at you with ancient ey... */,
+     .right = 590 /* The jaguar nods. "You have wisdom, trave... */,
+     .wrong = 706 /* The jaguar growls. "Wrong! Try again or ... */,
+     .nag = 754 /* The jaguar's emerald eyes follow you aro... */,
+     .nagSeconds = 20},
+};
+
+static const Container worldContainers[2] = {
+    {.of = {1, 1},
+     .guard = 0,
+     .guarded = 859 /* The jaguar is guarding this chest. Deal ... */,
+     .open = 914 /* You open the chest and find a piece of g... */,
+     .empty = 965 /* Chest is empty. You already took the key... */,
+     .dropItem = -1,
+     .bagItem = 3,
+     .grab = 1012 /* You grab the key part! */,
+     .full = 1035 /* Your inventory is full! Can't take the k... */},
+    {.of = {1, 2},
+     .guard = 0,
+     .guarded = 1240 /* That darn jaguar is blocking you from ch... */,
+     .open = 1310 /* You shake the tree hard! A weird fruit f... */,
+     .empty = 1403 /* Nothing else interesting about this tree... */,
+     .dropItem = 7,
+     .bagItem = 6,
+     .grab = 1445 /* You grab the keycard! */,
+     .full = 1467 /* No room in your inventory for the keycar... */},
+};
+
+static const Lockable worldLockables[4] = {
+    {.of = {0, 0},
+     .key = 9,
+     .otherKey = -1,
+     .usesUp = false,
+     .use = 176 /* You pry open the crate with the crowbar!... */,
+     .done = 269 /* The crate is already open and empty. */,
+     .reveals = 4,
+     .laterSeconds = 0,
+     .later = 0},
+    {.of = {2, 1},
+     .key = 10,
+     .otherKey = -1,
+     .usesUp = false,
+     .use = 1955 /* You insert the clean cog into the machin... */,
+     .done = 2102 /* The machine is already running and the c... */,
+     .reveals = 5,
+     .laterSeconds = 60,
+     .later = 2163 /* The machine's whirring slows down to a s... */},
+    {.of = {3, 0},
+     .key = 1,
+     .otherKey = 10,
+     .usesUp = false,
+     .use = 2495 /* You smash the glass with the cog. CRASH!... */,
+     .done = 2562 /* The glass is already smashed and the cro... */,
+     .reveals = 9,
+     .laterSeconds = 0,
+     .later = 0},
+    {.of = {3, 1},
+     .key = 7,
+     .otherKey = -1,
+     .usesUp = true,
+     .use = 2745 /* You toss the fruit in the blender and it... */,
+     .done = 0,
+     .reveals = 8,
+     .laterSeconds = 0,
+     .later = 0},
+};
+
+static const Pushable worldPushables[1] = {
+    {.of = {2, 0},
+     .reveals = 2,
+     .push = 1758 /* You push the crate aside, revealing a ru... */,
+     .again = 1823 /* You push the crate around a bit, but the... */},
+};
+
+static const Description worldDescriptions[5] = {
+    {.of = {0, 0},
+     .ready = 0,
+     .used = 306 /* An empty crate, now pried open. */,
+     .later = 0},
+    {.of = {1, 1},
+     .ready = 1084 /* A chest with the first part of a golden ... */,
+     .used = 1136 /* An empty chest. Nothing left in here. */,
+     .later = 0},
+    {.of = {1, 2},
+     .ready = 0,
+     .used = 1510 /* A weird tree with metal bits in the trun... */,
+     .later = 0},
+    {.of = {2, 1},
+     .ready = 0,
+     .used = 0,
+     .later = 2214 /* A complex machine humming quietly, its h... */},
+    {.of = {3, 0},
+     .ready = 0,
+     .used = 2616 /* Broken glass everywhere. The crowbar is ... */,
+     .later = 0},
+};
+
+static const Door worldDoors[2] = {
+    {.of = {3, -1},
+     .name = 2361 /* metal door */,
+     .opens = 2372 /* You swipe the keycard and the door slide... */},
+    {.of = {4, -1},
+     .name = 2912 /* golden door */,
+     .opens = 2924 /* You put the Golden Key in the door and i... */},
+};
+
+static const WorldTables builtinWorld = {
+    .text = worldText,
+    .textSize = sizeof(worldText),
+    .rooms = worldRooms,
+    .roomCount = 5,
+    .startRoom = 0,
+    .items = worldItems,
+    .itemCount = 13,
+    .parts = {worldRiddles, 1, worldContainers, 2, worldLockables, 4,
+              worldPushables, 1, worldDescriptions, 5, worldDoors, 2},
+};
@@ -0,0 +1,868 @@
+// World compiler for the Temple of Secrets
+// Reads a world definition (like temple.world) and writes a C header with the
+// whole world as const tables, so the game doesn't have to build anything
+// when it starts. The tables end up in .rodata. What interactables do (riddles,
+// containers, things an item gets used on, things you push) comes out as the
+// game's component arrays, sorted by room and slot like it wants them.
+//
+//   gcc worldc.c -o worldc
+//   ./worldc temple.world world_tables.h
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+// longest names and texts a world file can have
+#define NAME_SIZE 50
+#define TEXT_SIZE 1024
+#define MAX_ROOM_ITEMS 10
+#define MAX_ROOM_INTERACTABLES 10
+#define NO_ROOM -1
+
+typedef struct
+{
+    char name[NAME_SIZE];
+    char description[TEXT_SIZE];
+    char riddle[TEXT_SIZE];
+    char answer[NAME_SIZE];
+    int line;
+    // what its components say, NULL = nothing (most things have none of these, so they're copies and not arrays)
+    char *ask, *right, *wrong, *nag;
+    int nagSeconds;
+    char guard[NAME_SIZE]; // container: the thing whose riddle goes first
+    char *guarded, *open, *empty;
+    char drop[NAME_SIZE];
+    char hold[NAME_SIZE];
+    char *grab, *full;
+    char keys[2][NAME_SIZE]; // lockable: items that fit
+    int keyCount;
+    char *use, *done;
+    bool usesUp;
+    char reveal[NAME_SIZE];
+    int laterSeconds;
+    char *later;
+    bool pushable;
+    char pushReveal[NAME_SIZE];
+    char *push, *again;
+    char *looks[3]; // ready, used, later
+} InteractableDef;
+
+typedef struct
+{
+    char name[NAME_SIZE];
+    char description[TEXT_SIZE];
+    char keyName[NAME_SIZE];
+    bool isLocked;
+    char exits[4][NAME_SIZE]; // north, south, east, west (room names, "" = no exit)
+    int line;
+    InteractableDef interactables[MAX_ROOM_INTERACTABLES];
+    int interactableCount;
+    int items[MAX_ROOM_ITEMS];
+    int itemCount;
+    char *doorName; // the door into this room by name ("golden door"), NULL = only by direction
+    char *doorOpens;
+} RoomDef;
+
+typedef struct
+{
+    char name[NAME_SIZE];
+    char description[TEXT_SIZE];
+    int quantity;
+    bool canCombine;
+    char combineWith[NAME_SIZE];
+    char resultItem[NAME_SIZE];
+    char room[NAME_SIZE]; // where it starts, "" if nowhere
+    int line;
+} ItemDef;
+
+static const char *directions[4] = {"north", "south", "east", "west"};
+static const char *looks[3] = {"ready", "used", "later"};
+
+static RoomDef *rooms = NULL;
+static int roomCount = 0;
+static ItemDef *items = NULL;
+static int itemCount = 0;
+static int startRoom = -1;
+static const char *sourceName = "";
+
+// same hash as NameHash in full_game.c (FNV-1a over lowercase letters)
+static unsigned int NameHash(const char *name)
+{
+    unsigned int h = 2166136261u;
+    for (; *name; name++)
+    {
+        h ^= (unsigned char)tolower((unsigned char)*name);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void Fail(int line, const char *message, const char *detail)
+{
+    fprintf(stderr, "%s:%d: %s%s%s\n", sourceName, line, message, detail[0] ? ": " : "", detail);
+    exit(EXIT_FAILURE);
+}
+
+// split a line into words, "quoted text" counts as one word
+// in quotes \" is a quote, \\ a backslash and \n a new line (for texts that take more than one line)
+static int SplitLine(char *line, char **words, int maxWords, int lineNo)
+{
+    int count = 0;
+    char *p = line;
+    while (*p)
+    {
+        while (isspace((unsigned char)*p))
+            p++;
+        if (!*p || *p == '#')
+            break;
+        if (count == maxWords)
+            Fail(lineNo, "too many words on this line", "");
+        if (*p == '"')
+        {
+            char *out = ++p;
+            words[count++] = out;
+            while (*p && *p != '"')
+            {
+                if (*p == '\\' && (p[1] == '"' || p[1] == '\\' || p[1] == 'n'))
+                {
+                    *out++ = p[1] == 'n' ? '\n' : p[1];
+                    p += 2;
+                }
+                else
+                {
+                    *out++ = *p++;
+                }
+            }
+            if (*p != '"')
+                Fail(lineNo, "missing closing quote", "");
+            p++;
+            *out = '\0';
+        }
+        else
+        {
+            words[count++] = p;
+            while (*p && !isspace((unsigned char)*p))
+                p++;
+            if (*p)
+                *p++ = '\0';
+        }
+    }
+    return count;
+}
+
+static void CopyField(char *dst, size_t size, const char *src, int lineNo)
+{
+    if (strlen(src) >= size)
+        Fail(lineNo, "text is too long", src);
+    strcpy(dst, src);
+}
+
+// a text only some things have
+static char *CopyText(const char *src)
+{
+    char *copy = malloc(strlen(src) + 1);
+    if (!copy)
+    {
+        perror("worldc: out of memory");
+        exit(EXIT_FAILURE);
+    }
+    return strcpy(copy, src);
+}
+
+static const char *Str(const char *text)
+{
+    return text ? text : "";
+}
+
+static int Seconds(const char *word, int lineNo)
+{
+    int seconds = atoi(word);
+    if (seconds <= 0 || seconds > 86400)
+        Fail(lineNo, "seconds have to be between 1 and 86400", word);
+    return seconds;
+}
+
+// the interactable the lines after it belong to
+static InteractableDef *LastThing(RoomDef *room, const char *key, int lineNo)
+{
+    if (!room || room->interactableCount == 0)
+        Fail(lineNo, "needs an interactable before it", key);
+    return &room->interactables[room->interactableCount - 1];
+}
+
+static int FindRoom(const char *name)
+{
+    for (int i = 0; i < roomCount; i++)
+    {
+        if (strcmp(rooms[i].name, name) == 0)
+            return i;
+    }
+    return NO_ROOM;
+}
+
+static int FindItem(const char *name)
+{
+    for (int i = 0; i < itemCount; i++)
+    {
+        if (strcmp(items[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void *Grow(void *array, int count, size_t size)
+{
+    // start with 8, then double whenever we hit a power of two
+    if (count == 0 || (count >= 8 && (count & (count - 1)) == 0))
+    {
+        array = realloc(array, size * (size_t)(count ? count * 2 : 8));
+        if (!array)
+        {
+            perror("worldc: out of memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return array;
+}
+
+static void ParseWorld(FILE *in)
+{
+    char line[1024];
+    int lineNo = 0;
+    RoomDef *room = NULL;
+    ItemDef *item = NULL;
+    while (fgets(line, sizeof(line), in))
+    {
+        lineNo++;
+        char *words[8];
+        int n = SplitLine(line, words, 8, lineNo);
+        if (n == 0)
+            continue;
+        const char *key = words[0];
+
+        if (strcmp(key, "room") == 0 && n == 2)
+        {
+            rooms = Grow(rooms, roomCount, sizeof(RoomDef));
+            room = &rooms[roomCount++];
+            memset(room, 0, sizeof(*room));
+            CopyField(room->name, sizeof(room->name), words[1], lineNo);
+            room->line = lineNo;
+            item = NULL;
+        }
+        else if (strcmp(key, "item") == 0 && n == 3)
+        {
+            items = Grow(items, itemCount, sizeof(ItemDef));
+            item = &items[itemCount++];
+            memset(item, 0, sizeof(*item));
+            CopyField(item->name, sizeof(item->name), words[1], lineNo);
+            CopyField(item->description, sizeof(item->description), words[2], lineNo);
+            item->quantity = 1;
+            item->line = lineNo;
+            room = NULL;
+        }
+        else if (room && strcmp(key, "description") == 0 && n == 2)
+        {
+            CopyField(room->description, sizeof(room->description), words[1], lineNo);
+        }
+        else if (room && strcmp(key, "locked") == 0 && n == 2)
+        {
+            room->isLocked = true;
+            CopyField(room->keyName, sizeof(room->keyName), words[1], lineNo);
+        }
+        else if (room && strcmp(key, "start") == 0 && n == 1)
+        {
+            startRoom = roomCount - 1;
+        }
+        else if (room && strcmp(key, "exit") == 0 && n == 3)
+        {
+            int dir = -1;
+            for (int d = 0; d < 4; d++)
+            {
+                if (strcmp(words[1], directions[d]) == 0)
+                    dir = d;
+            }
+            if (dir == -1)
+                Fail(lineNo, "unknown direction", words[1]);
+            CopyField(room->exits[dir], NAME_SIZE, words[2], lineNo);
+        }
+        else if (room && strcmp(key, "interactable") == 0 && n == 3)
+        {
+            if (room->interactableCount == MAX_ROOM_INTERACTABLES)
+                Fail(lineNo, "too many interactables in", room->name);
+            InteractableDef *thing = &room->interactables[room->interactableCount++];
+            thing->line = lineNo;
+            CopyField(thing->name, sizeof(thing->name), words[1], lineNo);
+            CopyField(thing->description, sizeof(thing->description), words[2], lineNo);
+        }
+        else if (room && strcmp(key, "door") == 0 && n == 3)
+        {
+            room->doorName = CopyText(words[1]);
+            room->doorOpens = CopyText(words[2]);
+        }
+        // components of the last interactable: riddle
+        else if (strcmp(key, "riddle") == 0 && n == 3)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            CopyField(thing->riddle, sizeof(thing->riddle), words[1], lineNo);
+            CopyField(thing->answer, sizeof(thing->answer), words[2], lineNo);
+        }
+        else if (strcmp(key, "asks") == 0 && n == 2)
+        {
+            LastThing(room, key, lineNo)->ask = CopyText(words[1]);
+        }
+        else if (strcmp(key, "right") == 0 && n == 2)
+        {
+            LastThing(room, key, lineNo)->right = CopyText(words[1]);
+        }
+        else if (strcmp(key, "wrong") == 0 && n == 2)
+        {
+            LastThing(room, key, lineNo)->wrong = CopyText(words[1]);
+        }
+        else if (strcmp(key, "nags") == 0 && n == 3)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            thing->nagSeconds = Seconds(words[1], lineNo);
+            thing->nag = CopyText(words[2]);
+        }
+        // container
+        else if (strcmp(key, "guarded") == 0 && n == 3)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            CopyField(thing->guard, sizeof(thing->guard), words[1], lineNo);
+            thing->guarded = CopyText(words[2]);
+        }
+        else if (strcmp(key, "opens") == 0 && n == 3)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            thing->open = CopyText(words[1]);
+            thing->empty = CopyText(words[2]);
+        }
+        else if (strcmp(key, "drops") == 0 && n == 2)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            CopyField(thing->drop, sizeof(thing->drop), words[1], lineNo);
+        }
+        else if (strcmp(key, "holds") == 0 && n == 4)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            CopyField(thing->hold, sizeof(thing->hold), words[1], lineNo);
+            thing->grab = CopyText(words[2]);
+            thing->full = CopyText(words[3]);
+        }
+        // lockable
+        else if (strcmp(key, "key") == 0 && n == 2)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            if (thing->keyCount == 2)
+                Fail(lineNo, "only two keys fit one thing", words[1]);
+            CopyField(thing->keys[thing->keyCount], NAME_SIZE, words[1], lineNo);
+            thing->keyCount++;
+        }
+        else if (strcmp(key, "use") == 0 && (n == 2 || n == 3))
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            thing->use = CopyText(words[1]);
+            thing->done = n == 3 ? CopyText(words[2]) : NULL;
+        }
+        else if (strcmp(key, "uses-up") == 0 && n == 1)
+        {
+            LastThing(room, key, lineNo)->usesUp = true;
+        }
+        else if (strcmp(key, "reveals") == 0 && n == 2)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            CopyField(thing->reveal, sizeof(thing->reveal), words[1], lineNo);
+        }
+        else if (strcmp(key, "later") == 0 && n == 3)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            thing->laterSeconds = Seconds(words[1], lineNo);
+            thing->later = CopyText(words[2]);
+        }
+        // pushable
+        else if (strcmp(key, "pushed") == 0 && n == 4)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            thing->pushable = true;
+            CopyField(thing->pushReveal, sizeof(thing->pushReveal), words[1], lineNo);
+            thing->push = CopyText(words[2]);
+            thing->again = CopyText(words[3]);
+        }
+        // description
+        else if (strcmp(key, "looks") == 0 && n == 3)
+        {
+            InteractableDef *thing = LastThing(room, key, lineNo);
+            int look = -1;
+            for (int k = 0; k < 3; k++)
+            {
+                if (strcmp(words[1], looks[k]) == 0)
+                    look = k;
+            }
+            if (look == -1)
+                Fail(lineNo, "looks has to be ready, used or later", words[1]);
+            thing->looks[look] = CopyText(words[2]);
+        }
+        else if (item && strcmp(key, "combine") == 0 && n == 3)
+        {
+            item->canCombine = true;
+            CopyField(item->combineWith, sizeof(item->combineWith), words[1], lineNo);
+            CopyField(item->resultItem, sizeof(item->resultItem), words[2], lineNo);
+        }
+        else if (item && strcmp(key, "in") == 0 && n == 2)
+        {
+            CopyField(item->room, sizeof(item->room), words[1], lineNo);
+        }
+        else if (item && strcmp(key, "quantity") == 0 && n == 2)
+        {
+            item->quantity = atoi(words[1]);
+        }
+        else
+        {
+            Fail(lineNo, "don't know what to do with", key);
+        }
+    }
+}
+
+static int FindThing(const RoomDef *room, const char *name)
+{
+    for (int i = 0; i < room->interactableCount; i++)
+    {
+        if (strcmp(room->interactables[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// an item a component names, "" = none
+static int ItemOrNone(const char *name, int lineNo)
+{
+    if (!name[0])
+        return -1;
+    int id = FindItem(name);
+    if (id == -1)
+        Fail(lineNo, "item doesn't exist", name);
+    return id;
+}
+
+static bool IsContainer(const InteractableDef *thing)
+{
+    return thing->guard[0] || thing->open || thing->drop[0] || thing->hold[0];
+}
+
+static bool HasLooks(const InteractableDef *thing)
+{
+    return thing->looks[0] || thing->looks[1] || thing->looks[2];
+}
+
+// the components of a thing have to fit together
+static void ResolveThing(const RoomDef *room, const InteractableDef *thing)
+{
+    int line = thing->line;
+    if (!thing->riddle[0] && (thing->ask || thing->right || thing->wrong || thing->nag))
+        Fail(line, "asks, right, wrong and nags need a riddle", thing->name);
+    if (thing->guard[0])
+    {
+        int guard = FindThing(room, thing->guard);
+        if (guard == -1 || !room->interactables[guard].riddle[0])
+            Fail(line, "guarded by something in the room without a riddle", thing->guard);
+    }
+    ItemOrNone(thing->drop, line);
+    ItemOrNone(thing->hold, line);
+    if (thing->keyCount == 0 && (thing->use || thing->usesUp || thing->reveal[0] || thing->later))
+        Fail(line, "use, uses-up, reveals and later need a key", thing->name);
+    for (int k = 0; k < thing->keyCount; k++)
+        ItemOrNone(thing->keys[k], line);
+    ItemOrNone(thing->reveal, line);
+    ItemOrNone(thing->pushReveal, line);
+}
+
+// check names point at real things and put items in their rooms
+static void ResolveWorld(void)
+{
+    if (roomCount == 0)
+        Fail(0, "the world has no rooms", "");
+    if (startRoom == -1)
+        startRoom = 0;
+    for (int i = 0; i < roomCount; i++)
+    {
+        for (int d = 0; d < 4; d++)
+        {
+            if (rooms[i].exits[d][0] && FindRoom(rooms[i].exits[d]) == NO_ROOM)
+                Fail(rooms[i].line, "exit goes to a room that doesn't exist", rooms[i].exits[d]);
+        }
+        if (rooms[i].isLocked && FindItem(rooms[i].keyName) == -1)
+            Fail(rooms[i].line, "key item doesn't exist", rooms[i].keyName);
+        // "use <key> <name>" only keeps the last two words together
+        const char *door = rooms[i].doorName;
+        if (door && (!rooms[i].isLocked || !strchr(door, ' ') || strchr(door, ' ') != strrchr(door, ' ') ||
+                     strcmp(strchr(door, ' '), " door") != 0))
+            Fail(rooms[i].line, "a named door has to be two words ending in door, on a locked room", door);
+        for (int j = 0; j < rooms[i].interactableCount; j++)
+            ResolveThing(&rooms[i], &rooms[i].interactables[j]);
+    }
+    for (int i = 0; i < itemCount; i++)
+    {
+        if (FindItem(items[i].name) != i)
+            Fail(items[i].line, "item defined twice", items[i].name);
+        if (items[i].canCombine && FindItem(items[i].combineWith) == -1)
+            Fail(items[i].line, "combines with an item that doesn't exist", items[i].combineWith);
+        if (items[i].canCombine && FindItem(items[i].resultItem) == -1)
+            Fail(items[i].line, "combines into an item that doesn't exist", items[i].resultItem);
+        if (!items[i].room[0])
+            continue;
+        int room = FindRoom(items[i].room);
+        if (room == NO_ROOM)
+            Fail(items[i].line, "item is in a room that doesn't exist", items[i].room);
+        if (rooms[room].itemCount == MAX_ROOM_ITEMS)
+            Fail(items[i].line, "too many items in", rooms[room].name);
+        rooms[room].items[rooms[room].itemCount++] = i;
+    }
+}
+
+// every different string of the world once, back to back. offset 0 is always ""
+static char *pool = NULL;
+static unsigned int poolSize = 0;
+
+// offset of a string in the pool, added the first time we see it
+static unsigned int PoolText(const char *text)
+{
+    if (!pool)
+    {
+        pool = calloc(1, 1);
+        if (!pool)
+            Fail(0, "out of memory", "");
+        poolSize = 1;
+    }
+    // linear search is fine, worlds are small and this runs once at build time
+    for (unsigned int i = 0; i < poolSize; i += (unsigned int)strlen(pool + i) + 1)
+    {
+        if (strcmp(pool + i, text) == 0)
+            return i;
+    }
+    unsigned int size = (unsigned int)strlen(text) + 1;
+    char *bigger = realloc(pool, poolSize + size);
+    if (!bigger)
+        Fail(0, "out of memory", "");
+    pool = bigger;
+    memcpy(pool + poolSize, text, size);
+    poolSize += size;
+    return poolSize - size;
+}
+
+// write the pool as one C string literal per entry, each one ending in an explicit \0
+static void WritePool(FILE *out)
+{
+    fprintf(out, "static const char worldText[] =\n");
+    for (unsigned int i = 0; i < poolSize; i += (unsigned int)strlen(pool + i) + 1)
+    {
+        fprintf(out, "    \"");
+        for (const char *p = pool + i; *p; p++)
+        {
+            if (*p == '\n')
+            {
+                fputs("\\n", out);
+                continue;
+            }
+            if (*p == '"' || *p == '\\')
+                fputc('\\', out);
+            fputc(*p, out);
+        }
+        fprintf(out, "\\0\"%s\n", i + strlen(pool + i) + 1 < poolSize ? "" : ";");
+    }
+    fprintf(out, "\n");
+}
+
+// write a string as its pool offset, with the text in a comment so the header stays readable
+static void WriteRef(FILE *out, const char *text)
+{
+    fprintf(out, "%u", PoolText(text));
+    if (!text[0] || strstr(text, "*/"))
+        return;
+    // the comment stays on one line
+    int shown = (int)strcspn(text, "\n");
+    if (shown > 40)
+        shown = 40;
+    fprintf(out, " /* %.*s%s */", shown, text, text[shown] ? "..." : "");
+}
+
+// start of one component array, every part is {.of = {room, slot}, ...}
+static void StartParts(FILE *out, const char *type, const char *name, int count)
+{
+    fprintf(out, "static const %s %s[%d] = {\n", type, name, count ? count : 1);
+}
+
+static void WriteTextField(FILE *out, const char *field, const char *text)
+{
+    fprintf(out, ",\n     .%s = ", field);
+    WriteRef(out, Str(text));
+}
+
+// the component arrays, rooms in order and things in order within a room, so they come out sorted
+static void WriteComponents(FILE *out, int counts[6])
+{
+    memset(counts, 0, sizeof(int) * 6);
+    for (int i = 0; i < roomCount; i++)
+    {
+        for (int j = 0; j < rooms[i].interactableCount; j++)
+        {
+            const InteractableDef *thing = &rooms[i].interactables[j];
+            counts[0] += thing->riddle[0] != '\0';
+            counts[1] += IsContainer(thing);
+            counts[2] += thing->keyCount > 0;
+            counts[3] += thing->pushable;
+            counts[4] += HasLooks(thing);
+        }
+        counts[5] += rooms[i].doorName != NULL;
+    }
+
+    StartParts(out, "Riddle", "worldRiddles", counts[0]);
+    for (int i = 0; i < roomCount; i++)
+    {
+        for (int j = 0; j < rooms[i].interactableCount; j++)
+        {
+            const InteractableDef *thing = &rooms[i].interactables[j];
+            if (!thing->riddle[0])
+                continue;
+            fprintf(out, "    {.of = {%d, %d}", i, j);
+            WriteTextField(out, "riddle", thing->riddle);
+            WriteTextField(out, "answer", thing->answer);
+            WriteTextField(out, "ask", thing->ask);
+            WriteTextField(out, "right", thing->right);
+            WriteTextField(out, "wrong", thing->wrong);
+            WriteTextField(out, "nag", thing->nag);
+            fprintf(out, ",\n     .nagSeconds = %d},\n", thing->nagSeconds);
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    StartParts(out, "Container", "worldContainers", counts[1]);
+    for (int i = 0; i < roomCount; i++)
+    {
+        for (int j = 0; j < rooms[i].interactableCount; j++)
+        {
+            const InteractableDef *thing = &rooms[i].interactables[j];
+            if (!IsContainer(thing))
+                continue;
+            fprintf(out, "    {.of = {%d, %d},\n     .guard = %d", i, j, thing->guard[0] ? FindThing(&rooms[i], thing->guard) : -1);
+            WriteTextField(out, "guarded", thing->guarded);
+            WriteTextField(out, "open", thing->open);
+            WriteTextField(out, "empty", thing->empty);
+            fprintf(out, ",\n     .dropItem = %d,\n     .bagItem = %d", ItemOrNone(thing->drop, 0), ItemOrNone(thing->hold, 0));
+            WriteTextField(out, "grab", thing->grab);
+            WriteTextField(out, "full", thing->full);
+            fprintf(out, "},\n");
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    StartParts(out, "Lockable", "worldLockables", counts[2]);
+    for (int i = 0; i < roomCount; i++)
+    {
+        for (int j = 0; j < rooms[i].interactableCount; j++)
+        {
+            const InteractableDef *thing = &rooms[i].interactables[j];
+            if (thing->keyCount == 0)
+                continue;
+            fprintf(out, "    {.of = {%d, %d},\n     .key = %d,\n     .otherKey = %d,\n     .usesUp = %s", i, j,
+                    FindItem(thing->keys[0]), thing->keyCount > 1 ? FindItem(thing->keys[1]) : -1,
+                    thing->usesUp ? "true" : "false");
+            WriteTextField(out, "use", thing->use);
+            WriteTextField(out, "done", thing->done);
+            fprintf(out, ",\n     .reveals = %d,\n     .laterSeconds = %d", ItemOrNone(thing->reveal, 0), thing->laterSeconds);
+            WriteTextField(out, "later", thing->later);
+            fprintf(out, "},\n");
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    StartParts(out, "Pushable", "worldPushables", counts[3]);
+    for (int i = 0; i < roomCount; i++)
+    {
+        for (int j = 0; j < rooms[i].interactableCount; j++)
+        {
+            const InteractableDef *thing = &rooms[i].interactables[j];
+            if (!thing->pushable)
+                continue;
+            fprintf(out, "    {.of = {%d, %d},\n     .reveals = %d", i, j, ItemOrNone(thing->pushReveal, 0));
+            WriteTextField(out, "push", thing->push);
+            WriteTextField(out, "again", thing->again);
+            fprintf(out, "},\n");
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    StartParts(out, "Description", "worldDescriptions", counts[4]);
+    for (int i = 0; i < roomCount; i++)
+    {
+        for (int j = 0; j < rooms[i].interactableCount; j++)
+        {
+            const InteractableDef *thing = &rooms[i].interactables[j];
+            if (!HasLooks(thing))
+                continue;
+            fprintf(out, "    {.of = {%d, %d}", i, j);
+            for (int k = 0; k < 3; k++)
+                WriteTextField(out, looks[k], thing->looks[k]);
+            fprintf(out, "},\n");
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    StartParts(out, "Door", "worldDoors", counts[5]);
+    for (int i = 0; i < roomCount; i++)
+    {
+        if (!rooms[i].doorName)
+            continue;
+        fprintf(out, "    {.of = {%d, -1}", i);
+        WriteTextField(out, "name", rooms[i].doorName);
+        WriteTextField(out, "opens", rooms[i].doorOpens);
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "};\n\n");
+}
+
+static void WriteTables(FILE *out)
+{
+    fprintf(out, "// Generated by worldc from %s - don't edit, change the world file and run worldc again\n", sourceName);
+    fprintf(out, "// (included by full_game.c after the Room/Item/Interactable structs and the components)\n\n");
+
+    // all the text first, so the pool is complete before anything points into it
+    PoolText("");
+    for (int i = 0; i < roomCount; i++)
+    {
+        PoolText(rooms[i].name);
+        PoolText(rooms[i].description);
+        PoolText(Str(rooms[i].doorName));
+        PoolText(Str(rooms[i].doorOpens));
+        for (int j = 0; j < rooms[i].interactableCount; j++)
+        {
+            const InteractableDef *thing = &rooms[i].interactables[j];
+            const char *texts[] = {
+                thing->name, thing->description, thing->riddle, thing->answer, thing->ask, thing->right,
+                thing->wrong, thing->nag, thing->guarded, thing->open, thing->empty, thing->grab, thing->full,
+                thing->use, thing->done, thing->later, thing->push, thing->again, thing->looks[0], thing->looks[1],
+                thing->looks[2],
+            };
+            for (size_t k = 0; k < sizeof(texts) / sizeof(texts[0]); k++)
+                PoolText(Str(texts[k]));
+        }
+    }
+    for (int i = 0; i < itemCount; i++)
+    {
+        PoolText(items[i].name);
+        PoolText(items[i].description);
+    }
+    WritePool(out);
+
+    // all interactables in one array, rooms point at their slice of it
+    int interactableTotal = 0;
+    for (int i = 0; i < roomCount; i++)
+        interactableTotal += rooms[i].interactableCount;
+    fprintf(out, "static const Interactable worldInteractables[%d] = {\n", interactableTotal ? interactableTotal : 1);
+    for (int i = 0; i < roomCount; i++)
+    {
+        for (int j = 0; j < rooms[i].interactableCount; j++)
+        {
+            const InteractableDef *thing = &rooms[i].interactables[j];
+            fprintf(out, "    {.name = ");
+            WriteRef(out, thing->name);
+            fprintf(out, ",\n     .description = ");
+            WriteRef(out, thing->description);
+            fprintf(out, ",\n     .nameHash = 0x%08xu},\n", NameHash(thing->name));
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static const Item worldItems[%d] = {\n", itemCount ? itemCount : 1);
+    for (int i = 0; i < itemCount; i++)
+    {
+        const ItemDef *item = &items[i];
+        fprintf(out, "    {.name = ");
+        WriteRef(out, item->name);
+        fprintf(out, ",\n     .quantity = %d,\n     .description = ", item->quantity);
+        WriteRef(out, item->description);
+        fprintf(out, ",\n     .canCombine = %s,\n     .combineWith = %d,\n     .resultItem = %d",
+                item->canCombine ? "true" : "false",
+                item->canCombine ? FindItem(item->combineWith) : -1, item->canCombine ? FindItem(item->resultItem) : -1);
+        fprintf(out, ",\n     .homeRoom = %d,\n     .nameHash = 0x%08xu},\n",
+                item->room[0] ? FindRoom(item->room) : NO_ROOM, NameHash(item->name));
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static const Room worldRooms[%d] = {\n", roomCount);
+    int firstInteractable = 0;
+    for (int i = 0; i < roomCount; i++)
+    {
+        const RoomDef *room = &rooms[i];
+        fprintf(out, "    {.name = ");
+        WriteRef(out, room->name);
+        fprintf(out, ",\n     .description = ");
+        WriteRef(out, room->description);
+        fprintf(out, ",\n     .items = {");
+        for (int j = 0; j < room->itemCount; j++)
+            fprintf(out, "%s%d", j ? ", " : "", room->items[j]);
+        fprintf(out, "},\n     .itemCount = %d,\n", room->itemCount);
+        if (room->interactableCount)
+            fprintf(out, "     .interactables = &worldInteractables[%d],\n", firstInteractable);
+        else
+            fprintf(out, "     .interactables = NULL,\n");
+        fprintf(out, "     .interactableCount = %d,\n", room->interactableCount);
+        fprintf(out, "     .isLocked = %s,\n     .keyItem = %d", room->isLocked ? "true" : "false",
+                room->isLocked ? FindItem(room->keyName) : -1);
+        fprintf(out, ",\n     .id = %d", i);
+        for (int d = 0; d < 4; d++)
+            fprintf(out, ",\n     .%s = %d", directions[d], room->exits[d][0] ? FindRoom(room->exits[d]) : NO_ROOM);
+        fprintf(out, "},\n");
+        firstInteractable += room->interactableCount;
+    }
+    fprintf(out, "};\n\n");
+
+    int counts[6];
+    WriteComponents(out, counts);
+
+    fprintf(out, "static const WorldTables builtinWorld = {\n");
+    fprintf(out, "    .text = worldText,\n    .textSize = sizeof(worldText),\n");
+    fprintf(out, "    .rooms = worldRooms,\n    .roomCount = %d,\n    .startRoom = %d,\n", roomCount, startRoom);
+    fprintf(out, "    .items = worldItems,\n    .itemCount = %d,\n", itemCount);
+    fprintf(out, "    .parts = {worldRiddles, %d, worldContainers, %d, worldLockables, %d,\n", counts[0], counts[1], counts[2]);
+    fprintf(out, "              worldPushables, %d, worldDescriptions, %d, worldDoors, %d},\n};\n", counts[3], counts[4],
+            counts[5]);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <world file> <output header>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    sourceName = argv[1];
+    FILE *in = fopen(argv[1], "r");
+    if (!in)
+    {
+        perror("Failed to open world file");
+        return EXIT_FAILURE;
+    }
+    ParseWorld(in);
+    fclose(in);
+    ResolveWorld();
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out)
+    {
+        perror("Failed to create output file");
+        return EXIT_FAILURE;
+    }
+    WriteTables(out);
+    if (fclose(out) != 0)
+    {
+        perror("Failed to write output file");
+        return EXIT_FAILURE;
+    }
+    printf("%s: %d rooms, %d items\n", argv[2], roomCount, itemCount);
+    free(rooms);
+    free(items);
+    free(pool);
+    return 0;
+}
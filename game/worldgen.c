@@ -0,0 +1,600 @@
+// Random world generator for the Temple of Secrets
+// Makes a world of any size from a seed, so there's something bigger than temple.world to try the
+// engine on. The same seed and sizes always make the same world. It comes out as a page file
+// (like --save-world writes) and every world it makes can be won:
+//  - the rooms are a grid, cut into bands of rows. the only way into a band is a locked door from
+//    the band before, and the key for that door lies in the band before (in pieces, with recipes)
+//  - the Rucksack lies in the start room, the Gold Room is the last room of the last band
+//  - riddles all have an answer, and nothing needs one to get through
+// --solution writes the commands that win it, one per line (a transcript, like transcripts/*.txt)
+//
+//   make worldgen   (or: gcc -O2 -pthread worldgen.c -o worldgen)
+//   ./worldgen --rooms 1000000 --locks 100 --seed 7 big.pages
+//   ./temple_of_secrets --world big.pages
+
+#define TEMPLE_NO_MAIN
+#include "full_game.c"
+
+// with the Rucksack there are 9 free slots in the bag, and putting a key together piece by piece
+// (combining as soon as two pieces fit) holds at most depth + 1 of them at once
+#define MAX_RECIPE_DEPTH 8
+#define NAME_COUNT 12 // more than fit in a room, so a room never gets the same interactable twice
+
+typedef struct
+{
+    unsigned long long seed;
+    int rooms;
+    int items;         // at least what the keys need, the rest is junk lying around
+    int interactables;
+    int riddles;       // how many of the interactables ask one
+    int locks;         // locked doors on the way to the Gold Room
+    int recipeDepth;   // keys come in up to 2^depth pieces
+} GenOptions;
+
+
+static const char *const roomNames[] = {"Hall", "Gallery", "Crypt", "Chamber", "Passage", "Shrine", "Vault", "Cellar"};
+static const char *const roomTexts[] = {
+    "A long hall with cracked tiles. Dust hangs in the air.",
+    "Faded paintings line the walls of this gallery.",
+    "A cold crypt. Something drips somewhere in the dark.",
+    "A round chamber, its ceiling lost in shadow.",
+    "A narrow passage, you have to duck under the beams.",
+    "A small shrine, old candles melted into the floor.",
+    "A vault with empty shelves carved into the rock.",
+    "A damp cellar that smells of moss.",
+};
+static const char *const junkNames[] = {"Pebble", "Bone", "Coin", "Feather", "Shell", "Bead"};
+static const char *const junkTexts[] = {
+    "A smooth little pebble.", "An old bone, hopefully not human.", "A coin too worn to read.",
+    "A dusty feather.", "A shell, a long way from the sea.", "A glass bead.",
+};
+// plain things, the only component some of them get is a riddle (with the usual right and wrong lines)
+static const char *const thingNames[NAME_COUNT] = {
+    "Statue", "Mural", "Altar", "Fountain", "Lever", "Brazier",
+    "Pillar", "Tapestry", "Mirror", "Sarcophagus", "Bookshelf", "Idol",
+};
+static const char *const thingTexts[NAME_COUNT] = {
+    "A stone statue with its arms raised.", "A mural of people carrying something heavy.", "A plain altar, worn smooth.",
+    "A dry fountain.", "A rusted lever. It doesn't budge.", "A cold brazier full of ash.",
+    "A pillar covered in carvings.", "A moth eaten tapestry.", "A mirror, too dirty to see yourself in.",
+    "A closed sarcophagus. Better leave it that way.", "A bookshelf with rotten books.", "A small idol with ruby eyes.",
+};
+static const char *const riddles[][2] = {
+    {"What has keys but can't open locks?", "piano"},
+    {"What gets wetter the more it dries?", "towel"},
+    {"What has a face and two hands but no arms or legs?", "clock"},
+    {"The more you take, the more you leave behind. What are they?", "footsteps"},
+    {"What can you catch but not throw?", "cold"},
+    {"What has roots nobody sees and is taller than trees?", "mountain"},
+};
+
+#define COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+typedef struct
+{
+    GenOptions opt;
+    unsigned long long random;
+    int width; // rooms are a grid, row after row (only the last row can be short)
+    int height;
+    int *bandStart; // first row of each band (and one more for the end)
+    int *doorX;     // column of the locked door into each band (nothing for band 0)
+    int *keyFirst;  // item id of each lock's key, its pieces come right after it
+    int *keyDepth;
+    Room *rooms;
+    Item *items;
+    int itemCount;
+    Interactable *things;
+    Riddle *riddleParts; // in room order, so they come out sorted like the game wants its components
+    int riddleCount;
+    TextBuilder text;
+    // the texts lots of things share, looked up once instead of once per room
+    TextRef roomTexts[COUNT(roomTexts)];
+    TextRef doorTexts[COUNT(roomTexts)];
+    TextRef junkTexts[COUNT(junkTexts)];
+    TextRef thingNames[NAME_COUNT];
+    TextRef thingTexts[NAME_COUNT];
+    TextRef riddles[COUNT(riddles)][2];
+    bool failed; // ran out of memory somewhere
+} Generator;
+
+// splitmix64, same seed same world on every machine
+static unsigned long long NextRandom(Generator *g)
+{
+    unsigned long long z = (g->random += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static int RandomBelow(Generator *g, int n)
+{
+    return (int)(NextRandom(g) % (unsigned long long)n);
+}
+
+static TextRef GenText(Generator *g, const char *format, ...)
+{
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    TextRef ref = AddText(&g->text, text, false);
+    if (!ref)
+        g->failed = true;
+    return ref;
+}
+
+static void MakeSharedText(Generator *g)
+{
+    for (int i = 0; i < COUNT(roomTexts); i++)
+    {
+        g->roomTexts[i] = GenText(g, "%s", roomTexts[i]);
+        g->doorTexts[i] = GenText(g, "%s A heavy door to the south is locked.", roomTexts[i]);
+    }
+    for (int i = 0; i < COUNT(junkTexts); i++)
+        g->junkTexts[i] = GenText(g, "%s", junkTexts[i]);
+    for (int i = 0; i < NAME_COUNT; i++)
+    {
+        g->thingNames[i] = GenText(g, "%s", thingNames[i]);
+        g->thingTexts[i] = GenText(g, "%s", thingTexts[i]);
+    }
+    for (int i = 0; i < COUNT(riddles); i++)
+    {
+        g->riddles[i][0] = GenText(g, "%s", riddles[i][0]);
+        g->riddles[i][1] = GenText(g, "%s", riddles[i][1]);
+    }
+}
+
+static int BandFirstRoom(const Generator *g, int band)
+{
+    return g->bandStart[band] * g->width;
+}
+
+static int BandEndRoom(const Generator *g, int band)
+{
+    long long end = (long long)g->bandStart[band + 1] * g->width;
+    return end < g->opt.rooms ? (int)end : g->opt.rooms;
+}
+
+// a random room in [first, end) that still has space, the next one with space if it's full
+static bool PlaceItem(Generator *g, int item, int first, int end)
+{
+    int count = end - first;
+    int start = RandomBelow(g, count);
+    for (int i = 0; i < count; i++)
+    {
+        Room *room = &g->rooms[first + (start + i) % count];
+        if (room->itemCount < 10)
+        {
+            room->items[room->itemCount++] = item;
+            g->items[item].homeRoom = room->id;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void MakeItem(Generator *g, int id, TextRef name, TextRef description)
+{
+    Item *item = &g->items[id];
+    item->name = name;
+    item->description = description;
+    item->quantity = 1;
+    item->combineWith = -1;
+    item->resultItem = -1;
+    item->homeRoom = NO_ROOM;
+    item->nameHash = NameHash(g->text.hot + name);
+}
+
+// the key of a lock and its pieces, heap order: piece k is made from pieces 2k and 2k + 1 (k = 1 is the key)
+static bool MakeKey(Generator *g, int lock)
+{
+    int first = g->keyFirst[lock];
+    int pieces = (1 << (g->keyDepth[lock] + 1)) - 1;
+    TextRef shard = GenText(g, "A broken piece of something, it might fit with another piece.");
+    for (int k = 1; k <= pieces; k++)
+    {
+        if (k == 1)
+            MakeItem(g, first, GenText(g, "Key %d", lock + 1), GenText(g, "An iron key, the number %d is scratched into it.", lock + 1));
+        else
+            MakeItem(g, first + k - 1, GenText(g, "Shard %d.%d", lock + 1, k), shard);
+        if (k > 1)
+        {
+            // both ways around, so it doesn't matter which one the player says first
+            Item *item = &g->items[first + k - 1];
+            item->canCombine = true;
+            item->combineWith = first + (k ^ 1) - 1;
+            item->resultItem = first + k / 2 - 1;
+        }
+        if (k > pieces / 2 && !PlaceItem(g, first + k - 1, BandFirstRoom(g, lock), BandEndRoom(g, lock)))
+            return false;
+    }
+    return true;
+}
+
+static bool MakeRooms(Generator *g)
+{
+    int n = g->opt.rooms;
+    for (int id = 0; id < n; id++)
+    {
+        Room *room = &g->rooms[id];
+        int x = id % g->width, y = id / g->width;
+        int kind = RandomBelow(g, COUNT(roomNames));
+        room->id = id;
+        room->keyItem = -1;
+        room->name = GenText(g, "%s %d", roomNames[kind], id);
+        room->description = g->roomTexts[kind];
+        room->north = room->south = room->east = room->west = NO_ROOM;
+        if (x > 0)
+            room->west = id - 1;
+        if (x + 1 < g->width && id + 1 < n)
+            room->east = id + 1;
+        // up and down only inside a band, and through the one door between bands
+        int band = 0;
+        while (g->bandStart[band + 1] <= y)
+            band++;
+        if (y > g->bandStart[band] || (band > 0 && x == g->doorX[band]))
+            room->north = id - g->width;
+        if (id + g->width < n && (y + 1 < g->bandStart[band + 1] || x == g->doorX[band + 1]))
+        {
+            room->south = id + g->width;
+            if (y + 1 == g->bandStart[band + 1])
+                room->description = g->doorTexts[kind];
+        }
+        if (band > 0 && y == g->bandStart[band] && x == g->doorX[band])
+        {
+            room->isLocked = true;
+            room->keyItem = g->keyFirst[band - 1];
+        }
+    }
+    Room *gold = &g->rooms[n - 1];
+    gold->name = GenText(g, "Gold Room");
+    gold->description = GenText(g, "Gold everywhere! Piles of it, shining in the torch light.");
+    return !g->failed;
+}
+
+static bool MakeThings(Generator *g)
+{
+    int n = g->opt.rooms;
+    int total = g->opt.interactables;
+    // how many each room gets first, then every room's slice of the array
+    for (int i = 0; i < total; i++)
+    {
+        int start = RandomBelow(g, n);
+        for (int j = 0; j < n; j++)
+        {
+            Room *room = &g->rooms[(start + j) % n];
+            if (room->interactableCount < 10)
+            {
+                room->interactableCount++;
+                break;
+            }
+        }
+    }
+    int next = 0;
+    for (int id = 0; id < n; id++)
+    {
+        Room *room = &g->rooms[id];
+        if (!room->interactableCount)
+            continue;
+        Interactable *things = &g->things[next];
+        int name = RandomBelow(g, NAME_COUNT);
+        for (int j = 0; j < room->interactableCount; j++, next++)
+        {
+            Interactable *thing = &things[j];
+            int kind = (name + j) % NAME_COUNT;
+            thing->name = g->thingNames[kind];
+            thing->description = g->thingTexts[kind];
+            thing->nameHash = NameHash(thingNames[kind]);
+            // riddles spread evenly over all of them
+            if ((long long)(next + 1) * g->opt.riddles / total > (long long)next * g->opt.riddles / total)
+            {
+                int riddle = RandomBelow(g, COUNT(riddles));
+                Riddle *part = &g->riddleParts[g->riddleCount++];
+                part->of.room = id;
+                part->of.slot = j;
+                part->riddle = g->riddles[riddle][0];
+                part->answer = g->riddles[riddle][1];
+            }
+        }
+        room->interactables = things;
+    }
+    return !g->failed;
+}
+
+// sizes that don't work get fixed up (with a note), false if there's nothing to make
+static bool FixOptions(Generator *g)
+{
+    GenOptions *o = &g->opt;
+    if (o->rooms < 2 || o->rooms > MAX_WORLD_ROOMS)
+    {
+        fprintf(stderr, "worldgen: --rooms has to be between 2 and %d\n", MAX_WORLD_ROOMS);
+        return false;
+    }
+    g->width = 1;
+    while ((long long)g->width * g->width < o->rooms)
+        g->width++;
+    g->height = (o->rooms + g->width - 1) / g->width;
+    if (o->locks < 0)
+        o->locks = 0;
+    if (o->locks > g->height - 1)
+    {
+        fprintf(stderr, "worldgen: only room for %d locks (one band of rows each)\n", g->height - 1);
+        o->locks = g->height - 1;
+    }
+    if (o->recipeDepth < 0)
+        o->recipeDepth = 0;
+    if (o->recipeDepth > MAX_RECIPE_DEPTH)
+    {
+        fprintf(stderr, "worldgen: recipes go %d deep at most, more wouldn't fit in the bag\n", MAX_RECIPE_DEPTH);
+        o->recipeDepth = MAX_RECIPE_DEPTH;
+    }
+    long long space = 10LL * o->rooms;
+    if (o->items > space - 1)
+        o->items = (int)(space - 1);
+    if (o->interactables < 0)
+        o->interactables = 0;
+    if (o->interactables > space)
+        o->interactables = (int)space;
+    if (o->riddles > o->interactables)
+        o->riddles = o->interactables;
+    if (o->riddles < 0)
+        o->riddles = 0;
+    return true;
+}
+
+static bool Generate(Generator *g)
+{
+    const GenOptions *o = &g->opt;
+    g->random = o->seed;
+    int bands = o->locks + 1;
+    g->bandStart = calloc(bands + 1, sizeof(int));
+    g->doorX = calloc(bands + 1, sizeof(int));
+    g->keyFirst = calloc(bands, sizeof(int));
+    g->keyDepth = calloc(bands, sizeof(int));
+    g->rooms = calloc(o->rooms, sizeof(Room));
+    g->things = calloc(o->interactables + 1, sizeof(Interactable));
+    g->riddleParts = calloc(o->riddles + 1, sizeof(Riddle));
+    if (!g->bandStart || !g->doorX || !g->keyFirst || !g->keyDepth || !g->rooms || !g->things || !g->riddleParts)
+        return false;
+
+    for (int b = 0; b <= bands; b++)
+        g->bandStart[b] = (int)((long long)b * g->height / bands);
+    g->doorX[bands] = -1;
+    for (int b = 1; b < bands; b++)
+    {
+        int row = g->bandStart[b] * g->width;
+        int rowWidth = o->rooms - row < g->width ? o->rooms - row : g->width;
+        g->doorX[b] = RandomBelow(g, rowWidth);
+    }
+
+    // item 0 is the Rucksack, then every key with its pieces, then junk
+    int count = 1;
+    for (int lock = 0; lock < o->locks; lock++)
+    {
+        g->keyDepth[lock] = o->recipeDepth ? RandomBelow(g, o->recipeDepth + 1) : 0;
+        g->keyFirst[lock] = count;
+        count += (1 << (g->keyDepth[lock] + 1)) - 1;
+    }
+    g->itemCount = count > o->items ? count : o->items;
+    if (g->itemCount > MAX_WORLD_ITEMS)
+    {
+        fprintf(stderr, "worldgen: that's more than %d items\n", MAX_WORLD_ITEMS);
+        return false;
+    }
+    g->items = calloc(g->itemCount, sizeof(Item));
+    MakeSharedText(g);
+    if (!g->items || !MakeRooms(g) || !MakeThings(g))
+        return false;
+
+    MakeItem(g, 0, GenText(g, "Rucksack"), GenText(g, "A sturdy old rucksack, you could carry a lot more with it."));
+    PlaceItem(g, 0, 0, 1);
+    for (int lock = 0; lock < o->locks; lock++)
+    {
+        if (!MakeKey(g, lock))
+        {
+            fprintf(stderr, "worldgen: band %d is too small for the pieces of its key, use fewer locks or less recipe depth\n", lock);
+            return false;
+        }
+    }
+    for (int id = count; id < g->itemCount; id++)
+    {
+        int kind = RandomBelow(g, COUNT(junkNames));
+        MakeItem(g, id, GenText(g, "%s %d", junkNames[kind], id), g->junkTexts[kind]);
+        if (!PlaceItem(g, id, 0, o->rooms))
+            return false;
+    }
+    return !g->failed;
+}
+
+// ----- the solution -----
+
+static void WalkTo(FILE *out, const Generator *g, int *at, int to)
+{
+    int x = *at % g->width, y = *at / g->width;
+    int toX = to % g->width, toY = to / g->width;
+    // only the last row can be short: go up or down first if the column goes all the way, else across first
+    bool upDownFirst = toY * g->width + x < g->opt.rooms;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if ((pass == 0) == upDownFirst)
+        {
+            for (; y < toY; y++)
+                fprintf(out, "south\n");
+            for (; y > toY; y--)
+                fprintf(out, "north\n");
+        }
+        else
+        {
+            for (; x < toX; x++)
+                fprintf(out, "east\n");
+            for (; x > toX; x--)
+                fprintf(out, "west\n");
+        }
+    }
+    *at = to;
+}
+
+static const char *ItemName(const Generator *g, int item)
+{
+    return g->text.hot + g->items[item].name;
+}
+
+// pick up the pieces in an order where two always get put together as soon as they can
+static void CollectPiece(FILE *out, const Generator *g, int lock, int k, int *at)
+{
+    int first = g->keyFirst[lock];
+    int item = first + k - 1;
+    if (g->items[item].homeRoom != NO_ROOM)
+    {
+        WalkTo(out, g, at, g->items[item].homeRoom);
+        fprintf(out, "take %s\n", ItemName(g, item));
+        return;
+    }
+    CollectPiece(out, g, lock, 2 * k, at);
+    CollectPiece(out, g, lock, 2 * k + 1, at);
+    fprintf(out, "combine %s %s\n", ItemName(g, first + 2 * k - 1), ItemName(g, first + 2 * k));
+}
+
+static bool WriteSolution(const Generator *g, const char *path)
+{
+    FILE *out = fopen(path, "w");
+    if (!out)
+    {
+        perror("Failed to create the solution file");
+        return false;
+    }
+    int at = 0;
+    fprintf(out, "take Rucksack\n");
+    for (int lock = 0; lock < g->opt.locks; lock++)
+    {
+        CollectPiece(out, g, lock, 1, &at);
+        int door = g->bandStart[lock + 1] * g->width + g->doorX[lock + 1];
+        WalkTo(out, g, &at, door - g->width);
+        fprintf(out, "use %s south door\nsouth\n", ItemName(g, g->keyFirst[lock]));
+        at = door;
+    }
+    WalkTo(out, g, &at, g->opt.rooms - 1);
+    if (fclose(out) != 0)
+    {
+        perror("Failed to write the solution file");
+        return false;
+    }
+    return true;
+}
+
+static void FreeGenerator(Generator *g)
+{
+    free(g->bandStart);
+    free(g->doorX);
+    free(g->keyFirst);
+    free(g->keyDepth);
+    free(g->rooms);
+    free(g->items);
+    free(g->things);
+    free(g->riddleParts);
+    FreeTextBuilder(&g->text);
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <page file>\n"
+            "  --seed n             which world (default 1)\n"
+            "  --rooms n            default 1000\n"
+            "  --items n            items in total, at least what the keys need (default one per room)\n"
+            "  --interactables n    default one per two rooms\n"
+            "  --riddles n          how many interactables ask a riddle (default one in ten)\n"
+            "  --locks n            locked doors on the way to the Gold Room (default 10)\n"
+            "  --recipe-depth n     keys come in up to 2^n pieces that have to be combined (default 2, at most %d)\n"
+            "  --solution file      write the commands that win it\n"
+            "  --validate           run the validator on it too\n"
+            "  --compress-text      like the game's --compress-text\n",
+            name, MAX_RECIPE_DEPTH);
+}
+
+int main(int argc, char *argv[])
+{
+    Generator g = {0};
+    GenOptions *o = &g.opt;
+    o->seed = 1;
+    o->rooms = 1000;
+    o->items = -1;
+    o->interactables = -1;
+    o->riddles = -1;
+    o->locks = 10;
+    o->recipeDepth = 2;
+    const char *path = NULL;
+    const char *solutionPath = NULL;
+    bool validate = false, compress = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            o->seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--rooms") == 0 && i + 1 < argc)
+            o->rooms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--items") == 0 && i + 1 < argc)
+            o->items = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--interactables") == 0 && i + 1 < argc)
+            o->interactables = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--riddles") == 0 && i + 1 < argc)
+            o->riddles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--locks") == 0 && i + 1 < argc)
+            o->locks = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--recipe-depth") == 0 && i + 1 < argc)
+            o->recipeDepth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--solution") == 0 && i + 1 < argc)
+            solutionPath = argv[++i];
+        else if (strcmp(argv[i], "--validate") == 0)
+            validate = true;
+        else if (strcmp(argv[i], "--compress-text") == 0)
+            compress = true;
+        else if (argv[i][0] != '-' && !path)
+            path = argv[i];
+        else
+        {
+            Usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!path)
+    {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (o->items < 0)
+        o->items = o->rooms;
+    if (o->interactables < 0)
+        o->interactables = o->rooms / 2;
+    if (o->riddles < 0)
+        o->riddles = o->interactables / 10;
+    if (!FixOptions(&g))
+        return EXIT_FAILURE;
+
+    long long start = NowMs();
+    if (!Generate(&g))
+    {
+        if (g.failed || !g.rooms || !g.items)
+            fprintf(stderr, "worldgen: Memory fail - couldn't make the world\n");
+        FreeGenerator(&g);
+        return EXIT_FAILURE;
+    }
+    WorldTables tables = {g.text.hot, g.text.hotSize, g.rooms, o->rooms, 0, g.items, g.itemCount, {0}};
+    tables.parts.riddles = g.riddleParts;
+    tables.parts.riddleCount = g.riddleCount;
+    World *world = OpenTableWorld(&tables);
+    bool ok = world != NULL;
+    if (ok && validate)
+        ok = ValidateWorld(world, 0, stdout) == 0;
+    if (ok)
+        ok = SaveWorld(path, world, compress);
+    if (ok && solutionPath)
+        ok = WriteSolution(&g, solutionPath);
+    if (ok)
+        printf("%s: %d rooms, %d items, %d interactables (%d riddles), %d locks, made in %lld ms\n", path, o->rooms,
+               g.itemCount, o->interactables, o->riddles, o->locks, NowMs() - start);
+    if (world)
+        CloseWorld(world);
+    FreeGenerator(&g);
+    return ok ? 0 : EXIT_FAILURE;
+}